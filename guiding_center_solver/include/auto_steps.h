@@ -0,0 +1,47 @@
+#pragma once
+#include <Eigen/Dense>
+
+/**
+ * @brief 由局地物理尺度选择积分步长和差分步长 (Solver --auto-steps[=N])
+ *
+ * 不再使用 .para 中的 dt（只取其符号，即正向或反向积分）和 r_step：
+ *  - dt = min(弹跳周期, 波场最短周期) / N（默认 N = 1000），并取为 write_interval 的整数分之一，
+ *    输出记录的时刻与固定步长时相同；
+ *  - r_step = 1e-3 × B / |grad B|（磁场梯度尺度）。
+ * 弹跳周期由偶极近似估计：磁纬 λ 取自当地磁场的倾角 (tan I = 2 tan λ)，L = r / cos^2 λ，
+ * 赤道磁场 B_eq = B cos^6 λ / sqrt(1 + 3 sin^2 λ)，赤道投掷角 sin^2 α_eq = B_eq / Bm，
+ * τb = 4 L / v × (1.3802 - 0.3198 (y + sqrt(y)))，y = sin α_eq。
+ * 积分开始时选择一次，之后每个输出记录处重新估计，与当前值相差一倍以上时才改变（写入粒子日志）。
+ * Diagnosor 仍使用 .para 中的 t_step 和 r_step。
+ */
+
+namespace auto_steps {
+
+// 默认每个弹跳周期（或波周期）的步数
+const double DEFAULT_STEPS_PER_PERIOD = 1000.0;
+// r_step 与磁场梯度尺度之比
+const double R_STEP_FRACTION = 1e-3;
+// 新的选择与当前值之比超过该值时才改变
+const double HYSTERESIS = 2.0;
+
+struct Scales {
+    double L = 0.0, lambda = 0.0;   // 偶极近似的 L 和磁纬 [rad]
+    double B = 0.0;                 // |B| [nT]
+    double grad_length = 0.0;       // B / |grad B| [RE]
+    double tau_b = 0.0;             // 估计的弹跳周期 [s]
+    double wave_period = 0.0;       // 波场最短周期 [s]，没有波场时为 HUGE_VAL
+};
+
+// 状态 Y = (t, x, y, z, p_para) 处的局地尺度（用全局的 E0, mu, r_step 和场模型）
+Scales local_scales(const Eigen::VectorXd& Y);
+
+// 每个输出间隔的步数：dt = write_interval / 返回值 不超过 min(τb, 波周期) / steps_per_period
+int steps_per_write(const Scales& s, double write_interval, double steps_per_period);
+
+// 差分步长 [RE]
+double r_step_for(const Scales& s);
+
+// new_value 与 value 之比是否超出 HYSTERESIS
+bool changed(double value, double new_value);
+
+} // namespace auto_steps
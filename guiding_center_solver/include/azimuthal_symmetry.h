@@ -0,0 +1,51 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 方位对称去重 (Solver --symmetry[=TOL])
+ *
+ * 偶极场 (magnetic_field_model = 0) 且没有波场 (wave_field_model = 0) 时，场在 SM 坐标中绕 z 轴对称：
+ * 其他参数都相同、初始位置在 SM 坐标中只差一个绕 z 轴的转角 Δφ（同样的 ρ_SM 和 z_SM，即同样的 L 和 MLAT，
+ * 不同的 MLT）的粒子属于同一对称类。每类只积分一个代表粒子，其余粒子的轨迹由代表粒子的记录得到：
+ * 在各记录时刻把位置转到 SM 坐标，绕 z 轴转 Δφ，再转回 GSM（p_para 不变）。
+ *
+ * 偶极倾角 ψ 随时间变化，SM 坐标系绕 GSM y 轴以 dψ/dt 相对 GSM 转动，GSM 中的导心方程多出
+ * 不对称的一项，速度偏差不超过 |dψ/dt| r。粒子在偶极场中 r <= L，于是转出的轨迹与单独积分的偏差
+ * 不超过 L × (积分区间内 ψ 的全变差)，作为每类的偏差上限写入主日志；给出 TOL [RE] 时上限超过 TOL 的类
+ * 不去重。倾角不变时转出的轨迹与单独积分只差舍入误差。
+ */
+
+namespace symmetry {
+
+// 初始位置的 ρ_SM、z_SM 相同的判据 [RE]
+const double POSITION_TOL = 1e-9;
+// 转出的轨迹的结果缓存键：solver_cache_key 加此后缀（与积分的结果区分）
+const char* const KEY_SUFFIX = "+symmetry";
+
+struct Member {
+    std::string para_file;
+    double dphi = 0.0;      // 相对代表粒子绕 SM z 轴的转角 [rad]
+};
+
+struct Class {
+    std::string representative;
+    std::vector<Member> members;    // 不含代表粒子
+    double deviation = 0.0;         // 倾角变化造成的偏差上限 [RE]
+};
+
+/**
+ * @brief 把粒子按对称类分组（只考虑偶极场、无波场的粒子）
+ * @param tol 偏差上限超过 tol [RE] 的类不去重，放入 rejected
+ * @return 至少有两个粒子、偏差上限不超过 tol 的类
+ */
+std::vector<Class> find_classes(const std::vector<std::string>& para_files, double tol, std::vector<Class>& rejected);
+
+/**
+ * @brief 由代表粒子的输出写出成员的轨迹（按当前的 --profile 和 --encoding）、日志 (log/<name>.log) 和结果缓存标记
+ * @return 代表粒子的轨迹无法读取或输出文件无法写入时返回 false，原因写入 log
+ */
+bool emit(const std::string& representative, const Member& member, std::ostream& log);
+
+} // namespace symmetry
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "cpu_affinity.h"
+
+/**
+ * @brief 批处理调度
+ *
+ * 粒子之间的计算量相差很大（步数、场模型、是否提前进入大气层）。主进程先估计每个粒子的耗时，
+ * 再按从大到小的顺序分派：同时运行至多 jobs 个子进程，任一子进程结束就启动队列中的下一个
+ * （最长任务优先的列表调度），总耗时接近 总CPU时间 / jobs，而不是被最后启动的大任务拖住。
+ *
+ * 耗时估计 = 积分步数 × 每步耗时。每步耗时按场模型取相对系数
+ * （磁场: 偶极子 1, IGRF 5；波场: 无 0, 简谐波 1, 宽带波 3），
+ * 用历史记录 (log/cost_history.tsv) 校准；同名、同步数、同模型的粒子直接使用上次的实际耗时。
+ *
+ * 分片 (--shard=k/N)：把一个粒子集合分给 N 个节点。只用静态估计（不用各节点不同的历史记录），
+ * 按 估计耗时从大到小、文件名 的顺序依次分给当前负载最小的分片，因此同一组 .para 文件
+ * 在任何节点上得到同样的划分。每个分片的日志、汇总和历史记录带 ".shard<k>of<N>" 后缀，
+ * 由 Solver --merge-shards 合并。
+ */
+
+struct BatchJob {
+    std::string para_file;
+    std::string name;               // .para 文件名（不含扩展名）
+    int64_t steps = 0;
+    int magnetic_field_model = 0;
+    int wave_field_model = 0;
+    double cost = 0.0;              // 估计耗时 [s]
+    std::string cost_source;        // "model" / "fitted" / "history"
+    double elapsed = 0.0;           // 实际耗时 [s]
+    int status = 0;                 // 子进程退出状态
+    double weight = 1.0;            // 统计权重（--split 的分裂和轮盘赌，见 importance_splitting.h）
+    std::vector<std::string> members;   // 集合积分 (--ensemble)：在同一子进程中一起积分的粒子（第一个为 para_file）
+};
+
+// 读取 .para 文件并估计耗时（可以有多个历史记录文件），返回按估计耗时从大到小排序的任务
+std::vector<BatchJob> plan_batch(const std::vector<std::string>& para_files, const std::vector<std::string>& history_paths);
+
+/**
+ * @brief 执行任务：每个任务一个子进程 (exe para_file [forwarded...])
+ * @param max_jobs 同时运行的子进程数上限
+ * @param entry    非空时（仅 POSIX）子进程 fork 后直接调用 entry(para_file)，不再 exec，
+ *                 继承主进程已加载的库和配置
+ * @param placement 非空时每个槽位的子进程绑定在槽位的 CPU 上（见 cpu_affinity.h）；
+ *                 与 entry 同时给出且有多个 NUMA 节点时，由各节点的服务进程 fork 子进程
+ */
+void run_batch(std::vector<BatchJob>& jobs, int max_jobs, const std::string& exe,
+               const std::vector<std::string>& forwarded, std::ostream& log,
+               int (*entry)(const std::string&) = nullptr, const affinity::Placement* placement = nullptr);
+
+// 追加本次的实际耗时到历史记录
+void append_history(const std::string& history_path, const std::vector<BatchJob>& jobs);
+
+// 默认并行数：CPU 核数
+int default_jobs();
+
+// 选出第 k 个分片（0 <= k < n）的 .para 文件，保持输入顺序
+std::vector<std::string> select_shard(const std::vector<std::string>& para_files, int k, int n);
+
+// 分片文件名后缀：n == 1 时为空，否则为 ".shard<k>of<n>"
+std::string shard_suffix(int k, int n);
+
+// 每个粒子一行的运行汇总 (log/summary.tsv)
+void write_summary(const std::string& path, const std::vector<BatchJob>& jobs, int shard_index, int shard_count);
+
+// 合并 logDir 中各分片的 main/summary/cost_history，返回 false 表示没有找到分片或分片不完整
+bool merge_shards(const std::string& logDir, std::ostream& out);
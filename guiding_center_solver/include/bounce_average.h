@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <Eigen/Dense>
+
+/**
+ * @brief 弹跳平均的漂移积分 (Solver --bounce-average[=R])
+ *
+ * 缓变场中的捕获粒子只关心漂移时，不再逐个弹跳地积分：沿磁力线在两个镜点之间求弹跳积分
+ * （弹跳周期 τb、I = ∫ sqrt(1 - B/Bm) ds、漂移速度的弹跳平均），
+ * 以漂移壳/相位坐标 (L, φ) 和动量 p 为状态做 RK4，步长为漂移周期的几十分之一。
+ * (L, φ) 是磁力线与 SM 赤道面交点的偶极坐标：偶极子场中是磁力线的精确标记，IGRF 中是近似。
+ * mu 守恒，镜点磁场 Bm = (pc)^2 / (2 E0 mu)；波电场对漂移做的功 q<E·vd> 改变 p。
+ *
+ * 输出记录仍为 (t, x, y, z, p_para)：磁力线上 B 最小的点和该点的平行动量，即弹跳平均的导心。
+ * 以下情况改为完整的导心积分（从 B 最小点、p_para >= 0 继续）：
+ *  - 绝热性判据不满足：波场最短周期 < R τb（默认 R = 10）
+ *  - 镜点在大气层以下（损失锥）、磁力线不闭合或追踪失败
+ */
+
+namespace bounce_avg {
+
+// 默认的绝热性判据：波场最短周期至少为弹跳周期的 10 倍
+const double DEFAULT_RATIO = 10.0;
+
+// 一条磁力线上的弹跳积分（某一时刻）
+struct Integrals {
+    double L = 0.0, phi = 0.0;          // 磁力线与 SM 赤道面交点的偶极坐标 [RE], [rad]
+    Eigen::Vector3d eq = Eigen::Vector3d::Zero();   // 磁力线上 B 最小的点 (GSM) [RE]
+    double B_eq = 0.0, B_m = 0.0;       // B 最小值、镜点磁场 [nT]
+    double tau_b = 0.0;                 // 弹跳周期 [s]
+    double I = 0.0;                     // ∫ sqrt(1 - B/Bm) ds（镜点之间）[RE]
+    double dL_dt = 0.0, dphi_dt = 0.0;  // 弹跳平均的漂移 [RE/s], [rad/s]
+    double dp_dt = 0.0;                 // 弹跳平均的动量变化率 [MeV/RE]
+};
+
+// 漂移壳坐标中的状态，at 为当前状态的弹跳积分（也是下一步 RK4 的第一级）
+struct State {
+    double t = 0.0, L = 0.0, phi = 0.0, p = 0.0;
+    Integrals at;
+};
+
+// 从导心状态 Y = (t, x, y, z, p_para) 开始（用全局的 E0, mu, q, r_step），r_min 为大气层边界 [RE]
+// 失败时返回 false，reason 给出原因
+bool init(const Eigen::VectorXd& Y, double r_min, State& s, std::string& reason);
+
+// 前进 h [s]（可为负），失败时 s 不变
+bool step(State& s, double h, double r_min, std::string& reason);
+
+// 下一步的步长 [s]：漂移周期的 1/64，L 的变化不超过 0.01，不超过波场最短周期的 1/16
+double suggested_step(const State& s, double wave_period);
+
+// 弹跳平均导心的记录 (t, x, y, z, p_para)
+Eigen::VectorXd guiding_center(const State& s);
+
+} // namespace bounce_avg
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "particle_params.h"
+
+/**
+ * @brief 单粒子积分的检查点 (output/<name>.ckpt)
+ *
+ * 积分过程中定期写入（--checkpoint=S，按墙钟时间），先写 <name>.ckpt.tmp 再改名，
+ * 任何时刻磁盘上的检查点都是完整的。写检查点前先把轨迹文件已写出的部分交给系统，
+ * 检查点中记录轨迹文件的长度和写入器状态；--resume 时截断轨迹到该长度并从下一步继续，
+ * 结果与不中断的积分逐位相同。粒子正常结束后删除检查点。
+ * 检查点还记录本次运行的结果缓存键 (solver_cache_key：.para 数值、波场配置文件、可执行文件和
+ * 影响结果的选项)，键不同的检查点不能继续，从头开始。
+ *
+ * 文件格式（本机字节序）：
+ *   "GCKP", int32 version, ParticleParams 的 14 个 double 和 2 个 int32,
+ *   int32 profile, int32 encoding, int32 window, int64 len, 结果缓存的键 (len 字节),
+ *   int64 step, int64 write_count, double Y[5], double mu, double dt, double r_step, int64 next_write,
+ *   int32 has_wave_seed, uint32 wave_seed,
+ *   int64 len, 写入器状态 (len 字节), int64 len, 事件记录写入器状态 (len 字节，无 --events 时为 0),
+ *   int64 len, 积分器状态 (len 字节，无 --multirate 时为 0),
+ *   int64 len, 切线性方程的状态 (len 字节，无 --variational 时为 0), uint64 校验和 (之前全部内容的 FNV-1a)
+ */
+struct Checkpoint {
+    ParticleParams params;
+    int32_t profile = 0, encoding = 0, window = 0;
+    std::string key;            // 结果缓存的键 (solver_cache_key)
+    int64_t step = 0;           // 已完成的积分步数
+    int64_t write_count = 0;    // 已写出的记录数
+    double Y[5] = {0, 0, 0, 0, 0};
+    double mu = 0.0;            // 第一绝热不变量
+    double dt = 0.0;            // 积分步长
+    double r_step = 0.0;        // 差分步长（--auto-steps 时随积分改变）
+    int64_t next_write = 0;     // 下一个输出记录的步数
+    int32_t has_wave_seed = 0;
+    uint32_t wave_seed = 0;     // 宽带波随机相位的种子
+    std::string writer_state;   // TrajectoryWriter::checkpoint()
+    std::string events_state;   // 事件记录 (.gce) 写入器的 checkpoint()，无 --events 时为空
+    std::string integrator_state; // multirate::Integrator::checkpoint()，无 --multirate 时为空
+    std::string variational_state; // variational::checkpoint()（Φ 和 .gcv 写入器），无 --variational 时为空
+};
+
+// 原子地写入检查点，失败返回 false
+bool save_checkpoint(const std::string& path, const Checkpoint& ck);
+
+// 读取检查点，文件不存在、损坏或版本不符时返回 false
+bool load_checkpoint(const std::string& path, Checkpoint& ck);
+
+// 检查点是否属于同一次运行（.para 内容、输出方案和结果缓存的键都相同）
+bool checkpoint_matches(const Checkpoint& ck, const ParticleParams& params, int profile, int encoding, int window,
+                        const std::string& key);
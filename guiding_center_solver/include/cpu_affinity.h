@@ -0,0 +1,46 @@
+#pragma once
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 绑核与 NUMA 放置 (--pin)
+ *
+ * 批处理的每个槽位（同时运行的一个子进程）固定在一个 CPU 上：槽位依次轮流取各 NUMA 节点的 CPU，
+ * 节点内先取物理核、再取超线程，因此子进程均匀分布在各插槽上，并且不会在核之间迁移。
+ * CPU 和节点从 /sys/devices/system/node 读取，只用本进程允许使用的 CPU（taskset、cgroup）。
+ *
+ * 子进程绑核后才分配内存（exec 模式下重新读取波场配置），按首次写入分配在本节点上。
+ * 预 fork 模式下，主进程加载的只读表位于主进程所在的节点；有多个节点时，每个节点 fork 一个服务进程，
+ * 服务进程绑定在本节点的 CPU 上，重建这些表（localize，写入即在本节点得到一份副本），
+ * 再为分到本节点槽位的粒子 fork 子进程。
+ *
+ * 只支持 Linux（sched_setaffinity）和 Windows（SetProcessAffinityMask，只有一个节点）；
+ * 其他系统上 plan 返回空的放置，不绑核。
+ */
+
+namespace affinity {
+
+struct Placement {
+    std::vector<std::vector<int>> node_cpus;    // 每个 NUMA 节点可用的 CPU
+    std::vector<int> slot_cpus;                 // 每个槽位的 CPU，为空时不绑核
+    std::vector<int> slot_nodes;                // 每个槽位的节点
+    std::function<void()> localize;             // 预 fork 模式：各节点的服务进程中重建只读表
+
+    bool empty() const { return slot_cpus.empty(); }
+};
+
+// 为 slots 个槽位分配 CPU；无法读取拓扑或不支持绑核时返回空的放置
+Placement plan(int slots);
+
+// 当前进程（及其之后创建的子进程）只在这些 CPU 上运行，失败返回 false
+bool pin_current_process(const std::vector<int>& cpus);
+
+// CPU 列表的紧凑写法，如 "0-3,8,10-11"
+std::string cpu_list(const std::vector<int>& cpus);
+
+// 写入日志：各节点的 CPU 和各槽位的 CPU
+void describe(const Placement& placement, std::ostream& log);
+
+} // namespace affinity
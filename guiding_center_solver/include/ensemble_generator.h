@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "particle_params.h"
+
+/**
+ * @brief 粒子集合生成器（input 目录下的 .gen 文件）
+ *
+ * 在主进程内存中生成粒子，不写 .para 文件。.gen 文件每行 "key = value"，';' 或 '#' 之后为注释：
+ *   - .para 的参数名 = 数值：所有粒子共用的参数
+ *   - 维度 = 分布：L, MLT, MLAT, Ek, pa, t_ini 之一，分布为
+ *       linear a, b, n      a 到 b 等间距 n 个点（含两端）；抽样时 [a, b] 均匀分布
+ *       log a, b, n         对数等间距；抽样时对数均匀分布
+ *       values v1, v2, ...  列出的值；抽样时等概率取一个
+ *       isotropic a, b, n   投掷角 [deg]，按立体角均匀（密度 ∝ sin(pa)）
+ *       sin k, a, b, n      投掷角 [deg]，通量 ∝ sin^k(pa)（密度 ∝ sin^(k+1)(pa)）
+ *     数值也可以直接写作常数，如 "MLAT = 0"。
+ *   - sampling = grid | sobol N | random N：各维度的笛卡尔积网格（默认），或 N 个 Sobol 准随机点 / 伪随机点
+ *   - seed = S：random 的随机数种子；sobol 的数字移位（0 为不移位）。同样的 .gen 和 seed 得到同样的粒子
+ *
+ * 给出 L 时，初始位置由 (L, MLT, MLAT) 在 SM 坐标中确定（偶极场线 r = L cos^2(MLAT)，MLT 12 为正午），
+ * 再按 t_ini 用 Geopack 转换到 GSM；否则 xgsm, ygsm, zgsm 必须作为共用参数给出。
+ *
+ * 每个粒子有一个权重：它在生成变量 (L, MLT, MLAT, Ek, pa, t_ini) 空间中代表的体积，
+ * 网格为各维度单元宽度之积（端点取半个间距，isotropic/sin 取等概率单元的宽度），
+ * 抽样为 1 / (N × 抽样概率密度)；常数维度不计入，values 维度相当于对列出的值求和。
+ * 于是 Σ weight × g(粒子) ≈ ∫ g dL dMLT dMLAT dEk dpa dt_ini（只含非常数维度），可用于通量重建。
+ */
+
+namespace ensemble {
+
+struct Member {
+    std::string name;       // <.gen 文件名>_<序号>
+    ParticleParams params;
+    double L = 0.0, MLT = 0.0, MLAT = 0.0;  // 没有给出 L 时为 0
+    double weight = 1.0;
+};
+
+/**
+ * @brief 生成 gen_file 描述的全部粒子，依次调用 emit
+ * @return 文件无法打开或格式错误时返回 false（错误信息输出到 cerr）
+ */
+bool generate(const std::string& gen_file, const std::function<void(const Member&)>& emit);
+
+// 写出粒子表 (name, L, MLT, MLAT, Ek, pa, t_ini, xgsm, ygsm, zgsm, weight)，制表符分隔
+bool write_table(const std::string& gen_file, const std::string& path);
+
+} // namespace ensemble
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/**
+ * @brief 集合积分 (Solver --ensemble[=N])
+ *
+ * dt、t_ini 和场模型都相同的粒子，每一步 RK4 各级的时刻都相同，recalc 的结果、
+ * 宽带波各频率分量的时间因子对整组粒子都一样。这样的一组粒子放在一个子进程中同步积分：
+ * 状态 (x, y, z, p_para) 和每个粒子的常数 (mu, E0, q, r_step) 按分量连续存放 (SoA)，
+ * RK4 的每一级对整组一起求导：中心点和求梯度用的 6 个邻点（7n 个点，同一时刻）
+ * 一次 field_batch::evaluate，deb_dt 的 2n 个点（t ± r_step/|v|）再一次。
+ * 其余计算与 dydt 逐项相同，背景场和简谐波下结果与逐个粒子运行完全一致，宽带波只差舍入误差。
+ *
+ * 进入大气层或到达各自终点的粒子不再更新（掩码），结束的粒子多于四分之一时从数组中移除（压缩）。
+ * 每个粒子的输出文件、日志 (log/<name>.log) 和结果缓存标记与单独运行时相同；不写检查点。
+ */
+
+namespace lockstep {
+
+// 默认每组粒子数 (--ensemble)
+const int DEFAULT_SIZE = 32;
+// 每组粒子数上限（每个粒子同时打开日志和输出文件）
+const int MAX_SIZE = 256;
+
+// 把可以一起积分的粒子（dt, t_ini, 场模型都相同）按原顺序分组，每组至多 size 个；读不了参数的粒子单独成组
+std::vector<std::vector<std::string>> group(const std::vector<std::string>& para_files, int size);
+
+// 子进程：一起积分一组粒子，全部成功返回 0
+int run(const std::vector<std::string>& para_files);
+
+} // namespace lockstep
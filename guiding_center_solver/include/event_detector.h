@@ -0,0 +1,73 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+/**
+ * @brief 事件检测 (Solver --events=LIST)
+ *
+ * 每一步 RK4 之后检查各事件函数 g(t, Y) 是否变号；变号时用该步的三次 Hermite 插值
+ * （两端的状态和 dydt）求根，得到事件的时刻和状态，精度不再受 dt 限制。
+ *
+ * LIST 逗号分隔，每项为 name[=value][:stop]，:stop 表示发生该事件时结束积分：
+ *  - mirror            镜点，p_para = 0
+ *  - equator           穿过 SM 赤道面，z_SM = 0
+ *  - atmosphere        进入大气层，r = 1 + atmosphere_altitude / 6371（总是结束积分）
+ *  - lmax=L            偶极 L 越过 L（SM 坐标）
+ *  - magnetopause[=Dp] 越过 Shue et al. (1998) 磁层顶，动压 Dp [nPa]（默认 2），IMF Bz = 0
+ *
+ * 事件记录 output/<name>.gce：前缀 "GCEV", int32 count，之后每个事件 7 个 double：
+ *   t, x, y, z, p_para（与轨迹记录相同），type（EventType），direction（g 增大为 +1，减小为 -1）
+ */
+
+namespace events {
+
+enum EventType { MIRROR = 0, EQUATOR = 1, ATMOSPHERE = 2, LMAX = 3, MAGNETOPAUSE = 4 };
+
+const int NCOLS = 7;
+
+// 事件名（与 --events 中相同）
+const char* event_name(int type);
+
+// Shue et al. (1998) 磁层顶（IMF Bz = 0）在与 +x 夹角 theta 方向上的距离 [RE]，动压 Dp [nPa]
+double magnetopause_distance(double Dp, double cos_theta);
+
+struct Event {
+    int type = MIRROR;
+    double value = 0.0;     // lmax: L, magnetopause: Dp [nPa]
+    bool stop = false;
+};
+
+// 解析 --events 的值，格式错误时返回 false，error 给出原因
+bool parse_events(const std::string& spec, std::vector<Event>& events, std::string& error);
+
+// 定位得到的事件
+struct Crossing {
+    int type = MIRROR;
+    int direction = 0;
+    bool stop = false;
+    Eigen::VectorXd Y;      // (t, x, y, z, p_para)
+};
+
+class Detector {
+public:
+    // r_atmosphere: 大气层边界 [RE]
+    Detector(const std::vector<Event>& events, double r_atmosphere);
+
+    // 从状态 Y 开始（或重新开始）检测
+    void start(const Eigen::VectorXd& Y);
+
+    // 一步 RK4 之后调用：Y0 -> Y1，k1 = dydt(Y0)，步长 dt。
+    // 该步中的事件按时间顺序追加到 found，返回 true 表示其中有结束积分的事件（之后的事件不再记录）
+    bool check(const Eigen::VectorXd& Y0, const Eigen::VectorXd& k1, const Eigen::VectorXd& Y1, double dt,
+               std::vector<Crossing>& found);
+
+private:
+    double g(const Event& e, const Eigen::VectorXd& Y) const;
+
+    std::vector<Event> events_;
+    double r_atmosphere_;
+    std::vector<double> g_prev_;
+};
+
+} // namespace events
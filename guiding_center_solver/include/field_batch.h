@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+
+/**
+ * @brief 批量计算一组点的场（集合积分 --ensemble 使用，见 ensemble_integrator.h）
+ *
+ * 逐点的 Bvec/Evec 每次都要 gmtime + recalc（背景场和波场各一次），而 recalc 只取决于 t 的整秒：
+ * 这里同一整秒内的点共用一次 recalc，然后直接读 Geopack 公共区中的倾角、旋转矩阵和 IGRF 系数，
+ * 对连续存放 (SoA) 的坐标逐点计算，不再经过 Fortran 调用。
+ *  - 偶极子、IGRF：照搬 DIP_08 / IGRF_GSW_08 的计算顺序，结果与 dipole_bg / igrf_bg 相同
+ *  - 简谐波 (1, 2)：SM 坐标转换在这里做，分量函数与逐点计算相同，结果相同
+ *  - 宽带波 (3, 4)：各频率分量的时间因子之和对同一时刻的点只算一次 (temporal_sums)，
+ *    每点的计算量不再随频率分量数增长；与逐点计算只差舍入误差
+ */
+
+namespace field_batch {
+
+// 一组点，各分量连续存放
+struct Points {
+    std::vector<double> t, x, y, z;
+    void resize(size_t n) { t.resize(n); x.resize(n); y.resize(n); z.resize(n); }
+    size_t size() const { return t.size(); }
+};
+
+// 各点的场 (GSM)：B = 背景场 + 波场 [nT]，E = 波场 [mV/m]
+struct Fields {
+    std::vector<double> Bx, By, Bz, Ex, Ey, Ez;
+    void resize(size_t n) { Bx.resize(n); By.resize(n); Bz.resize(n); Ex.resize(n); Ey.resize(n); Ez.resize(n); }
+};
+
+// 加载 Geopack（含公共区）和波场配置，不可用时返回 false（此时只能逐点计算）
+bool prepare(int magnetic_field_model, int wave_field_model);
+
+// 计算 points 中各点的场，结果写入 fields（自动调整大小）
+void evaluate(int magnetic_field_model, int wave_field_model, const Points& points, Fields& fields);
+
+} // namespace field_batch
@@ -1,7 +1,10 @@
 #pragma once
+#include <ctime>
 #include <Eigen/Dense>
 #include <vector>
 
+const double c = 47.055; // Speed of light in RE/s
+
 Eigen::Vector3d Bvec(const double& t, const double& xgsm, const double& ygsm, const double& zgsm);
 
 Eigen::Vector3d B_bg(const double& t, const double& xgsm, const double& ygsm, const double& zgsm);
@@ -14,6 +17,17 @@ Eigen::VectorXd B_grad_curv(const double& t,
                 const double& zgsm, 
                 const double& dr = 0.001);
 
+// 场在一点附近的二阶展开（中心差分，步长 dr）：B_grad_curv 的 7 个点加 12 个对角点上的 B，
+// 及 6 个轴向点上的 E；grad_curv 与 B_grad_curv(t, x, y, z, dr) 逐位相同
+struct FieldJet {
+    Eigen::Vector3d B, E;
+    Eigen::VectorXd grad_curv;  // grad |B|, 曲率
+    Eigen::Matrix3d dB;         // dB(i, j) = ∂B_i/∂x_j
+    Eigen::Matrix3d dE;         // dE(i, j) = ∂E_i/∂x_j
+    Eigen::Matrix3d d2B[3];     // d2B[k](i, j) = ∂²B_i/∂x_j∂x_k
+};
+FieldJet field_jet(double t, double xgsm, double ygsm, double zgsm, double dr);
+
 Eigen::Vector3d deb_dt(const double& t, 
                 const double& xgsm, 
                 const double& ygsm, 
@@ -27,4 +41,26 @@ double pBpt(const double& t,
                 const double& zgsm, 
                 const double& dt=0.0005);
 
-Eigen::Vector3d Evec(const double& t, const double& xgsm, const double& ygsm, const double& zgsm);
\ No newline at end of file
+Eigen::Vector3d Evec(const double& t, const double& xgsm, const double& ygsm, const double& zgsm);
+
+// 预先加载 Geopack 和给定波场模型的配置（含波谱），供 fork 出的子进程共享；失败返回 false
+bool preload_field_model(int wave_field_model);
+
+// 波场的随机状态（宽带波的相位种子），没有随机状态的模型返回 false
+bool wave_seed(int wave_field_model, unsigned int& seed);
+void restore_wave_seed(int wave_field_model, unsigned int seed);
+
+// 按 t 调用 Geopack 的 recalc（与 magnetic_field_models.cpp 相同，只取决于 t 的整秒），
+// 之后的 smgsm 等坐标变换用该时刻；带 last 的版本与上次同一秒时不重算
+void recalc_at(double t);
+void recalc_at(double t, time_t& last);
+
+// GSM <-> SM（位置或矢量），用最近一次 recalc 的时刻
+Eigen::Vector3d gsm_to_sm(const Eigen::Vector3d& v);
+Eigen::Vector3d sm_to_gsm(const Eigen::Vector3d& v);
+
+// 状态 Y = (t, x, y, z, ...) 的位置在 SM 中的坐标（先 recalc 到 Y[0]）
+Eigen::Vector3d to_sm(const Eigen::VectorXd& Y);
+
+// 波场的最短周期 [s]（绝热性判据，见 bounce_average.h），没有波场时为 HUGE_VAL
+double wave_shortest_period(int wave_field_model);
@@ -23,4 +23,17 @@ GEOPACK_API
 void geogsm(double* xgeo, double* ygeo, double* zgeo, double* xgsm, double* ygsm, double* zgsm, int* J);
 
 GEOPACK_API
-void smgsm(double* xsm, double* ysm, double* zsm, double* xgsm, double* ygsm, double* zgsm, int* J);
\ No newline at end of file
+void smgsm(double* xsm, double* ysm, double* zsm, double* xgsm, double* ygsm, double* zgsm, int* J);
+
+// 预先加载 Geopack 动态库（否则在第一次调用时加载），成功返回 1
+GEOPACK_API
+int load_geopack();
+
+// Geopack 的公共区（recalc 的结果），供批量计算场的函数直接读取，找不到时返回 nullptr
+// /GEOPACK1/: 34 个双精度数，[10] SPS, [11] CPS（偶极倾角的 sin/cos），[16..24] GEO->GSW 旋转矩阵 A11,A21,A31,A12,...,A33
+// /GEOPACK2/: G(105), H(105), REC(105)（IGRF 系数）
+GEOPACK_API
+double* geopack1_common();
+
+GEOPACK_API
+double* geopack2_common();
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "batch_scheduler.h"
+
+/**
+ * @brief 重要性分裂与俄罗斯轮盘赌 (Solver --split=SPEC)
+ *
+ * 损失锥、共振等研究关心的是少见的轨迹。均匀的集合中只有极少数粒子到达这些区域，
+ * 统计误差由到达的粒子数决定。这里按用户给出的相空间边界（重要性函数的一组层）给粒子加权：
+ *  - 粒子越过更高的一层时分裂为 N 个：原粒子继续积分，另有 N-1 个子粒子从该处的状态出发，
+ *    每个的权重都是原来的 1/N；
+ *  - 粒子回落到比当前层低两层时（一层的回差，避免在层附近来回时反复分裂和淘汰）玩俄罗斯轮盘赌：
+ *    以 1/N 的概率存活，权重乘 N，否则结束积分。
+ * 两种操作都保持权重的期望，Σ weight × g(粒子) 仍是 g 的无偏估计，而到达高层的粒子数约多 N^层数 倍。
+ *
+ * SPEC = FUNC<l1,l2,...[:N[:J]] 或 FUNC>l1,l2,...[:N[:J]]：
+ *  - FUNC 为 L（SM 坐标中的偶极 L = r / cos^2 λ）或 pa_eq（偶极近似的赤道投掷角 [deg]，
+ *    sin^2 α_eq = sin^2 α × cos^6 λ / sqrt(1 + 3 sin^2 λ)）；
+ *  - "<" 表示值越小越重要（各层递减，如 pa_eq<10,7,5 接近损失锥），">" 表示越大越重要（各层递增）；
+ *  - N 为分裂数（默认 4），J 为子粒子投掷角的随机扰动幅度 [deg]（默认 0.5，均匀分布于 ±J）。
+ * 场是确定的，从同一状态出发的子粒子轨迹相同，需要扰动才能探索邻近的相空间；
+ * 有随机相位的宽带波场时子粒子沿用原粒子的波场随机状态。
+ *
+ * 子粒子在原粒子所在的一代结束后作为下一代运行（批处理调度照常），名为 <原粒子名>_s<k>，
+ * 参数和权重由主进程登记（exec 的子进程通过 --split-member= 得到）。随机数种子由粒子名确定，
+ * 同样的输入得到同样的分裂。
+ *
+ * 每个粒子写出 output/<name>.split（制表符分隔）：
+ *   event, t, x, y, z, p_para, Ek, pa, level, weight, seed, wave_seed
+ * event 为 start（初始状态）、child（一个子粒子，seed 为其随机数种子）、survived/killed（轮盘赌）、
+ * end（最后的状态）；Ek [MeV] 和 pa [deg] 由 p_para 和 mu 得到；wave_seed 在没有随机波场时为 -1。
+ * 主进程汇总为 output/splitting.tsv，每个粒子的最终权重写入 log/summary.tsv 的 weight 列。
+ */
+
+namespace splitting {
+
+enum Function { L_SHELL = 0, PA_EQ = 1 };
+
+const int DEFAULT_FACTOR = 4;
+const double DEFAULT_JITTER = 0.5;
+const int MAX_FACTOR = 64;
+const int MAX_GENERATIONS = 100;
+
+struct Spec {
+    int function = L_SHELL;
+    bool below = false;             // "<"：值越小越重要
+    std::vector<double> levels;
+    int factor = DEFAULT_FACTOR;
+    double jitter = DEFAULT_JITTER; // [deg]
+};
+
+// 解析 --split 的值，格式错误时返回 false，error 给出原因
+bool parse_spec(const std::string& text, Spec& spec, std::string& error);
+
+// 重要性函数的值（用全局的 mu, E0）和所在的层（越过的层数）
+double importance(const Spec& spec, const Eigen::VectorXd& Y);
+int level(const Spec& spec, const Eigen::VectorXd& Y);
+
+// 粒子的权重和分裂状态
+struct Member {
+    double weight = 1.0;
+    int level = -1;                 // 当前层，-1 为由初始状态确定（原始粒子）
+    uint64_t seed = 0;              // 0 为由粒子名确定
+    int has_wave_seed = 0;
+    unsigned int wave_seed = 0;
+};
+
+// 粒子的 Member：主进程登记的子粒子，或 --split-member= 给出的值；都没有时为原始粒子
+Member member(const std::string& para_file);
+
+// 转发给子进程的 "--split-member=..."，不是子粒子时为空
+std::string child_argument(const std::string& para_file);
+
+// 解析 --split-member= 的值
+bool decode_member(const std::string& text, Member& m);
+
+// 单个粒子积分中的分裂和轮盘赌
+class Tracker {
+public:
+    Tracker(const Spec& spec, const Member& member, const std::string& para_file, const Eigen::VectorXd& Y,
+            bool has_wave_seed, unsigned int wave_seed);
+
+    // 一步之后调用：越过更高的层时记录子粒子，回落两层时轮盘赌；返回 false 表示被淘汰，积分应结束
+    bool check(const Eigen::VectorXd& Y, std::ostream& log);
+
+    // 写出 .split 文件，Y 为最后的状态
+    bool write(const std::string& path, const Eigen::VectorXd& Y) const;
+
+    double weight() const { return weight_; }
+    double initial_weight() const { return initial_weight_; }
+    int children() const { return children_; }
+    int survived() const { return survived_; }
+    bool killed() const { return killed_; }
+
+private:
+    void record(std::ostream& out, const char* event, const Eigen::VectorXd& Y, uint64_t seed) const;
+
+    Spec spec_;
+    int level_;
+    double weight_, initial_weight_;
+    std::mt19937_64 rng_;
+    long long wave_seed_;
+    int children_ = 0, survived_ = 0;
+    bool killed_ = false;
+    std::ostringstream rows_;
+};
+
+/**
+ * @brief 主进程：读取一代粒子的 .split 文件，设置各任务的最终权重 (BatchJob::weight)，
+ * 登记它们的子粒子（参数、Member）并返回子粒子的路径（下一代）
+ */
+std::vector<std::string> spawn(std::vector<BatchJob>& jobs, int generation, std::ostream& log);
+
+// 写出 spawn 汇总的粒子表 (output/splitting.tsv)：
+// name, parent, generation, t_start, t_end, level, weight_start, weight_end, children,
+// fate（end, killed, failed：进程失败，不分裂；missing：没有 .split 文件）
+bool write_table(const std::string& path);
+
+} // namespace splitting
@@ -0,0 +1,48 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "batch_scheduler.h"
+
+/**
+ * @brief 拉取式任务协调（动态负载均衡）
+ *
+ * 协调进程 (Solver --serve=ADDR) 持有粒子队列（按估计耗时从大到小），工作进程
+ * (Solver --worker=ADDR) 空闲时向它请求任务，因此快的节点自然多做，不会像静态分片那样空等。
+ * ADDR 写作 "unix:PATH" 或 "tcp:HOST:PORT"。工作进程与协调进程在同一工作目录结构下运行
+ * （input/ 中有同样的 .para 文件），任务用相对路径 input/<name>.para 传递。
+ *
+ * 协议：每行一条消息，字段用制表符分隔，工作进程发请求、协调进程回一行：
+ *   GET                          -> JOB <id> <lease> <para> [options...] | WAIT <seconds> | DONE
+ *   RENEW <id>                   -> OK | CANCEL
+ *   RESULT <id> <status> <secs>  -> OK
+ * 工作进程为每个任务 fork/exec 子进程 (exe para [options...])，即原有的单粒子入口，
+ * 运行期间每 lease/3 秒续租一次。租约到期未续、连接断开或子进程失败的任务重新排队，
+ * 最多重试 retries 次；被收回的任务再续租时得到 CANCEL，工作进程终止对应的子进程。
+ */
+
+namespace job_queue {
+
+// "unix:PATH" / "tcp:HOST:PORT" 是否有效
+bool valid_address(const std::string& address);
+
+/**
+ * @brief 协调进程：分发 jobs 直到全部完成或失败，结果写回 jobs（elapsed, status）
+ * @param lease     租约时长 [s]
+ * @param retries   失败任务的最多重试次数
+ * @param forwarded 随任务发给工作进程的选项
+ */
+void serve(std::vector<BatchJob>& jobs, const std::string& address, double lease, int retries,
+           const std::vector<std::string>& forwarded, std::ostream& log);
+
+/**
+ * @brief 工作进程：开 slots 个并行的请求循环，直到协调进程回复 DONE 或退出
+ * @param workDir   解析任务相对路径的工作目录
+ * @param slot_cpus 非空时第 s 个请求循环（及其子进程）绑定在 slot_cpus[s] 上
+ * @return 完成的任务数
+ */
+int work(const std::string& address, const std::string& exe, const std::string& workDir, int slots,
+         const std::vector<int>& slot_cpus = {});
+
+} // namespace job_queue
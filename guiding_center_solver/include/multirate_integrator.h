@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <Eigen/Dense>
+
+/**
+ * @brief 多速率积分 (Solver --multirate[=TOL])
+ *
+ * dydt 中平行运动只需要该点的 B 和沿磁力线的 b·grad B（3 次 Bvec），而漂移用到的梯度、曲率
+ * （7 次 Bvec）、deb_dt（2 次）和电场在一步 dt 之间变化很小，对轨迹的影响也小。把 dt 的若干步 (M 步)
+ * 合成一个宏步：
+ *  - 慢变量 S = (E, grad B, curv B, deb_dt) 只在宏步的端点完整计算，宏步内由最近 3 个端点外推（二次多项式）；
+ *  - 每一步 dt 仍是 RK4，各级计算 B 和 b·grad B，其余用外推的 S，公式与 dydt 相同（drift_terms）
+ *    （外推的 deb_dt 只取与 b 垂直的分量；宏步起点的 S 是完整计算值，原样使用）。
+ * 宏步结束时完整计算 S（也是下一宏步的起点），与外推值比较得到误差估计：
+ *   err = M dt * max(|dv| / r, |dp_para/dt| / p)，
+ * 即外推误差在一个宏步内造成的位置（相对地心距离）和动量（相对总动量）偏差。
+ * err > TOL（默认 1e-9）时退回宏步起点，M 减半重算；err < TOL/16 时下一宏步 M 加倍（至多 MAX_RATIO）。
+ * 波场使场快速变化时 M 自动减小，M = 1 时每一级都完整计算 S，即普通的 RK4（与不加 --multirate 逐位相同）。
+ *
+ * 宏步的各步仍按 dt 交给调用者（写轨迹、事件检测），检查点只写在宏步端点。
+ */
+
+namespace multirate {
+
+const double DEFAULT_TOL = 1e-9;
+const int MAX_RATIO = 64;
+
+// 宏步端点：慢变量（电场、|B| 的梯度、曲率、deb_dt（沿 v_total））和该点的 B、b·grad B
+struct Node {
+    double t = 0.0;
+    double p = 0.0;     // 总动量（误差估计的尺度）
+    Eigen::Matrix<double, 12, 1> S = Eigen::Matrix<double, 12, 1>::Zero();
+    Eigen::Vector3d B = Eigen::Vector3d::Zero();
+    double dB_ds = 0.0;
+};
+
+class Integrator {
+public:
+    explicit Integrator(double tol);
+
+    // 前进一步 dt（全局 dt）：Y 更新为下一步的状态，k1 为该步起点的导数（事件检测用）。
+    // 新的宏步至多 max_steps 步（--auto-steps 在输出记录处改变 dt，宏步不能跨过）
+    void step(Eigen::VectorXd& Y, Eigen::VectorXd& k1, int max_steps = MAX_RATIO);
+
+    // 是否在宏步端点（可以写检查点）
+    bool at_node() const { return queue_.empty(); }
+
+    // 检查点状态（只在宏步端点），restore 失败返回 false
+    std::string checkpoint() const;
+    bool restore(const std::string& state);
+
+    int ratio() const { return ratio_; }
+    long long steps() const { return steps_; }
+    long long macro_steps() const { return macro_steps_; }
+    long long rejected() const { return rejected_; }
+    long long full_evaluations() const { return full_evaluations_; }
+    long long field_evaluations() const { return field_evaluations_; }
+
+private:
+    struct SubStep {
+        Eigen::VectorXd Y, k1;
+    };
+
+    Node evaluate(const Eigen::VectorXd& Y);
+    Eigen::Matrix<double, 12, 1> extrapolate(double t) const;
+    Eigen::VectorXd rhs(const Eigen::VectorXd& Y, const Eigen::Matrix<double, 12, 1>& S);
+    Eigen::VectorXd rhs(const Eigen::VectorXd& Y, const Eigen::Vector3d& B, double dB_ds,
+                        const Eigen::Matrix<double, 12, 1>& S, bool extrapolated) const;
+    Eigen::VectorXd exact_rhs(const Eigen::VectorXd& Y);
+    void advance(const Eigen::VectorXd& Y, int max_steps);
+
+    double tol_;
+    int ratio_ = 1;
+    std::deque<Node> history_;          // 最近的宏步端点（至多 3 个），最后一个为当前宏步的起点
+    std::deque<SubStep> queue_;         // 已算好、尚未交给调用者的步
+    long long steps_ = 0, macro_steps_ = 0, rejected_ = 0, full_evaluations_ = 0, field_evaluations_ = 0;
+};
+
+} // namespace multirate
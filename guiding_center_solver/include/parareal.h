@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+#include <functional>
+#include <Eigen/Dense>
+
+/**
+ * @brief 时间并行积分 (Solver --parareal[=S[:R]])
+ *
+ * 单个粒子的长时间积分（例如宽带波中积分数天）只能用一个核。Parareal 把积分区间分成 S 段，
+ * 每段的边界都是输出记录：
+ *  - 粗积分 G：RK4，步长约为 R dt（默认 R = 20），在主进程中逐段串行；
+ *  - 细积分 F：与普通运行相同的 RK4（步长 dt），各段在 fork 出的子进程中并行，结果经管道返回。
+ * 第 0 次迭代 U[j+1] = G(U[j])；之后每次迭代并行算 F(U[j])，再串行修正
+ *   U'[j+1] = G(U'[j]) + F(U[j]) - G(U[j])，
+ * 直到各段起点的变化 max(|dx| / r, |dp_para| / p) < TOL。起点与上次细积分相同（逐位）的段不再重算，
+ * 下一段的起点直接取细积分的结果，因此第 k 次迭代后前 k 段与串行结果逐位相同，至多 S 次迭代即为串行结果。
+ * 输出的记录取自各段最后一次细积分。
+ *
+ * Geopack 的公共区不能多线程共用，所以用进程而不是线程并行。
+ * 不写检查点；进入大气层的段之后的各段不再计算。
+ */
+
+namespace parareal {
+
+const int DEFAULT_COARSE_RATIO = 20;
+const int MAX_SLICES = 256;
+const double TOL = 1e-9;
+
+struct Stats {
+    int slices = 0;                 // 实际的段数
+    int iterations = 0;             // 细积分的迭代次数
+    long long fine_slices = 0;      // 细积分的段数（各次迭代之和）
+    long long coarse_steps = 0;     // 粗积分的步数
+    double change = 0.0;            // 最后一次迭代各段起点的最大变化
+    double fine_seconds = 0.0, coarse_seconds = 0.0;    // 墙钟时间
+};
+
+/**
+ * @brief 从 Y（第 0 步）积分 num_steps 步（全局的 dt），第 write_step 的整数倍步调用 write(记录)
+ * @param p        总动量 [MeV/c]（收敛判据的尺度）
+ * @param r_min    大气层边界 [RE]，细积分进入后该段结束
+ * @param slices   段数 S（不超过输出间隔数）
+ * @param coarse_ratio 粗积分步长与 dt 之比 R
+ * @return 进入大气层的步数，积分到 num_steps 时为 0；Y 为最后的状态。子进程失败时返回 -1，error 给出原因
+ */
+int32_t integrate(Eigen::VectorXd& Y, int32_t num_steps, int write_step, double p, double r_min, int slices,
+                  int coarse_ratio, const std::function<void(const double*)>& write, std::ostream& log,
+                  Stats& stats, std::string& error);
+
+} // namespace parareal
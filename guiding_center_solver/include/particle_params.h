@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 粒子参数（.para 文件）
+ *
+ * .para 文件每行一个数值，';' 之后为注释，空行和不以数值开头的行被跳过。数值依次为：
+ * dt, E0, q, t_ini, t_interval, write_interval, xgsm, ygsm, zgsm, Ek, pa,
+ * atmosphere_altitude, t_step, r_step, magnetic_field_model, wave_field_model
+ */
+struct ParticleParams {
+    double dt = 0.0, E0 = 0.0, q = 0.0;
+    double t_ini = 0.0, t_interval = 0.0, write_interval = 0.0;
+    double xgsm = 0.0, ygsm = 0.0, zgsm = 0.0;
+    double Ek = 0.0, pa = 0.0;
+    double atmosphere_altitude = 0.0;
+    double t_step = 0.0, r_step = 0.0;
+    int magnetic_field_model = 0, wave_field_model = 0;
+    int num_values = 0;     // 实际读到的数值个数
+};
+
+const int NUM_PARTICLE_PARAMS = 16;
+
+// 按 .para 中的序号 (0..15) 设置或读取参数
+void set_particle_param(ParticleParams& params, int idx, double val);
+double get_particle_param(const ParticleParams& params, int idx);
+
+// 前 14 个（浮点）参数，依 .para 中的顺序；结果缓存的键和检查点按这些数值（而不是文本）比较参数
+const int NUM_PARTICLE_DOUBLES = 14;
+void particle_param_doubles(const ParticleParams& params, double (&values)[NUM_PARTICLE_DOUBLES]);
+
+// 参数名（如 "dt", "Ek"）对应的序号，未知时为 -1
+int particle_param_index(const std::string& name);
+const char* particle_param_name(int idx);
+
+// 读取 .para 文件（或清单中的粒子，见下），文件无法打开时返回 false
+bool read_particle_params(const std::string& para_file, ParticleParams& params);
+
+/**
+ * @brief 粒子清单（input 目录下的 .pman 文件）：一个文件描述整个粒子集合
+ *
+ * "key = value" 行给出所有粒子共用的参数（名称同 .para 中的 16 个参数），
+ * "columns = ..." 行列出每个粒子各自的参数（可以包括 name），其后每行一个粒子，逗号分隔。
+ * 每个参数要么是共用值，要么是一列；没有 name 列时粒子名为 <清单名>_<行号>（从 0 开始）。
+ * ';' 或 '#' 之后为注释。清单逐行读取一遍，每个粒子只占固定大小的内存。
+ *
+ * 清单中的粒子用虚拟路径 <清单路径>/<name>.para 表示，文件名和输出文件名与 .para 粒子相同。
+ * 读取清单时参数登记在进程内，read_particle_params 直接返回；子进程通过 --params= 得到参数，
+ * 不必再读清单。
+ */
+bool read_manifest(const std::string& manifest_file, std::vector<std::string>& particles);
+
+// 粒子集合生成器 (input/*.gen，格式见 ensemble_generator.h)：粒子同样登记为 <生成器路径>/<name>.para
+bool read_generator(const std::string& gen_file, std::vector<std::string>& particles);
+
+// 路径是清单 (.pman) 或生成器 (.gen)，即其中粒子的虚拟路径的父目录
+bool is_particle_source(const std::string& path);
+
+// input/ 中的全部粒子：.para 文件，然后是各清单、各生成器中的粒子。清单或生成器有错时返回 false
+bool find_particles(const std::string& inputDir, std::vector<std::string>& particles);
+
+// 登记粒子参数，之后 read_particle_params(particle) 不再读文件
+void register_particle_params(const std::string& particle, const ParticleParams& params);
+
+// 转发给子进程的参数选项 "--params=v1,...,v16"，不是清单或生成器中的粒子时为空
+std::string particle_params_argument(const std::string& particle);
+
+// 解析 --params= 的值（16 个逗号分隔的数值）
+bool decode_particle_params(const std::string& text, ParticleParams& params);
+
+// 积分步数 t_interval / |dt|
+int64_t integration_steps(const ParticleParams& params);
@@ -37,6 +37,13 @@ public:
      * @throws std::runtime_error 如果无法获取可执行文件路径
      */
     static std::string getExecutableDirectory();
+
+    /**
+     * @brief 获取可执行文件本身的绝对路径
+     * @return 可执行文件路径
+     * @throws std::runtime_error 如果无法获取可执行文件路径
+     */
+    static std::string getExecutablePath();
     
     // 路径拼接和构建
     
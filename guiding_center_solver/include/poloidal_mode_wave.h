@@ -2,6 +2,18 @@
 #include <Eigen/Dense>
 
 namespace pol_wave {
+    // 读取 input/*.wpol 并计算波谱（只在第一次调用时进行），失败返回 false
+    bool loadWaveConfig();
+    // 随机相位的种子（配置为 seed 时为读取配置时的时间）；恢复检查点时用 restore_seed 还原同一波场
+    unsigned int current_seed();
+    void restore_seed(unsigned int s);
+    // 最短的分量周期 2π/max(ωi) [s]，配置无效时为 HUGE_VAL
+    double shortest_period();
     // 返回一个6维向量：前3个元素是电场分量(Ex, Ey, Ez)，后3个元素是磁场分量(Bx, By, Bz)
     Eigen::VectorXd pol_wave(const double& t, const double& xgsm, const double& ygsm, const double& zgsm);
+    // 批量计算（见 field_batch.h）：各频率分量的时间因子只取决于 t，同一时刻的所有点共用
+    // temporal_sums(t) = (Σ E0i cos ai, Σ E0i sin ai, Σ E0i/ωi cos ai, Σ E0i/ωi sin ai)，ai = phi0i - ωi t
+    Eigen::Vector4d temporal_sums(const double& t);
+    // SM 坐标中一点的波场（前3个元素 E，后3个元素 B，SM 坐标），与 pol_wave 只差舍入误差
+    Eigen::Matrix<double, 6, 1> wave_sm(const Eigen::Vector4d& sums, const double& xsm, const double& ysm, const double& zsm);
 }
@@ -2,6 +2,10 @@
 #include <Eigen/Dense>
 
 namespace simple_pol_wave {
+    // 读取 input/*.pol（只在第一次调用时进行）
+    void load_config();
+    // 波周期 [s]，配置无效时为 HUGE_VAL
+    double shortest_period();
     double E_phi(const double& t, const double& L, const double& mu, const double& phi);
     double E_L(const double& t, const double& L, const double& mu, const double& phi);
     double B_L(const double& t, const double& L, const double& mu, const double& phi);
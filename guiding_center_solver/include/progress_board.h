@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "batch_scheduler.h"
+
+/**
+ * @brief 运行进度表 (log/progress.board)
+ *
+ * 主进程在启动子进程前创建进度表文件：文件头之后每个粒子一个 128 字节的槽位
+ * （状态、PID、已完成步数、总步数、模拟时间、开始/结束的墙钟时间、粒子名）。
+ * 子进程把文件映射到内存 (mmap, MAP_SHARED)，积分中每步用 relaxed 原子写更新自己的槽位，
+ * 不加锁、不写日志、不刷新缓冲区；Solver --status 映射同一文件，给出各状态的粒子数、
+ * 总吞吐量和预计剩余时间。
+ *
+ * exec 的子进程通过 --board=<槽位>:<进度表路径> 找到槽位；预 fork 的子进程继承主进程的映射。
+ * 只支持 POSIX；Windows 上不创建进度表。
+ */
+
+namespace progress_board {
+
+enum State {
+    STATE_QUEUED = 0,
+    STATE_RUNNING = 1,
+    STATE_DONE = 2,
+    STATE_FAILED = 3,
+};
+
+// 主进程：为 jobs 创建进度表（覆盖旧文件），失败返回 false
+bool create(const std::string& path, const std::vector<BatchJob>& jobs);
+
+// 转发给子进程的选项 "--board=<槽位>:<路径>"，没有进度表时为空
+std::string child_argument(const std::string& para_file);
+
+// 子进程：开始积分（steps_done 为从检查点继续时已完成的步数，t_sim 为当前时间），之后 update 写入该粒子的槽位
+// （--board=... 或继承的进度表，都没有时不做任何事）
+void begin(const std::string& para_file, int64_t steps_total, int64_t steps_done, double t_ini, double t_sim);
+
+// 积分中每步调用
+void update(int64_t step, double t_sim);
+
+// 积分中总步数改变（--auto-steps 改变步长）
+void update_total(int64_t steps_total);
+
+// 积分结束
+void finish(bool ok);
+
+// 主进程：批处理结束后，把没有正常结束的粒子（子进程失败、启动前出错）记为失败
+void settle(const std::vector<BatchJob>& jobs);
+
+/**
+ * @brief Solver --status：显示进度表
+ * @param all 为 true 时列出所有粒子，否则只列出运行中的
+ * @return 进度表不存在或无效时返回 false
+ */
+bool show(const std::string& path, bool all, std::ostream& out);
+
+} // namespace progress_board
@@ -0,0 +1,79 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+#include "event_detector.h"
+
+/**
+ * @brief 反向追踪的相空间密度映射 (Solver --psd-map=FILE)
+ *
+ * 沿导心轨迹相空间密度 f 守恒（Liouville 定理）。把每个粒子（.para, .pman 或 .gen 给出的观测点）
+ * 从观测点反向积分（dt 取负）到边界，观测点的 f 就等于边界模型在终点处的 f：
+ *  - time          到达 t_ini - t_interval 仍在区域内：初始分布（边界模型，或 FILE 中的常数）
+ *  - lmax          偶极 L（SM）越过 L_max：外边界的源分布（边界模型）
+ *  - magnetopause  越过 Shue et al. (1998) 磁层顶：同上
+ *  - atmosphere    进入大气层：损失锥，常数（默认 0）
+ * 边界由事件检测（event_detector.h）在步内定位，不受 dt 限制；观测点已在外边界之外时不积分，终点就是观测点。
+ * 映射不写轨迹（--profile=events），每个粒子只写终点 output/<name>.endpoint，主进程按边界模型取值，
+ * 写出 output/psd_map.tsv。
+ * 边界模型只在主进程中使用：只改模型参数时，已有的终点仍是最新的（缓存键只含边界），不重新积分。
+ *
+ * FILE 每行 "key = value"，';' 或 '#' 之后为注释，各项都可省略：
+ *   L_max = 7            外边界（偶极 L），0 为没有
+ *   magnetopause = 2     磁层顶边界，动压 Dp [nPa]，0 为没有
+ *   f0, Ek0, gamma, n, L0, lambda
+ *                        边界模型 f = f0 (Ek / Ek0)^(-gamma) sin^n(pa_eq) (L / L0)^lambda，
+ *                        Ek [MeV]，pa_eq 为偶极近似的赤道投掷角；默认 f0 = Ek0 = L0 = 1，其余为 0
+ *   time = model | 数值   time 边界的 f（默认 model）
+ *   atmosphere = 数值     atmosphere 边界的 f（默认 0）
+ * f 的单位与 f0 相同。--events 中其他 :stop 事件结束的粒子没有 f (NaN)。
+ *
+ * output/<name>.endpoint（制表符分隔）两行：observation（观测点）和终点，列为
+ *   boundary, t, x, y, z, p_para, Ek, pa, L, MLT, pa_eq
+ * 终点一行的 boundary 为上面的边界名；Ek [MeV], pa [deg] 由 p_para 和 mu 得到，L 和 MLT 为 SM 中的偶极值。
+ */
+
+namespace psd_map {
+
+struct Model {
+    double L_max = 0.0;
+    double magnetopause = 0.0;          // Dp [nPa]
+    double f0 = 1.0, Ek0 = 1.0, gamma = 0.0, n = 0.0, L0 = 1.0, lambda = 0.0;
+    bool time_model = true;             // time 边界用边界模型，否则为常数 f_time
+    double f_time = 0.0;
+    double f_atmosphere = 0.0;
+};
+
+// 读取边界模型文件，格式错误时返回 false，error 给出原因（含行号）
+bool load_model(const std::string& path, Model& model, std::string& error);
+
+// 结束积分的边界事件（lmax, magnetopause）
+std::vector<events::Event> boundary_events(const Model& model);
+
+// 观测点已在边界之外时返回该边界名（lmax, magnetopause），否则为空字符串
+std::string outside(const Model& model, const Eigen::VectorXd& Y);
+
+// 缓存键中的边界部分（不含模型参数）
+std::string boundary_key(const Model& model);
+
+// 边界模型在 (L, Ek, pa_eq) 处的值
+double source(const Model& model, double L, double Ek, double pa_eq);
+
+// 终点文件路径，outFileBase 不含扩展名
+std::string endpoint_path(const std::string& outFileBase);
+
+// 写出观测点和终点（用全局的 mu, E0 得到 Ek 和 pa）
+bool write_endpoint(const std::string& path, const Eigen::VectorXd& observation, const std::string& boundary,
+                    const Eigen::VectorXd& end);
+
+/**
+ * @brief 主进程：读取各粒子的终点，按边界模型写出 PSD 映射表：
+ *   name, t, x, y, z, Ek, pa, L, MLT, pa_eq（观测点）, boundary, t_b, L_b, MLT_b, Ek_b, pa_eq_b（终点）, f
+ * 没有终点文件的粒子 boundary 为 missing，f 为 NaN
+ */
+bool write_map(const std::string& path, const std::vector<std::string>& para_files, const Model& model,
+               std::ostream& log);
+
+} // namespace psd_map
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/**
+ * @brief 结果缓存（增量重算）
+ *
+ * 每个粒子的结果由一个内容键决定：.para 中的数值、场模型编号、所用波场配置文件
+ * (.pol/.tor/.wpol/.wtor) 的内容、可执行文件本身的内容，以及影响输出的选项。
+ * 子进程成功写完输出文件后，在旁边写一个戳记文件 <输出文件>.stamp，内容为一行
+ * "<键> <输出文件字节数>"。主进程启动子进程之前比较键和文件大小，一致的粒子直接跳过；
+ * --force 忽略戳记，全部重算。子进程开始写输出之前先删除旧戳记，被中断的粒子不会被当作已完成。
+ *
+ * .gct 等输出格式不变（MATLAB 和其他读取程序不受影响），键只存在戳记文件中。
+ */
+
+namespace result_cache {
+
+const uint64_t FNV_OFFSET = 1469598103934665603ULL;
+
+// FNV-1a，h 为之前的哈希值，可以连续累加多段数据
+uint64_t hash_bytes(const void* data, size_t len, uint64_t h = FNV_OFFSET);
+
+// 把文件内容累加进 h，文件无法打开时返回 false
+bool hash_file(const std::string& path, uint64_t& h);
+
+// 当前可执行文件内容的哈希（只计算一次）
+uint64_t binary_hash();
+
+// 波场模型所用的配置文件（input/ 中第一个对应扩展名的文件），无波场或找不到时为空
+std::string wave_config_file(int wave_field_model);
+
+/**
+ * @brief 粒子的内容键（16 位十六进制）
+ * @param extra 其他影响结果的内容（输出选项、上游结果的键等）
+ * @return .para 无法读取时为空
+ */
+std::string particle_key(const std::string& para_file, const std::string& extra);
+
+// 戳记文件路径（内联，trajectory_io 删除旧输出时也用到）
+inline std::string stamp_path(const std::string& output_file) { return output_file + ".stamp"; }
+
+// output_file 的有效戳记中的键；没有戳记、文件不存在或大小不符时为空
+std::string stamp_key(const std::string& output_file);
+
+// output_file 已是 key 的结果
+bool up_to_date(const std::string& output_file, const std::string& key);
+
+// 输出文件写完后记录键，失败返回 false
+bool write_stamp(const std::string& output_file, const std::string& key);
+
+// 删除戳记（开始重写输出之前）
+inline void clear_stamp(const std::string& output_file) { std::remove(stamp_path(output_file).c_str()); }
+
+} // namespace result_cache
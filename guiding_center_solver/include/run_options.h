@@ -0,0 +1,60 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace psd_map { struct Model; }
+
+/**
+ * @brief 运行选项
+ *
+ * 主进程从命令行解析 "--key=value" 形式的选项，启动子进程时原样转发，
+ * 因此子进程看到的选项与主进程一致。
+ */
+struct RunOptions {
+    std::string diag_columns;   // Diagnosor: 需要输出的诊断量，逗号分隔；为空时查找 input/*.dcol，仍为空则输出全部
+    int encoding = 0;           // 输出文件编码 (traj_io::Encoding)，--encoding=raw|compressed
+    int profile = 0;            // Solver: 轨迹输出方案 (traj_io::Profile)，--profile=full|compact|envelope|events
+    int envelope_window = 100;  // Solver: envelope 方案每个窗口的记录数，--window=N
+    int jobs = 0;               // Solver: 同时运行的子进程数上限，--jobs=N，0 为 CPU 核数
+    bool prefork = false;       // Solver: 预先加载 Geopack 和波场配置后 fork 子进程，不再 exec，--prefork
+    bool pin = false;           // Solver: 子进程绑核，按 NUMA 节点放置，--pin（只在主进程和工作进程中使用）
+    int ensemble = 0;           // Solver: 集合积分，每组至多 N 个粒子在一个子进程中同步积分，--ensemble[=N]，0 为逐个粒子（只在主进程中使用）
+    double symmetry = 0.0;      // Solver: 偶极场、无波场时每个方位对称类只积分一个粒子，其余由旋转得到，--symmetry[=TOL]（见 azimuthal_symmetry.h），
+                                // TOL 为允许的偏差上限 [RE]（不给出时不限），0 为不使用（只在主进程中使用）
+    double bounce_average = 0.0; // Solver: 弹跳平均的漂移积分，--bounce-average[=R]（见 bounce_average.h），0 为不使用
+    double auto_steps = 0.0;    // Solver: 由局地尺度选择 dt 和 r_step，每个周期 N 步，--auto-steps[=N]（见 auto_steps.h），0 为使用 .para 中的值
+    int parareal = 0;           // Solver: 时间并行积分的段数，--parareal[=S[:R]]（见 parareal.h），0 为不使用
+    int parareal_coarse = 20;   // Solver: 时间并行积分粗积分步长与 dt 之比 R
+    double multirate = 0.0;     // Solver: 多速率积分，--multirate[=TOL]（见 multirate_integrator.h），0 为不使用
+    int variational = 0;        // Solver: 同时积分切线性方程，--variational[=matrix|ftle]（见 variational.h，variational::Output），0 为不使用
+    std::string split;          // Solver: 重要性分裂和俄罗斯轮盘赌，--split=SPEC（见 importance_splitting.h），为空时不使用
+    std::string split_member;   // 子进程: 子粒子的权重和分裂状态，--split-member=...（由主进程逐个粒子给出，不转发）
+    std::string psd_map;        // Solver: 反向追踪的相空间密度映射，--psd-map=FILE 边界模型的绝对路径（见 psd_mapping.h），为空时不使用
+    std::shared_ptr<const psd_map::Model> psd_model; // 解析 --psd-map 时读取的边界模型（每个进程只读一次，读取失败即退出）
+    std::string events;         // Solver: 检测的事件，--events=LIST（见 event_detector.h），为空时不检测
+    std::string stream;         // Solver: 轨迹流式输出到 fifo:PATH 或 unix:PATH，不写文件
+    int shard_index = 0;        // Solver/Diagnosor: 只运行第 k 个分片，--shard=k/N（k 从 0 开始）
+    int shard_count = 1;
+    bool merge_shards = false;  // Solver: 合并各分片的日志和汇总，--merge-shards
+    std::string serve;          // Solver: 作为任务协调进程监听 unix:PATH 或 tcp:HOST:PORT
+    std::string worker;         // Solver: 作为工作进程向该地址的协调进程请求任务
+    double lease = 30.0;        // Solver: 协调进程的租约时长 [s]，--lease=S
+    int retries = 2;            // Solver: 失败任务的最多重试次数，--retries=N
+    double checkpoint = 60.0;   // Solver: 检查点间隔（墙钟时间）[s]，--checkpoint=S，0 为不写检查点
+    bool resume = false;        // Solver: 有检查点的粒子从检查点继续，--resume
+    bool force = false;         // Solver/Diagnosor: 忽略结果缓存，全部重算，--force（只在主进程中使用）
+    std::string params;         // 子进程: 清单中粒子的参数，--params=v1,...,v16（由主进程逐个粒子给出，不转发）
+    std::string board;          // 子进程: 进度表中的槽位，--board=<槽位>:<路径>（由主进程逐个粒子给出，不转发）
+    int status = 0;             // Solver: 显示进度表后退出，--status（1: 运行中的粒子）或 --status=all（2: 全部粒子）
+    std::string t_range;        // Diagnosor: 只诊断该时间范围内的记录，--t_range=t0,t1（原样转发）
+    double t_begin = 0.0, t_end = 0.0;
+};
+
+extern RunOptions run_options;
+
+// 解析命令行中的 "--key=value" 选项，返回剩余的位置参数（不含argv[0]）
+std::vector<std::string> parse_run_options(int argc, char* argv[]);
+
+// 生成转发给子进程的选项参数
+std::vector<std::string> forward_run_options();
@@ -1,4 +1,6 @@
 #pragma once
+#include <ostream>
+#include <string>
 #include <Eigen/Dense>
 #ifdef _WIN32
 #include <windows.h>
@@ -10,4 +12,36 @@
 extern std::string exeDir;
 
 Eigen::VectorXd dydt(const Eigen::VectorXd& arr_in);
-int singular_particle(const std::string& para_file);
\ No newline at end of file
+
+// 导心方程右端的各项（dydt、多速率积分、集合积分和弹跳平均共用同一组公式）
+struct DriftTerms {
+    double gamm = 1.0;
+    Eigen::Vector3d unit_B, vd_ExB, vd_grad, vd_curv, v_para, v_total;  // 速度 [RE/s]
+    double dp_dt_1 = 0.0;   // 镜面力 -mu/gamma b·grad B
+    double dp_dt_2 = 0.0;   // 平行电场
+    double dp_coef = 0.0;   // dp_dt_3 = dp_coef v_total·deb_dt
+};
+// 给定该点的场量 B, E, grad |B|, 曲率和粒子的 E0 [MeV], mu [MeV/nT], q [e]；
+// gamm 为 0 时由 p_para 和 |B| 计算，否则直接使用（弹跳平均用总动量）
+DriftTerms drift_terms(double E0, double mu, double q, double p_para, const Eigen::Vector3d& B,
+                       const Eigen::Vector3d& E, const Eigen::Vector3d& grad_B, const Eigen::Vector3d& curv_B,
+                       double gamm = 0.0);
+// dydt 及其对 Y 的雅可比矩阵 J = ∂(dydt)/∂Y。x, y, z 方向：由 field_jet 的 B 的一、二阶导数解析地得到
+// B, E, grad_B, curv_B 在 Y ± r_step 处的一阶展开，只在这两点重新计算 deb_dt，再作中心差分；
+// t 方向为步长 t_step 的 dydt 中心差分（time_column 为 false 时置零）；p_para 方向复用 Y 处的场量（步长 1e-6 p）。
+// 每次约 57 次 Bvec（不要 t 列时 37 次），dydt 为 10 次。返回值与 dydt(Y) 逐位相同
+Eigen::VectorXd dydt_jacobian(const Eigen::VectorXd& Y, Eigen::Matrix<double, 5, 5>& J, bool time_column = true);
+int singular_particle(const std::string& para_file);
+
+// 按当前选项 (--profile, --encoding) 得到的轨迹输出文件路径，outFileBase 不含扩展名
+std::string trajectory_output_path(const std::string& outFileBase);
+
+// 轨迹结果的缓存键 (result_cache)，包括输出选项
+std::string solver_cache_key(const std::string& para_file);
+
+// 按当前选项的输出编码 (traj_io::Encoding)，紧凑方案不压缩
+int output_encoding();
+
+struct ParticleParams;
+// 粒子日志中的参数部分
+void log_particle_params(std::ostream& log, const ParticleParams& params, const std::string& outFilePath);
\ No newline at end of file
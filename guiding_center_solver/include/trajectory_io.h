@@ -0,0 +1,215 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief 轨迹/诊断文件的读写
+ *
+ * 原始格式(raw)：前缀(prefix) + 若干条记录，每条记录 ncols 个 double，
+ * 即 .gct/.gcd 一直以来的布局。
+ *
+ * 压缩格式(compressed, 扩展名加 'z'，如 .gctz/.gcdz)：无损块编码。
+ *   文件头: "GCZ1", int32 ncols, int32 block_size, int32 prefix_len,
+ *           int64 record_count, int64 index_offset
+ *   前缀:   prefix_len 字节，与原始文件的前缀完全相同
+ *   数据块: int32 nrec, int32 payload_len, payload
+ *   索引:   int64 nblocks, 每块 {int64 offset, int64 first_record, double first_value}
+ * 块内按列编码：每列 1 字节预测阶数（1: 前值，2: 线性外推，3: 二次外推，取残差最小者），
+ * 残差 r = bits(x) XOR bits(预测值)，每个残差用 4 bit 记录有效字节数，再存储低位有效字节：
+ *   uint8 order, uint8 ctrl[(nrec+1)/2]（第k个残差在 ctrl[k/2] 的低/高半字节）, 残差字节
+ * 块可顺序流式解码（索引缺失时也可以），也可以通过索引按块号随机访问。
+ *
+ * 轨迹(.gct)另有两种输出方案(profile)：
+ *   compact  (.gctc): "GCTC", int32 count, double t_ini, double write_dt,
+ *                     double offset[4], double scale[4], 之后每条记录 4 个 float32
+ *                     （x, y, z, p_para 的 (v - offset) / scale）；时间不存储，
+ *                     t_k = t_ini + k * write_dt
+ *   envelope (.gcte): 前缀 "GCTE", int32 count, int32 window, int32 0, double write_dt，
+ *                     之后每个窗口（window 条轨迹记录）一条 14 个 double 的记录：
+ *                     t_first, t_last, 以及 x, y, z, p_para 各自的 min, max, mean；
+ *                     可与压缩编码组合 (.gctez)
+ *   events            不写轨迹，粒子的输出只有事件记录 (.gce，Solver --events)
+ * TrajectoryReader 读取 compact 文件时还原出 5 列记录，与 full 方案一致。
+ *
+ * 按时间随机访问（每条记录第一列为时间，正向或反向积分时单调）：
+ *   raw 定长记录直接对文件二分查找，compact 由 t_ini + k * write_dt 直接计算，
+ *   compressed 先在块索引（每块首条记录的时间）中二分，再解码一个块。
+ */
+
+namespace traj_io {
+
+enum Encoding { ENCODING_RAW = 0, ENCODING_COMPRESSED = 1 };
+
+// "raw" / "compressed" -> Encoding，未知名称返回 -1
+int parse_encoding(const std::string& name);
+
+// 给定基础路径（不含扩展名）和扩展名（如 ".gct"），返回该编码对应的文件路径
+std::string encoded_path(const std::string& base, const std::string& ext, int encoding);
+
+enum Profile { PROFILE_FULL = 0, PROFILE_COMPACT = 1, PROFILE_ENVELOPE = 2, PROFILE_EVENTS = 3 };
+
+// "full" / "compact" / "envelope" / "events" -> Profile，未知名称返回 -1
+int parse_profile(const std::string& name);
+
+// 轨迹文件扩展名：.gct / .gctc / .gcte；events 方案不写轨迹，只写事件记录 (.gce，见 event_detector.h)
+std::string profile_ext(int profile);
+
+// 查找可逐点读取的轨迹文件（.gct, .gctz, .gctc），都不存在时返回空字符串
+std::string find_trajectory(const std::string& base);
+
+const int ENVELOPE_NCOLS = 14;
+
+class TrajectoryWriter {
+public:
+    /**
+     * @param path         输出文件路径
+     * @param ncols        每条记录的 double 数
+     * @param prefix       记录前的文件头（原样保存）
+     * @param count_offset 前缀中 int32 记录数的位置，close() 时写入实际记录数；-1 表示无
+     */
+    TrajectoryWriter(const std::string& path, int ncols, const std::string& prefix, int count_offset)
+        : path_(path), ncols_(ncols), prefix_(prefix), count_offset_(count_offset) {}
+    virtual ~TrajectoryWriter() {}
+
+    virtual bool good() const = 0;
+    virtual void write(const double* record) = 0;
+    virtual void close() = 0;
+
+    /**
+     * @brief 检查点：把已写出的数据交给系统，返回从此处继续写入所需的状态
+     * （文件长度、尚在缓冲中的记录等）。返回空字符串表示不支持（如流式输出）。
+     * raw 和 compact 同时把文件头中的记录数更新为当前值，进程中断后文件仍可读。
+     */
+    virtual std::string checkpoint() { return ""; }
+    // 由 checkpoint() 的状态恢复：文件截断到检查点时的长度并继续写入，失败返回 false
+    virtual bool restore(const char*&, const char*) { return false; }
+
+    int64_t count() const { return count_; }
+    const std::string& path() const { return path_; }
+
+protected:
+    std::string path_;
+    int ncols_;
+    std::string prefix_;
+    int count_offset_;
+    int64_t count_ = 0;
+};
+
+// 创建写入器，同时删除同名的其他编码的旧文件；resume 为 true 时不打开文件，由调用者 restore()
+std::unique_ptr<TrajectoryWriter> open_writer(const std::string& base, const std::string& ext, int encoding,
+                                              int ncols, const std::string& prefix, int count_offset,
+                                              bool resume = false);
+
+/**
+ * @brief 创建轨迹(.gct)写入器，写入 5 列记录 (t, x, y, z, p_para)
+ *
+ * 同时删除该粒子其他输出方案/编码的旧轨迹文件。
+ * @param write_count 预计记录数（close() 时改为实际值）
+ * @param write_dt    相邻记录的时间间隔（compact 的隐式时间，envelope 的窗口时间）
+ * @param window      envelope 方案每个窗口的记录数
+ * @param resume_state 非空时从该检查点状态继续写入已有文件（不删除其他文件），失败返回 nullptr
+ */
+std::unique_ptr<TrajectoryWriter> open_trajectory_writer(const std::string& base, int profile, int encoding,
+                                                         int32_t write_count, double write_dt, int window,
+                                                         const std::string* resume_state = nullptr);
+
+// 检查点状态的序列化（按本机字节序原样存储，只用于标量和数组；Eigen 对象逐个元素存储）
+template <class T>
+inline void put_value(std::string& out, const T& v) {
+    static_assert(std::is_trivially_copyable<T>::value, "put_value stores raw bytes");
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+template <class T>
+inline bool get_value(const char*& p, const char* end, T& v) {
+    static_assert(std::is_trivially_copyable<T>::value, "get_value restores raw bytes");
+    if (end - p < static_cast<std::ptrdiff_t>(sizeof(T))) return false;
+    std::memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+class TrajectoryReader {
+public:
+    /**
+     * @param path         文件路径，按文件内容自动识别编码
+     * @param ncols        原始格式时每条记录的 double 数（压缩格式从文件头读取）
+     * @param prefix_len   原始格式时前缀字节数
+     * @param count_offset 原始格式时前缀中 int32 记录数的位置
+     */
+    bool open(const std::string& path, int ncols, int prefix_len, int count_offset);
+
+    // 顺序读取下一条记录
+    bool next(double* record);
+
+    // 按块随机访问（原始格式按 block_size 条记录划分虚拟块）
+    int64_t num_blocks() const;
+    bool read_block(int64_t k, std::vector<double>& records);
+
+    // 第一条时间不早于 t 的记录序号（按积分方向；反向积分时为不晚于 t），都早于 t 时返回 count()
+    int64_t lower_bound_time(double t);
+    // 把顺序读取的位置移到第 k 条记录
+    bool seek(int64_t k);
+    // 把顺序读取的位置移到时间在 t0 和 t1 之间（含端点）的第一条记录，返回范围内的记录数
+    int64_t seek_range(double t0, double t1);
+    // 读取时间在 t0 和 t1 之间（含端点）的全部记录，行优先存储
+    bool read_range(double t0, double t1, std::vector<double>& records);
+
+    int encoding() const { return encoding_; }
+    int profile() const { return profile_; }
+    int ncols() const { return ncols_; }
+    int64_t count() const { return count_; }
+    const std::string& prefix() const { return prefix_; }
+
+private:
+    bool load_block_at(int64_t offset);
+    bool open_compact(int64_t file_size);
+    int direction();
+    int64_t bound_time(double t, bool upper);
+    double time_at(int64_t k);
+    int64_t block_of(int64_t k) const;
+    bool cached_block(int64_t b);
+    void expand_compact(const float* packed, int64_t first, int64_t nrec, double* records) const;
+
+    std::ifstream in_;
+    int encoding_ = ENCODING_RAW;
+    int profile_ = PROFILE_FULL;
+    int ncols_ = 0;
+    int block_size_ = 0;
+    int64_t count_ = 0;
+    int64_t data_offset_ = 0;
+    int64_t index_offset_ = 0;
+    std::string prefix_;
+    std::vector<int64_t> block_offsets_;
+    std::vector<int64_t> block_first_record_;
+    std::vector<double> block_first_time_;
+
+    // 时间查找用的块缓存，以及积分方向（+1 正向，-1 反向，0 未知）
+    std::vector<double> cache_;
+    int64_t cache_id_ = -1;
+    int direction_ = 0;
+
+    // compact: 隐式时间和 float32 的还原参数
+    double t_ini_ = 0.0, write_dt_ = 0.0;
+    double offset_[4] = {0, 0, 0, 0}, scale_[4] = {1, 1, 1, 1};
+
+    // streaming state
+    std::vector<double> block_;
+    int64_t block_pos_ = 0;
+    int64_t next_block_offset_ = 0;
+    int64_t records_read_ = 0;
+};
+
+// 打开轨迹文件（任意方案和编码）并读取时间在 [t0, t1] 内的记录；ncols 返回每条记录的列数
+bool read_range(const std::string& path, double t0, double t1, std::vector<double>& records, int* ncols = nullptr);
+
+// 块编码/解码（nrec 条记录，行优先存储）
+void encode_block(const double* records, int nrec, int ncols, std::string& out);
+bool decode_block(const char* data, size_t len, int nrec, int ncols, double* records);
+
+} // namespace traj_io
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "trajectory_io.h"
+
+/**
+ * @brief 轨迹流式输出（命名管道 / UNIX 域套接字），用于在线分析
+ *
+ * 输出目标写作 "fifo:PATH" 或 "unix:PATH"。消费者（如 StreamConsumer）需先启动：
+ * fifo 由消费者创建并打开读端，unix 由消费者监听。多个粒子进程可以同时写同一目标。
+ *
+ * 帧格式（小端）：
+ *   帧头 16 字节: uint16 magic (0x4753, "GS"), uint16 type, uint32 stream, uint32 count, uint32 length
+ *   之后 length 字节的负载。stream 为生产者进程号，区分同时写入的粒子。
+ *   FRAME_START   : StreamMeta（见下），count = 0
+ *   FRAME_RECORDS : count 条记录，每条 ncols 个 double
+ *   FRAME_END     : int64 实际记录数，count = 0
+ * 每帧不超过 PIPE_BUF（4096 字节）并用一次 write 写出，因此多个进程共用一个 fifo 时帧不会交错。
+ */
+
+namespace traj_stream {
+
+const uint16_t FRAME_MAGIC = 0x4753;
+const int FRAME_HEADER_LEN = 16;
+const int MAX_FRAME_LEN = 4096;
+
+enum FrameType { FRAME_START = 1, FRAME_RECORDS = 2, FRAME_END = 3 };
+
+struct FrameHeader {
+    uint16_t magic;
+    uint16_t type;
+    uint32_t stream;
+    uint32_t count;
+    uint32_t length;
+};
+
+// START 帧负载：粒子的基本参数
+struct StreamMeta {
+    int32_t ncols = 5;
+    int32_t magnetic_field_model = 0;
+    int32_t wave_field_model = 0;
+    int32_t expected_count = 0;
+    double E0 = 0.0, q = 0.0, Ek = 0.0, pa = 0.0;
+    double p = 0.0;             // 初始动量 [MeV/c]
+    double mu = 0.0;            // 第一绝热不变量 [MeV/nT]
+    double t_ini = 0.0;
+    double write_dt = 0.0;
+    std::string name;           // .para 文件名（不含扩展名）
+
+    std::string to_bytes() const;
+    bool from_bytes(const char* data, size_t len);
+};
+
+// "fifo:PATH" / "unix:PATH" 是否有效
+bool valid_target(const std::string& target);
+
+// 每个 RECORDS 帧最多容纳的记录数
+int records_per_frame(int ncols);
+
+/**
+ * @brief 创建流式写入器。连接失败时输出错误并退出。
+ * 接口与文件写入器相同（traj_io::TrajectoryWriter），close() 发送 END 帧。
+ */
+std::unique_ptr<traj_io::TrajectoryWriter> open_stream_writer(const std::string& target, const StreamMeta& meta);
+
+} // namespace traj_stream
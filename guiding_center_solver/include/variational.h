@@ -0,0 +1,58 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <Eigen/Dense>
+
+#include "trajectory_io.h"
+
+/**
+ * @brief 切线性（变分）方程 (Solver --variational[=matrix|ftle])
+ *
+ * 与 Y = (t, x, y, z, p_para) 一起积分 5×5 的灵敏度矩阵 Φ = ∂Y(t)/∂Y(t_ini)：
+ *   dΦ/dt = J(Y) Φ，Φ(t_ini) = I，
+ * J 为 dydt 的雅可比矩阵（dydt_jacobian：位置方向由 B 的二阶差分解析地线性化场量，t、p_para 方向为中心差分）。
+ * Φ 与 Y 用同一个 RK4（各级的 J 取在 Y 的各级状态上），Y 的结果与不加 --variational 逐位相同。
+ *
+ * 成本：每个 RK4 级约 57 次 Bvec，ftle 方案不需要 Φ 的第 0 列，约 37 次（dydt 为 10 次）。
+ * 实测（Release 构建，偶极场中 L = 4 的 1 MeV 质子 20 s）matrix 约为普通运行的 5.6 倍，ftle 约 3.6 倍；
+ * 加极向波场时 5.5 倍和 3.9 倍。对 x, y, z, p_para 的扰动运行需要 5 次（单侧差分）或 9 次（中心差分）运行，
+ * 且结果依赖扰动幅度；matrix 方案另外给出对 t_ini 的灵敏度。
+ *
+ * 有限时间 Lyapunov 指数 (FTLE)：位置 [RE] 和 p_para / p 组成的 4×4 子矩阵的最大奇异值 σ，
+ *   λ = ln σ / |t - t_ini|  [1/s]（p 为总动量，t_ini 处为 0）。
+ *
+ * 输出 output/<name>.gcv，与轨迹记录同时写入：前缀 "GCVR", int32 count, int32 ncols，
+ * 之后每条记录 ncols 个 double：t, λ，matrix 方案再加按行排列的 Φ（25 个）。
+ */
+
+namespace variational {
+
+enum Output { NONE = 0, MATRIX = 1, FTLE = 2 };
+
+typedef Eigen::Matrix<double, 5, 5> Matrix5d;
+
+// 每条记录的 double 数
+int ncols(int output);
+
+// 一步 RK4，同时积分 Y 和 Φ；k1 = dydt(Y)（事件检测用）。output 为 FTLE 时不积分 Φ 的第 0 列（对 t_ini 的灵敏度）
+void step(Eigen::VectorXd& Y, Matrix5d& Phi, double h, Eigen::VectorXd& k1, int output);
+
+// 有限时间 Lyapunov 指数 [1/s]，p 为总动量 [MeV/c]
+double ftle(const Matrix5d& Phi, double elapsed, double p);
+
+/**
+ * @brief 打开 .gcv 写入器
+ * @param resume_state 非空时从检查点状态（checkpoint() 的返回值）继续写入，同时恢复 Phi；
+ *                     状态属于其他输出方案或无法恢复时返回 nullptr
+ */
+std::unique_ptr<traj_io::TrajectoryWriter> open_writer(const std::string& outFileBase, int output,
+                                                      const std::string* resume_state, Matrix5d& Phi);
+
+// 写一条记录
+void write(traj_io::TrajectoryWriter& writer, int output, const Eigen::VectorXd& Y, const Matrix5d& Phi,
+           double t_ini, double p);
+
+// 检查点状态：int32 output, Φ（25 个 double），写入器的 checkpoint()；写入器不支持时返回空字符串
+std::string checkpoint(traj_io::TrajectoryWriter& writer, int output, const Matrix5d& Phi);
+
+} // namespace variational
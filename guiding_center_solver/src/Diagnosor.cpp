@@ -11,6 +11,11 @@
 #include "particle_calculator.h"
 #include "geopack_caller.h"
 #include "path_utils.h"
+#include "run_options.h"
+#include "trajectory_io.h"
+#include "particle_params.h"
+#include "batch_scheduler.h"
+#include "result_cache.h"
 
 #ifdef _WIN32
     #include <process.h>
@@ -22,8 +27,117 @@
 using namespace std;
 using namespace Eigen;
 
-const double c = 47.055; // Speed of light in RE/s
 string exeDir;
+extern int magnetic_field_model;    // 场模型（singular_particle.cpp），field_calculator 据此计算
+extern int wave_field_model;
+
+// 诊断量（列组），顺序即写入.gcd记录时的顺序
+enum DiagColumn {
+    COL_T, COL_GSM_POS, COL_P_PARA, COL_SM_POS, COL_MLAT, COL_MLT, COL_L,
+    COL_B, COL_E, COL_GRAD_B, COL_CURV_B,
+    COL_VD_EXB, COL_VD_GRAD, COL_VD_CURV, COL_V_PARA, COL_GAMM,
+    COL_DP_DT_1, COL_DP_DT_2, COL_DP_DT_3, COL_PB_PT,
+    NUM_DIAG_COLUMNS
+};
+
+#define BIT(col) (1u << (col))
+
+struct DiagColumnInfo {
+    const char* name;
+    int width;      // number of doubles
+    uint32_t deps;  // columns that must be computed first
+};
+
+const DiagColumnInfo diag_columns[NUM_DIAG_COLUMNS] = {
+    {"t",        1, 0},
+    {"gsm_pos",  3, 0},
+    {"p_para",   1, 0},
+    {"sm_pos",   3, 0},
+    {"MLAT",     1, BIT(COL_SM_POS)},
+    {"MLT",      1, BIT(COL_SM_POS)},
+    {"L",        1, BIT(COL_SM_POS) | BIT(COL_MLAT)},
+    {"B",        3, 0},
+    {"E",        3, 0},
+    {"grad_B",   3, 0},
+    {"curv_B",   3, 0},
+    {"vd_ExB",   3, BIT(COL_E) | BIT(COL_B)},
+    {"vd_grad",  3, BIT(COL_B) | BIT(COL_GRAD_B) | BIT(COL_GAMM)},
+    {"vd_curv",  3, BIT(COL_B) | BIT(COL_CURV_B) | BIT(COL_GAMM)},
+    {"v_para",   3, BIT(COL_B) | BIT(COL_GAMM)},
+    {"gamm",     1, BIT(COL_B)},
+    {"dp_dt_1",  1, BIT(COL_B) | BIT(COL_GRAD_B) | BIT(COL_GAMM)},
+    {"dp_dt_2",  1, BIT(COL_B) | BIT(COL_E)},
+    {"dp_dt_3",  1, BIT(COL_GAMM) | BIT(COL_VD_EXB) | BIT(COL_VD_GRAD) | BIT(COL_VD_CURV) | BIT(COL_V_PARA)},
+    {"pB_pt",    1, 0},
+};
+
+// 解析列选择（逗号、空格或换行分隔），空字符串或"all"表示全部列；t总是输出
+uint32_t parse_column_selection(const string& spec) {
+    uint32_t mask = BIT(COL_T);
+    string token;
+    istringstream iss(spec);
+    bool any = false;
+    while (iss >> token) {
+        size_t start = 0;
+        while (start <= token.size()) {
+            size_t end = token.find(',', start);
+            string name = token.substr(start, end == string::npos ? string::npos : end - start);
+            start = (end == string::npos) ? token.size() + 1 : end + 1;
+            if (name.empty()) continue;
+            any = true;
+            if (name == "all") return (1u << NUM_DIAG_COLUMNS) - 1;
+            int col = 0;
+            while (col < NUM_DIAG_COLUMNS && name != diag_columns[col].name) ++col;
+            if (col == NUM_DIAG_COLUMNS) {
+                cerr << "Unknown diagnostic column: " << name << endl;
+                exit(1);
+            }
+            mask |= BIT(col);
+        }
+    }
+    return any ? mask : (1u << NUM_DIAG_COLUMNS) - 1;
+}
+
+// 依赖闭包：选中的列加上计算它们所需的全部列
+uint32_t column_closure(uint32_t mask) {
+    uint32_t closure = mask;
+    uint32_t previous;
+    do {
+        previous = closure;
+        for (int col = 0; col < NUM_DIAG_COLUMNS; ++col) {
+            if (closure & BIT(col)) closure |= diag_columns[col].deps;
+        }
+    } while (closure != previous);
+    return closure;
+}
+
+// 列选择：命令行 --columns 优先，其次是 input/ 下的第一个 .dcol 文件
+string read_column_spec(const string& inputDir) {
+    if (!run_options.diag_columns.empty()) return run_options.diag_columns;
+
+    string dcol_file = PathUtils::findFirstFileWithExtension(inputDir, ".dcol");
+    if (dcol_file.empty()) return "";
+
+    ifstream in(dcol_file);
+    string spec, line;
+    while (getline(in, line)) {
+        size_t pos = line.find_first_of(";#");
+        spec += " " + ((pos != string::npos) ? line.substr(0, pos) : line);
+    }
+    return spec;
+}
+
+// 诊断结果的缓存键，包含轨迹文件戳记中的键；轨迹没有有效戳记时为空，总是重新诊断
+string diagnosis_cache_key(const string& para_file, const string& trajectory) {
+    string trajectory_key = trajectory.empty() ? "" : result_cache::stamp_key(trajectory);
+    if (trajectory_key.empty()) return "";
+
+    ostringstream extra;
+    extra << "diagnosor columns=" << parse_column_selection(read_column_spec(PathUtils::joinPath(exeDir, "input")))
+          << " encoding=" << run_options.encoding << " t_range=" << run_options.t_range
+          << " trajectory=" << PathUtils::getFilename(trajectory) << " " << trajectory_key;
+    return result_cache::particle_key(para_file, extra.str());
+}
 
 int diagnose_gct(string filePath){
     // If in child process mode, reinitialize exeDir using PathUtils
@@ -63,50 +177,22 @@ int diagnose_gct(string filePath){
 
     // All output below is written to logFile
     // logFile << "Trying to open parameter file: " << filePath << endl;
-    ifstream para_in(filePath);
-    if (!para_in) {
+    ParticleParams params;
+    if (!read_particle_params(filePath, params)) {
         logFile << "Failed to open parameter file: " << filePath << endl;
         logFile.close();
         exit(1);
     }
-    // Declare variables for parameters
-    double dt, E0, q, t_ini, t_interval, write_interval;
-    double xgsm, ygsm, zgsm, Ek, pa, atmosphere_altitude;
-    double t_step, r_step;
-    int32_t magnetic_field_model, wave_field_model;
-
-    string line;
-    int idx = 0;
-    while (getline(para_in, line)) {
-        if (line.empty()) continue;
-
-        size_t pos = line.find(';');
-        string value_str = (pos != string::npos) ? line.substr(0, pos) : line;
-        istringstream iss(value_str);
-        double val;
-        if (!(iss >> val)) continue;
-        switch (idx) {
-            case 0: dt = val; break;
-            case 1: E0 = val; break;
-            case 2: q = val; break;
-            case 3: t_ini = val; break;
-            case 4: t_interval = val; break;
-            case 5: write_interval = val; break;
-            case 6: xgsm = val; break;
-            case 7: ygsm = val; break;
-            case 8: zgsm = val; break;
-            case 9: Ek = val; break;
-            case 10: pa = val; break;
-            case 11: atmosphere_altitude = val; break;
-            case 12: t_step = val; break;
-            case 13: r_step = val; break;
-            case 14: magnetic_field_model = static_cast<int>(val); break; // 新增
-            case 15: wave_field_model = static_cast<int>(val); break;     // 新增
-            default: break;
-        }
-        ++idx;
-    }
-    para_in.close();
+    double dt = params.dt, E0 = params.E0, q = params.q;
+    double t_ini = params.t_ini, t_interval = params.t_interval, write_interval = params.write_interval;
+    double xgsm = params.xgsm, ygsm = params.ygsm, zgsm = params.zgsm, Ek = params.Ek, pa = params.pa;
+    double atmosphere_altitude = params.atmosphere_altitude;
+    double t_step = params.t_step, r_step = params.r_step;
+    int32_t magnetic_field_model = params.magnetic_field_model, wave_field_model = params.wave_field_model;
+
+    // the field calculators read the models from the globals (singular_particle.cpp)
+    ::magnetic_field_model = magnetic_field_model;
+    ::wave_field_model = wave_field_model;
 
     // calculate mu
     double mu;
@@ -120,41 +206,55 @@ int diagnose_gct(string filePath){
 
     // file name for output using PathUtils
     string filename = base_filename;
-    string outFilePath = PathUtils::joinPath(outputDir, filename + ".gct");
-    string diagFilePath = PathUtils::joinPath(outputDir, filename + ".gcd");
+    string outFileBase = PathUtils::joinPath(outputDir, filename);
+    // .gct, .gctz or .gctc (an envelope .gcte cannot be diagnosed point by point)
+    string outFilePath = traj_io::find_trajectory(outFileBase);
+    if (outFilePath.empty()) {
+        cerr << "No trajectory (.gct, .gctz or .gctc) found for " << outFileBase << endl;
+        exit(1);
+    }
+    string diagFilePath = traj_io::encoded_path(outFileBase, ".gcd", run_options.encoding);
+    string cacheKey = diagnosis_cache_key(filePath, outFilePath);
+    result_cache::clear_stamp(diagFilePath);
 
-    ifstream infile(outFilePath, ios::binary);
-    if (!infile) {
+    // the trajectory may be raw or compressed, the reader detects it
+    traj_io::TrajectoryReader infile;
+    if (!infile.open(outFilePath, 5, sizeof(int32_t), 0)) {
         cerr << "Failed to open file: " << outFilePath << endl;
         exit(1);
     }
     // Read the number of records
-    int32_t write_count; // 用int32_t替换long
-    infile.read(reinterpret_cast<char*>(&write_count), sizeof(write_count));
-    if (infile.gcount() != sizeof(write_count)) {
-        cerr << "Failed to read write count from file: " << outFilePath << endl;
-        exit(1);
+    int32_t write_count = static_cast<int32_t>(infile.count()); // 用int32_t替换long
+    if (!run_options.t_range.empty()) {
+        // only the records in --t_range, located through the time index
+        write_count = static_cast<int32_t>(infile.seek_range(run_options.t_begin, run_options.t_end));
     }
 
+    // column schema of the diagnostic records
+    uint32_t column_mask = parse_column_selection(read_column_spec(PathUtils::joinPath(exeDir, "input")));
+    uint32_t compute_mask = column_closure(column_mask);
+    int32_t record_len = 0;
+    for (int col = 0; col < NUM_DIAG_COLUMNS; ++col) {
+        if (column_mask & BIT(col)) record_len += diag_columns[col].width;
+    }
+    auto needs = [compute_mask](DiagColumn col) { return (compute_mask & BIT(col)) != 0; };
+
     // logFile << "Diagnosing file: " << outFilePath << endl;
     
-    ofstream diag_out(diagFilePath, ios::binary | ios::trunc);
-    if (!diag_out) {
+    double para_array[14] = {dt, E0, q, t_ini, t_interval, write_interval,
+                         xgsm, ygsm, zgsm, Ek, pa, atmosphere_altitude, t_step, r_step};
+    int32_t int_array[5] = {magnetic_field_model, wave_field_model, write_count,
+                            record_len, static_cast<int32_t>(column_mask)};
+    string header(reinterpret_cast<const char*>(para_array), sizeof(para_array));
+    header.append(reinterpret_cast<const char*>(int_array), sizeof(int_array));
+
+    unique_ptr<traj_io::TrajectoryWriter> diag_out =
+        traj_io::open_writer(outFileBase, ".gcd", run_options.encoding, record_len, header, sizeof(para_array) + 2 * sizeof(int32_t));
+    if (!diag_out->good()) {
         cerr << "Failed to open diagnostics file: " << diagFilePath << endl;
         exit(1);
     }
-    double para_array[14] = {dt, E0, q, t_ini, t_interval, write_interval,
-                         xgsm, ygsm, zgsm, Ek, pa, atmosphere_altitude, t_step, r_step};
-    diag_out.write(reinterpret_cast<const char*>(para_array), sizeof(para_array));
 
-    diag_out.write(reinterpret_cast<const char*>(&magnetic_field_model), sizeof(magnetic_field_model));
-    diag_out.write(reinterpret_cast<const char*>(&wave_field_model), sizeof(wave_field_model));
-    diag_out.write(reinterpret_cast<const char*>(&write_count), sizeof(write_count));
-
-    // Wring the diagnostic data
-    infile.clear();
-    infile.seekg(sizeof(write_count), ios::beg); // Skip the write_count
-    
     // Write log header with timestamp
     time_t now = time(nullptr);
     char timeBuffer[80];
@@ -171,13 +271,18 @@ int diagnose_gct(string filePath){
     logFile << "Processing trajectory file: " << outFilePath << endl;
     logFile << "Output diagnostic file: " << diagFilePath << endl;
     logFile << "Number of records to process: " << write_count << endl;
+    if (!run_options.t_range.empty()) logFile << "Time range: " << run_options.t_range << " s" << endl;
+    logFile << "Diagnostic columns (" << record_len << " doubles per record):";
+    for (int col = 0; col < NUM_DIAG_COLUMNS; ++col) {
+        if (column_mask & BIT(col)) logFile << " " << diag_columns[col].name;
+    }
+    logFile << endl;
     
     // Record start time
     auto start_time = std::chrono::high_resolution_clock::now();
     VectorXd Y(5);
     for (int32_t i = 0; i < write_count; ++i) { // 用int32_t替换long
-        infile.read(reinterpret_cast<char*>(Y.data()), Y.size() * sizeof(double));
-        if (infile.gcount() != Y.size() * sizeof(double)) {
+        if (!infile.next(Y.data())) {
             cerr << "Failed to read record " << i << " from file: " << outFilePath << endl;
             exit(1);
         }
@@ -190,81 +295,82 @@ int diagnose_gct(string filePath){
         double p_para = Y[4];
 
         // Convert GSM coordinates to SM coordinates
-        time_t epoch_time = static_cast<time_t>(t);
-        tm* time_info = gmtime(&epoch_time);
-        int IYEAR = time_info->tm_year + 1900;
-        int IDAY = time_info->tm_yday + 1;
-        int IHOUR = time_info->tm_hour;
-        int MIN = time_info->tm_min;
-        double ISEC = static_cast<double>(time_info->tm_sec);
-
-        double vgsex = -400.0, vgsey = 0.0, vgsez = 0.0;
-        recalc(&IYEAR, &IDAY, &IHOUR, &MIN, &ISEC, &vgsex, &vgsey, &vgsez);
-        double xsm, ysm, zsm;
-        int J = -1; // 1: SM->GSM, -1: GSM->SM
-        smgsm(&xsm, &ysm, &zsm, &x, &y, &z, &J);
-        double sm_pos[3] = {xsm, ysm, zsm};
-        double MLAT = atan2(zsm, sqrt(xsm*xsm + ysm*ysm)) * 180.0 / M_PI;
-        double MLT = acos(xsm / sqrt(xsm*xsm + ysm*ysm)) * 12.0 / M_PI * (ysm < 0 ? -1 : 1) + 12.0 ; 
-        double L = sqrt(xsm*xsm + ysm*ysm + zsm*zsm) / pow(cos(MLAT*M_PI/180),2); 
+        double sm_pos[3] = {0.0, 0.0, 0.0};
+        double MLAT = 0.0, MLT = 0.0, L = 0.0;
+        if (needs(COL_SM_POS)) {
+            time_t epoch_time = static_cast<time_t>(t);
+            tm* time_info = gmtime(&epoch_time);
+            int IYEAR = time_info->tm_year + 1900;
+            int IDAY = time_info->tm_yday + 1;
+            int IHOUR = time_info->tm_hour;
+            int MIN = time_info->tm_min;
+            double ISEC = static_cast<double>(time_info->tm_sec);
+
+            double vgsex = -400.0, vgsey = 0.0, vgsez = 0.0;
+            recalc(&IYEAR, &IDAY, &IHOUR, &MIN, &ISEC, &vgsex, &vgsey, &vgsez);
+            double xsm, ysm, zsm;
+            int J = -1; // 1: SM->GSM, -1: GSM->SM
+            smgsm(&xsm, &ysm, &zsm, &x, &y, &z, &J);
+            sm_pos[0] = xsm; sm_pos[1] = ysm; sm_pos[2] = zsm;
+            MLAT = atan2(zsm, sqrt(xsm*xsm + ysm*ysm)) * 180.0 / M_PI;
+            MLT = acos(xsm / sqrt(xsm*xsm + ysm*ysm)) * 12.0 / M_PI * (ysm < 0 ? -1 : 1) + 12.0 ; 
+            L = sqrt(xsm*xsm + ysm*ysm + zsm*zsm) / pow(cos(MLAT*M_PI/180),2); 
+        }
 
         // Calculate the field
-        Vector3d B = Bvec(t, x, y, z);
-        double Bt = B.norm();
-        if (Bt < 1e-10) {
-            cerr << "ERROR: Zero magnetic field detected at position [" << x << ", " << y << ", " << z
-                 << "], time = " << t << " (record " << i << ")" << endl;
-            cerr << "Cannot compute unit vector and drift velocities with zero field." << endl;
-            exit(1);
+        Vector3d B = Vector3d::Zero();
+        Vector3d unit_B = Vector3d::Zero();
+        double Bt = 0.0;
+        if (needs(COL_B)) {
+            B = Bvec(t, x, y, z);
+            Bt = B.norm();
+            if (Bt < 1e-10) {
+                cerr << "ERROR: Zero magnetic field detected at position [" << x << ", " << y << ", " << z
+                     << "], time = " << t << " (record " << i << ")" << endl;
+                cerr << "Cannot compute unit vector and drift velocities with zero field." << endl;
+                exit(1);
+            }
+            unit_B = B / Bt;
+        }
+        Vector3d E = needs(COL_E) ? Evec(t, x, y, z) : Vector3d::Zero();
+
+        Vector3d grad_B = Vector3d::Zero();
+        Vector3d curv_B = Vector3d::Zero();
+        if (needs(COL_GRAD_B) || needs(COL_CURV_B)) {
+            VectorXd dB = B_grad_curv(t, x, y, z, r_step);
+            grad_B = Vector3d(dB[0], dB[1], dB[2]);
+            curv_B = Vector3d(dB[3], dB[4], dB[5]);
         }
-        Vector3d E = Evec(t, x, y, z);
-
-        VectorXd dB = B_grad_curv(t, x, y, z, r_step);
-        Vector3d grad_B(dB[0], dB[1], dB[2]);
-        Vector3d curv_B(dB[3], dB[4], dB[5]);
-        Vector3d unit_B(B[0] / Bt, B[1] / Bt, B[2] / Bt);
 
         // Calculate the drift velocities
-        double gamm = sqrt(1. + pow(p_para * c, 2) / pow(E0, 2) + 2. * mu * Bt / E0);
-        Vector3d vd_ExB = E.cross(B) / Bt / Bt * 0.15696123;                                                 // ExB drift velocity in RE/s
-        Vector3d vd_grad = mu * B.cross(grad_B) / (gamm * q * pow(Bt, 2)) * 24.6368279;                      // gradient drift velocity in RE/s
-        Vector3d vd_curv = pow(p_para * c, 2) / (gamm * E0 * q * pow(Bt, 2)) * B.cross(curv_B) * 24.6368279; // curvature drift velocity in RE/s
-        Vector3d v_para = p_para * pow(c, 2) / (gamm * E0) * unit_B;                                         // parallel velocity in RE/s
+        double gamm = needs(COL_GAMM) ? sqrt(1. + pow(p_para * c, 2) / pow(E0, 2) + 2. * mu * Bt / E0) : 0.0;
+        Vector3d vd_ExB = needs(COL_VD_EXB) ? Vector3d(E.cross(B) / Bt / Bt * 0.15696123) : Vector3d::Zero();                                                 // ExB drift velocity in RE/s
+        Vector3d vd_grad = needs(COL_VD_GRAD) ? Vector3d(mu * B.cross(grad_B) / (gamm * q * pow(Bt, 2)) * 24.6368279) : Vector3d::Zero();                      // gradient drift velocity in RE/s
+        Vector3d vd_curv = needs(COL_VD_CURV) ? Vector3d(pow(p_para * c, 2) / (gamm * E0 * q * pow(Bt, 2)) * B.cross(curv_B) * 24.6368279) : Vector3d::Zero(); // curvature drift velocity in RE/s
+        Vector3d v_para = needs(COL_V_PARA) ? Vector3d(p_para * pow(c, 2) / (gamm * E0) * unit_B) : Vector3d::Zero();                                         // parallel velocity in RE/s
         Vector3d v_total = vd_ExB + vd_grad + vd_curv + v_para;
 
         // Calculate the changing rate of parallel momentum
-        double dp_dt_1 = -mu / gamm * grad_B.dot(unit_B);
-        double dp_dt_2 = q * E.dot(unit_B) * 6.371e-3;
-        double dp_dt_3 = gamm * E0 / pow(c, 2) * v_total.dot(deb_dt(t, x, y, z, v_total, r_step));
-        double dp_dt = dp_dt_1 + dp_dt_2 + dp_dt_3;
-
-        double pB_pt = pBpt(t, x, y, z, t_step);
-
+        double dp_dt_1 = needs(COL_DP_DT_1) ? -mu / gamm * grad_B.dot(unit_B) : 0.0;
+        double dp_dt_2 = needs(COL_DP_DT_2) ? q * E.dot(unit_B) * 6.371e-3 : 0.0;
+        double dp_dt_3 = needs(COL_DP_DT_3) ? gamm * E0 / pow(c, 2) * v_total.dot(deb_dt(t, x, y, z, v_total, r_step)) : 0.0;
+
+        double pB_pt = needs(COL_PB_PT) ? pBpt(t, x, y, z, t_step) : 0.0;
+
+        // assemble the selected columns in schema order
+        const double* values[NUM_DIAG_COLUMNS] = {
+            &t, gsm_pos, &p_para, sm_pos, &MLAT, &MLT, &L,
+            B.data(), E.data(), grad_B.data(), curv_B.data(),
+            vd_ExB.data(), vd_grad.data(), vd_curv.data(), v_para.data(), &gamm,
+            &dp_dt_1, &dp_dt_2, &dp_dt_3, &pB_pt
+        };
         double record[40];
         int idx = 0;
-        record[idx++] = t;                // 1
-        record[idx++] = gsm_pos[0];       // 2
-        record[idx++] = gsm_pos[1];       // 3
-        record[idx++] = gsm_pos[2];       // 4
-        record[idx++] = p_para;           // 5
-        for (int j = 0; j < 3; ++j) record[idx++] = sm_pos[j]; // 6-8
-        record[idx++] = MLAT;            // 9
-        record[idx++] = MLT;             // 10
-        record[idx++] = L;               // 11
-        for (int j = 0; j < 3; ++j) record[idx++] = B[j];         // 12-14
-        for (int j = 0; j < 3; ++j) record[idx++] = E[j];         // 15-17
-        for (int j = 0; j < 3; ++j) record[idx++] = grad_B[j];    // 18-20
-        for (int j = 0; j < 3; ++j) record[idx++] = curv_B[j];    // 21-23
-        for (int j = 0; j < 3; ++j) record[idx++] = vd_ExB[j];    // 24-26
-        for (int j = 0; j < 3; ++j) record[idx++] = vd_grad[j];   // 27-29
-        for (int j = 0; j < 3; ++j) record[idx++] = vd_curv[j];   // 30-32
-        for (int j = 0; j < 3; ++j) record[idx++] = v_para[j];    // 33-35
-        record[idx++] = gamm;             // 36
-        record[idx++] = dp_dt_1;          // 37
-        record[idx++] = dp_dt_2;          // 38
-        record[idx++] = dp_dt_3;          // 39
-        record[idx++] = pB_pt;            // 40
-        diag_out.write(reinterpret_cast<const char*>(record), sizeof(record));
+        for (int col = 0; col < NUM_DIAG_COLUMNS; ++col) {
+            if (!(column_mask & BIT(col))) continue;
+            for (int j = 0; j < diag_columns[col].width; ++j) record[idx++] = values[col][j];
+        }
+        diag_out->write(record);
 
         // only output at multiples of 10% to reduce log file size
         static int last_percent = -1;
@@ -275,7 +381,7 @@ int diagnose_gct(string filePath){
         }
 
         // Record abnormal values (optional)
-        if (gamm > 100 || std :: isnan(gamm) || std :: isinf(gamm)) {
+        if (needs(COL_GAMM) && (gamm > 100 || std :: isnan(gamm) || std :: isinf(gamm))) {
             logFile << "WARNING: Unusual gamma value " << gamm << " at record " << i
                     << ", position [" << x << ", " << y << ", " << z << "]" << endl;
         }
@@ -303,17 +409,21 @@ int diagnose_gct(string filePath){
     logFile << "Completion time: " << timeBuffer << endl;
     logFile << "=== END OF DIAGNOSTIC LOG ===" << endl;
 
-    diag_out.close();
-    infile.close();
+    diag_out->close();
+    if (!cacheKey.empty() && !result_cache::write_stamp(diagFilePath, cacheKey)) {
+        logFile << "WARNING: Failed to write result stamp for " << diagFilePath << endl;
+    }
     logFile.close();
     return 0;
 }
 
 int main(int argc, char* argv[]) {
+    vector<string> positional = parse_run_options(argc, argv);
+
     // Check if in child process mode
-    if (argc > 1) {
+    if (!positional.empty()) {
         // Child process mode: directly process parameter file and return
-        string para_file = argv[1];
+        string para_file = positional[0];
         diagnose_gct(para_file);
         return 0;
     }
@@ -330,16 +440,28 @@ int main(int argc, char* argv[]) {
     
     string inputDir = PathUtils::joinPath(exeDir, "input");
     string logDir = PathUtils::joinPath(exeDir, "log");
-    string mainLogPath = PathUtils::joinPath(logDir, "main.log");
+    string mainLogPath = PathUtils::joinPath(logDir, "main" + shard_suffix(run_options.shard_index, run_options.shard_count) + ".log");
 
     // Read all .para files in inputDir using PathUtils
-    vector<string> para_files = PathUtils::findFilesWithExtension(inputDir, ".para", true);
+    // and the particles of the manifests (input/*.pman) and ensemble generators (input/*.gen)
+    vector<string> all_para_files;
+    if (!find_particles(inputDir, all_para_files)) {
+        cerr << "Failed to read the particle manifests or generators in " << inputDir << endl;
+        exit(1);
+    }
 
-    if (para_files.empty()) {
-        cerr << "No .para files found in " << inputDir << endl;
+    if (all_para_files.empty()) {
+        cerr << "No .para files, .pman manifests or .gen generators found in " << inputDir << endl;
         exit(1);
     }
 
+    // same partition as Solver --shard=k/N, so each node diagnoses the particles it has integrated
+    vector<string> para_files = select_shard(all_para_files, run_options.shard_index, run_options.shard_count);
+    if (para_files.empty()) {
+        cout << "Shard " << run_options.shard_index << " of " << run_options.shard_count << " has no particles" << endl;
+        return 0;
+    }
+
     // Record start time
     auto total_start_time = std::chrono::high_resolution_clock::now();
 
@@ -364,14 +486,40 @@ int main(int argc, char* argv[]) {
     for (const auto& file : para_files) {
         mainLogFile << "  " << file << endl;
     }
+
+    // skip the particles whose diagnostics already match their trajectory, the options and this executable
+    if (!run_options.force) {
+        string outputDir = PathUtils::joinPath(exeDir, "output");
+        vector<string> stale;
+        for (const auto& file : para_files) {
+            string outFileBase = PathUtils::joinPath(outputDir, PathUtils::getBasename(PathUtils::getFilename(file)));
+            string diagFilePath = traj_io::encoded_path(outFileBase, ".gcd", run_options.encoding);
+            string key = diagnosis_cache_key(file, traj_io::find_trajectory(outFileBase));
+            if (!result_cache::up_to_date(diagFilePath, key)) stale.push_back(file);
+        }
+        if (stale.size() < para_files.size()) {
+            size_t cached = para_files.size() - stale.size();
+            mainLogFile << "Up to date, skipped: " << cached << " particles (--force recomputes them)" << endl;
+            cout << cached << " of " << para_files.size() << " particles are up to date" << endl;
+        }
+        para_files.swap(stale);
+        if (para_files.empty()) {
+            mainLogFile << "=== NOTHING TO DO ===" << endl;
+            return 0;
+        }
+    }
     mainLogFile << "Starting parallel processing..." << endl;
 
     // Parallel processing: start a separate process for each parameter file
     cout << "Starting " << para_files.size() << " processes for diagnosis..." << endl;
     vector<intptr_t> process_handles;
+    vector<string> forwarded = forward_run_options();
 
     for (const auto& para_file : para_files) {
         string cmd = string(argv[0]) + " \"" + para_file + "\"";
+        for (const auto& opt : forwarded) cmd += " \"" + opt + "\"";
+        string params = particle_params_argument(para_file);  // particles of a manifest
+        if (!params.empty()) cmd += " \"" + params + "\"";
 #ifdef _WIN32
         // Create process on Windows
         PROCESS_INFORMATION pi;
@@ -393,7 +541,11 @@ int main(int argc, char* argv[]) {
         // On Unix/Linux, use fork+exec to create process
         pid_t pid = fork();
         if (pid == 0) {  // Child process
-            execlp(argv[0], argv[0], para_file.c_str(), NULL);
+            vector<char*> child_argv = {argv[0], const_cast<char*>(para_file.c_str())};
+            for (auto& opt : forwarded) child_argv.push_back(const_cast<char*>(opt.c_str()));
+            if (!params.empty()) child_argv.push_back(const_cast<char*>(params.c_str()));
+            child_argv.push_back(nullptr);
+            execvp(argv[0], child_argv.data());
             exit(1);  // If exec fails
         }
         else if (pid > 0) {  // Parent process
@@ -6,6 +6,9 @@
 #include <Eigen/Dense>
 #include <chrono>
 #include <thread>
+#include <set>
+#include <map>
+#include <algorithm>
 
 #ifdef _WIN32
     #include <process.h>
@@ -18,18 +21,97 @@
 #include "particle_calculator.h"
 #include "singular_particle.h"
 #include "path_utils.h"
+#include "particle_params.h"
+#include "run_options.h"
+#include "batch_scheduler.h"
+#include "job_coordinator.h"
+#include "result_cache.h"
+#include "ensemble_generator.h"
+#include "cpu_affinity.h"
+#include "progress_board.h"
+#include "ensemble_integrator.h"
+#include "azimuthal_symmetry.h"
+#include "trajectory_io.h"
+#include "variational.h"
+#include "importance_splitting.h"
+#include "psd_mapping.h"
 
 using namespace std;
 using namespace Eigen;
 
 string exeDir;  // 全局变量，供其他源文件使用
 
+// 集合积分 (--ensemble)：第一个粒子 -> 整组粒子，预 fork 的子进程据此找到自己的一组
+static map<string, vector<string>> ensemble_members;
+
+// 预 fork 的子进程：单个粒子或一组粒子
+static int run_particles(const string& para_file)
+{
+    auto found = ensemble_members.find(para_file);
+    if (found == ensemble_members.end()) return singular_particle(para_file);
+    return lockstep::run(found->second);
+}
+
+// 把可以一起积分的粒子合成一个任务（按 --resume 从检查点继续的粒子仍单独运行），返回按估计耗时排序的任务
+static vector<BatchJob> ensemble_jobs(const vector<BatchJob>& jobs, int size, ostream& log)
+{
+    string outputDir = PathUtils::joinPath(exeDir, "output");
+    map<string, const BatchJob*> by_file;
+    vector<string> files;
+    vector<BatchJob> result;
+    for (const auto& job : jobs) {
+        string checkpointPath = PathUtils::joinPath(outputDir, job.name) + ".ckpt";
+        if (run_options.resume && PathUtils::fileExists(checkpointPath)) {
+            result.push_back(job);
+            continue;
+        }
+        by_file[job.para_file] = &job;
+        files.push_back(job.para_file);
+    }
+
+    size_t ensembles = 0;
+    for (const auto& members : lockstep::group(files, size)) {
+        const BatchJob& first = *by_file[members[0]];
+        if (members.size() == 1) {
+            result.push_back(first);
+            continue;
+        }
+        BatchJob job = first;
+        job.members = members;
+        job.name = first.name + "+" + to_string(members.size() - 1);
+        job.cost = 0.0;
+        for (const auto& file : members) {
+            job.steps = max(job.steps, by_file[file]->steps);
+            job.cost += by_file[file]->cost;
+        }
+        job.cost_source = "ensemble";
+        ensemble_members[members[0]] = members;
+        result.push_back(job);
+        ++ensembles;
+    }
+    sort(result.begin(), result.end(), [](const BatchJob& a, const BatchJob& b) { return a.cost > b.cost; });
+
+    log << "Ensembles (--ensemble=" << size << "): " << jobs.size() << " particles in " << result.size() << " processes, "
+        << ensembles << " of them ensembles" << endl;
+    for (const auto& job : result) {
+        if (job.members.empty()) continue;
+        log << "  " << job.name << ":";
+        for (const auto& file : job.members) log << " " << PathUtils::getBasename(PathUtils::getFilename(file));
+        log << endl;
+    }
+    return result;
+}
+
 int main(int argc, char* argv[])
 {
+    vector<string> positional = parse_run_options(argc, argv);
+
     // check if the program is running in child process mode
-    if (argc > 1) {
+    if (!positional.empty()) {
         // If the program is running in child process mode, it will directly handle the parameter file and return
-        string para_file = argv[1];
+        // several particles: integrate them together (an ensemble of Solver --ensemble)
+        if (positional.size() > 1) return lockstep::run(positional);
+        string para_file = positional[0];
         singular_particle(para_file);
         return 0;
     }
@@ -44,6 +126,19 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
+    // worker mode: take particles from a coordinator (Solver --serve=...) until it has none left
+    if (!run_options.worker.empty()) {
+        int slots = run_options.jobs > 0 ? run_options.jobs : 1;
+        affinity::Placement placement;
+        if (run_options.pin) {
+            placement = affinity::plan(slots);
+            affinity::describe(placement, cout);
+        }
+        int done = job_queue::work(run_options.worker, argv[0], exeDir, slots, placement.slot_cpus);
+        cout << "Worker finished " << done << " particles" << endl;
+        return 0;
+    }
+
     // Create log directory if it doesn't exist using PathUtils
     string logDir = PathUtils::joinPath(exeDir, "log");
     if (!PathUtils::createDirectory(logDir)) {
@@ -51,19 +146,44 @@ int main(int argc, char* argv[])
         exit(1);
     }
     logDir = PathUtils::ensureTrailingSeparator(logDir);
+
+    // merge the logs and summaries of all shards (copied into this log directory) and exit
+    if (run_options.merge_shards) {
+        return merge_shards(logDir, cout) ? 0 : 1;
+    }
+
+    // show the progress board of the batch running in this workspace (or the last one) and exit
+    if (run_options.status) {
+        string boardPath = logDir + "progress" + shard_suffix(run_options.shard_index, run_options.shard_count) + ".board";
+        return progress_board::show(boardPath, run_options.status == 2, cout) ? 0 : 1;
+    }
     
     // Read all .para files in exeDir/input using PathUtils
     string inputDir = PathUtils::joinPath(exeDir, "input");
-    vector<string> para_files = PathUtils::findFilesWithExtension(inputDir, ".para", true);
+    // and the particles of the manifests (input/*.pman) and ensemble generators (input/*.gen)
+    vector<string> all_para_files;
+    if (!find_particles(inputDir, all_para_files)) {
+        cerr << "Failed to read the particle manifests or generators in " << inputDir << endl;
+        exit(1);
+    }
 
     // For demonstration, just use the first .para file found
-    if (para_files.empty()) {
-        cerr << "No .para files found in " << inputDir << endl;
+    if (all_para_files.empty()) {
+        cerr << "No .para files, .pman manifests or .gen generators found in " << inputDir << endl;
         exit(1);
     }
 
+    // only the particles of this shard (all of them without --shard)
+    int shard = run_options.shard_index, shards = run_options.shard_count;
+    string suffix = shard_suffix(shard, shards);
+    vector<string> para_files = select_shard(all_para_files, shard, shards);
+    if (para_files.empty()) {
+        cout << "Shard " << shard << " of " << shards << " has no particles (" << all_para_files.size() << " in total)" << endl;
+        return 0;
+    }
+
     // create main log file using PathUtils
-    string mainLogPath = PathUtils::joinPath(logDir, "main.log");
+    string mainLogPath = PathUtils::joinPath(logDir, "main" + suffix + ".log");
     ofstream mainLogFile(mainLogPath, ios::out | ios::trunc);
     if (!mainLogFile) {
         cerr << "Failed to create main log file: " << mainLogPath << endl;
@@ -84,80 +204,266 @@ int main(int argc, char* argv[])
     mainLogFile << "=== SOLVER MAIN PROCESS STARTED AT " << timeBuffer << " ===" << endl;
     mainLogFile << "Executable path: " << exeDir << endl;
     mainLogFile << "Log directory: " << logDir << endl;
+    if (shards > 1) {
+        mainLogFile << "Shard " << shard << " of " << shards << ": " << para_files.size() << " of "
+                    << all_para_files.size() << " parameter files" << endl;
+    }
     mainLogFile << "Found " << para_files.size() << " parameter files to process:" << endl;
     for (const auto& file : para_files) {
         mainLogFile << "  " << file << endl;
     }
-    mainLogFile << "Starting parallel processing..." << endl;
 
-    // Record start time
-    auto total_start_time = std::chrono::high_resolution_clock::now();
-    
-    // Parallel processing: launch a separate process for each parameter file
-    cout << "Starting " << para_files.size() << " processes..." << endl;
-    mainLogFile << "Creating " << para_files.size() << " child processes..." << endl;
-    
-    vector<intptr_t> process_handles;
-
-    for (const auto& para_file : para_files) {
-        string cmd = string(argv[0]) + " \"" + para_file + "\"";
-        mainLogFile << "Launching process for: " << para_file << endl;
-        mainLogFile << "Command: " << cmd << endl;
-        
-        #ifdef _WIN32
-        // Create process on Windows
-        PROCESS_INFORMATION pi;
-        STARTUPINFOA si;
-        ZeroMemory(&si, sizeof(si));
-        si.cb = sizeof(si);
-        ZeroMemory(&pi, sizeof(pi));
-        
-        // create process
-        if (CreateProcessA(NULL, (LPSTR)cmd.c_str(), NULL, NULL, FALSE, 
-                          0, NULL, NULL, &si, &pi)) {
-            process_handles.push_back((intptr_t)pi.hProcess);
-            CloseHandle(pi.hThread); // close thread handle, keep process handle
-            mainLogFile << "Process created successfully, PID: " << pi.dwProcessId << endl;
+    // the particle table of every ensemble generator (weights for flux reconstruction)
+    for (const auto& gen_file : PathUtils::findFilesWithExtension(inputDir, ".gen", true)) {
+        string outputDir = PathUtils::joinPath(exeDir, "output");
+        string table = PathUtils::joinPath(outputDir, PathUtils::getBasename(PathUtils::getFilename(gen_file)) + ".ensemble.tsv");
+        if (PathUtils::createDirectory(outputDir) && ensemble::write_table(gen_file, table)) {
+            mainLogFile << "Ensemble table: " << table << endl;
+        }
+    }
+
+    // the PSD at every observation point from the mapping endpoints (--psd-map), cached ones included
+    vector<string> map_files = para_files;
+    auto write_psd_map = [&]() {
+        if (!run_options.psd_model) return;
+        string mapPath = PathUtils::joinPath(PathUtils::joinPath(exeDir, "output"), "psd_map" + suffix + ".tsv");
+        if (psd_map::write_map(mapPath, map_files, *run_options.psd_model, mainLogFile)) {
+            mainLogFile << "PSD map: " << mapPath << endl;
         } else {
-            mainLogFile << "ERROR: Failed to create process for: " << para_file << endl;
-            cerr << "Failed to create process for: " << para_file << endl;
-        }
-        #else
-        // Unix/Linux uses fork+exec to create processes
-        pid_t pid = fork();
-        if (pid == 0) {  // child process
-            execlp(argv[0], argv[0], para_file.c_str(), NULL);
-            exit(1);  // If exec fails, exit child process
-        } else if (pid > 0) {  // parent process
-            process_handles.push_back(pid);
-            mainLogFile << "Process created successfully, PID: " << pid << endl;
+            mainLogFile << "ERROR: Failed to write PSD map " << mapPath << endl;
+        }
+    };
+
+    // skip the particles whose output already matches the inputs, the options and this executable
+    // (not with --split: the children of a skipped particle would not be known)
+    if (run_options.stream.empty() && !run_options.force && run_options.split.empty()) {
+        string outputDir = PathUtils::joinPath(exeDir, "output");
+        vector<string> stale;
+        size_t cached = 0;
+        for (const auto& file : para_files) {
+            string outFileBase = PathUtils::joinPath(outputDir, PathUtils::getBasename(PathUtils::getFilename(file)));
+            string outFilePath = trajectory_output_path(outFileBase), key = solver_cache_key(file);
+            if (result_cache::up_to_date(outFilePath, key) ||
+                (run_options.symmetry > 0.0 && result_cache::up_to_date(outFilePath, key + symmetry::KEY_SUFFIX))) {
+                ++cached;
+            } else {
+                stale.push_back(file);
+            }
+        }
+        if (cached > 0) {
+            mainLogFile << "Up to date, skipped: " << cached << " particles (--force recomputes them)" << endl;
+            cout << cached << " of " << para_files.size() << " particles are up to date" << endl;
+        }
+        para_files.swap(stale);
+        if (para_files.empty()) {
+            write_psd_map();
+            mainLogFile << "=== NOTHING TO DO ===" << endl;
+            return 0;
+        }
+    }
+    // dipole field without waves: integrate one particle of every azimuthal symmetry class, rotate it for the others
+    vector<symmetry::Class> symmetry_classes;
+    if (run_options.symmetry > 0.0) {
+        if (!run_options.stream.empty() || !run_options.serve.empty()) {
+            mainLogFile << "--symmetry is not used with --stream or --serve, particles run one by one" << endl;
+        } else if (!run_options.events.empty() || run_options.variational != variational::NONE || !run_options.split.empty() ||
+                   run_options.profile == traj_io::PROFILE_ENVELOPE || run_options.profile == traj_io::PROFILE_EVENTS) {
+            mainLogFile << "--symmetry is not used with --events, --variational, --split or --profile=envelope|events, "
+                        << "particles run one by one" << endl;
         } else {
-            mainLogFile << "ERROR: Failed to create process for: " << para_file << endl;
-            cerr << "Failed to create process for: " << para_file << endl;
+            vector<symmetry::Class> rejected;
+            symmetry_classes = symmetry::find_classes(para_files, run_options.symmetry, rejected);
+            set<string> rotated;
+            for (const auto& c : symmetry_classes) {
+                for (const auto& m : c.members) rotated.insert(m.para_file);
+            }
+            vector<string> integrated;
+            for (const auto& file : para_files) {
+                if (!rotated.count(file)) integrated.push_back(file);
+            }
+            mainLogFile << "Azimuthal symmetry (--symmetry): " << para_files.size() << " particles, " << integrated.size()
+                        << " integrated, " << rotated.size() << " rotated from " << symmetry_classes.size()
+                        << " representatives" << endl;
+            for (const auto& c : symmetry_classes) {
+                mainLogFile << "  " << PathUtils::getBasename(PathUtils::getFilename(c.representative)) << ": "
+                            << c.members.size() << " rotated copies, deviation from the tilt change < " << c.deviation
+                            << " RE" << endl;
+            }
+            for (const auto& c : rejected) {
+                mainLogFile << "  " << PathUtils::getBasename(PathUtils::getFilename(c.representative)) << " and "
+                            << c.members.size() << " others: integrated one by one, deviation bound " << c.deviation
+                            << " RE > " << run_options.symmetry << " RE" << endl;
+            }
+            para_files.swap(integrated);
         }
-        #endif
     }
 
-    // wait for all processes to complete
-    cout << "Waiting for all processes to complete..." << endl;
-    mainLogFile << "Waiting for all " << process_handles.size() << " processes to complete..." << endl;
+    // estimate the cost of every particle and dispatch the most expensive ones first
+    // (a shard keeps its own timings until the shards are merged)
+    string historyPath = PathUtils::joinPath(logDir, "cost_history" + suffix + ".tsv");
+    vector<string> historyPaths = {PathUtils::joinPath(logDir, "cost_history.tsv")};
+    if (shards > 1) historyPaths.push_back(historyPath);
+    vector<BatchJob> jobs = plan_batch(para_files, historyPaths);
+    int max_jobs = run_options.jobs > 0 ? run_options.jobs : default_jobs();
+    mainLogFile << "Estimated cost (longest first, history: " << historyPath << "):" << endl;
+    for (const auto& job : jobs) {
+        mainLogFile << "  " << job.name << ": " << job.steps << " steps, models " << job.magnetic_field_model
+                    << "/" << job.wave_field_model << ", " << job.cost << " s (" << job.cost_source << ")" << endl;
+    }
+    if (run_options.serve.empty()) {
+        mainLogFile << "Starting parallel processing with at most " << max_jobs << " processes..." << endl;
+    }
+
+    // integrate compatible particles together, one child process per ensemble (not for streams or workers)
+    vector<BatchJob> particle_jobs;
+    if (run_options.ensemble > 0 && run_options.serve.empty()) {
+        if (!run_options.stream.empty()) {
+            mainLogFile << "--ensemble is not used with --stream, particles run one by one" << endl;
+        } else if (run_options.bounce_average > 0.0) {
+            mainLogFile << "--ensemble is not used with --bounce-average, particles run one by one" << endl;
+        } else if (!run_options.events.empty()) {
+            mainLogFile << "--ensemble is not used with --events, particles run one by one" << endl;
+        } else if (run_options.multirate > 0.0) {
+            mainLogFile << "--ensemble is not used with --multirate, particles run one by one" << endl;
+        } else if (run_options.auto_steps > 0.0) {
+            mainLogFile << "--ensemble is not used with --auto-steps, particles run one by one" << endl;
+        } else if (run_options.parareal > 0) {
+            mainLogFile << "--ensemble is not used with --parareal, particles run one by one" << endl;
+        } else if (run_options.variational != variational::NONE) {
+            mainLogFile << "--ensemble is not used with --variational, particles run one by one" << endl;
+        } else if (!run_options.split.empty()) {
+            mainLogFile << "--ensemble is not used with --split, particles run one by one" << endl;
+        } else if (!run_options.psd_map.empty()) {
+            mainLogFile << "--ensemble is not used with --psd-map, particles run one by one" << endl;
+        } else {
+            particle_jobs = jobs;
+            jobs = ensemble_jobs(particle_jobs, run_options.ensemble, mainLogFile);
+        }
+    }
+
+    // Record start time
+    auto total_start_time = std::chrono::high_resolution_clock::now();
     
-    int completed_processes = 0;
-    #ifdef _WIN32
-    for (auto handle : process_handles) {
-        WaitForSingleObject((HANDLE)handle, INFINITE);
-        CloseHandle((HANDLE)handle);
-        completed_processes++;
-        mainLogFile << "Process " << completed_processes << " of " << process_handles.size() << " completed." << endl;
+    if (!run_options.serve.empty()) {
+        // coordinator mode: workers (Solver --worker=...) pull the particles, longest first
+        job_queue::serve(jobs, run_options.serve, run_options.lease, run_options.retries, forward_run_options(), mainLogFile);
+    } else {
+        // pin every slot to one CPU, spread over the NUMA nodes
+        affinity::Placement placement;
+        if (run_options.pin) {
+            placement = affinity::plan(max_jobs);
+            affinity::describe(placement, mainLogFile);
+        }
+        const affinity::Placement* pinned = placement.empty() ? nullptr : &placement;
+
+        set<int> wave_models;
+        if (run_options.prefork) {
+            // load geopack and the wave configs once; the forked children inherit them copy-on-write
+            auto preload_start = std::chrono::high_resolution_clock::now();
+            for (const auto& job : jobs) wave_models.insert(job.wave_field_model);
+            for (int model : wave_models) {
+                if (!preload_field_model(model)) {
+                    cerr << "Failed to preload wave field model " << model << endl;
+                    exit(1);
+                }
+            }
+            std::chrono::duration<double> preload_elapsed = std::chrono::high_resolution_clock::now() - preload_start;
+            mainLogFile << "Pre-fork mode: geopack and " << wave_models.size() << " wave field models loaded in "
+                        << preload_elapsed.count() << " s" << endl;
+            // the server process of each NUMA node rebuilds the wave spectra in its own memory
+            placement.localize = [&wave_models]() {
+                for (int model : wave_models) {
+                    unsigned int seed;
+                    if (wave_seed(model, seed)) restore_wave_seed(model, seed);
+                }
+            };
+        }
+
+        // Parallel processing: a separate process for each parameter file, at most max_jobs at a time
+        auto run_jobs = [&](vector<BatchJob>& batch) {
+            cout << "Starting " << batch.size() << " processes (" << max_jobs << " at a time)..." << endl;
+            mainLogFile << "Creating " << batch.size() << " child processes..." << endl;
+
+            // live progress of every particle, see Solver --status
+            string boardPath = PathUtils::joinPath(logDir, "progress" + suffix + ".board");
+            if (progress_board::create(boardPath, batch)) {
+                mainLogFile << "Progress board: " << boardPath << " (Solver --status)" << endl;
+            }
+            run_batch(batch, max_jobs, argv[0], forward_run_options(), mainLogFile,
+                      run_options.prefork ? run_particles : nullptr, pinned);
+            progress_board::settle(batch);
+        };
+        run_jobs(jobs);
+
+        // importance splitting (--split): the children of every generation run as the next one
+        if (!run_options.split.empty()) {
+            vector<BatchJob> generation;
+            generation.swap(jobs);
+            for (int g = 0;; ++g) {
+                vector<string> children = splitting::spawn(generation, g, mainLogFile);
+                jobs.insert(jobs.end(), generation.begin(), generation.end());
+                if (children.empty()) break;
+                if (g + 1 == splitting::MAX_GENERATIONS) {
+                    mainLogFile << "WARNING: " << children.size() << " children not run, at most "
+                                << splitting::MAX_GENERATIONS << " generations" << endl;
+                    break;
+                }
+                generation = plan_batch(children, historyPaths);
+                run_jobs(generation);
+            }
+            string tablePath = PathUtils::joinPath(PathUtils::joinPath(exeDir, "output"), "splitting.tsv");
+            if (splitting::write_table(tablePath)) {
+                mainLogFile << "Splitting table: " << tablePath << " (" << jobs.size() << " particles)" << endl;
+            }
+        }
     }
-    #else
-    for (auto pid : process_handles) {
-        int status;
-        waitpid(pid, &status, 0);
-        completed_processes++;
-        mainLogFile << "Process " << completed_processes << " of " << process_handles.size() << " completed (PID: " << pid << ", status: " << status << ")." << endl;
+    if (!particle_jobs.empty()) {
+        // summary and history per particle: an ensemble's status for all its particles, its time shared among them
+        map<string, const BatchJob*> by_file;
+        for (const auto& job : jobs) {
+            if (job.members.empty()) by_file[job.para_file] = &job;
+            for (const auto& file : job.members) by_file[file] = &job;
+        }
+        for (auto& particle : particle_jobs) {
+            const BatchJob& job = *by_file[particle.para_file];
+            particle.status = job.status;
+            particle.elapsed = job.members.empty() ? job.elapsed : job.elapsed / job.members.size();
+        }
+        jobs.swap(particle_jobs);
     }
-    #endif
+    append_history(historyPath, jobs);
+
+    // the rotated copies (--symmetry), after the history: they cost nothing to integrate
+    if (!symmetry_classes.empty()) {
+        auto rotate_start = std::chrono::high_resolution_clock::now();
+        map<string, const BatchJob*> by_file;
+        for (const auto& job : jobs) by_file[job.para_file] = &job;
+        size_t emitted = 0, copies = 0;
+        vector<BatchJob> rotated;
+        for (const auto& c : symmetry_classes) {
+            const BatchJob& rep = *by_file[c.representative];
+            for (const auto& m : c.members) {
+                auto start = std::chrono::high_resolution_clock::now();
+                BatchJob job = rep;
+                job.para_file = m.para_file;
+                job.name = PathUtils::getBasename(PathUtils::getFilename(m.para_file));
+                job.cost = 0.0;
+                job.cost_source = "symmetry";
+                job.status = (rep.status == 0 && symmetry::emit(c.representative, m, mainLogFile)) ? 0 : 1;
+                job.elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+                if (job.status == 0) ++emitted;
+                rotated.push_back(job);
+                ++copies;
+            }
+        }
+        jobs.insert(jobs.end(), rotated.begin(), rotated.end());
+        std::chrono::duration<double> rotate_elapsed = std::chrono::high_resolution_clock::now() - rotate_start;
+        mainLogFile << "Rotated copies (--symmetry): " << emitted << " of " << copies << " written in "
+                    << rotate_elapsed.count() << " s" << endl;
+    }
+    string summaryPath = PathUtils::joinPath(logDir, "summary" + suffix + ".tsv");
+    write_summary(summaryPath, jobs, shard, shards);
+    write_psd_map();
 
     // Record end time and output elapsed time
     auto total_end_time = std::chrono::high_resolution_clock::now();
@@ -175,12 +481,13 @@ int main(int argc, char* argv[])
     
     // write end log information
     mainLogFile << "=== ALL SIMULATION PROCESSES COMPLETED ===" << endl;
-    mainLogFile << "Total files processed: " << para_files.size() << endl;
+    mainLogFile << "Total files processed: " << jobs.size() << endl;
     mainLogFile << "Total processing time: " << total_elapsed.count() << " seconds" << endl;
-    mainLogFile << "Average time per file: " << (total_elapsed.count() / para_files.size()) << " seconds" << endl;
+    mainLogFile << "Average time per file: " << (total_elapsed.count() / jobs.size()) << " seconds" << endl;
     mainLogFile << "Completion time: " << timeBuffer << endl;
     mainLogFile << "All output files should be available in: " << PathUtils::joinPath(exeDir, "output") << endl;
     mainLogFile << "Individual simulation logs available in: " << logDir << endl;
+    mainLogFile << "Run summary: " << summaryPath << endl;
     mainLogFile << "=== END OF SOLVER MAIN LOG ===" << endl;
     
     mainLogFile.close();
@@ -0,0 +1,70 @@
+#include <cmath>
+#include <algorithm>
+#include <Eigen/Dense>
+
+#include "auto_steps.h"
+#include "field_calculator.h"
+
+using namespace std;
+using namespace Eigen;
+
+extern double E0, mu;
+extern double r_step;
+extern int wave_field_model;
+
+namespace auto_steps {
+
+namespace {
+
+} // namespace
+
+Scales local_scales(const VectorXd& Y)
+{
+    double t = Y[0], x = Y[1], y = Y[2], z = Y[3], p_para = Y[4];
+    Scales s;
+
+    Vector3d B = Bvec(t, x, y, z);
+    s.B = B.norm();
+    VectorXd dB = B_grad_curv(t, x, y, z, r_step);
+    s.grad_length = s.B / Vector3d(dB[0], dB[1], dB[2]).norm();
+
+    // 磁纬：偶极场中 B_r / B_h = 2 tan λ
+    Vector3d r_hat = Vector3d(x, y, z).normalized();
+    double B_r = fabs(B.dot(r_hat));
+    double B_h = (B - B.dot(r_hat) * r_hat).norm();
+    s.lambda = atan2(B_r, 2.0 * B_h);
+    double r = sqrt(x * x + y * y + z * z);
+    double cos_l = cos(s.lambda), sin_l = sin(s.lambda);
+    s.L = r / (cos_l * cos_l);
+    double B_eq = s.B * pow(cos_l, 6) / sqrt(1.0 + 3.0 * sin_l * sin_l);
+
+    // 总动量和镜点磁场：(p_perp c)^2 = 2 E0 mu B，Bm = (pc)^2 / (2 E0 mu)
+    double pc2 = pow(p_para * c, 2) + 2.0 * E0 * mu * s.B;
+    double sin2_eq = (mu > 0.0) ? min(1.0, B_eq * 2.0 * E0 * mu / pc2) : 0.0;
+    double ya = sqrt(sin2_eq);
+    double gamm = sqrt(1.0 + pc2 / (E0 * E0));
+    double v = sqrt(pc2) * c / (gamm * E0);     // RE/s
+    s.tau_b = 4.0 * s.L / v * (1.3802 - 0.3198 * (ya + sqrt(ya)));
+
+    s.wave_period = wave_shortest_period(wave_field_model);
+    return s;
+}
+
+int steps_per_write(const Scales& s, double write_interval, double steps_per_period)
+{
+    double dt_max = min(s.tau_b, s.wave_period) / steps_per_period;
+    double n = ceil(fabs(write_interval) / dt_max);
+    return static_cast<int>(max(1.0, min(n, 1e9)));
+}
+
+double r_step_for(const Scales& s)
+{
+    return R_STEP_FRACTION * s.grad_length;
+}
+
+bool changed(double value, double new_value)
+{
+    return new_value > value * HYSTERESIS || new_value * HYSTERESIS < value;
+}
+
+} // namespace auto_steps
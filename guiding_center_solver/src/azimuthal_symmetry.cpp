@@ -0,0 +1,188 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <cmath>
+#include <map>
+#include <algorithm>
+#include <Eigen/Dense>
+
+#include "azimuthal_symmetry.h"
+#include "particle_params.h"
+#include "geopack_caller.h"
+#include "field_calculator.h"
+#include "trajectory_io.h"
+#include "singular_particle.h"
+#include "result_cache.h"
+#include "run_options.h"
+#include "path_utils.h"
+
+using namespace std;
+using namespace Eigen;
+
+namespace symmetry {
+
+namespace {
+
+// [t0, t1] 内偶极倾角的全变差 [rad]，每 TILT_SAMPLE 秒取一点
+double tilt_variation(double t0, double t1)
+{
+    const double TILT_SAMPLE = 60.0;
+    if (t1 < t0) swap(t0, t1);
+    int n = max(1, static_cast<int>(ceil((t1 - t0) / TILT_SAMPLE)));
+    time_t last = -1;
+    double variation = 0.0, psi0 = 0.0;
+    for (int k = 0; k <= n; ++k) {
+        recalc_at(t0 + (t1 - t0) * k / n, last);
+        const double* g = geopack1_common();
+        double psi = g ? atan2(g[10], g[11]) : 0.0;    // SPS, CPS
+        if (k > 0) variation += fabs(psi - psi0);
+        psi0 = psi;
+    }
+    return variation;
+}
+
+string timestamp()
+{
+    time_t now = time(nullptr);
+    char timeBuffer[80];
+    struct tm timeinfo;
+    #ifdef _WIN32
+        localtime_s(&timeinfo, &now);
+    #else
+        localtime_r(&now, &timeinfo);
+    #endif
+    strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    return timeBuffer;
+}
+
+} // namespace
+
+vector<Class> find_classes(const vector<string>& para_files, double tol, vector<Class>& rejected)
+{
+    // 键：除初始位置外的全部参数，以及初始位置的 ρ_SM、z_SM（按 POSITION_TOL 取整）
+    map<string, size_t> index;
+    vector<Class> classes;
+    vector<double> phi0, L;
+    time_t last = -1;
+    for (const auto& file : para_files) {
+        ParticleParams params;
+        if (!read_particle_params(file, params) || params.magnetic_field_model != 0 || params.wave_field_model != 0) {
+            continue;
+        }
+        recalc_at(params.t_ini, last);
+        Vector3d sm = gsm_to_sm(Vector3d(params.xgsm, params.ygsm, params.zgsm));
+        double rho = hypot(sm[0], sm[1]);
+        ostringstream key;
+        key << setprecision(17);
+        for (int idx = 0; idx < NUM_PARTICLE_PARAMS; ++idx) {
+            if (idx < 6 || idx > 8) key << get_particle_param(params, idx) << ' ';
+        }
+        key << llround(rho / POSITION_TOL) << ' ' << llround(sm[2] / POSITION_TOL);
+
+        double phi = atan2(sm[1], sm[0]);
+        auto found = index.find(key.str());
+        if (found == index.end()) {
+            index[key.str()] = classes.size();
+            classes.push_back(Class{file, {}, 0.0});
+            phi0.push_back(phi);
+            L.push_back(pow(sm.norm(), 3) / (rho * rho));     // 偶极磁力线 r = L cos^2 λ
+        } else {
+            classes[found->second].members.push_back(Member{file, phi - phi0[found->second]});
+        }
+    }
+
+    vector<Class> result;
+    for (size_t k = 0; k < classes.size(); ++k) {
+        Class& c = classes[k];
+        if (c.members.empty()) continue;
+        ParticleParams params;
+        read_particle_params(c.representative, params);
+        double t_end = params.t_ini + params.t_interval * (params.dt < 0 ? -1.0 : 1.0);
+        c.deviation = L[k] * tilt_variation(params.t_ini, t_end);
+        (c.deviation <= tol ? result : rejected).push_back(move(c));
+    }
+    return result;
+}
+
+bool emit(const string& representative, const Member& member, ostream& log)
+{
+    string logDir = PathUtils::joinPath(exeDir, "log");
+    string outputDir = PathUtils::joinPath(exeDir, "output");
+    string name = PathUtils::getBasename(PathUtils::getFilename(member.para_file));
+    string repName = PathUtils::getBasename(PathUtils::getFilename(representative));
+    string repPath = trajectory_output_path(PathUtils::joinPath(outputDir, repName));
+    string outFileBase = PathUtils::joinPath(outputDir, name);
+    string outFilePath = trajectory_output_path(outFileBase);
+
+    string logFilePath = PathUtils::joinPath(logDir, name + ".log");
+    ofstream logFile(logFilePath, ios::out | ios::trunc);
+    if (!logFile) {
+        log << "  " << name << ": failed to create log file " << logFilePath << endl;
+        return false;
+    }
+    logFile << "=== SIMULATION STARTED AT " << timestamp() << " ===" << endl;
+    logFile << "Parameter file: " << member.para_file << endl;
+    logFile << "Log file: " << logFilePath << endl;
+    logFile << "Azimuthal symmetry (--symmetry): rotated copy of " << repName << " by "
+            << member.dphi * 180.0 / M_PI << " deg about the SM z axis, not integrated" << endl;
+    ParticleParams params;
+    if (!read_particle_params(member.para_file, params)) {
+        logFile << "ERROR: Failed to open parameter file: " << member.para_file << endl;
+        log << "  " << name << ": failed to open parameter file" << endl;
+        return false;
+    }
+    log_particle_params(logFile, params, outFilePath);
+
+    traj_io::TrajectoryReader in;
+    if (!in.open(repPath, 5, sizeof(int32_t), 0)) {
+        logFile << "ERROR: Failed to read the trajectory of " << repName << ": " << repPath << endl;
+        log << "  " << name << ": failed to read " << repPath << endl;
+        return false;
+    }
+    result_cache::clear_stamp(outFilePath);
+    double dt = params.dt;
+    int write_step = static_cast<int>(params.write_interval / abs(dt));
+    double write_dt = run_options.auto_steps > 0.0 ? (dt < 0 ? -1.0 : 1.0) * params.write_interval : write_step * dt;
+    auto outfile = traj_io::open_trajectory_writer(outFileBase, run_options.profile, output_encoding(),
+                                                   static_cast<int32_t>(in.count()), write_dt, run_options.envelope_window);
+    if (!outfile->good()) {
+        logFile << "ERROR: Failed to open output file: " << outFilePath << endl;
+        log << "  " << name << ": failed to open " << outFilePath << endl;
+        return false;
+    }
+
+    double cos_d = cos(member.dphi), sin_d = sin(member.dphi);
+    double Y[5], final_Y[5] = {0, 0, 0, 0, 0};
+    time_t last = -1;
+    while (in.next(Y)) {
+        recalc_at(Y[0], last);
+        Vector3d sm = gsm_to_sm(Vector3d(Y[1], Y[2], Y[3]));
+        Vector3d gsm = sm_to_gsm(Vector3d(cos_d * sm[0] - sin_d * sm[1], sin_d * sm[0] + cos_d * sm[1], sm[2]));
+        Y[1] = gsm[0];
+        Y[2] = gsm[1];
+        Y[3] = gsm[2];
+        outfile->write(Y);
+        copy(Y, Y + 5, final_Y);
+    }
+    outfile->close();
+    if (!result_cache::write_stamp(outFilePath, solver_cache_key(member.para_file) + KEY_SUFFIX)) {
+        logFile << "WARNING: Failed to write result stamp for " << outFilePath << endl;
+    }
+
+    logFile << "=== SIMULATION COMPLETED ===" << endl;
+    logFile << "Final state:" << endl;
+    logFile << "  Final time: " << final_Y[0] << " s" << endl;
+    logFile << "  Final position: [" << final_Y[1] << ", " << final_Y[2] << ", " << final_Y[3] << "] RE" << endl;
+    logFile << "  Final parallel momentum: " << final_Y[4] << " MeV/c" << endl;
+    logFile << "  Final distance from Earth: " << sqrt(final_Y[1] * final_Y[1] + final_Y[2] * final_Y[2] + final_Y[3] * final_Y[3])
+            << " RE" << endl;
+    logFile << "  Actual writes: " << outfile->count() << " (as " << repName << ")" << endl;
+    logFile << "Output file: " << outFilePath << endl;
+    logFile << "Completion time: " << timestamp() << endl;
+    logFile << "=== END OF SIMULATION LOG ===" << endl;
+    return true;
+}
+
+} // namespace symmetry
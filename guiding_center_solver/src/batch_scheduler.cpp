@@ -0,0 +1,790 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <queue>
+#include <tuple>
+#include <set>
+#include <thread>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/types.h>
+    #include <sys/wait.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <unistd.h>
+#endif
+
+#include "batch_scheduler.h"
+#include "particle_params.h"
+#include "progress_board.h"
+#include "importance_splitting.h"
+#include "path_utils.h"
+
+using namespace std;
+
+namespace {
+
+const double DEFAULT_SECONDS_PER_UNIT = 1e-3;   // 未优化编译、偶极子场下每步约 1 ms
+
+// 每步相对耗时（磁场 + 波场）
+double model_factor(int magnetic_field_model, int wave_field_model)
+{
+    double mag = (magnetic_field_model == 1) ? 5.0 : 1.0;
+    double wave = 0.0;
+    if (wave_field_model == 1 || wave_field_model == 2) wave = 1.0;
+    if (wave_field_model == 3 || wave_field_model == 4) wave = 3.0;
+    return mag + wave;
+}
+
+struct HistoryRow {
+    string name;
+    int magnetic_field_model, wave_field_model;
+    int64_t steps;
+    double seconds;
+};
+
+vector<HistoryRow> read_history(const string& path)
+{
+    vector<HistoryRow> rows;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream iss(line);
+        HistoryRow row;
+        if (getline(iss, row.name, '\t') &&
+            iss >> row.magnetic_field_model >> row.wave_field_model >> row.steps >> row.seconds &&
+            row.steps > 0 && row.seconds > 0.0) {
+            rows.push_back(row);
+        }
+    }
+    return rows;
+}
+
+double median(vector<double> v)
+{
+    sort(v.begin(), v.end());
+    size_t n = v.size();
+    return (n % 2) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+double seconds_since(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// 从 "<prefix>.shard<k>of<n><ext>" 中解析分片号
+bool parse_shard_name(const string& filename, const string& prefix, const string& ext, int& k, int& n)
+{
+    string head = prefix + ".shard";
+    if (filename.compare(0, head.size(), head) != 0 || filename.size() <= head.size() + ext.size() ||
+        filename.compare(filename.size() - ext.size(), ext.size(), ext) != 0) {
+        return false;
+    }
+    string middle = filename.substr(head.size(), filename.size() - head.size() - ext.size());
+    char extra;
+    return sscanf(middle.c_str(), "%dof%d%c", &k, &n, &extra) == 2 && n > 1 && k >= 0 && k < n;
+}
+
+struct SummaryRow {
+    string name;
+    int shard = 0;
+    string fields;      // shard 之后的各列，原样保留
+    double seconds = 0.0;
+    int status = 0;
+};
+
+const char* SUMMARY_HEADER = "# name\tshard\tmagnetic_field_model\twave_field_model\tsteps\testimated\tseconds\tstatus\tweight\n";
+
+vector<SummaryRow> read_summary(const string& path)
+{
+    vector<SummaryRow> rows;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream iss(line);
+        SummaryRow row;
+        int mag, wave;
+        int64_t steps;
+        double estimated;
+        if (getline(iss, row.name, '\t') &&
+            iss >> row.shard >> mag >> wave >> steps >> estimated >> row.seconds >> row.status) {
+            row.fields = line.substr(row.name.size() + 1);
+            row.fields = row.fields.substr(row.fields.find('\t') + 1);
+            rows.push_back(row);
+        }
+    }
+    return rows;
+}
+
+#ifndef _WIN32
+// 节点服务进程中，子进程结束时唤醒 poll
+int sigchld_pipe = -1;
+
+void on_sigchld(int)
+{
+    int saved = errno;
+    char c = 0;
+    if (write(sigchld_pipe, &c, 1) < 0) {}
+    errno = saved;
+}
+
+bool write_all(int fd, const string& text)
+{
+    size_t done = 0;
+    while (done < text.size()) {
+        ssize_t n = write(fd, text.data() + done, text.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// 从 fd 读入数据，取出完整的行；对端关闭时返回 false
+bool read_lines(int fd, string& buffer, vector<string>& lines)
+{
+    char chunk[4096];
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR) return true;
+    if (n <= 0) return false;
+    buffer.append(chunk, static_cast<size_t>(n));
+    size_t start = 0, end;
+    while ((end = buffer.find('\n', start)) != string::npos) {
+        lines.push_back(buffer.substr(start, end - start));
+        start = end + 1;
+    }
+    buffer.erase(0, start);
+    return true;
+}
+
+/**
+ * @brief 一个 NUMA 节点的服务进程（预 fork 模式），不返回
+ *
+ * 绑定在节点的 CPU 上并重建只读表，然后从 cmd_fd 读取 "<任务序号> <CPU>"，
+ * 为每个任务 fork 一个绑定在该 CPU 上的子进程，向 report_fd 写 "S <任务序号> <PID>"（已启动）
+ * 和 "D <任务序号> <退出状态>"（已结束）。cmd_fd 关闭且子进程都已结束时退出。
+ */
+void serve_node(const vector<int>& cpus, int cmd_fd, int report_fd, const vector<BatchJob>& jobs,
+                int (*entry)(const string&), const function<void()>& localize)
+{
+    affinity::pin_current_process(cpus);
+    if (localize) localize();
+
+    int sig_fds[2];
+    if (pipe(sig_fds) != 0) _exit(1);
+    fcntl(sig_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(sig_fds[1], F_SETFL, O_NONBLOCK);
+    sigchld_pipe = sig_fds[1];
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigchld;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGCHLD, &sa, nullptr);
+
+    map<pid_t, size_t> running;
+    string buffer;
+    bool open = true;
+    while (open || !running.empty()) {
+        pollfd fds[2] = {{sig_fds[0], POLLIN, 0}, {open ? cmd_fd : -1, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) break;
+
+        if (fds[0].revents & POLLIN) {
+            char drain[64];
+            while (read(sig_fds[0], drain, sizeof(drain)) > 0) {}
+        }
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            auto it = running.find(pid);
+            if (it == running.end()) continue;
+            write_all(report_fd, "D " + to_string(it->second) + " " + to_string(status) + "\n");
+            running.erase(it);
+        }
+
+        vector<string> lines;
+        if (open && (fds[1].revents & (POLLIN | POLLHUP)) && !read_lines(cmd_fd, buffer, lines)) open = false;
+        for (const auto& line : lines) {
+            size_t idx;
+            int cpu;
+            if (sscanf(line.c_str(), "%zu %d", &idx, &cpu) != 2 || idx >= jobs.size()) continue;
+            pid = fork();
+            if (pid == 0) {
+                signal(SIGCHLD, SIG_DFL);
+                close(sig_fds[0]);
+                close(sig_fds[1]);
+                close(cmd_fd);
+                close(report_fd);
+                affinity::pin_current_process({cpu});
+                int rc = entry(jobs[idx].para_file);
+                fflush(nullptr);
+                _exit(rc);   // 粒子的文件已由 entry 关闭；不运行继承自父进程的静态析构和 atexit
+            }
+            if (pid > 0) {
+                running[pid] = idx;
+                write_all(report_fd, "S " + to_string(idx) + " " + to_string(pid) + "\n");
+            } else {
+                write_all(report_fd, "D " + to_string(idx) + " -1\n");
+            }
+        }
+    }
+    _exit(0);
+}
+
+/**
+ * @brief 预 fork 模式、多个 NUMA 节点：每个节点一个服务进程，空闲槽位的任务交给槽位所在节点的服务进程
+ */
+void run_on_node_servers(vector<BatchJob>& jobs, int max_jobs, ostream& log, int (*entry)(const string&),
+                         const affinity::Placement& placement)
+{
+    struct Server {
+        pid_t pid = -1;
+        int cmd_fd = -1, report_fd = -1;
+        string buffer;
+    };
+    vector<Server> servers(placement.node_cpus.size());
+    for (size_t n = 0; n < servers.size(); ++n) {
+        int cmd[2], report[2];
+        if (pipe(cmd) != 0 || pipe(report) != 0) {
+            log << "ERROR: Failed to create pipes for the node servers" << endl;
+            break;
+        }
+        log.flush();
+        fflush(nullptr);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(cmd[1]);
+            close(report[0]);
+            for (size_t k = 0; k < n; ++k) {
+                close(servers[k].cmd_fd);
+                close(servers[k].report_fd);
+            }
+            serve_node(placement.node_cpus[n], cmd[0], report[1], jobs, entry, placement.localize);
+        }
+        close(cmd[0]);
+        close(report[1]);
+        servers[n].pid = pid;
+        servers[n].cmd_fd = cmd[1];
+        servers[n].report_fd = report[0];
+        if (pid < 0) {
+            close(cmd[1]);
+            close(report[0]);
+            servers[n].cmd_fd = servers[n].report_fd = -1;
+            log << "ERROR: Failed to create the server process for node " << n << endl;
+        } else {
+            log << "Node " << n << " server started, PID: " << pid << ", CPUs " << affinity::cpu_list(placement.node_cpus[n]) << endl;
+        }
+    }
+
+    vector<int> free_slots;     // 栈顶为编号最小的空闲槽位
+    for (int s = max_jobs - 1; s >= 0; --s) {
+        if (servers[placement.slot_nodes[s]].cmd_fd >= 0) free_slots.push_back(s);
+    }
+    map<size_t, pair<int, chrono::steady_clock::time_point>> running;  // 任务 -> (槽位, 开始时间)
+    size_t next = 0;
+    int completed = 0;
+    while (next < jobs.size() || !running.empty()) {
+        while (!free_slots.empty() && next < jobs.size()) {
+            int slot = free_slots.back();
+            Server& server = servers[placement.slot_nodes[slot]];
+            BatchJob& job = jobs[next];
+            log << "Launching process for: " << job.para_file << " (estimated " << job.cost << " s, CPU "
+                << placement.slot_cpus[slot] << ", node " << placement.slot_nodes[slot] << ")" << endl;
+            if (!write_all(server.cmd_fd, to_string(next) + " " + to_string(placement.slot_cpus[slot]) + "\n")) {
+                job.status = -1;
+                log << "ERROR: Failed to create process for: " << job.para_file << endl;
+                cerr << "Failed to create process for: " << job.para_file << endl;
+            } else {
+                free_slots.pop_back();
+                running[next] = {slot, chrono::steady_clock::now()};
+            }
+            ++next;
+        }
+        if (running.empty()) {
+            if (free_slots.empty()) break;  // 所有服务进程都已失效
+            continue;
+        }
+
+        vector<pollfd> fds;
+        for (auto& server : servers) fds.push_back({server.report_fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) break;
+        for (size_t n = 0; n < servers.size(); ++n) {
+            if (!(fds[n].revents & (POLLIN | POLLHUP))) continue;
+            vector<string> lines;
+            if (!read_lines(servers[n].report_fd, servers[n].buffer, lines)) {
+                // 服务进程意外退出：其上运行的任务记为失败，其槽位不再使用
+                log << "ERROR: Node " << n << " server exited" << endl;
+                close(servers[n].report_fd);
+                close(servers[n].cmd_fd);
+                servers[n].report_fd = servers[n].cmd_fd = -1;
+                for (auto it = running.begin(); it != running.end();) {
+                    if (placement.slot_nodes[it->second.first] != static_cast<int>(n)) { ++it; continue; }
+                    jobs[it->first].status = -1;
+                    it = running.erase(it);
+                }
+                free_slots.erase(remove_if(free_slots.begin(), free_slots.end(),
+                                           [&](int s) { return placement.slot_nodes[s] == static_cast<int>(n); }),
+                                 free_slots.end());
+            }
+            for (const auto& line : lines) {
+                char kind;
+                size_t idx;
+                long value;
+                if (sscanf(line.c_str(), "%c %zu %ld", &kind, &idx, &value) != 3) continue;
+                auto it = running.find(idx);
+                if (it == running.end()) continue;
+                if (kind == 'S') {
+                    log << "Process created successfully, PID: " << value << endl;
+                    continue;
+                }
+                BatchJob& job = jobs[idx];
+                job.status = static_cast<int>(value);
+                job.elapsed = seconds_since(it->second.second);
+                free_slots.push_back(it->second.first);
+                running.erase(it);
+                ++completed;
+                log << "Process " << completed << " of " << jobs.size() << " completed: " << job.name
+                    << " (status: " << job.status << ", " << job.elapsed << " s, estimated " << job.cost << " s)." << endl;
+            }
+        }
+        sort(free_slots.rbegin(), free_slots.rend());
+    }
+
+    for (auto& server : servers) {
+        if (server.cmd_fd >= 0) close(server.cmd_fd);
+        if (server.report_fd >= 0) close(server.report_fd);
+        if (server.pid > 0) waitpid(server.pid, nullptr, 0);
+    }
+}
+#endif
+
+} // namespace
+
+int default_jobs()
+{
+    unsigned n = thread::hardware_concurrency();
+    return n > 0 ? static_cast<int>(n) : 1;
+}
+
+vector<BatchJob> plan_batch(const vector<string>& para_files, const vector<string>& history_paths)
+{
+    vector<HistoryRow> history;
+    for (const auto& path : history_paths) {
+        vector<HistoryRow> rows = read_history(path);
+        history.insert(history.end(), rows.begin(), rows.end());
+    }
+
+    // 用历史记录校准每步耗时：全局单位耗时，以及各模型组合自己的每步耗时（中位数，不受个别提前结束的粒子影响）
+    double unit = DEFAULT_SECONDS_PER_UNIT;
+    map<pair<int, int>, vector<double>> pair_rates;
+    if (!history.empty()) {
+        vector<double> units;
+        for (const auto& row : history) {
+            double rate = row.seconds / row.steps;
+            units.push_back(rate / model_factor(row.magnetic_field_model, row.wave_field_model));
+            pair_rates[{row.magnetic_field_model, row.wave_field_model}].push_back(rate);
+        }
+        unit = median(units);
+    }
+
+    // 每个粒子（同名、同步数、同模型）最后一次的实际耗时；按名字索引，粒子数很多时不必逐行比较
+    map<tuple<string, int64_t, int, int>, double> last_seconds;
+    for (const auto& row : history) {
+        last_seconds[make_tuple(row.name, row.steps, row.magnetic_field_model, row.wave_field_model)] = row.seconds;
+    }
+
+    vector<BatchJob> jobs;
+    jobs.reserve(para_files.size());
+    for (const auto& para_file : para_files) {
+        BatchJob job;
+        job.para_file = para_file;
+        job.name = PathUtils::getBasename(PathUtils::getFilename(para_file));
+
+        ParticleParams params;
+        if (read_particle_params(para_file, params)) {
+            job.steps = integration_steps(params);
+            job.magnetic_field_model = params.magnetic_field_model;
+            job.wave_field_model = params.wave_field_model;
+        }
+
+        auto it = pair_rates.find({job.magnetic_field_model, job.wave_field_model});
+        if (it != pair_rates.end()) {
+            job.cost = job.steps * median(it->second);
+            job.cost_source = "fitted";
+        } else {
+            job.cost = job.steps * unit * model_factor(job.magnetic_field_model, job.wave_field_model);
+            job.cost_source = "model";
+        }
+        // 同一粒子上次的实际耗时最准确，包括提前进入大气层的情况
+        auto last = last_seconds.find(make_tuple(job.name, job.steps, job.magnetic_field_model, job.wave_field_model));
+        if (last != last_seconds.end()) {
+            job.cost = last->second;
+            job.cost_source = "history";
+        }
+        jobs.push_back(job);
+    }
+
+    stable_sort(jobs.begin(), jobs.end(), [](const BatchJob& a, const BatchJob& b) { return a.cost > b.cost; });
+    return jobs;
+}
+
+void run_batch(vector<BatchJob>& jobs, int max_jobs, const string& exe,
+               const vector<string>& forwarded, ostream& log, int (*entry)(const string&),
+               const affinity::Placement* placement)
+{
+    if (max_jobs < 1) max_jobs = 1;
+    auto batch_start = chrono::steady_clock::now();
+    size_t next = 0;
+    int completed = 0;
+
+    // 绑核：每个槽位一个 CPU，槽位 s 空闲时才在其上启动下一个任务
+    if (placement && static_cast<int>(placement->slot_cpus.size()) < max_jobs) placement = nullptr;
+    vector<int> free_slots;     // 栈顶为编号最小的空闲槽位
+    for (int s = max_jobs - 1; s >= 0; --s) free_slots.push_back(s);
+
+#ifdef _WIN32
+    if (entry) log << "Pre-forked children are not available on Windows, starting new processes instead" << endl;
+    if (max_jobs > MAXIMUM_WAIT_OBJECTS) max_jobs = MAXIMUM_WAIT_OBJECTS;
+    vector<HANDLE> handles;
+    vector<size_t> running;
+    vector<int> slots;
+    vector<chrono::steady_clock::time_point> started;
+    while (next < jobs.size() || !handles.empty()) {
+        while (static_cast<int>(handles.size()) < max_jobs && next < jobs.size()) {
+            BatchJob& job = jobs[next];
+            string cmd = exe + " \"" + job.para_file + "\"";
+            for (size_t m = 1; m < job.members.size(); ++m) cmd += " \"" + job.members[m] + "\"";
+            for (const auto& opt : forwarded) cmd += " \"" + opt + "\"";
+            string params = job.members.empty() ? particle_params_argument(job.para_file) : "";
+            if (!params.empty()) cmd += " \"" + params + "\"";
+            string board = progress_board::child_argument(job.para_file);
+            if (!board.empty()) cmd += " \"" + board + "\"";
+            string member = splitting::child_argument(job.para_file);
+            if (!member.empty()) cmd += " \"" + member + "\"";
+            int slot = free_slots.back();
+            log << "Launching process for: " << job.para_file << " (estimated " << job.cost << " s";
+            if (placement) log << ", CPU " << placement->slot_cpus[slot];
+            log << ")" << endl;
+            log << "Command: " << cmd << endl;
+
+            PROCESS_INFORMATION pi;
+            STARTUPINFOA si;
+            ZeroMemory(&si, sizeof(si));
+            si.cb = sizeof(si);
+            ZeroMemory(&pi, sizeof(pi));
+            // 绑核时先挂起，设置亲和性后再运行
+            DWORD flags = placement ? CREATE_SUSPENDED : 0;
+            if (CreateProcessA(NULL, (LPSTR)cmd.c_str(), NULL, NULL, FALSE, flags, NULL, NULL, &si, &pi)) {
+                if (placement) {
+                    SetProcessAffinityMask(pi.hProcess, static_cast<DWORD_PTR>(1) << placement->slot_cpus[slot]);
+                    ResumeThread(pi.hThread);
+                }
+                CloseHandle(pi.hThread);
+                handles.push_back(pi.hProcess);
+                running.push_back(next);
+                slots.push_back(slot);
+                free_slots.pop_back();
+                started.push_back(chrono::steady_clock::now());
+                log << "Process created successfully, PID: " << pi.dwProcessId << endl;
+            } else {
+                job.status = -1;
+                log << "ERROR: Failed to create process for: " << job.para_file << endl;
+                cerr << "Failed to create process for: " << job.para_file << endl;
+            }
+            ++next;
+        }
+        if (handles.empty()) continue;
+
+        DWORD ret = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, INFINITE);
+        size_t k = ret - WAIT_OBJECT_0;
+        if (k >= handles.size()) break;
+        BatchJob& job = jobs[running[k]];
+        DWORD code = 0;
+        GetExitCodeProcess(handles[k], &code);
+        CloseHandle(handles[k]);
+        job.status = static_cast<int>(code);
+        job.elapsed = seconds_since(started[k]);
+        free_slots.push_back(slots[k]);
+        sort(free_slots.rbegin(), free_slots.rend());
+        handles.erase(handles.begin() + k);
+        running.erase(running.begin() + k);
+        slots.erase(slots.begin() + k);
+        started.erase(started.begin() + k);
+        ++completed;
+        log << "Process " << completed << " of " << jobs.size() << " completed: " << job.name
+            << " (status: " << job.status << ", " << job.elapsed << " s, estimated " << job.cost << " s)." << endl;
+    }
+#else
+    if (entry && placement && placement->node_cpus.size() > 1) {
+        // 多个 NUMA 节点：只读表在每个节点各建一份
+        run_on_node_servers(jobs, max_jobs, log, entry, *placement);
+        next = jobs.size();
+    }
+    struct Running {
+        size_t job;
+        int slot;
+        chrono::steady_clock::time_point start;
+    };
+    map<pid_t, Running> running;
+    while (next < jobs.size() || !running.empty()) {
+        while (static_cast<int>(running.size()) < max_jobs && next < jobs.size()) {
+            BatchJob& job = jobs[next];
+            int slot = free_slots.back();
+            log << "Launching process for: " << job.para_file << " (estimated " << job.cost << " s";
+            if (placement) log << ", CPU " << placement->slot_cpus[slot] << ", node " << placement->slot_nodes[slot];
+            log << ")" << endl;
+
+            // 未写出的缓冲区会被子进程复制一份
+            log.flush();
+            fflush(nullptr);
+            pid_t pid = fork();
+            if (pid == 0 && placement) {
+                // 绑核后再分配内存（exec 后读取配置），内存在本节点上
+                affinity::pin_current_process({placement->slot_cpus[slot]});
+            }
+            if (pid == 0 && entry) {  // pre-forked child: everything loaded by the parent is inherited
+                int rc = entry(job.para_file);
+                fflush(nullptr);
+                _exit(rc);   // 粒子的文件已由 entry 关闭；不运行继承自父进程的静态析构和 atexit
+            } else if (pid == 0) {  // child process
+                vector<char*> child_argv = {const_cast<char*>(exe.c_str()), const_cast<char*>(job.para_file.c_str())};
+                for (size_t m = 1; m < job.members.size(); ++m) child_argv.push_back(const_cast<char*>(job.members[m].c_str()));
+                for (auto& opt : forwarded) child_argv.push_back(const_cast<char*>(opt.c_str()));
+                // particles of a manifest (an ensemble child reads the manifests itself)
+                string params = job.members.empty() ? particle_params_argument(job.para_file) : "";
+                if (!params.empty()) child_argv.push_back(const_cast<char*>(params.c_str()));
+                string board = progress_board::child_argument(job.para_file);  // slot in the progress board
+                if (!board.empty()) child_argv.push_back(const_cast<char*>(board.c_str()));
+                string member = splitting::child_argument(job.para_file);  // weight of a split particle (--split)
+                if (!member.empty()) child_argv.push_back(const_cast<char*>(member.c_str()));
+                child_argv.push_back(nullptr);
+                execvp(exe.c_str(), child_argv.data());
+                _exit(127);   // exec 失败：不运行父进程的 atexit 和缓冲区刷新
+            } else if (pid > 0) {
+                running[pid] = {next, slot, chrono::steady_clock::now()};
+                free_slots.pop_back();
+                log << "Process created successfully, PID: " << pid << endl;
+            } else {
+                job.status = -1;
+                log << "ERROR: Failed to create process for: " << job.para_file << endl;
+                cerr << "Failed to create process for: " << job.para_file << endl;
+            }
+            ++next;
+        }
+        if (running.empty()) continue;
+
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) break;
+        auto it = running.find(pid);
+        if (it == running.end()) continue;
+        BatchJob& job = jobs[it->second.job];
+        job.status = status;
+        job.elapsed = seconds_since(it->second.start);
+        free_slots.push_back(it->second.slot);
+        sort(free_slots.rbegin(), free_slots.rend());
+        running.erase(it);
+        ++completed;
+        log << "Process " << completed << " of " << jobs.size() << " completed: " << job.name
+            << " (PID: " << pid << ", status: " << status << ", " << job.elapsed << " s, estimated " << job.cost << " s)." << endl;
+    }
+#endif
+
+    // 调度效果：总CPU时间 / 并行数 与 最长任务 的较大者是墙钟时间的下限
+    double wall = seconds_since(batch_start);
+    double total = 0.0, longest = 0.0;
+    size_t particles = 0;
+    for (const auto& job : jobs) {
+        total += job.elapsed;
+        longest = max(longest, job.elapsed);
+        particles += job.members.empty() ? 1 : job.members.size();
+    }
+    double bound = max(total / max_jobs, longest);
+    log << "Batch finished: wall " << wall << " s, sum of particle times " << total << " s, "
+        << max_jobs << " slots, lower bound " << bound << " s";
+    if (wall > 0.0) log << ", efficiency " << (bound / wall * 100.0) << "%, " << (particles / wall) << " particles/s";
+    log << endl;
+}
+
+void append_history(const string& history_path, const vector<BatchJob>& jobs)
+{
+    bool exists = PathUtils::fileExists(history_path);
+    ofstream out(history_path, ios::app);
+    if (!out) return;
+    if (!exists) out << "# name\tmagnetic_field_model\twave_field_model\tsteps\tseconds\n";
+    for (const auto& job : jobs) {
+        if (job.status != 0 || job.elapsed <= 0.0) continue;
+        out << job.name << '\t' << job.magnetic_field_model << '\t' << job.wave_field_model << '\t'
+            << job.steps << '\t' << job.elapsed << '\n';
+    }
+}
+
+vector<string> select_shard(const vector<string>& para_files, int k, int n)
+{
+    if (n <= 1) return para_files;
+
+    // 只用静态估计，与各节点的历史记录无关；同耗时按文件名排序，与目录遍历顺序无关
+    vector<BatchJob> jobs = plan_batch(para_files, {});
+    sort(jobs.begin(), jobs.end(), [](const BatchJob& a, const BatchJob& b) {
+        if (a.cost != b.cost) return a.cost > b.cost;
+        if (a.name != b.name) return a.name < b.name;
+        return a.para_file < b.para_file;
+    });
+
+    // 依次分给当前负载最小的分片（负载相同取编号小的），小顶堆按 (负载, 编号) 排序
+    priority_queue<pair<double, int>, vector<pair<double, int>>, greater<pair<double, int>>> load;
+    for (int i = 0; i < n; ++i) load.push({0.0, i});
+    set<string> selected;
+    for (const auto& job : jobs) {
+        pair<double, int> target = load.top();
+        load.pop();
+        if (target.second == k) selected.insert(job.para_file);
+        load.push({target.first + job.cost, target.second});
+    }
+
+    vector<string> out;
+    for (const auto& file : para_files) {
+        if (selected.count(file)) out.push_back(file);
+    }
+    return out;
+}
+
+string shard_suffix(int k, int n)
+{
+    return n > 1 ? ".shard" + to_string(k) + "of" + to_string(n) : "";
+}
+
+void write_summary(const string& path, const vector<BatchJob>& jobs, int shard_index, int shard_count)
+{
+    ofstream out(path, ios::out | ios::trunc);
+    if (!out) {
+        cerr << "Failed to write run summary: " << path << endl;
+        return;
+    }
+    out << "# shard " << shard_index << " of " << shard_count << ", " << jobs.size() << " particles\n";
+    out << SUMMARY_HEADER;
+    for (const auto& job : jobs) {
+        out << job.name << '\t' << shard_index << '\t' << job.magnetic_field_model << '\t' << job.wave_field_model << '\t'
+            << job.steps << '\t' << job.cost << '\t' << job.elapsed << '\t' << job.status << '\t' << job.weight << '\n';
+    }
+}
+
+bool merge_shards(const string& logDir, ostream& out)
+{
+    // 收集各分片的文件，所有文件的分片数必须一致
+    int count = 0;
+    map<int, string> mains, summaries, histories;
+    auto collect = [&](const string& prefix, const string& ext, map<int, string>& found) {
+        for (const auto& filename : PathUtils::findFilesWithExtension(logDir, ext, false)) {
+            int k, n;
+            if (!parse_shard_name(filename, prefix, ext, k, n)) continue;
+            if (count != 0 && n != count) {
+                cerr << "Shard files of different shard counts in " << logDir << " (" << count << " and " << n
+                     << "), remove the stale ones first" << endl;
+                return false;
+            }
+            count = n;
+            found[k] = PathUtils::joinPath(logDir, filename);
+        }
+        return true;
+    };
+    if (!collect("summary", ".tsv", summaries) || !collect("main", ".log", mains) ||
+        !collect("cost_history", ".tsv", histories)) {
+        return false;
+    }
+    if (count == 0) {
+        cerr << "No shard summaries (summary.shard<k>of<N>.tsv) found in " << logDir << endl;
+        return false;
+    }
+    vector<int> missing;
+    for (int k = 0; k < count; ++k) {
+        if (!summaries.count(k)) missing.push_back(k);
+    }
+    if (!missing.empty()) {
+        cerr << "Missing summaries of " << missing.size() << " of " << count << " shards:";
+        for (int k : missing) cerr << " " << k;
+        cerr << endl;
+        return false;
+    }
+
+    // 汇总：每个粒子一行，按名字排序；同一粒子出现在多个分片说明各节点的输入不一致
+    vector<SummaryRow> rows;
+    vector<double> shard_seconds(count, 0.0);
+    vector<int> shard_particles(count, 0), shard_failed(count, 0);
+    for (const auto& kv : summaries) {
+        for (const auto& row : read_summary(kv.second)) {
+            rows.push_back(row);
+            shard_seconds[kv.first] += row.seconds;
+            shard_particles[kv.first] += 1;
+            if (row.status != 0) shard_failed[kv.first] += 1;
+        }
+    }
+    stable_sort(rows.begin(), rows.end(), [](const SummaryRow& a, const SummaryRow& b) { return a.name < b.name; });
+    int duplicates = 0;
+    for (size_t i = 1; i < rows.size(); ++i) {
+        if (rows[i].name == rows[i - 1].name) ++duplicates;
+    }
+
+    string summaryPath = PathUtils::joinPath(logDir, "summary.tsv");
+    ofstream summary(summaryPath, ios::out | ios::trunc);
+    summary << "# merged from " << count << " shards, " << rows.size() << " particles\n" << SUMMARY_HEADER;
+    for (const auto& row : rows) summary << row.name << '\t' << row.shard << '\t' << row.fields << '\n';
+    summary.close();
+
+    // main.log：合并后的统计，之后依次附上各分片的日志
+    double total = 0.0, slowest = 0.0;
+    int failed = 0;
+    for (int k = 0; k < count; ++k) {
+        total += shard_seconds[k];
+        slowest = max(slowest, shard_seconds[k]);
+        failed += shard_failed[k];
+    }
+    string mainPath = PathUtils::joinPath(logDir, "main.log");
+    ofstream mainLog(mainPath, ios::out | ios::trunc);
+    mainLog << "=== MERGED LOG OF " << count << " SHARDS ===" << endl;
+    for (int k = 0; k < count; ++k) {
+        mainLog << "Shard " << k << ": " << shard_particles[k] << " particles, " << shard_failed[k]
+                << " failed, sum of particle times " << shard_seconds[k] << " s" << endl;
+    }
+    mainLog << "Total: " << rows.size() << " particles, " << failed << " failed, sum of particle times " << total << " s";
+    if (total > 0.0) mainLog << ", shard imbalance (slowest / mean) " << slowest / (total / count);
+    mainLog << endl;
+    if (duplicates > 0) mainLog << "WARNING: " << duplicates << " particles were run by more than one shard" << endl;
+    for (const auto& kv : mains) {
+        mainLog << "\n=== SHARD " << kv.first << " OF " << count << ": " << kv.second << " ===" << endl;
+        ifstream in(kv.second);
+        mainLog << in.rdbuf();
+    }
+    mainLog.close();
+
+    // 各分片的实测耗时并入 cost_history.tsv，合并后删除，避免重复计入
+    string historyPath = PathUtils::joinPath(logDir, "cost_history.tsv");
+    bool exists = PathUtils::fileExists(historyPath);
+    ofstream history(historyPath, ios::app);
+    if (!exists) history << "# name\tmagnetic_field_model\twave_field_model\tsteps\tseconds\n";
+    int history_rows = 0;
+    for (const auto& kv : histories) {
+        for (const auto& row : read_history(kv.second)) {
+            history << row.name << '\t' << row.magnetic_field_model << '\t' << row.wave_field_model << '\t'
+                    << row.steps << '\t' << row.seconds << '\n';
+            ++history_rows;
+        }
+        remove(kv.second.c_str());
+    }
+    history.close();
+
+    out << "Merged " << count << " shards: " << rows.size() << " particles (" << failed << " failed) into "
+        << summaryPath << " and " << mainPath << ", " << history_rows << " timings added to " << historyPath << endl;
+    if (duplicates > 0) out << "WARNING: " << duplicates << " particles were run by more than one shard" << endl;
+    return true;
+}
@@ -0,0 +1,285 @@
+#include <iostream>
+#include <ctime>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <Eigen/Dense>
+
+#include "bounce_average.h"
+#include "field_calculator.h"
+#include "coordinates_transfer.h"
+#include "singular_particle.h"
+
+using namespace std;
+using namespace Eigen;
+
+extern double E0, mu, q;
+extern double r_step;
+
+namespace bounce_avg {
+
+namespace {
+
+const int NODES = 32;           // 镜点之间的求积节点数
+const int MAX_TRACE = 4000;     // 每个方向追踪磁力线的最多步数
+const double R_OPEN = 40.0;     // 超出该距离 [RE] 的磁力线当作不闭合
+const int BISECTIONS = 40;
+
+
+// 追踪得到的磁力线：各点位置、单位切向 b、弧长 s、|B|
+struct Line {
+    vector<Vector3d> x, b;
+    vector<double> s, B;
+
+    // 弧长 s 处的位置（三次 Hermite 插值，切向即 b）
+    Vector3d at(double si) const
+    {
+        size_t i = upper_bound(s.begin(), s.end(), si) - s.begin();
+        i = min(max<size_t>(i, 1), s.size() - 1) - 1;
+        double h = s[i + 1] - s[i];
+        double u = (si - s[i]) / h;
+        double u2 = u * u, u3 = u2 * u;
+        return (2 * u3 - 3 * u2 + 1) * x[i] + (u3 - 2 * u2 + u) * h * b[i] +
+               (-2 * u3 + 3 * u2) * x[i + 1] + (u3 - u2) * h * b[i + 1];
+    }
+};
+
+// 从 x0 沿 dir * b 追踪磁力线，直到 B >= Bm 且仍在增大（越过镜点）
+// 返回 0 成功，1 先到达大气层（损失锥），2 不闭合或步数过多
+int trace(double t, const Vector3d& x0, double dir, double Bm, double r_min,
+          vector<Vector3d>& xs, vector<Vector3d>& bs, vector<double>& Bs)
+{
+    auto unit_b = [&](const Vector3d& x, double& Bt) {
+        Vector3d B = Bvec(t, x[0], x[1], x[2]);
+        Bt = B.norm();
+        return Vector3d(B / Bt);
+    };
+
+    Vector3d x = x0;
+    double Bt;
+    Vector3d b = unit_b(x, Bt);
+    for (int n = 0; n < MAX_TRACE; ++n) {
+        double ds = dir * min(max(0.05 * x.norm(), 0.002), 0.5);
+        double unused;
+        Vector3d k1 = b;
+        Vector3d k2 = unit_b(x + 0.5 * ds * k1, unused);
+        Vector3d k3 = unit_b(x + 0.5 * ds * k2, unused);
+        Vector3d k4 = unit_b(x + ds * k3, unused);
+        x += ds / 6.0 * (k1 + 2 * k2 + 2 * k3 + k4);
+        double B_prev = Bt;
+        b = unit_b(x, Bt);
+        xs.push_back(x);
+        bs.push_back(b);
+        Bs.push_back(Bt);
+        if (Bt >= Bm && Bt > B_prev) return 0;
+        if (x.norm() < r_min) return 1;
+        if (x.norm() > R_OPEN) return 2;
+    }
+    return 2;
+}
+
+// 弧长区间 [a, b] 中 f(s) 变号的点（二分）
+template <typename F>
+double bisect(const F& f, double a, double b)
+{
+    double fa = f(a);
+    for (int n = 0; n < BISECTIONS; ++n) {
+        double m = 0.5 * (a + b);
+        double fm = f(m);
+        if ((fm < 0) == (fa < 0)) { a = m; fa = fm; }
+        else b = m;
+    }
+    return 0.5 * (a + b);
+}
+
+// t 时刻过 x0 的磁力线上、动量 p 的粒子的弹跳积分
+bool integrals(double t, const Vector3d& x0, double p, double r_min, Integrals& out, string& reason)
+{
+    double Bm = pow(p * c, 2) / (2.0 * E0 * mu);
+    if (!(mu > 0.0) || !isfinite(Bm)) {
+        reason = "no perpendicular momentum (pitch angle 0)";
+        return false;
+    }
+
+    // 两个方向各追踪到镜点之外，拼成一条磁力线（沿 -b 的一段在前）
+    vector<Vector3d> xs_m, bs_m, xs_p, bs_p;
+    vector<double> Bs_m, Bs_p;
+    Vector3d B0 = Bvec(t, x0[0], x0[1], x0[2]);
+    for (double dir : {-1.0, 1.0}) {
+        int status = (dir < 0) ? trace(t, x0, dir, Bm, r_min, xs_m, bs_m, Bs_m)
+                               : trace(t, x0, dir, Bm, r_min, xs_p, bs_p, Bs_p);
+        if (status == 1) { reason = "mirror point below the atmosphere (loss cone)"; return false; }
+        if (status == 2) { reason = "open field line"; return false; }
+    }
+    Line line;
+    for (size_t i = xs_m.size(); i-- > 0;) {
+        line.x.push_back(xs_m[i]); line.b.push_back(bs_m[i]); line.B.push_back(Bs_m[i]);
+    }
+    line.x.push_back(x0); line.b.push_back(B0 / B0.norm()); line.B.push_back(B0.norm());
+    for (size_t i = 0; i < xs_p.size(); ++i) {
+        line.x.push_back(xs_p[i]); line.b.push_back(bs_p[i]); line.B.push_back(Bs_p[i]);
+    }
+    // 弧长取弦长之和（步长小时只差高阶小量），沿 s 增大的方向切向都是 b
+    line.s.push_back(0.0);
+    for (size_t i = 1; i < line.x.size(); ++i) line.s.push_back(line.s.back() + (line.x[i] - line.x[i - 1]).norm());
+
+    auto B_at = [&](double si) { Vector3d x = line.at(si); return Bvec(t, x[0], x[1], x[2]).norm(); };
+
+    // B 最小的点：网格上的最小值附近做抛物线拟合
+    size_t k = min_element(line.B.begin(), line.B.end()) - line.B.begin();
+    if (k == 0 || k + 1 >= line.B.size()) {
+        reason = "no minimum of B between the mirror points";
+        return false;
+    }
+    double s_eq;
+    {
+        double s0 = line.s[k - 1], s1 = line.s[k], s2 = line.s[k + 1];
+        double f0 = line.B[k - 1], f1 = line.B[k], f2 = line.B[k + 1];
+        double d01 = (f1 - f0) / (s1 - s0), d12 = (f2 - f1) / (s2 - s1);
+        double curv = (d12 - d01) / (s2 - s0);
+        s_eq = (curv > 0.0) ? 0.5 * (s0 + s1) - d01 / (2.0 * curv) : s1;
+        s_eq = min(max(s_eq, s0), s2);
+    }
+    out.eq = line.at(s_eq);
+    out.B_eq = B_at(s_eq);
+
+    // 镜点：B 最小点两侧 B = Bm 的位置（赤道附近镜像的粒子 Bm 稍大于 B_eq）
+    double Bm_use = max(Bm, out.B_eq * (1.0 + 1e-9));
+    auto above = [&](double si) { return B_at(si) - Bm_use; };
+    size_t i1 = k, i2 = k;
+    while (i1 > 0 && !(line.B[i1] >= Bm_use && line.s[i1] < s_eq)) --i1;
+    while (i2 + 1 < line.B.size() && !(line.B[i2] >= Bm_use && line.s[i2] > s_eq)) ++i2;
+    if (line.B[i1] < Bm_use || line.B[i2] < Bm_use) {
+        reason = "mirror points not found";
+        return false;
+    }
+    double s_m1 = bisect(above, line.s[i1], s_eq);
+    double s_m2 = bisect(above, s_eq, line.s[i2]);
+
+    // 磁力线与 SM 赤道面的交点：漂移壳坐标 (L, φ)
+    recalc_at(t);
+    auto z_sm = [&](double si) { return gsm_to_sm(line.at(si))[2]; };
+    size_t j = 0;
+    while (j + 1 < line.x.size() && (gsm_to_sm(line.x[j])[2] < 0) == (gsm_to_sm(line.x[j + 1])[2] < 0)) ++j;
+    if (j + 1 >= line.x.size()) {
+        reason = "field line does not cross the SM equator";
+        return false;
+    }
+    Vector3d cross_sm = gsm_to_sm(line.at(bisect(z_sm, line.s[j], line.s[j + 1])));
+    Vector3d dip = cartesian_to_dipole(cross_sm);
+    out.L = dip[0];
+    out.phi = dip[1];
+
+    // 镜点之间求积：s = s_m1 + (s_m2 - s_m1)(1 - cos θ)/2，消去镜点处 1/v_para 的奇点
+    double gamm = sqrt(1. + pow(p * c, 2) / pow(E0, 2));
+    double T = 0.0, I = 0.0, sum_L = 0.0, sum_phi = 0.0, sum_W = 0.0;
+    double half = 0.5 * (s_m2 - s_m1);
+    for (int n = 0; n < NODES; ++n) {
+        double theta = (n + 0.5) * M_PI / NODES;
+        double si = s_m1 + half * (1.0 - cos(theta));
+        double ds = half * sin(theta) * M_PI / NODES;
+        Vector3d x = line.at(si);
+
+        // 漂移速度与 dydt 相同（drift_terms，p_para 的符号不影响漂移），gamma 由总动量得到
+        Vector3d B = Bvec(t, x[0], x[1], x[2]);
+        double Bt = B.norm();
+        Vector3d E = Evec(t, x[0], x[1], x[2]);
+        VectorXd dB = B_grad_curv(t, x[0], x[1], x[2], r_step);
+        Vector3d grad_B(dB[0], dB[1], dB[2]);
+        Vector3d curv_B(dB[3], dB[4], dB[5]);
+        double ratio = max(1.0 - Bt / Bm_use, 1e-12);
+        DriftTerms d = drift_terms(E0, mu, q, p * sqrt(ratio), B, E, grad_B, curv_B, gamm);
+        Vector3d vd = d.vd_ExB + d.vd_grad + d.vd_curv;
+        double v_para = d.v_para.norm();
+
+        // 漂移在偶极坐标中的分量：dL/dt = e_L·v / h_L, dφ/dt = e_φ·v / h_φ
+        Vector3d x_sm = gsm_to_sm(x);
+        Vector3d v_sm = gsm_to_sm(vd);
+        Matrix3d basis = dipole_basis(x_sm);
+        Vector3d h = dipole_scale_factor(x_sm);
+
+        double w = ds / v_para;     // 经过该段的时间
+        T += w;
+        I += sqrt(ratio) * ds;
+        sum_L += w * basis.col(0).dot(v_sm) / h[0];
+        sum_phi += w * basis.col(1).dot(v_sm) / h[1];
+        sum_W += w * q * E.dot(vd) * 6.371e-3;     // 电场对漂移做功 [MeV/s]，平行电场的功在一次弹跳中抵消
+    }
+    out.B_m = Bm;
+    out.tau_b = 2.0 * T;
+    out.I = I;
+    out.dL_dt = sum_L / T;
+    out.dphi_dt = sum_phi / T;
+    out.dp_dt = gamm * E0 / (p * c * c) * (sum_W / T);     // dW = v dp
+    return true;
+}
+
+// 漂移壳坐标 (L, φ) 对应的 SM 赤道面上的点 (GSM)
+Vector3d label_point(double t, double L, double phi)
+{
+    recalc_at(t);
+    return sm_to_gsm(Vector3d(L * cos(phi), L * sin(phi), 0.0));
+}
+
+} // namespace
+
+bool init(const VectorXd& Y, double r_min, State& s, string& reason)
+{
+    double t = Y[0];
+    Vector3d x(Y[1], Y[2], Y[3]);
+    Vector3d B = Bvec(t, x[0], x[1], x[2]);
+    // mu 守恒：p^2 = p_para^2 + 2 E0 mu B / c^2
+    double p = sqrt(Y[4] * Y[4] + 2.0 * E0 * mu * B.norm() / (c * c));
+    if (!integrals(t, x, p, r_min, s.at, reason)) return false;
+    s.t = t;
+    s.L = s.at.L;
+    s.phi = s.at.phi;
+    s.p = p;
+    return true;
+}
+
+bool step(State& s, double h, double r_min, string& reason)
+{
+    // y = (L, φ, p) 的 RK4，每一级重新追踪该级的磁力线
+    auto rate = [](const Integrals& a) { return Vector3d(a.dL_dt, a.dphi_dt, a.dp_dt); };
+    auto eval = [&](double t, const Vector3d& y, Integrals& a) {
+        return integrals(t, label_point(t, y[0], y[1]), y[2], r_min, a, reason);
+    };
+    Vector3d y(s.L, s.phi, s.p);
+    Integrals a2, a3, a4, next;
+    Vector3d k1 = rate(s.at);
+    if (!eval(s.t + 0.5 * h, y + 0.5 * h * k1, a2)) return false;
+    Vector3d k2 = rate(a2);
+    if (!eval(s.t + 0.5 * h, y + 0.5 * h * k2, a3)) return false;
+    Vector3d k3 = rate(a3);
+    if (!eval(s.t + h, y + h * k3, a4)) return false;
+    Vector3d k4 = rate(a4);
+    y += (h / 6.0) * (k1 + 2 * k2 + 2 * k3 + k4);
+    if (!eval(s.t + h, y, next)) return false;
+
+    s.t += h;
+    s.L = y[0];
+    s.phi = remainder(y[1], 2.0 * M_PI);
+    s.p = y[2];
+    s.at = next;
+    return true;
+}
+
+double suggested_step(const State& s, double wave_period)
+{
+    double h = HUGE_VAL;
+    if (s.at.dphi_dt != 0.0) h = min(h, 2.0 * M_PI / fabs(s.at.dphi_dt) / 64.0);
+    if (s.at.dL_dt != 0.0) h = min(h, 0.01 / fabs(s.at.dL_dt));
+    if (isfinite(wave_period)) h = min(h, wave_period / 16.0);
+    return h;
+}
+
+VectorXd guiding_center(const State& s)
+{
+    VectorXd Y(5);
+    double ratio = max(1.0 - s.at.B_eq / s.at.B_m, 0.0);
+    Y << s.t, s.at.eq[0], s.at.eq[1], s.at.eq[2], s.p * sqrt(ratio);
+    return Y;
+}
+
+} // namespace bounce_avg
@@ -0,0 +1,137 @@
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+#include <filesystem>
+
+#include "checkpoint.h"
+#include "result_cache.h"
+#include "trajectory_io.h"
+
+using namespace std;
+using traj_io::put_value;
+using traj_io::get_value;
+
+namespace {
+
+const char CHECKPOINT_MAGIC[4] = {'G', 'C', 'K', 'P'};
+const int32_t CHECKPOINT_VERSION = 6;
+
+// ParticleParams 的数值部分，依 .para 中的顺序
+void put_params(string& out, const ParticleParams& p)
+{
+    double values[NUM_PARTICLE_DOUBLES];
+    particle_param_doubles(p, values);
+    put_value(out, values);
+    put_value(out, static_cast<int32_t>(p.magnetic_field_model));
+    put_value(out, static_cast<int32_t>(p.wave_field_model));
+}
+
+bool get_params(const char*& p, const char* end, ParticleParams& params)
+{
+    double v[NUM_PARTICLE_DOUBLES];
+    int32_t mag, wave;
+    if (!get_value(p, end, v) || !get_value(p, end, mag) || !get_value(p, end, wave)) return false;
+    for (int i = 0; i < NUM_PARTICLE_DOUBLES; ++i) set_particle_param(params, i, v[i]);
+    params.magnetic_field_model = mag;
+    params.wave_field_model = wave;
+    return true;
+}
+
+} // namespace
+
+bool save_checkpoint(const string& path, const Checkpoint& ck)
+{
+    string data(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    put_value(data, CHECKPOINT_VERSION);
+    put_params(data, ck.params);
+    put_value(data, ck.profile);
+    put_value(data, ck.encoding);
+    put_value(data, ck.window);
+    put_value(data, static_cast<int64_t>(ck.key.size()));
+    data += ck.key;
+    put_value(data, ck.step);
+    put_value(data, ck.write_count);
+    put_value(data, ck.Y);
+    put_value(data, ck.mu);
+    put_value(data, ck.dt);
+    put_value(data, ck.r_step);
+    put_value(data, ck.next_write);
+    put_value(data, ck.has_wave_seed);
+    put_value(data, ck.wave_seed);
+    put_value(data, static_cast<int64_t>(ck.writer_state.size()));
+    data += ck.writer_state;
+    put_value(data, static_cast<int64_t>(ck.events_state.size()));
+    data += ck.events_state;
+    put_value(data, static_cast<int64_t>(ck.integrator_state.size()));
+    data += ck.integrator_state;
+    put_value(data, static_cast<int64_t>(ck.variational_state.size()));
+    data += ck.variational_state;
+    put_value(data, result_cache::hash_bytes(data.data(), data.size()));
+
+    // 先写临时文件再改名，中断时旧检查点仍然完整
+    string tmp = path + ".tmp";
+    {
+        ofstream out(tmp, ios::binary | ios::trunc);
+        out.write(data.data(), data.size());
+        out.flush();
+        if (!out) return false;
+    }
+    error_code ec;
+    filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+bool load_checkpoint(const string& path, Checkpoint& ck)
+{
+    ifstream in(path, ios::binary);
+    if (!in) return false;
+    string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    if (data.size() < sizeof(CHECKPOINT_MAGIC) + sizeof(uint64_t) ||
+        memcmp(data.data(), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+        return false;
+    }
+    size_t body = data.size() - sizeof(uint64_t);
+    uint64_t checksum;
+    memcpy(&checksum, data.data() + body, sizeof(checksum));
+    if (checksum != result_cache::hash_bytes(data.data(), body)) return false;
+
+    const char* p = data.data() + sizeof(CHECKPOINT_MAGIC);
+    const char* end = data.data() + body;
+    int32_t version;
+    int64_t len;
+    if (!get_value(p, end, version) || version != CHECKPOINT_VERSION || !get_params(p, end, ck.params) ||
+        !get_value(p, end, ck.profile) || !get_value(p, end, ck.encoding) || !get_value(p, end, ck.window) ||
+        !get_value(p, end, len) || len < 0 || len > end - p) {
+        return false;
+    }
+    ck.key.assign(p, static_cast<size_t>(len));
+    p += len;
+    if (!get_value(p, end, ck.step) || !get_value(p, end, ck.write_count) || !get_value(p, end, ck.Y) ||
+        !get_value(p, end, ck.mu) || !get_value(p, end, ck.dt) || !get_value(p, end, ck.r_step) ||
+        !get_value(p, end, ck.next_write) || !get_value(p, end, ck.has_wave_seed) || !get_value(p, end, ck.wave_seed) || !get_value(p, end, len) || len < 0 || len > end - p) {
+        return false;
+    }
+    ck.writer_state.assign(p, static_cast<size_t>(len));
+    p += len;
+    if (!get_value(p, end, len) || len < 0 || len > end - p) return false;
+    ck.events_state.assign(p, static_cast<size_t>(len));
+    p += len;
+    if (!get_value(p, end, len) || len < 0 || len > end - p) return false;
+    ck.integrator_state.assign(p, static_cast<size_t>(len));
+    p += len;
+    if (!get_value(p, end, len) || len != end - p) return false;
+    ck.variational_state.assign(p, static_cast<size_t>(len));
+    return true;
+}
+
+bool checkpoint_matches(const Checkpoint& ck, const ParticleParams& params, int profile, int encoding, int window,
+                        const string& key)
+{
+    string a, b;
+    put_params(a, ck.params);
+    put_params(b, params);
+    return a == b && !key.empty() && ck.key == key && ck.profile == profile && ck.encoding == encoding &&
+           (profile != traj_io::PROFILE_ENVELOPE || ck.window == window);
+}
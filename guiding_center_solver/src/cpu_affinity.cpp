@@ -0,0 +1,196 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <thread>
+
+#ifdef _WIN32
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <sched.h>
+    #include <dirent.h>
+#endif
+
+#include "cpu_affinity.h"
+
+using namespace std;
+
+namespace affinity {
+
+namespace {
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+vector<int> parse_cpu_list(const string& text)
+{
+    vector<int> cpus;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t comma = text.find(',', pos);
+        string item = text.substr(pos, comma == string::npos ? string::npos : comma - pos);
+        pos = (comma == string::npos) ? text.size() : comma + 1;
+        if (item.empty() || item[0] < '0' || item[0] > '9') continue;
+        int first = atoi(item.c_str()), last = first;
+        size_t dash = item.find('-');
+        if (dash != string::npos) last = atoi(item.c_str() + dash + 1);
+        for (int c = first; c <= last; ++c) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+string read_line(const string& path)
+{
+    ifstream in(path);
+    string line;
+    getline(in, line);
+    return line;
+}
+
+#ifdef __linux__
+// 本进程允许使用的 CPU
+set<int> allowed_cpus()
+{
+    set<int> cpus;
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) != 0) return cpus;
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+        if (CPU_ISSET(c, &mask)) cpus.insert(c);
+    }
+    return cpus;
+}
+
+// 各 NUMA 节点的 CPU（按节点编号）；没有 /sys/devices/system/node 时为一个节点
+vector<vector<int>> read_nodes(const set<int>& allowed)
+{
+    vector<pair<int, vector<int>>> nodes;
+    const string root = "/sys/devices/system/node/";
+    if (DIR* dir = opendir(root.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            string name = entry->d_name;
+            if (name.rfind("node", 0) != 0 || name.size() == 4 || name.find_first_not_of("0123456789", 4) != string::npos) continue;
+            vector<int> cpus;
+            for (int c : parse_cpu_list(read_line(root + name + "/cpulist"))) {
+                if (allowed.count(c)) cpus.push_back(c);
+            }
+            if (!cpus.empty()) nodes.emplace_back(atoi(name.c_str() + 4), cpus);
+        }
+        closedir(dir);
+    }
+    sort(nodes.begin(), nodes.end());
+
+    vector<vector<int>> result;
+    for (auto& node : nodes) result.push_back(node.second);
+    if (result.empty() && !allowed.empty()) result.emplace_back(allowed.begin(), allowed.end());
+    return result;
+}
+
+// 物理核在前、超线程在后：cpu 是 thread_siblings_list 中最小的一个时为物理核
+void primary_threads_first(vector<int>& cpus)
+{
+    auto is_primary = [](int c) {
+        vector<int> siblings = parse_cpu_list(read_line("/sys/devices/system/cpu/cpu" + to_string(c) + "/topology/thread_siblings_list"));
+        return siblings.empty() || *min_element(siblings.begin(), siblings.end()) == c;
+    };
+    stable_partition(cpus.begin(), cpus.end(), is_primary);
+}
+#endif
+
+} // namespace
+
+Placement plan(int slots)
+{
+    Placement placement;
+#if defined(__linux__)
+    placement.node_cpus = read_nodes(allowed_cpus());
+    for (auto& cpus : placement.node_cpus) primary_threads_first(cpus);
+#elif defined(_WIN32)
+    // 进程亲和性掩码只有 64 位：只用前 64 个逻辑处理器，看作一个节点
+    int count = min<int>(static_cast<int>(thread::hardware_concurrency()), 64);
+    if (count > 0) {
+        placement.node_cpus.emplace_back();
+        for (int c = 0; c < count; ++c) placement.node_cpus[0].push_back(c);
+    }
+#endif
+    if (placement.node_cpus.empty() || slots < 1) return placement;
+
+    // 各节点轮流取下一个 CPU；某个节点取完后继续取其他节点的
+    vector<pair<int, int>> order;   // (cpu, node)
+    size_t longest = 0;
+    for (const auto& cpus : placement.node_cpus) longest = max(longest, cpus.size());
+    for (size_t i = 0; i < longest; ++i) {
+        for (size_t n = 0; n < placement.node_cpus.size(); ++n) {
+            if (i < placement.node_cpus[n].size()) order.emplace_back(placement.node_cpus[n][i], static_cast<int>(n));
+        }
+    }
+    // 槽位多于 CPU 时从头再分一轮
+    for (int s = 0; s < slots; ++s) {
+        placement.slot_cpus.push_back(order[s % order.size()].first);
+        placement.slot_nodes.push_back(order[s % order.size()].second);
+    }
+    return placement;
+}
+
+bool pin_current_process(const vector<int>& cpus)
+{
+#if defined(__linux__)
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int c : cpus) {
+        if (c >= 0 && c < CPU_SETSIZE) CPU_SET(c, &mask);
+    }
+    return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#elif defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (int c : cpus) {
+        if (c >= 0 && c < 64) mask |= static_cast<DWORD_PTR>(1) << c;
+    }
+    return mask != 0 && SetProcessAffinityMask(GetCurrentProcess(), mask);
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+string cpu_list(const vector<int>& cpus)
+{
+    vector<int> sorted(cpus);
+    sort(sorted.begin(), sorted.end());
+    sorted.erase(unique(sorted.begin(), sorted.end()), sorted.end());
+    string text;
+    for (size_t i = 0; i < sorted.size();) {
+        size_t j = i;
+        while (j + 1 < sorted.size() && sorted[j + 1] == sorted[j] + 1) ++j;
+        if (!text.empty()) text += ",";
+        text += to_string(sorted[i]);
+        if (j > i) text += "-" + to_string(sorted[j]);
+        i = j + 1;
+    }
+    return text;
+}
+
+void describe(const Placement& placement, ostream& log)
+{
+    if (placement.empty()) {
+        log << "CPU pinning: not available on this system, processes are not pinned" << endl;
+        return;
+    }
+    log << "CPU pinning: " << placement.node_cpus.size() << " NUMA node(s)";
+    for (size_t n = 0; n < placement.node_cpus.size(); ++n) {
+        log << (n ? ", " : " (") << "node " << n << ": CPUs " << cpu_list(placement.node_cpus[n]);
+    }
+    log << ")" << endl;
+    log << "Slot CPUs:";
+    for (size_t s = 0; s < placement.slot_cpus.size(); ++s) {
+        log << " " << s << "->" << placement.slot_cpus[s] << "/node" << placement.slot_nodes[s];
+    }
+    log << endl;
+
+    size_t cpus = 0;
+    for (const auto& node : placement.node_cpus) cpus += node.size();
+    if (placement.slot_cpus.size() > cpus) {
+        log << "WARNING: " << placement.slot_cpus.size() << " slots on " << cpus << " CPUs, some slots share a CPU" << endl;
+    }
+}
+
+} // namespace affinity
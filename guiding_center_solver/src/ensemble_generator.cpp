@@ -0,0 +1,409 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include <vector>
+
+#include "ensemble_generator.h"
+#include "field_calculator.h"
+#include "path_utils.h"
+
+using namespace std;
+
+namespace ensemble {
+
+namespace {
+
+enum DimKind { DIM_CONST, DIM_LINEAR, DIM_LOG, DIM_VALUES, DIM_SIN };
+enum { D_L, D_MLT, D_MLAT, D_EK, D_PA, D_TINI, NUM_DIMS };
+const char* const DIM_NAMES[NUM_DIMS] = {"L", "MLT", "MLAT", "Ek", "pa", "t_ini"};
+
+enum Sampling { SAMPLE_GRID, SAMPLE_SOBOL, SAMPLE_RANDOM };
+
+const int SIN_TABLE_SIZE = 4096;
+
+struct Dimension {
+    DimKind kind = DIM_CONST;
+    bool given = false;
+    double a = 0.0, b = 0.0;
+    int64_t n = 1;              // 网格点数
+    double k = 0.0;             // sin^k
+    vector<double> values;
+    vector<double> cdf;         // sin 分布：[a, b] 上等间距的累积分布
+    double norm = 1.0;          // sin 分布：sin^(k+1) 在 [a, b] 上的积分 [deg]
+    vector<double> nodes, widths;
+
+    double density_shape(double x) const {
+        return pow(sin(x * M_PI / 180.0), k + 1.0);
+    }
+
+    // 逆累积分布，u ∈ [0, 1]
+    double inverse(double u) const {
+        switch (kind) {
+            case DIM_LINEAR: return a + u * (b - a);
+            case DIM_LOG: return a * pow(b / a, u);
+            case DIM_VALUES: {
+                size_t i = static_cast<size_t>(u * values.size());
+                return values[min(i, values.size() - 1)];
+            }
+            case DIM_SIN: {
+                size_t hi = lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+                if (hi == 0) return a;
+                if (hi >= cdf.size()) return b;
+                double step = (b - a) / (cdf.size() - 1);
+                double frac = (cdf[hi] > cdf[hi - 1]) ? (u - cdf[hi - 1]) / (cdf[hi] - cdf[hi - 1]) : 0.0;
+                return a + (hi - 1 + frac) * step;
+            }
+            default: return a;
+        }
+    }
+
+    // 抽样点 x 的 1 / 概率密度
+    double inverse_density(double x) const {
+        switch (kind) {
+            case DIM_LINEAR: return b - a;
+            case DIM_LOG: return x * log(b / a);
+            case DIM_VALUES: return static_cast<double>(values.size());
+            case DIM_SIN: return norm / density_shape(x);
+            default: return 1.0;
+        }
+    }
+
+    void build() {
+        if (kind == DIM_SIN) {
+            cdf.assign(SIN_TABLE_SIZE + 1, 0.0);
+            double step = (b - a) / SIN_TABLE_SIZE;
+            for (int i = 1; i <= SIN_TABLE_SIZE; ++i) {
+                cdf[i] = cdf[i - 1] + 0.5 * step * (density_shape(a + (i - 1) * step) + density_shape(a + i * step));
+            }
+            norm = cdf.back();
+            for (auto& c : cdf) c /= norm;
+        }
+
+        // 网格点和单元宽度
+        nodes.clear();
+        widths.clear();
+        if (kind == DIM_CONST) {
+            nodes.push_back(a);
+            widths.push_back(1.0);
+        } else if (kind == DIM_VALUES) {
+            nodes = values;
+            widths.assign(values.size(), 1.0);
+        } else if (kind == DIM_SIN) {
+            for (int64_t i = 0; i < n; ++i) {
+                nodes.push_back(inverse((i + 0.5) / n));
+                widths.push_back(inverse(static_cast<double>(i + 1) / n) - inverse(static_cast<double>(i) / n));
+            }
+        } else if (n == 1) {
+            nodes.push_back(a);
+            widths.push_back(1.0);
+        } else {
+            for (int64_t i = 0; i < n; ++i) nodes.push_back(inverse(static_cast<double>(i) / (n - 1)));
+            for (int64_t i = 0; i < n; ++i) {
+                double lo = nodes[i > 0 ? i - 1 : i], hi = nodes[i + 1 < n ? i + 1 : i];
+                widths.push_back(0.5 * (hi - lo));
+            }
+        }
+    }
+};
+
+// Sobol 序列（Joe & Kuo 的方向数，前 6 维）
+class Sobol {
+public:
+    Sobol(int dims, uint64_t seed) : dims_(dims), x_(dims, 0), shift_(dims, 0) {
+        static const struct { int s, a; unsigned m[4]; } table[NUM_DIMS - 1] = {
+            {1, 0, {1}}, {2, 1, {1, 3}}, {3, 1, {1, 3, 1}}, {3, 2, {1, 1, 1}}, {4, 1, {1, 1, 3, 3}}
+        };
+        v_.assign(dims, vector<uint32_t>(32));
+        for (int j = 0; j < 32; ++j) v_[0][j] = 1u << (31 - j);
+        for (int d = 1; d < dims; ++d) {
+            int s = table[d - 1].s, a = table[d - 1].a;
+            for (int j = 0; j < 32; ++j) {
+                if (j < s) {
+                    v_[d][j] = table[d - 1].m[j] << (31 - j);
+                    continue;
+                }
+                uint32_t v = v_[d][j - s] ^ (v_[d][j - s] >> s);
+                for (int k = 1; k < s; ++k) {
+                    if ((a >> (s - 1 - k)) & 1) v ^= v_[d][j - k];
+                }
+                v_[d][j] = v;
+            }
+        }
+        if (seed != 0) {
+            mt19937_64 rng(seed);
+            for (auto& s : shift_) s = static_cast<uint32_t>(rng() >> 32);
+        }
+    }
+
+    // 下一个点（跳过原点）
+    void next(vector<double>& u) {
+        uint32_t c = 0;
+        for (uint64_t i = index_; i & 1; i >>= 1) ++c;
+        ++index_;
+        u.resize(dims_);
+        for (int d = 0; d < dims_; ++d) {
+            x_[d] ^= v_[d][c];
+            u[d] = (x_[d] ^ shift_[d]) / 4294967296.0;
+        }
+    }
+
+private:
+    int dims_;
+    uint64_t index_ = 0;
+    vector<uint32_t> x_, shift_;
+    vector<vector<uint32_t>> v_;
+};
+
+string trim(const string& s)
+{
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == string::npos) return "";
+    return s.substr(b, s.find_last_not_of(" \t\r") - b + 1);
+}
+
+// 逗号分隔的数值
+bool parse_numbers(const string& text, vector<double>& out)
+{
+    out.clear();
+    stringstream ss(text);
+    string item;
+    while (getline(ss, item, ',')) {
+        item = trim(item);
+        char* end = nullptr;
+        double v = strtod(item.c_str(), &end);
+        if (item.empty() || *end != '\0') return false;
+        out.push_back(v);
+    }
+    return !out.empty();
+}
+
+int dim_index(const string& name)
+{
+    for (int d = 0; d < NUM_DIMS; ++d) {
+        if (name == DIM_NAMES[d]) return d;
+    }
+    return -1;
+}
+
+} // namespace
+
+bool generate(const string& gen_file, const function<void(const Member&)>& emit)
+{
+    ifstream in(gen_file);
+    if (!in) {
+        cerr << "Failed to open ensemble generator: " << gen_file << endl;
+        return false;
+    }
+
+    ParticleParams shared;
+    shared.num_values = NUM_PARTICLE_PARAMS;
+    bool has_shared[NUM_PARTICLE_PARAMS] = {false};
+    Dimension dims[NUM_DIMS];
+    Sampling sampling = SAMPLE_GRID;
+    int64_t samples = 0;
+    uint64_t seed = 0;
+
+    string line;
+    for (int lineno = 1; getline(in, line); ++lineno) {
+        auto fail = [&](const string& msg) {
+            cerr << gen_file << ":" << lineno << ": " << msg << endl;
+            return false;
+        };
+        line = trim(line.substr(0, line.find_first_of(";#")));
+        if (line.empty()) continue;
+        size_t eq = line.find('=');
+        if (eq == string::npos) return fail("expected \"key = value\"");
+        string key = trim(line.substr(0, eq));
+        string value = trim(line.substr(eq + 1));
+        string word = value.substr(0, value.find_first_of(" \t"));
+        string rest = trim(value.substr(word.size()));
+        vector<double> nums;
+
+        if (key == "sampling") {
+            if (word == "grid") {
+                sampling = SAMPLE_GRID;
+            } else if ((word == "sobol" || word == "random") && parse_numbers(rest, nums) && nums.size() == 1 && nums[0] >= 1) {
+                sampling = (word == "sobol") ? SAMPLE_SOBOL : SAMPLE_RANDOM;
+                samples = static_cast<int64_t>(nums[0]);
+            } else {
+                return fail("invalid sampling: " + value + " (expected grid, sobol N or random N)");
+            }
+            continue;
+        }
+        if (key == "seed") {
+            if (!parse_numbers(value, nums) || nums.size() != 1 || nums[0] < 0) return fail("invalid seed: " + value);
+            seed = static_cast<uint64_t>(nums[0]);
+            continue;
+        }
+
+        int d = dim_index(key);
+        bool is_number = parse_numbers(value, nums) && nums.size() == 1;
+        if (d < 0) {
+            int idx = particle_param_index(key);
+            if (idx < 0) return fail("unknown parameter " + key);
+            if (!is_number) return fail("only L, MLT, MLAT, Ek, pa and t_ini can be distributions, not " + key);
+            set_particle_param(shared, idx, nums[0]);
+            has_shared[idx] = true;
+            continue;
+        }
+
+        Dimension& dim = dims[d];
+        dim = Dimension();
+        dim.given = true;
+        if (is_number) {
+            dim.a = dim.b = nums[0];
+        } else if (!parse_numbers(rest, nums)) {
+            return fail("invalid values for " + key + ": " + value);
+        } else if (word == "values") {
+            dim.kind = DIM_VALUES;
+            dim.values = nums;
+        } else if (word == "linear" || word == "log" || word == "isotropic" || word == "sin") {
+            size_t first = (word == "sin") ? 1 : 0;
+            if (nums.size() != first + 2 && nums.size() != first + 3) return fail("expected " + word + (first ? " k," : "") + " a, b[, n]");
+            dim.kind = (word == "linear") ? DIM_LINEAR : (word == "log") ? DIM_LOG : DIM_SIN;
+            dim.k = first ? nums[0] : 0.0;
+            dim.a = nums[first];
+            dim.b = nums[first + 1];
+            dim.n = (nums.size() == first + 3) ? static_cast<int64_t>(nums[first + 2]) : 0;
+            if (dim.kind == DIM_LOG && !(dim.a > 0.0 && dim.b > 0.0)) return fail("log range must be positive");
+            if (dim.kind == DIM_SIN && (d != D_PA || dim.a < 0.0 || dim.b > 180.0 || dim.a >= dim.b || dim.k < 0.0)) {
+                return fail(word + " is a pitch angle distribution on 0 <= a < b <= 180 deg with k >= 0");
+            }
+        } else {
+            return fail("unknown distribution " + word + " (expected linear, log, values, isotropic or sin)");
+        }
+    }
+
+    // 每个参数都要有来源：共用值、维度，或由 L/MLT/MLAT 算出的位置
+    bool by_L = dims[D_L].given;
+    if (by_L && !dims[D_MLT].given) {
+        cerr << gen_file << ": L needs MLT" << endl;
+        return false;
+    }
+    for (int i = 0; i < NUM_PARTICLE_PARAMS; ++i) {
+        string name = particle_param_name(i);
+        bool from_dim = (name == "Ek" && dims[D_EK].given) || (name == "pa" && dims[D_PA].given) ||
+                        (name == "t_ini" && dims[D_TINI].given);
+        bool from_L = by_L && (name == "xgsm" || name == "ygsm" || name == "zgsm");
+        if (has_shared[i] && (from_dim || from_L)) {
+            cerr << gen_file << ": " << name << " is given twice" << endl;
+            return false;
+        }
+        if (!has_shared[i] && !from_dim && !from_L) {
+            cerr << gen_file << ": parameter " << name << " is not set" << endl;
+            return false;
+        }
+    }
+    if (!by_L && (dims[D_MLT].given || dims[D_MLAT].given)) {
+        cerr << gen_file << ": MLT and MLAT need L" << endl;
+        return false;
+    }
+
+    int64_t total = (sampling == SAMPLE_GRID) ? 1 : samples;
+    for (int d = 0; d < NUM_DIMS; ++d) {
+        Dimension& dim = dims[d];
+        if (sampling == SAMPLE_GRID && (dim.kind == DIM_LINEAR || dim.kind == DIM_LOG || dim.kind == DIM_SIN) && dim.n < 1) {
+            cerr << gen_file << ": " << DIM_NAMES[d] << " needs the number of grid points" << endl;
+            return false;
+        }
+        if (!dim.given && d >= D_EK) {
+            // 没有作为维度给出：取共用参数
+            dim.a = dim.b = get_particle_param(shared, particle_param_index(DIM_NAMES[d]));
+        }
+        dim.build();
+        if (sampling == SAMPLE_GRID) total *= static_cast<int64_t>(dim.nodes.size());
+    }
+    if (total > INT32_MAX) {
+        cerr << gen_file << ": too many particles (" << total << ")" << endl;
+        return false;
+    }
+
+    // 随机维度：非常数的维度，依次占用 Sobol 的各维
+    vector<int> active;
+    for (int d = 0; d < NUM_DIMS; ++d) {
+        if (dims[d].kind != DIM_CONST) active.push_back(d);
+    }
+    Sobol sobol(max<int>(1, static_cast<int>(active.size())), seed);
+    mt19937_64 rng(seed);
+
+    string prefix = PathUtils::getBasename(PathUtils::getFilename(gen_file));
+    int width = static_cast<int>(to_string(max<int64_t>(total - 1, 0)).size());
+    Member m;
+    vector<double> u;
+    time_t last_recalc = -1;
+    double x[NUM_DIMS];
+    for (int64_t i = 0; i < total; ++i) {
+        m.weight = 1.0;
+        if (sampling == SAMPLE_GRID) {
+            // 笛卡尔积，最后一维变化最快
+            int64_t rem = i;
+            for (int d = NUM_DIMS - 1; d >= 0; --d) {
+                int64_t count = static_cast<int64_t>(dims[d].nodes.size());
+                x[d] = dims[d].nodes[rem % count];
+                m.weight *= dims[d].widths[rem % count];
+                rem /= count;
+            }
+        } else {
+            if (sampling == SAMPLE_SOBOL) {
+                sobol.next(u);
+            } else {
+                u.resize(active.size());
+                for (auto& v : u) v = (rng() >> 11) * (1.0 / 9007199254740992.0);
+            }
+            for (int d = 0; d < NUM_DIMS; ++d) x[d] = dims[d].a;
+            for (size_t j = 0; j < active.size(); ++j) {
+                const Dimension& dim = dims[active[j]];
+                x[active[j]] = dim.inverse(u[j]);
+                m.weight *= dim.inverse_density(x[active[j]]);
+            }
+            m.weight /= static_cast<double>(total);
+        }
+
+        m.params = shared;
+        m.params.Ek = x[D_EK];
+        m.params.pa = x[D_PA];
+        m.params.t_ini = x[D_TINI];
+        if (by_L) {
+            m.L = x[D_L];
+            m.MLT = x[D_MLT];
+            m.MLAT = x[D_MLAT];
+            double lat = m.MLAT * M_PI / 180.0, phi = (m.MLT - 12.0) * M_PI / 12.0;
+            double r = m.L * cos(lat) * cos(lat);
+            recalc_at(m.params.t_ini, last_recalc);
+            Eigen::Vector3d gsm = sm_to_gsm(Eigen::Vector3d(r * cos(lat) * cos(phi), r * cos(lat) * sin(phi), r * sin(lat)));
+            m.params.xgsm = gsm[0];
+            m.params.ygsm = gsm[1];
+            m.params.zgsm = gsm[2];
+        }
+
+        string index = to_string(i);
+        m.name = prefix + "_" + string(width - index.size(), '0') + index;
+        emit(m);
+    }
+    return true;
+}
+
+bool write_table(const string& gen_file, const string& path)
+{
+    ofstream out(path, ios::out | ios::trunc);
+    if (!out) {
+        cerr << "Failed to write ensemble table: " << path << endl;
+        return false;
+    }
+    out.precision(17);
+    out << "# name\tL\tMLT\tMLAT\tEk\tpa\tt_ini\txgsm\tygsm\tzgsm\tweight\n";
+    bool ok = generate(gen_file, [&](const Member& m) {
+        out << m.name << '\t' << m.L << '\t' << m.MLT << '\t' << m.MLAT << '\t' << m.params.Ek << '\t'
+            << m.params.pa << '\t' << m.params.t_ini << '\t' << m.params.xgsm << '\t' << m.params.ygsm << '\t'
+            << m.params.zgsm << '\t' << m.weight << '\n';
+    });
+    return ok && static_cast<bool>(out);
+}
+
+} // namespace ensemble
@@ -0,0 +1,475 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <Eigen/Dense>
+
+#include "ensemble_integrator.h"
+#include "field_batch.h"
+#include "field_calculator.h"
+#include "particle_calculator.h"
+#include "particle_params.h"
+#include "path_utils.h"
+#include "progress_board.h"
+#include "result_cache.h"
+#include "run_options.h"
+#include "singular_particle.h"
+#include "trajectory_io.h"
+
+using namespace std;
+using namespace Eigen;
+
+extern int magnetic_field_model, wave_field_model;
+
+namespace lockstep {
+
+namespace {
+
+// 集合中的一个粒子：参数、日志、输出
+struct Member {
+    string para_file;
+    string name;
+    ParticleParams params;
+    ofstream log;
+    string outFileBase, outFilePath;
+    unique_ptr<traj_io::TrajectoryWriter> outfile;
+    int32_t num_steps = 0;
+    int write_step = 1;
+    int32_t write_count = 0, actual_write_count = 1;
+    double r_limit = 1.0;
+    int last_percent = -1;
+    bool running = false;
+};
+
+// 集合的状态：尚未移除的粒子按分量连续存放，member 为粒子在集合中的序号
+struct State {
+    vector<double> x, y, z, p_para;
+    vector<double> mu, E0, q, r_step;
+    vector<int> member;
+    vector<char> active;        // 0: 已结束（进入大气层或到达终点），下次压缩时移除
+
+    size_t size() const { return member.size(); }
+
+    void push(double x0, double y0, double z0, double p0, double mu0, double E00, double q0, double dr, int m)
+    {
+        x.push_back(x0); y.push_back(y0); z.push_back(z0); p_para.push_back(p0);
+        mu.push_back(mu0); E0.push_back(E00); q.push_back(q0); r_step.push_back(dr);
+        member.push_back(m);
+        active.push_back(1);
+    }
+
+    // 移除已结束的粒子，保持顺序
+    void compact()
+    {
+        size_t k = 0;
+        for (size_t i = 0; i < size(); ++i) {
+            if (!active[i]) continue;
+            x[k] = x[i]; y[k] = y[i]; z[k] = z[i]; p_para[k] = p_para[i];
+            mu[k] = mu[i]; E0[k] = E0[i]; q[k] = q[i]; r_step[k] = r_step[i];
+            member[k] = member[i];
+            active[k] = 1;
+            ++k;
+        }
+        for (auto* v : {&x, &y, &z, &p_para, &mu, &E0, &q, &r_step}) v->resize(k);
+        member.resize(k);
+        active.resize(k);
+    }
+};
+
+// RK4 一级的状态或导数（t 对整组相同，dt/dt = 1）
+struct Stage {
+    vector<double> x, y, z, p;
+    void resize(size_t n) { x.resize(n); y.resize(n); z.resize(n); p.resize(n); }
+};
+
+// 整组粒子的 dydt，各项与 singular_particle.cpp 的 dydt、field_calculator.cpp 的 B_grad_curv/deb_dt 逐项相同
+class Derivative {
+public:
+    Derivative(int magnetic_model, int wave_model) : magnetic_model_(magnetic_model), wave_model_(wave_model) {}
+
+    void operator()(double t, const State& s, const Stage& Y, Stage& k)
+    {
+        size_t n = s.size();
+        k.resize(n);
+
+        // 中心点和 ±x, ±y, ±z 邻点，第 j 块为 [j*n, (j+1)*n)
+        points_.resize(7 * n);
+        auto put = [&](int j, size_t i, double x, double y, double z) {
+            size_t idx = j * n + i;
+            points_.t[idx] = t;
+            points_.x[idx] = x;
+            points_.y[idx] = y;
+            points_.z[idx] = z;
+        };
+        for (size_t i = 0; i < n; ++i) {
+            double x = Y.x[i], y = Y.y[i], z = Y.z[i], dr = s.r_step[i];
+            put(0, i, x, y, z);
+            put(1, i, x + dr, y, z);
+            put(2, i, x - dr, y, z);
+            put(3, i, x, y + dr, z);
+            put(4, i, x, y - dr, z);
+            put(5, i, x, y, z + dr);
+            put(6, i, x, y, z - dr);
+        }
+        field_batch::evaluate(magnetic_model_, wave_model_, points_, fields_);
+
+        dp_partial_.resize(n);
+        dp_coef_.resize(n);
+        deb_dt_.resize(n);
+        deb_points_.resize(2 * n);
+        for (size_t i = 0; i < n; ++i) {
+            auto B_at = [&](int j) { size_t idx = j * n + i; return Vector3d(fields_.Bx[idx], fields_.By[idx], fields_.Bz[idx]); };
+            double dr = s.r_step[i];
+            double E0 = s.E0[i], mu = s.mu[i], q = s.q[i], p_para = Y.p[i];
+
+            Vector3d B = B_at(0);
+            Vector3d E(fields_.Ex[i], fields_.Ey[i], fields_.Ez[i]);
+
+            // B_grad_curv
+            Vector3d B0 = B;
+            double B0_t = B0.norm();
+            Vector3d eb = B0 / B0_t;
+            Vector3d B_x_plus = B_at(1), B_x_minus = B_at(2);
+            Vector3d B_y_plus = B_at(3), B_y_minus = B_at(4);
+            Vector3d B_z_plus = B_at(5), B_z_minus = B_at(6);
+            double B_x_plus_t = B_x_plus.norm(), B_x_minus_t = B_x_minus.norm();
+            double B_y_plus_t = B_y_plus.norm(), B_y_minus_t = B_y_minus.norm();
+            double B_z_plus_t = B_z_plus.norm(), B_z_minus_t = B_z_minus.norm();
+
+            Vector3d grad_B((B_x_plus_t - B_x_minus_t) / (2 * dr),
+                            (B_y_plus_t - B_y_minus_t) / (2 * dr),
+                            (B_z_plus_t - B_z_minus_t) / (2 * dr));
+            Matrix3d grad_eb;
+            grad_eb.col(0) = (B_x_plus / B_x_plus_t - B_x_minus / B_x_minus_t) / (2 * dr);
+            grad_eb.col(1) = (B_y_plus / B_y_plus_t - B_y_minus / B_y_minus_t) / (2 * dr);
+            grad_eb.col(2) = (B_z_plus / B_z_plus_t - B_z_minus / B_z_minus_t) / (2 * dr);
+            Vector3d curv_B(eb.dot(grad_eb.row(0).transpose()),
+                            eb.dot(grad_eb.row(1).transpose()),
+                            eb.dot(grad_eb.row(2).transpose()));
+
+            // drift velocities
+            DriftTerms d = drift_terms(E0, mu, q, p_para, B, E, grad_B, curv_B);
+            const Vector3d& v_total = d.v_total;
+            dp_partial_[i] = d.dp_dt_1 + d.dp_dt_2;
+            dp_coef_[i] = d.dp_coef;
+
+            k.x[i] = v_total[0];
+            k.y[i] = v_total[1];
+            k.z[i] = v_total[2];
+
+            // deb_dt 的两个点：[0, n) 为 t - dt，[n, 2n) 为 t + dt
+            double dt = dr / v_total.norm();
+            deb_dt_[i] = dt;
+            deb_points_.t[i] = t - dt;
+            deb_points_.x[i] = Y.x[i] - dt * v_total[0];
+            deb_points_.y[i] = Y.y[i] - dt * v_total[1];
+            deb_points_.z[i] = Y.z[i] - dt * v_total[2];
+            deb_points_.t[n + i] = t + dt;
+            deb_points_.x[n + i] = Y.x[i] + dt * v_total[0];
+            deb_points_.y[n + i] = Y.y[i] + dt * v_total[1];
+            deb_points_.z[n + i] = Y.z[i] + dt * v_total[2];
+        }
+        field_batch::evaluate(magnetic_model_, wave_model_, deb_points_, deb_fields_);
+
+        for (size_t i = 0; i < n; ++i) {
+            Vector3d v_total(k.x[i], k.y[i], k.z[i]);
+            Vector3d B_minus(deb_fields_.Bx[i], deb_fields_.By[i], deb_fields_.Bz[i]);
+            Vector3d B_plus(deb_fields_.Bx[n + i], deb_fields_.By[n + i], deb_fields_.Bz[n + i]);
+            Vector3d deb = (B_plus / B_plus.norm() - B_minus / B_minus.norm()) / (2 * deb_dt_[i]);
+            double dp_dt_3 = dp_coef_[i] * v_total.dot(deb);
+            k.p[i] = dp_partial_[i] + dp_dt_3;
+        }
+    }
+
+private:
+    int magnetic_model_, wave_model_;
+    field_batch::Points points_, deb_points_;
+    field_batch::Fields fields_, deb_fields_;
+    vector<double> dp_partial_, dp_coef_, deb_dt_;
+};
+
+string timestamp()
+{
+    time_t now = time(nullptr);
+    char timeBuffer[80];
+    struct tm timeinfo;
+    #ifdef _WIN32
+        localtime_s(&timeinfo, &now);
+    #else
+        localtime_r(&now, &timeinfo);
+    #endif
+    strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    return timeBuffer;
+}
+
+// 粒子结束：关闭输出，写结果缓存标记和日志结尾
+void finish(Member& m, const double Y[5], double elapsed)
+{
+    m.outfile->close();
+    remove((m.outFileBase + ".ckpt").c_str());
+    if (!result_cache::write_stamp(m.outFilePath, solver_cache_key(m.para_file))) {
+        m.log << "WARNING: Failed to write result stamp for " << m.outFilePath << endl;
+    }
+
+    m.log << "=== SIMULATION COMPLETED ===" << endl;
+    m.log << "Final state:" << endl;
+    m.log << "  Final time: " << Y[0] << " s" << endl;
+    m.log << "  Final position: [" << Y[1] << ", " << Y[2] << ", " << Y[3] << "] RE" << endl;
+    m.log << "  Final parallel momentum: " << Y[4] << " MeV/c" << endl;
+    m.log << "  Final distance from Earth: " << sqrt(Y[1] * Y[1] + Y[2] * Y[2] + Y[3] * Y[3]) << " RE" << endl;
+    m.log << "Performance statistics:" << endl;
+    m.log << "  Total integration time: " << elapsed << " seconds (whole ensemble)" << endl;
+    m.log << "  Average time per step: " << (elapsed / m.num_steps) << " seconds" << endl;
+    m.log << "  Expected writes: " << m.write_count << endl;
+    m.log << "  Actual writes: " << m.actual_write_count << endl;
+    m.log << "Output file: " << m.outFilePath << endl;
+    m.log << "Completion time: " << timestamp() << endl;
+    m.log << "=== END OF SIMULATION LOG ===" << endl;
+    m.log.close();
+    m.running = false;
+}
+
+} // namespace
+
+vector<vector<string>> group(const vector<string>& para_files, int size)
+{
+    if (size < 1) size = 1;
+    typedef tuple<double, double, int, int> Key;    // dt, t_ini, 背景场模型, 波场模型
+    map<Key, size_t> open_group;                    // 每个键尚未满的组
+    vector<vector<string>> groups;
+    for (const auto& file : para_files) {
+        ParticleParams params;
+        if (!read_particle_params(file, params)) {
+            groups.push_back({file});
+            continue;
+        }
+        Key key(params.dt, params.t_ini, params.magnetic_field_model, params.wave_field_model);
+        auto found = open_group.find(key);
+        if (found == open_group.end() || static_cast<int>(groups[found->second].size()) >= size) {
+            open_group[key] = groups.size();
+            groups.push_back({});
+            found = open_group.find(key);
+        }
+        groups[found->second].push_back(file);
+    }
+    return groups;
+}
+
+int run(const vector<string>& para_files)
+{
+    string logDir = PathUtils::joinPath(exeDir, "log");
+    string outputDir = PathUtils::joinPath(exeDir, "output");
+    if (!PathUtils::createDirectory(logDir) || !PathUtils::createDirectory(outputDir)) {
+        cerr << "Failed to create log or output directory in " << exeDir << endl;
+        return 1;
+    }
+
+    // exec 的子进程没有清单/生成器中粒子的参数：一次读入所有清单和生成器，不再逐个粒子查找
+    for (const auto& file : para_files) {
+        if (!ifstream(file) && particle_params_argument(file).empty()) {
+            vector<string> all;
+            find_particles(PathUtils::joinPath(exeDir, "input"), all);
+            break;
+        }
+    }
+
+    int failed = 0;
+    vector<unique_ptr<Member>> members;
+    for (const auto& para_file : para_files) {
+        unique_ptr<Member> m(new Member);
+        m->para_file = para_file;
+        m->name = PathUtils::getBasename(PathUtils::getFilename(para_file));
+        string logFilePath = PathUtils::joinPath(logDir, m->name + ".log");
+        m->log.open(logFilePath, ios::out | ios::trunc);
+        if (!m->log) {
+            cerr << "Failed to create log file: " << logFilePath << endl;
+            ++failed;
+            continue;
+        }
+        m->log << "=== SIMULATION STARTED AT " << timestamp() << " ===" << endl;
+        m->log << "Parameter file: " << para_file << endl;
+        m->log << "Log file: " << logFilePath << endl;
+        m->log << "Ensemble: integrated together with " << para_files.size() - 1 << " other particles (--ensemble)" << endl;
+        if (!read_particle_params(para_file, m->params)) {
+            m->log << "ERROR: Failed to open parameter file: " << para_file << endl;
+            cerr << "Failed to open parameter file: " << para_file << endl;
+            ++failed;
+            continue;
+        }
+        m->log << "Reading parameters from file..." << endl;
+        members.push_back(move(m));
+    }
+    if (members.empty()) return 1;
+
+    // 分组时已保证 dt、t_ini、场模型相同；单独给出的一组文件也检查一遍
+    const ParticleParams& first = members[0]->params;
+    double dt = first.dt, t_ini = first.t_ini;
+    magnetic_field_model = first.magnetic_field_model;
+    wave_field_model = first.wave_field_model;
+    for (auto& m : members) {
+        const ParticleParams& p = m->params;
+        if (p.dt != dt || p.t_ini != t_ini || p.magnetic_field_model != magnetic_field_model || p.wave_field_model != wave_field_model) {
+            cerr << "Ensemble members must share dt, t_ini and the field models: " << m->para_file << " differs from "
+                 << members[0]->para_file << endl;
+            return 1;
+        }
+    }
+    if (!field_batch::prepare(magnetic_field_model, wave_field_model)) {
+        cerr << "Failed to prepare the batched field models" << endl;
+        return 1;
+    }
+
+    State s;
+    int32_t max_steps = 0;
+    int encoding = output_encoding();
+    for (size_t idx = 0; idx < members.size(); ++idx) {
+        Member& m = *members[idx];
+        const ParticleParams& p = m.params;
+        m.outFileBase = PathUtils::joinPath(outputDir, m.name);
+        m.outFilePath = trajectory_output_path(m.outFileBase);
+        result_cache::clear_stamp(m.outFilePath);  // 重写期间输出文件不算最新
+        log_particle_params(m.log, p, m.outFilePath);
+
+        // pre-parameter calculations (same as singular_particle)
+        double t_end = p.t_ini + p.t_interval * abs(dt) / dt;
+        m.num_steps = static_cast<int32_t>((t_end - p.t_ini) / dt);
+        double pm = momentum(p.E0, p.Ek);
+        double p_para = pm * cos(p.pa * M_PI / 180.0);
+        Vector3d B = Bvec(p.t_ini, p.xgsm, p.ygsm, p.zgsm);
+        double mu0 = adiabatic_1st(pm, p.pa, p.E0, B.norm());
+        m.write_step = static_cast<int>(p.write_interval / abs(dt));
+        m.write_count = m.num_steps / m.write_step + 1;
+        m.r_limit = 1.0 + p.atmosphere_altitude / 6371.0;
+
+        m.log << "Simulation setup:" << endl;
+        m.log << "  Total momentum p = " << pm << " MeV/c" << endl;
+        m.log << "  Parallel momentum p_para = " << p_para << " MeV/c" << endl;
+        m.log << "  Initial magnetic field |B| = " << B.norm() << " nT" << endl;
+        m.log << "  First adiabatic invariant mu = " << mu0 << " MeV/nT" << endl;
+        m.log << "  Simulation end time = " << t_end << " s" << endl;
+        m.log << "  Total integration steps = " << m.num_steps << endl;
+        m.log << "  Write every " << m.write_step << " steps" << endl;
+        m.log << "  Expected output records = " << m.write_count << endl;
+
+        m.outfile = traj_io::open_trajectory_writer(m.outFileBase, run_options.profile, encoding, m.write_count,
+                                                    m.write_step * dt, run_options.envelope_window);
+        if (!m.outfile->good()) {
+            m.log << "ERROR: Failed to open output file: " << m.outFilePath << endl;
+            cerr << "Failed to open output file: " + m.outFilePath << endl;
+            ++failed;
+            continue;
+        }
+        double Y[5] = {p.t_ini, p.xgsm, p.ygsm, p.zgsm, p_para};
+        m.outfile->write(Y);
+        m.running = true;
+        m.log << "Starting integration loop..." << endl;
+        if (m.num_steps < 1) {
+            finish(m, Y, 0.0);
+            continue;
+        }
+        s.push(p.xgsm, p.ygsm, p.zgsm, p_para, mu0, p.E0, p.q, p.r_step, static_cast<int>(idx));
+        max_steps = max(max_steps, m.num_steps);
+    }
+
+    auto start_time = chrono::high_resolution_clock::now();
+    auto elapsed = [&start_time]() {
+        return chrono::duration<double>(chrono::high_resolution_clock::now() - start_time).count();
+    };
+    progress_board::begin(para_files[0], max_steps, 0, t_ini, t_ini);
+
+    Derivative dydt(magnetic_field_model, wave_field_model);
+    Stage Y1, Y2, k1, k2, k3, k4;
+    double t = t_ini;
+    size_t finished = 0;    // 已结束、尚未移除的粒子数
+    for (int32_t i = 1; i <= max_steps && s.size() > 0; ++i) {
+        size_t n = s.size();
+        Y1.x = s.x; Y1.y = s.y; Y1.z = s.z; Y1.p = s.p_para;
+        Y2.resize(n);
+
+        // Runge-Kutta 4th order integration
+        dydt(t, s, Y1, k1);
+        for (size_t j = 0; j < n; ++j) {
+            Y2.x[j] = Y1.x[j] + 0.5 * dt * k1.x[j];
+            Y2.y[j] = Y1.y[j] + 0.5 * dt * k1.y[j];
+            Y2.z[j] = Y1.z[j] + 0.5 * dt * k1.z[j];
+            Y2.p[j] = Y1.p[j] + 0.5 * dt * k1.p[j];
+        }
+        dydt(t + 0.5 * dt * 1.0, s, Y2, k2);
+        for (size_t j = 0; j < n; ++j) {
+            Y2.x[j] = Y1.x[j] + 0.5 * dt * k2.x[j];
+            Y2.y[j] = Y1.y[j] + 0.5 * dt * k2.y[j];
+            Y2.z[j] = Y1.z[j] + 0.5 * dt * k2.z[j];
+            Y2.p[j] = Y1.p[j] + 0.5 * dt * k2.p[j];
+        }
+        dydt(t + 0.5 * dt * 1.0, s, Y2, k3);
+        for (size_t j = 0; j < n; ++j) {
+            Y2.x[j] = Y1.x[j] + dt * k3.x[j];
+            Y2.y[j] = Y1.y[j] + dt * k3.y[j];
+            Y2.z[j] = Y1.z[j] + dt * k3.z[j];
+            Y2.p[j] = Y1.p[j] + dt * k3.p[j];
+        }
+        dydt(t + dt * 1.0, s, Y2, k4);
+        for (size_t j = 0; j < n; ++j) {
+            if (!s.active[j]) continue;
+            s.x[j] += (dt / 6.0) * (k1.x[j] + 2 * k2.x[j] + 2 * k3.x[j] + k4.x[j]);
+            s.y[j] += (dt / 6.0) * (k1.y[j] + 2 * k2.y[j] + 2 * k3.y[j] + k4.y[j]);
+            s.z[j] += (dt / 6.0) * (k1.z[j] + 2 * k2.z[j] + 2 * k3.z[j] + k4.z[j]);
+            s.p_para[j] += (dt / 6.0) * (k1.p[j] + 2 * k2.p[j] + 2 * k3.p[j] + k4.p[j]);
+        }
+        t += (dt / 6.0) * (1.0 + 2 * 1.0 + 2 * 1.0 + 1.0);
+        progress_board::update(i, t);
+
+        for (size_t j = 0; j < n; ++j) {
+            if (!s.active[j]) continue;
+            Member& m = *members[s.member[j]];
+            double Y[5] = {t, s.x[j], s.y[j], s.z[j], s.p_para[j]};
+            if (i % m.write_step == 0) {
+                m.outfile->write(Y);
+                ++m.actual_write_count;
+            }
+            // Output progress every 10% of the total steps
+            int percent = static_cast<int>(100.0 * i / m.num_steps);
+            if (percent != m.last_percent && percent % 10 == 0) {
+                m.log << "Progress: " << percent << "% (" << i << " / " << m.num_steps << " steps)" << '\n';
+                m.log << "  Current time: " << Y[0] << " s" << '\n';
+                m.last_percent = percent;
+            }
+
+            // check if the particle has reached the atmosphere
+            double r_current = sqrt(Y[1] * Y[1] + Y[2] * Y[2] + Y[3] * Y[3]);
+            if (r_current < m.r_limit) {
+                m.log << "EARLY TERMINATION: Particle reached atmosphere at step " << i << endl;
+                m.log << "  Final time: " << Y[0] << " s" << endl;
+                m.log << "  Final position: [" << Y[1] << ", " << Y[2] << ", " << Y[3] << "] RE" << endl;
+                m.log << "  Distance from Earth: " << r_current << " RE" << endl;
+                m.log << "  Atmosphere threshold: " << m.r_limit << " RE" << endl;
+            } else if (i < m.num_steps) {
+                continue;
+            }
+            finish(m, Y, elapsed());
+            s.active[j] = 0;
+            ++finished;
+        }
+
+        // 结束的粒子不再更新，但仍占着数组；攒够四分之一再移除
+        if (finished > 0 && finished * 4 >= s.size()) {
+            s.compact();
+            finished = 0;
+        }
+    }
+
+    progress_board::finish(failed == 0);
+    for (auto& m : members) {
+        if (m->running) {
+            m->log << "ERROR: Ensemble ended before this particle finished" << endl;
+            ++failed;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+} // namespace lockstep
@@ -0,0 +1,173 @@
+#include <iostream>
+#include <sstream>
+#include <ctime>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <Eigen/Dense>
+
+#include "event_detector.h"
+#include "field_calculator.h"
+#include "singular_particle.h"
+
+using namespace std;
+using namespace Eigen;
+
+namespace events {
+
+namespace {
+
+const int MAX_ITERATIONS = 60;
+
+} // namespace
+
+double magnetopause_distance(double Dp, double cos_theta)
+{
+    const double Bz = 0.0;
+    double r0 = (10.22 + 1.29 * tanh(0.184 * (Bz + 8.14))) * pow(Dp, -1.0 / 6.6);
+    double alpha = (0.58 - 0.007 * Bz) * (1.0 + 0.024 * log(Dp));
+    return r0 * pow(2.0 / (1.0 + cos_theta), alpha);
+}
+
+const char* event_name(int type)
+{
+    switch (type) {
+        case MIRROR: return "mirror";
+        case EQUATOR: return "equator";
+        case ATMOSPHERE: return "atmosphere";
+        case LMAX: return "lmax";
+        case MAGNETOPAUSE: return "magnetopause";
+        default: return "unknown";
+    }
+}
+
+bool parse_events(const string& spec, vector<Event>& events, string& error)
+{
+    events.clear();
+    stringstream items(spec);
+    string item;
+    while (getline(items, item, ',')) {
+        if (item.empty()) continue;
+        Event e;
+        const string suffix = ":stop";
+        if (item.size() > suffix.size() && item.compare(item.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            e.stop = true;
+            item.erase(item.size() - suffix.size());
+        }
+        size_t eq = item.find('=');
+        string name = item.substr(0, eq);
+        string value = (eq == string::npos) ? "" : item.substr(eq + 1);
+        char* end = nullptr;
+        if (!value.empty()) e.value = strtod(value.c_str(), &end);
+        bool bad_value = !value.empty() && (*end != '\0' || !(e.value > 0.0));
+
+        if (name == "mirror") e.type = MIRROR;
+        else if (name == "equator") e.type = EQUATOR;
+        else if (name == "atmosphere") e.type = ATMOSPHERE;
+        else if (name == "lmax") e.type = LMAX;
+        else if (name == "magnetopause") e.type = MAGNETOPAUSE;
+        else {
+            error = "unknown event " + name + " (expected mirror, equator, atmosphere, lmax=L or magnetopause[=Dp])";
+            return false;
+        }
+        if (bad_value || (!value.empty() && e.type != LMAX && e.type != MAGNETOPAUSE)) {
+            error = "invalid value for event " + name + ": " + value;
+            return false;
+        }
+        if (e.type == LMAX && value.empty()) {
+            error = "lmax needs a value (lmax=L)";
+            return false;
+        }
+        if (e.type == MAGNETOPAUSE && value.empty()) e.value = 2.0;
+        // 进入大气层总是结束积分（与不检测事件时相同）
+        if (e.type == ATMOSPHERE) e.stop = false;
+        events.push_back(e);
+    }
+    if (events.empty()) {
+        error = "no events given";
+        return false;
+    }
+    return true;
+}
+
+Detector::Detector(const vector<Event>& events, double r_atmosphere)
+    : events_(events), r_atmosphere_(r_atmosphere), g_prev_(events.size(), 0.0) {}
+
+double Detector::g(const Event& e, const VectorXd& Y) const
+{
+    double r = sqrt(Y[1] * Y[1] + Y[2] * Y[2] + Y[3] * Y[3]);
+    switch (e.type) {
+        case MIRROR: return Y[4];
+        case EQUATOR: return to_sm(Y)[2];
+        case ATMOSPHERE: return r - r_atmosphere_;
+        case LMAX: {
+            Vector3d sm = to_sm(Y);
+            double rho2 = sm[0] * sm[0] + sm[1] * sm[1];
+            return r * r * r / rho2 - e.value;   // L = r / sin^2(theta)
+        }
+        case MAGNETOPAUSE: return r - magnetopause_distance(e.value, Y[1] / r);
+        default: return 1.0;
+    }
+}
+
+void Detector::start(const VectorXd& Y)
+{
+    for (size_t i = 0; i < events_.size(); ++i) g_prev_[i] = g(events_[i], Y);
+}
+
+bool Detector::check(const VectorXd& Y0, const VectorXd& k1, const VectorXd& Y1, double dt, vector<Crossing>& found)
+{
+    VectorXd k_end;     // dydt(Y1)，有事件时才计算
+    // 该步的三次 Hermite 插值，s ∈ [0, 1]
+    auto dense = [&](double s) {
+        double s2 = s * s, s3 = s2 * s;
+        return VectorXd((2 * s3 - 3 * s2 + 1) * Y0 + (s3 - 2 * s2 + s) * dt * k1 +
+                        (-2 * s3 + 3 * s2) * Y1 + (s3 - s2) * dt * k_end);
+    };
+
+    vector<pair<double, Crossing>> located;
+    for (size_t i = 0; i < events_.size(); ++i) {
+        const Event& e = events_[i];
+        double g0 = g_prev_[i];
+        double g1 = g(e, Y1);
+        g_prev_[i] = g1;
+        if ((g0 < 0) == (g1 < 0)) continue;
+        if (k_end.size() == 0) k_end = dydt(Y1);
+
+        // Illinois 法（试位法）求 g(dense(s)) = 0
+        double a = 0.0, b = 1.0, ga = g0, gb = g1;
+        int side = 0;
+        for (int n = 0; n < MAX_ITERATIONS && b - a > 1e-12; ++n) {
+            double s = (a * gb - b * ga) / (gb - ga);
+            if (!(s > a && s < b)) s = 0.5 * (a + b);
+            double gs = g(e, dense(s));
+            if ((gs < 0) == (ga < 0)) {
+                a = s; ga = gs;
+                if (side == -1) gb *= 0.5;
+                side = -1;
+            } else {
+                b = s; gb = gs;
+                if (side == 1) ga *= 0.5;
+                side = 1;
+            }
+        }
+        double s = (fabs(ga) < fabs(gb)) ? a : b;
+        Crossing c;
+        c.type = e.type;
+        c.direction = (g1 > g0) ? 1 : -1;
+        c.stop = e.stop;
+        c.Y = dense(s);
+        located.push_back(make_pair(s, c));
+    }
+
+    sort(located.begin(), located.end(), [](const pair<double, Crossing>& x, const pair<double, Crossing>& y) {
+        return x.first < y.first;
+    });
+    for (const auto& l : located) {
+        found.push_back(l.second);
+        if (l.second.stop) return true;
+    }
+    return false;
+}
+
+} // namespace events
@@ -0,0 +1,290 @@
+#include <iostream>
+#include <ctime>
+#include <cmath>
+#include <functional>
+#include <Eigen/Dense>
+
+#include "field_batch.h"
+#include "field_calculator.h"
+#include "geopack_caller.h"
+#include "coordinates_transfer.h"
+#include "poloidal_simple_harmonic_wave.h"
+#include "toroidal_simple_harmonic_wave.h"
+#include "poloidal_mode_wave.h"
+#include "toroidal_mode_wave.h"
+
+using namespace std;
+using namespace Eigen;
+
+namespace field_batch {
+
+namespace {
+
+const double* geopack1 = nullptr;   // /GEOPACK1/
+const double* geopack2 = nullptr;   // /GEOPACK2/: G, H, REC
+
+// DIP_08：[begin, end) 中各点的偶极子场
+void dipole_kernel(const Points& p, Fields& f, size_t begin, size_t end)
+{
+    const double SPS = geopack1[10], CPS = geopack1[11];
+    const double* G = geopack2;
+    const double* H = geopack2 + 105;
+    const double DIPMOM = sqrt(G[1] * G[1] + G[2] * G[2] + H[2] * H[2]);
+
+    for (size_t k = begin; k < end; ++k) {
+        double X = p.x[k], Y = p.y[k], Z = p.z[k];
+        double P = X * X;
+        double U = Z * Z;
+        double V = 3.0 * Z * X;
+        double T = Y * Y;
+        double R = sqrt(P + T + U);
+        double R4 = (R * R) * (R * R);
+        double Q = DIPMOM / (R * R4);
+        f.Bx[k] = Q * ((T + U - 2.0 * P) * SPS - V * CPS);
+        f.By[k] = -3.0 * Y * Q * (X * SPS + Z * CPS);
+        f.Bz[k] = Q * ((P + T - 2.0 * U) * CPS - V * SPS);
+    }
+}
+
+// IGRF_GSW_08：[begin, end) 中各点的 IGRF 场
+void igrf_kernel(const Points& p, Fields& f, size_t begin, size_t end)
+{
+    const double A11 = geopack1[16], A21 = geopack1[17], A31 = geopack1[18];
+    const double A12 = geopack1[19], A22 = geopack1[20], A32 = geopack1[21];
+    const double A13 = geopack1[22], A23 = geopack1[23], A33 = geopack1[24];
+    const double* G = geopack2;         // G(MN) = G[MN - 1]
+    const double* H = geopack2 + 105;
+    const double* REC = geopack2 + 210;
+
+    for (size_t k = begin; k < end; ++k) {
+        // GSW -> GEO
+        double XGEO = A11 * p.x[k] + A21 * p.y[k] + A31 * p.z[k];
+        double YGEO = A12 * p.x[k] + A22 * p.y[k] + A32 * p.z[k];
+        double ZGEO = A13 * p.x[k] + A23 * p.y[k] + A33 * p.z[k];
+
+        double RHO2 = XGEO * XGEO + YGEO * YGEO;
+        double R = sqrt(RHO2 + ZGEO * ZGEO);
+        double C = ZGEO / R;
+        double RHO = sqrt(RHO2);
+        double S = RHO / R;
+        double CF, SF;
+        if (S < 1e-10) {
+            CF = 1.0;
+            SF = 0.0;
+        } else {
+            CF = XGEO / RHO;
+            SF = YGEO / RHO;
+        }
+
+        double PP = 1.0 / R;
+        double P = PP;
+        int IRP3 = static_cast<int>(R + 2);
+        int NM = 3 + 30 / IRP3;
+        if (NM > 13) NM = 13;
+
+        int K = NM + 1;
+        double A[14], B[14];
+        for (int N = 1; N <= K; ++N) {
+            P = P * PP;
+            A[N - 1] = P;
+            B[N - 1] = P * N;
+        }
+
+        P = 1.0;
+        double D = 0.0;
+        double BBR = 0.0, BBT = 0.0, BBF = 0.0;
+        double X = 0.0, Y = 1.0;
+
+        for (int M = 1; M <= K; ++M) {
+            int MM = M - 1;
+            if (M > 1) {
+                double W = X;
+                X = W * CF + Y * SF;
+                Y = Y * CF - W * SF;
+            }
+            double Q = P;
+            double Z = D;
+            double BI = 0.0;
+            double P2 = 0.0;
+            double D2 = 0.0;
+            for (int N = M; N <= K; ++N) {
+                double AN = A[N - 1];
+                int MN = N * (N - 1) / 2 + M;
+                double E = G[MN - 1];
+                double HH = H[MN - 1];
+                double W = E * Y + HH * X;
+                BBR = BBR + B[N - 1] * W * Q;
+                BBT = BBT - AN * W * Z;
+                if (M > 1) {
+                    double QQ = Q;
+                    if (S < 1e-10) QQ = Z;
+                    BI = BI + AN * (E * X - HH * Y) * QQ;
+                }
+                double XK = REC[MN - 1];
+                double DP = C * Z - S * Q - XK * D2;
+                double PM = C * Q - XK * P2;
+                D2 = Z;
+                P2 = Q;
+                Z = DP;
+                Q = PM;
+            }
+            D = S * D + C * P;
+            P = S * P;
+            if (M == 1) continue;
+            BI = BI * MM;
+            BBF = BBF + BI;
+        }
+
+        double BR = BBR;
+        double BT = BBT;
+        double BF;
+        if (S < 1e-10) {
+            if (C < 0.0) BBF = -BBF;
+            BF = BBF;
+        } else {
+            BF = BBF / S;
+        }
+
+        double HE = BR * S + BT * C;
+        double HXGEO = HE * CF - BF * SF;
+        double HYGEO = HE * SF + BF * CF;
+        double HZGEO = BR * C - BT * S;
+
+        // GEO -> GSW
+        f.Bx[k] = A11 * HXGEO + A12 * HYGEO + A13 * HZGEO;
+        f.By[k] = A21 * HXGEO + A22 * HYGEO + A23 * HZGEO;
+        f.Bz[k] = A31 * HXGEO + A32 * HYGEO + A33 * HZGEO;
+    }
+}
+
+// 波场：GSM -> SM，按模型计算，再转回 GSM；E 写入 f.E*，B 加到 f.B* 上
+template <typename WaveSM>
+void wave_kernel(const Points& p, Fields& f, size_t begin, size_t end, WaveSM wave_sm)
+{
+    const double SPS = geopack1[10], CPS = geopack1[11];
+    for (size_t k = begin; k < end; ++k) {
+        double xsm = p.x[k] * CPS - p.z[k] * SPS;
+        double ysm = p.y[k];
+        double zsm = p.x[k] * SPS + p.z[k] * CPS;
+
+        Matrix<double, 6, 1> EB_sm = wave_sm(p.t[k], xsm, ysm, zsm);
+
+        f.Ex[k] = EB_sm[0] * CPS + EB_sm[2] * SPS;
+        f.Ey[k] = EB_sm[1];
+        f.Ez[k] = EB_sm[2] * CPS - EB_sm[0] * SPS;
+        f.Bx[k] = f.Bx[k] + (EB_sm[3] * CPS + EB_sm[5] * SPS);
+        f.By[k] = f.By[k] + EB_sm[4];
+        f.Bz[k] = f.Bz[k] + (EB_sm[5] * CPS - EB_sm[3] * SPS);
+    }
+}
+
+// 简谐波：与 E_wave / B_wave 相同的分量组合
+template <typename Wave>
+Matrix<double, 6, 1> simple_wave_sm(const double& t, const double& xsm, const double& ysm, const double& zsm)
+{
+    Vector3d dip_cor = cartesian_to_dipole(Vector3d(xsm, ysm, zsm));
+    double L = dip_cor[0];
+    double phi = dip_cor[1];
+    double mu = dip_cor[2];
+    Matrix3d dip_bas = dipole_basis(Vector3d(xsm, ysm, zsm));
+    Vector3d e_L = dip_bas.col(0);
+    Vector3d e_phi = dip_bas.col(1);
+    Vector3d e_mu = dip_bas.col(2);
+
+    Vector3d E_sm = Wave::E_L(t, L, mu, phi) * e_L + Wave::E_phi(t, L, mu, phi) * e_phi;
+    Vector3d B_sm = Wave::B_L(t, L, mu, phi) * e_L + Wave::B_phi(t, L, mu, phi) * e_phi + Wave::B_mu(t, L, mu, phi) * e_mu;
+
+    Matrix<double, 6, 1> EB_sm;
+    EB_sm << E_sm, B_sm;
+    return EB_sm;
+}
+
+struct SimplePol {
+    static double E_L(const double& t, const double& L, const double& mu, const double& phi) { return simple_pol_wave::E_L(t, L, mu, phi); }
+    static double E_phi(const double& t, const double& L, const double& mu, const double& phi) { return simple_pol_wave::E_phi(t, L, mu, phi); }
+    static double B_L(const double& t, const double& L, const double& mu, const double& phi) { return simple_pol_wave::B_L(t, L, mu, phi); }
+    static double B_phi(const double& t, const double& L, const double& mu, const double& phi) { return simple_pol_wave::B_phi(t, L, mu, phi); }
+    static double B_mu(const double& t, const double& L, const double& mu, const double& phi) { return simple_pol_wave::B_mu(t, L, mu, phi); }
+};
+
+struct SimpleTor {
+    static double E_L(const double& t, const double& L, const double& mu, const double& phi) { return simple_tor_wave::E_L(t, L, mu, phi); }
+    static double E_phi(const double& t, const double& L, const double& mu, const double& phi) { return simple_tor_wave::E_phi(t, L, mu, phi); }
+    static double B_L(const double& t, const double& L, const double& mu, const double& phi) { return simple_tor_wave::B_L(t, L, mu, phi); }
+    static double B_phi(const double& t, const double& L, const double& mu, const double& phi) { return simple_tor_wave::B_phi(t, L, mu, phi); }
+    static double B_mu(const double& t, const double& L, const double& mu, const double& phi) { return simple_tor_wave::B_mu(t, L, mu, phi); }
+};
+
+// 宽带波：同一 t 的点共用各频率分量的时间因子之和
+template <Vector4d (*temporal_sums)(const double&),
+          Matrix<double, 6, 1> (*wave_sm)(const Vector4d&, const double&, const double&, const double&)>
+struct ModeWave {
+    bool valid = false;
+    double t = 0.0;
+    Vector4d sums;
+
+    Matrix<double, 6, 1> operator()(const double& t_in, const double& xsm, const double& ysm, const double& zsm)
+    {
+        if (!valid || t_in != t) {
+            sums = temporal_sums(t_in);
+            t = t_in;
+            valid = true;
+        }
+        return wave_sm(sums, xsm, ysm, zsm);
+    }
+};
+
+} // namespace
+
+bool prepare(int magnetic_field_model, int wave_field_model)
+{
+    if (magnetic_field_model != 0 && magnetic_field_model != 1) {
+        cerr << "Error: Unknown magnetic_field_model = " << magnetic_field_model << endl;
+        return false;
+    }
+    if (!preload_field_model(wave_field_model)) return false;
+    geopack1 = geopack1_common();
+    geopack2 = geopack2_common();
+    if (!geopack1 || !geopack2) {
+        cerr << "Geopack common blocks /GEOPACK1/, /GEOPACK2/ not found in the library" << endl;
+        return false;
+    }
+    return true;
+}
+
+void evaluate(int magnetic_field_model, int wave_field_model, const Points& points, Fields& fields)
+{
+    size_t n = points.size();
+    fields.resize(n);
+
+    ModeWave<pol_wave::temporal_sums, pol_wave::wave_sm> pol;
+    ModeWave<tor_wave::temporal_sums, tor_wave::wave_sm> tor;
+
+    // 同一整秒的点共用一次 recalc
+    size_t begin = 0;
+    while (begin < n) {
+        time_t second = static_cast<time_t>(points.t[begin]);
+        size_t end = begin + 1;
+        while (end < n && static_cast<time_t>(points.t[end]) == second) ++end;
+        recalc_at(static_cast<double>(second));
+
+        if (magnetic_field_model == 0) dipole_kernel(points, fields, begin, end);
+        else igrf_kernel(points, fields, begin, end);
+
+        switch (wave_field_model) {
+            case 0:
+                for (size_t k = begin; k < end; ++k) fields.Ex[k] = fields.Ey[k] = fields.Ez[k] = 0.0;
+                break;
+            case 1: wave_kernel(points, fields, begin, end, simple_wave_sm<SimplePol>); break;
+            case 2: wave_kernel(points, fields, begin, end, simple_wave_sm<SimpleTor>); break;
+            case 3: wave_kernel(points, fields, begin, end, std::ref(pol)); break;
+            case 4: wave_kernel(points, fields, begin, end, std::ref(tor)); break;
+            default:
+                cerr << "Error: Unknown wave_field_model = " << wave_field_model << endl;
+                exit(EXIT_FAILURE);
+        }
+        begin = end;
+    }
+}
+
+} // namespace field_batch
@@ -89,6 +89,45 @@ VectorXd get_wave_cached(const double& t, const double& xgsm, const double& ygsm
 }
 
 
+bool preload_field_model(int wave_field_model) {
+    if (!load_geopack()) {
+        std::cerr << "Failed to load Geopack library." << std::endl;
+        return false;
+    }
+    switch (wave_field_model) {
+        case 0: return true;
+        case 1: simple_pol_wave::load_config(); return true;
+        case 2: simple_tor_wave::load_config(); return true;
+        case 3: return pol_wave::loadWaveConfig();
+        case 4: return tor_wave::loadWaveConfig();
+        default:
+            std::cerr << "Error: Unknown wave_field_model = " << wave_field_model << std::endl;
+            return false;
+    }
+}
+
+bool wave_seed(int wave_field_model, unsigned int& seed) {
+    if (wave_field_model == 3 && pol_wave::loadWaveConfig()) seed = pol_wave::current_seed();
+    else if (wave_field_model == 4 && tor_wave::loadWaveConfig()) seed = tor_wave::current_seed();
+    else return false;
+    return true;
+}
+
+void restore_wave_seed(int wave_field_model, unsigned int seed) {
+    if (wave_field_model == 3) pol_wave::restore_seed(seed);
+    if (wave_field_model == 4) tor_wave::restore_seed(seed);
+}
+
+double wave_shortest_period(int wave_field_model) {
+    switch (wave_field_model) {
+        case 1: return simple_pol_wave::shortest_period();
+        case 2: return simple_tor_wave::shortest_period();
+        case 3: return pol_wave::shortest_period();
+        case 4: return tor_wave::shortest_period();
+        default: return HUGE_VAL;
+    }
+}
+
 //calculate the electric field vector in GSM coordinates
 Vector3d Evec(const double& t, const double& xgsm, const double& ygsm, const double& zgsm) {
     // 使用统一的缓存函数，提取电场部分（前3个分量）
@@ -115,61 +154,98 @@ Vector3d Bvec(const double& t, const double& xgsm, const double& ygsm, const dou
     return B_bg(t, xgsm, ygsm, zgsm) + B_wav(t, xgsm, ygsm, zgsm);
 }
 
+namespace {
+
+// grad |B| and curvature (b·∇)b by central differences: B0 at the point, Bp[j] / Bm[j] at ±dr along axis j
+VectorXd grad_curv_from(const Vector3d& B0, const Vector3d* Bp, const Vector3d* Bm, double dr)
+{
+    VectorXd B_arr(6);
+    Vector3d eb = B0 / B0.norm();
+    Matrix3d grad_eb;
+    for (int j = 0; j < 3; ++j)
+    {
+        double Bp_t = Bp[j].norm();
+        double Bm_t = Bm[j].norm();
+        B_arr[j] = (Bp_t - Bm_t) / (2 * dr);
+        grad_eb.col(j) = (Bp[j] / Bp_t - Bm[j] / Bm_t) / (2 * dr);
+    }
+    for (int i = 0; i < 3; ++i) B_arr[3 + i] = eb.dot(grad_eb.row(i).transpose());
+    return B_arr;
+}
+
+} // namespace
+
 // calculate the gradient and curvature of Bvec
 VectorXd B_grad_curv(const double& t,         //Epoch time in seconds
                            const double& xgsm,      //X position in GSM coordinates in RE
                            const double& ygsm,      //Y position in GSM coordinates in RE
                            const double& zgsm,      //Z position in GSM coordinates in RE
                            const double& dr) {      //Spatial step size in RE for gradient and curvature calculation
-    // calculate the gradient and curvature of the magnetic field vector
-    VectorXd B_arr(6);//output vector for B gradient and curvature
-
-    // calculate magnetic field at the given position
+    // calculate magnetic field at the given position and at the neighboring points
+    const Vector3d r0(xgsm, ygsm, zgsm);
     Vector3d B0 = Bvec(t, xgsm, ygsm, zgsm);
-    double B0_t = B0.norm();
-    Vector3d eb = B0 / B0_t;
-
-    // calculate magnetic field at the neighboring points
-    Vector3d B_x_plus = Bvec(t, xgsm + dr, ygsm, zgsm);
-    double B_x_plus_t = B_x_plus.norm();
-    Vector3d eb_x_plus = B_x_plus / B_x_plus_t;
-
-    Vector3d B_x_minus = Bvec(t, xgsm - dr, ygsm, zgsm);
-    double B_x_minus_t = B_x_minus.norm();
-    Vector3d eb_x_minus = B_x_minus / B_x_minus_t;
-
-    Vector3d B_y_plus = Bvec(t, xgsm, ygsm + dr, zgsm);
-    double B_y_plus_t = B_y_plus.norm();
-    Vector3d eb_y_plus = B_y_plus / B_y_plus_t;
-
-    Vector3d B_y_minus = Bvec(t, xgsm, ygsm - dr, zgsm);
-    double B_y_minus_t = B_y_minus.norm();
-    Vector3d eb_y_minus = B_y_minus / B_y_minus_t;
-
-    Vector3d B_z_plus = Bvec(t, xgsm, ygsm, zgsm + dr);
-    double B_z_plus_t = B_z_plus.norm();
-    Vector3d eb_z_plus = B_z_plus / B_z_plus_t;
-
-    Vector3d B_z_minus = Bvec(t, xgsm, ygsm, zgsm - dr);
-    double B_z_minus_t = B_z_minus.norm();
-    Vector3d eb_z_minus = B_z_minus / B_z_minus_t;
+    Vector3d Bp[3], Bm[3];
+    for (int j = 0; j < 3; ++j)
+    {
+        Vector3d r = r0;
+        r[j] = r0[j] + dr;
+        Bp[j] = Bvec(t, r[0], r[1], r[2]);
+        r[j] = r0[j] - dr;
+        Bm[j] = Bvec(t, r[0], r[1], r[2]);
+    }
+    return grad_curv_from(B0, Bp, Bm, dr);
+}
 
-    // calculate magnetic field gradient
-    B_arr[0] = (B_x_plus_t - B_x_minus_t) / (2 * dr);
-    B_arr[1] = (B_y_plus_t - B_y_minus_t) / (2 * dr);
-    B_arr[2] = (B_z_plus_t - B_z_minus_t) / (2 * dr);
+// B, E and their spatial derivatives on the B_grad_curv stencil plus the 12 diagonal points
+FieldJet field_jet(double t, double xgsm, double ygsm, double zgsm, double dr)
+{
+    FieldJet jet;
+    const Vector3d r0(xgsm, ygsm, zgsm);
+    jet.B = Bvec(t, xgsm, ygsm, zgsm);
+    jet.E = Evec(t, xgsm, ygsm, zgsm);
 
-    // calculate magnetic field curvature
-    Matrix3d grad_eb;
-    grad_eb.col(0) = (eb_x_plus - eb_x_minus) / (2 * dr);
-    grad_eb.col(1) = (eb_y_plus - eb_y_minus) / (2 * dr);
-    grad_eb.col(2) = (eb_z_plus - eb_z_minus) / (2 * dr);
+    // axis points; Evec right after Bvec at the same point reuses the wave field
+    Vector3d Bp[3], Bm[3], Ep[3], Em[3];
+    for (int j = 0; j < 3; ++j)
+    {
+        Vector3d r = r0;
+        r[j] = r0[j] + dr;
+        Bp[j] = Bvec(t, r[0], r[1], r[2]);
+        Ep[j] = Evec(t, r[0], r[1], r[2]);
+        r[j] = r0[j] - dr;
+        Bm[j] = Bvec(t, r[0], r[1], r[2]);
+        Em[j] = Evec(t, r[0], r[1], r[2]);
+    }
+    jet.grad_curv = grad_curv_from(jet.B, Bp, Bm, dr);
 
-    B_arr[3] = eb.dot(grad_eb.row(0).transpose());
-    B_arr[4] = eb.dot(grad_eb.row(1).transpose());
-    B_arr[5] = eb.dot(grad_eb.row(2).transpose());
+    for (int j = 0; j < 3; ++j)
+    {
+        jet.dB.col(j) = (Bp[j] - Bm[j]) / (2 * dr);
+        jet.dE.col(j) = (Ep[j] - Em[j]) / (2 * dr);
+        jet.d2B[j].col(j) = (Bp[j] - 2 * jet.B + Bm[j]) / (dr * dr);
+    }
 
-    return B_arr;
+    // mixed second derivatives
+    for (int j = 0; j < 3; ++j)
+    {
+        for (int k = j + 1; k < 3; ++k)
+        {
+            Vector3d sum = Vector3d::Zero();
+            for (int sj = -1; sj <= 1; sj += 2)
+            {
+                for (int sk = -1; sk <= 1; sk += 2)
+                {
+                    Vector3d r = r0;
+                    r[j] += sj * dr;
+                    r[k] += sk * dr;
+                    sum += (sj * sk) * Bvec(t, r[0], r[1], r[2]);
+                }
+            }
+            jet.d2B[j].col(k) = sum / (4 * dr * dr);
+            jet.d2B[k].col(j) = jet.d2B[j].col(k);
+        }
+    }
+    return jet;
 }
 
 // calculate the total time derivative of the unit magnetic field vector
@@ -200,4 +276,48 @@ double pBpt(const double& t,
     double Bt_plus = B_plus.norm();
 
     return (Bt_plus - Bt_minus) / (2 * dt);
-}
\ No newline at end of file
+}
+void recalc_at(double t)
+{
+    time_t epoch_time = static_cast<time_t>(t);
+    tm* time_info = gmtime(&epoch_time);
+
+    int IYEAR = time_info->tm_year + 1900;
+    int IDAY = time_info->tm_yday + 1;
+    int IHOUR = time_info->tm_hour;
+    int MIN = time_info->tm_min;
+    double ISEC = static_cast<double>(time_info->tm_sec);
+
+    double vgsex = -400.0, vgsey = 0.0, vgsez = 0.0;
+    recalc(&IYEAR, &IDAY, &IHOUR, &MIN, &ISEC, &vgsex, &vgsey, &vgsez);
+}
+
+void recalc_at(double t, time_t& last)
+{
+    time_t epoch_time = static_cast<time_t>(t);
+    if (epoch_time == last) return;
+    last = epoch_time;
+    recalc_at(t);
+}
+
+Vector3d gsm_to_sm(const Vector3d& v)
+{
+    double xsm, ysm, zsm, xgsm = v[0], ygsm = v[1], zgsm = v[2];
+    int J = -1;
+    smgsm(&xsm, &ysm, &zsm, &xgsm, &ygsm, &zgsm, &J);
+    return Vector3d(xsm, ysm, zsm);
+}
+
+Vector3d sm_to_gsm(const Vector3d& v)
+{
+    double xsm = v[0], ysm = v[1], zsm = v[2], xgsm, ygsm, zgsm;
+    int J = 1;
+    smgsm(&xsm, &ysm, &zsm, &xgsm, &ygsm, &zgsm, &J);
+    return Vector3d(xgsm, ygsm, zgsm);
+}
+
+Vector3d to_sm(const VectorXd& Y)
+{
+    recalc_at(Y[0]);
+    return gsm_to_sm(Vector3d(Y[1], Y[2], Y[3]));
+}
@@ -17,6 +17,44 @@
 
 static LibHandle lib_geopack = nullptr;
 
+extern "C"
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+int load_geopack()
+{
+    if (!lib_geopack) lib_geopack = LOAD_LIB(GEOPACK_LIB_PATH);
+    return lib_geopack ? 1 : 0;
+}
+
+// common blocks /GEOPACK1/ and /GEOPACK2/ (updated by recalc)
+static double* geopack_common(const char* name)
+{
+    if (!lib_geopack) lib_geopack = LOAD_LIB(GEOPACK_LIB_PATH);
+    if (!lib_geopack) return nullptr;
+    return (double*)GET_PROC(lib_geopack, name);
+}
+
+extern "C"
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+double* geopack1_common()
+{
+    static double* block = geopack_common("geopack1_");
+    return block;
+}
+
+extern "C"
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+double* geopack2_common()
+{
+    static double* block = geopack_common("geopack2_");
+    return block;
+}
+
 // Recalc
 extern "C"
 #ifdef _WIN32
@@ -0,0 +1,330 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <algorithm>
+#include <Eigen/Dense>
+
+#include "importance_splitting.h"
+#include "field_calculator.h"
+#include "particle_params.h"
+#include "singular_particle.h"
+#include "run_options.h"
+#include "result_cache.h"
+#include "path_utils.h"
+
+using namespace std;
+using namespace Eigen;
+
+extern double E0, mu;
+
+namespace splitting {
+
+namespace {
+
+// 主进程登记的子粒子
+map<string, Member> registered;
+map<string, string> parent_of;
+
+struct Row {
+    string name, parent;
+    int generation = 0, level = 0, children = 0;
+    double t_start = 0.0, t_end = 0.0, weight_start = 1.0, weight_end = 1.0;
+    string fate = "missing";
+};
+vector<Row> table;
+
+// 垂直动量的平方 (p_perp)^2 = 2 E0 |B| mu / c^2
+double p_perp2(const VectorXd& Y)
+{
+    double B = Bvec(Y[0], Y[1], Y[2], Y[3]).norm();
+    return 2.0 * E0 * B * mu / (c * c);
+}
+
+} // namespace
+
+bool parse_spec(const string& text, Spec& spec, string& error)
+{
+    spec = Spec();
+    size_t op = text.find_first_of("<>");
+    if (op == string::npos) {
+        error = "expected FUNC<levels or FUNC>levels";
+        return false;
+    }
+    string func = text.substr(0, op);
+    if (func == "L") spec.function = L_SHELL;
+    else if (func == "pa_eq") spec.function = PA_EQ;
+    else {
+        error = "unknown function " + func + " (expected L or pa_eq)";
+        return false;
+    }
+    spec.below = text[op] == '<';
+
+    vector<string> parts;
+    stringstream rest(text.substr(op + 1));
+    string part;
+    while (getline(rest, part, ':')) parts.push_back(part);
+    if (parts.empty() || parts.size() > 3) {
+        error = "expected levels[:N[:J]]";
+        return false;
+    }
+    stringstream items(parts[0]);
+    string item;
+    while (getline(items, item, ',')) {
+        char* end = nullptr;
+        double value = strtod(item.c_str(), &end);
+        if (item.empty() || *end != '\0') {
+            error = "invalid level " + item;
+            return false;
+        }
+        if (!spec.levels.empty() && (spec.below ? value >= spec.levels.back() : value <= spec.levels.back())) {
+            error = string("levels must be ") + (spec.below ? "decreasing" : "increasing");
+            return false;
+        }
+        spec.levels.push_back(value);
+    }
+    if (spec.levels.empty()) {
+        error = "no levels";
+        return false;
+    }
+    if (parts.size() > 1) {
+        spec.factor = atoi(parts[1].c_str());
+        if (spec.factor < 2 || spec.factor > MAX_FACTOR) {
+            error = "split factor must be 2.." + to_string(MAX_FACTOR);
+            return false;
+        }
+    }
+    if (parts.size() > 2) {
+        spec.jitter = atof(parts[2].c_str());
+        if (!(spec.jitter >= 0.0)) {
+            error = "invalid pitch-angle jitter " + parts[2];
+            return false;
+        }
+    }
+    return true;
+}
+
+double importance(const Spec& spec, const VectorXd& Y)
+{
+    Vector3d sm = to_sm(Y);
+    double r2 = sm.squaredNorm();
+    double cos2 = (sm[0] * sm[0] + sm[1] * sm[1]) / r2;
+    if (spec.function == L_SHELL) return sqrt(r2) / cos2;
+
+    // 偶极场中 B_eq / B = cos^6 λ / sqrt(1 + 3 sin^2 λ)
+    double s = p_perp2(Y);
+    double sin2 = s / (Y[4] * Y[4] + s);
+    double sin2_eq = min(1.0, sin2 * pow(cos2, 3) / sqrt(1.0 + 3.0 * (1.0 - cos2)));
+    return asin(sqrt(sin2_eq)) * 180.0 / M_PI;
+}
+
+int level(const Spec& spec, const VectorXd& Y)
+{
+    double value = importance(spec, Y);
+    int k = 0;
+    for (double l : spec.levels) {
+        if (spec.below ? value < l : value > l) ++k;
+    }
+    return k;
+}
+
+Member member(const string& para_file)
+{
+    auto found = registered.find(para_file);
+    if (found != registered.end()) return found->second;
+    Member m;
+    if (!run_options.split_member.empty()) decode_member(run_options.split_member, m);
+    return m;
+}
+
+string child_argument(const string& para_file)
+{
+    auto found = registered.find(para_file);
+    if (found == registered.end()) return "";
+    const Member& m = found->second;
+    char buf[160];
+    snprintf(buf, sizeof(buf), "--split-member=%.17g,%d,%llu,%d,%u", m.weight, m.level,
+             static_cast<unsigned long long>(m.seed), m.has_wave_seed, m.wave_seed);
+    return buf;
+}
+
+bool decode_member(const string& text, Member& m)
+{
+    unsigned long long seed;
+    char extra;
+    if (sscanf(text.c_str(), "%lf,%d,%llu,%d,%u%c", &m.weight, &m.level, &seed, &m.has_wave_seed, &m.wave_seed,
+               &extra) != 5 || !(m.weight > 0.0) || m.level < -1) {
+        return false;
+    }
+    m.seed = seed;
+    return true;
+}
+
+Tracker::Tracker(const Spec& spec, const Member& member, const string& para_file, const VectorXd& Y,
+                 bool has_wave_seed, unsigned int wave_seed)
+    : spec_(spec), weight_(member.weight), initial_weight_(member.weight)
+{
+    level_ = member.level >= 0 ? member.level : level(spec_, Y);
+    string name = PathUtils::getBasename(PathUtils::getFilename(para_file));
+    uint64_t seed = member.seed ? member.seed : result_cache::hash_bytes(name.data(), name.size());
+    rng_.seed(seed);
+    wave_seed_ = has_wave_seed ? static_cast<long long>(wave_seed) : -1;
+    record(rows_, "start", Y, seed);
+}
+
+void Tracker::record(ostream& out, const char* event, const VectorXd& Y, uint64_t seed) const
+{
+    double p = sqrt(Y[4] * Y[4] + p_perp2(Y));
+    double Ek = sqrt(p * p * c * c + E0 * E0) - E0;
+    double pa = acos(max(-1.0, min(1.0, Y[4] / p))) * 180.0 / M_PI;
+    out << setprecision(17) << event << '\t' << Y[0] << '\t' << Y[1] << '\t' << Y[2] << '\t' << Y[3] << '\t' << Y[4]
+        << '\t' << Ek << '\t' << pa << '\t' << level_ << '\t' << weight_ << '\t' << seed << '\t' << wave_seed_ << '\n';
+}
+
+bool Tracker::check(const VectorXd& Y, ostream& log)
+{
+    int k = level(spec_, Y);
+    while (k > level_) {
+        ++level_;
+        weight_ /= spec_.factor;
+        for (int j = 1; j < spec_.factor; ++j) {
+            uint64_t seed = rng_();
+            record(rows_, "child", Y, seed ? seed : 1);
+            ++children_;
+        }
+        log << "SPLIT at t = " << Y[0] << " s into level " << level_ << ": " << spec_.factor - 1
+            << " children, weight " << weight_ << endl;
+    }
+    while (k <= level_ - 2) {
+        if (uniform_real_distribution<double>(0.0, 1.0)(rng_) >= 1.0 / spec_.factor) {
+            log << "KILLED by Russian roulette at t = " << Y[0] << " s (level " << k << ", weight " << weight_ << ")"
+                << endl;
+            killed_ = true;
+            weight_ = 0.0;
+            record(rows_, "killed", Y, 0);
+            return false;
+        }
+        --level_;
+        weight_ *= spec_.factor;
+        ++survived_;
+        record(rows_, "survived", Y, 0);
+        log << "SURVIVED Russian roulette at t = " << Y[0] << " s: level " << level_ << ", weight " << weight_ << endl;
+    }
+    return true;
+}
+
+bool Tracker::write(const string& path, const VectorXd& Y) const
+{
+    ofstream out(path, ios::out | ios::trunc);
+    if (!out) return false;
+    out << "# event\tt\tx\ty\tz\tp_para\tEk\tpa\tlevel\tweight\tseed\twave_seed\n" << rows_.str();
+    if (!killed_) record(out, "end", Y, 0);
+    return static_cast<bool>(out);
+}
+
+vector<string> spawn(vector<BatchJob>& jobs, int generation, ostream& log)
+{
+    string outputDir = PathUtils::joinPath(exeDir, "output");
+    vector<string> children;
+    int killed = 0;
+    Spec spec;
+    string error;
+    parse_spec(run_options.split, spec, error);
+    for (auto& job : jobs) {
+        Row row;
+        row.name = job.name;
+        row.parent = parent_of.count(job.para_file) ? parent_of[job.para_file] : "";
+        row.generation = generation;
+        Member m = member(job.para_file);
+        row.weight_start = row.weight_end = job.weight = m.weight;
+
+        if (job.status != 0) {
+            // a failed particle has no children (and no valid split record)
+            log << "  " << job.name << ": failed (status " << job.status << "), not split" << endl;
+            row.fate = "failed";
+            table.push_back(row);
+            continue;
+        }
+        string path = PathUtils::joinPath(outputDir, job.name) + ".split";
+        ifstream in(path);
+        ParticleParams params;
+        if (!in || !read_particle_params(job.para_file, params)) {
+            log << "  " << job.name << ": no split record " << path << endl;
+            table.push_back(row);
+            continue;
+        }
+        double t_end = params.t_ini + params.t_interval * (params.dt < 0 ? -1.0 : 1.0);
+        string dir = PathUtils::getParentDirectory(job.para_file);
+
+        string line;
+        while (getline(in, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            istringstream iss(line);
+            string event;
+            double t, x, y, z, p_para, Ek, pa, weight;
+            int lvl;
+            unsigned long long seed;
+            long long wave_seed;
+            if (!(iss >> event >> t >> x >> y >> z >> p_para >> Ek >> pa >> lvl >> weight >> seed >> wave_seed)) continue;
+            if (event == "start") {
+                row.t_start = t;
+                row.level = lvl;
+            } else if (event == "child") {
+                // 子粒子：从该处的状态出发，投掷角随机扰动
+                mt19937_64 rng(seed ^ 0x9e3779b97f4a7c15ULL);
+                double child_pa = pa + uniform_real_distribution<double>(-spec.jitter, spec.jitter)(rng);
+                if (child_pa < 0.0) child_pa = -child_pa;
+                if (child_pa > 180.0) child_pa = 360.0 - child_pa;
+
+                ParticleParams cp = params;
+                cp.t_ini = t;
+                cp.t_interval = fabs(t_end - t);
+                cp.xgsm = x;
+                cp.ygsm = y;
+                cp.zgsm = z;
+                cp.Ek = Ek;
+                cp.pa = child_pa;
+                string child = PathUtils::joinPath(dir, job.name + "_s" + to_string(++row.children) + ".para");
+                register_particle_params(child, cp);
+                Member cm;
+                cm.weight = weight;
+                cm.level = lvl;
+                cm.seed = seed;
+                cm.has_wave_seed = wave_seed >= 0 ? 1 : 0;
+                cm.wave_seed = wave_seed >= 0 ? static_cast<unsigned int>(wave_seed) : 0;
+                registered[child] = cm;
+                parent_of[child] = job.name;
+                children.push_back(child);
+            } else if (event == "end" || event == "killed") {
+                row.t_end = t;
+                row.weight_end = job.weight = weight;
+                row.fate = event;
+                if (event == "killed") ++killed;
+            }
+        }
+        table.push_back(row);
+    }
+    log << "Importance splitting (--split=" << run_options.split << "), generation " << generation << ": "
+        << jobs.size() << " particles, " << children.size() << " children, " << killed << " killed by roulette" << endl;
+    return children;
+}
+
+bool write_table(const string& path)
+{
+    ofstream out(path, ios::out | ios::trunc);
+    if (!out) return false;
+    out << "# name\tparent\tgeneration\tt_start\tt_end\tlevel\tweight_start\tweight_end\tchildren\tfate\n";
+    out << setprecision(17);
+    for (const auto& row : table) {
+        out << row.name << '\t' << (row.parent.empty() ? "-" : row.parent) << '\t' << row.generation << '\t'
+            << row.t_start << '\t' << row.t_end << '\t' << row.level << '\t' << row.weight_start << '\t'
+            << row.weight_end << '\t' << row.children << '\t' << row.fate << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+} // namespace splitting
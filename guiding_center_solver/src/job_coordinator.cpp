@@ -0,0 +1,439 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <deque>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "job_coordinator.h"
+#include "cpu_affinity.h"
+#include "path_utils.h"
+#include "particle_params.h"
+
+using namespace std;
+
+namespace job_queue {
+
+bool valid_address(const string& address) {
+    if (address.rfind("unix:", 0) == 0) return address.size() > 5;
+    if (address.rfind("tcp:", 0) != 0) return false;
+    size_t colon = address.rfind(':');
+    if (colon <= 4) return false;
+    int port = atoi(address.c_str() + colon + 1);
+    return port > 0 && port < 65536 && address.find_first_not_of("0123456789", colon + 1) == string::npos;
+}
+
+#ifdef _WIN32
+
+void serve(vector<BatchJob>&, const string& address, double, int, const vector<string>&, ostream&) {
+    cerr << "The job coordinator (" << address << ") is only supported on POSIX systems" << endl;
+    exit(1);
+}
+
+int work(const string& address, const string&, const string&, int, const vector<int>&) {
+    cerr << "Workers (" << address << ") are only supported on POSIX systems" << endl;
+    exit(1);
+}
+
+#else
+
+namespace {
+
+double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+vector<string> split_fields(const string& line) {
+    vector<string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab == string::npos ? string::npos : tab - start));
+        if (tab == string::npos) break;
+        start = tab + 1;
+    }
+    return fields;
+}
+
+// 工作进程中的相对路径：input/<name>.para，清单中的粒子为 input/<清单>/<name>.para
+string relative_particle(const string& para_file) {
+    string parent = PathUtils::getParentDirectory(para_file);
+    string filename = PathUtils::getFilename(para_file);
+    if (is_particle_source(parent)) {
+        return PathUtils::joinPath({"input", PathUtils::getFilename(parent), filename});
+    }
+    return PathUtils::joinPath("input", filename);
+}
+
+bool send_line(int fd, const string& line) {
+    string data = line + "\n";
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// 阻塞读取一行（不含换行），连接关闭时返回 false
+bool read_line(int fd, string& buffer, string& line) {
+    char chunk[4096];
+    size_t eol;
+    while ((eol = buffer.find('\n')) == string::npos) {
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+    line = buffer.substr(0, eol);
+    buffer.erase(0, eol + 1);
+    return true;
+}
+
+// 打开监听 (listen = true) 或连接的套接字，失败返回 -1
+int open_socket(const string& address, bool listen_mode) {
+    if (address.rfind("unix:", 0) == 0) {
+        string path = address.substr(5);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            cerr << "UNIX socket path too long: " << path << endl;
+            return -1;
+        }
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (listen_mode) {
+            unlink(path.c_str());
+            if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 && listen(fd, 64) == 0) return fd;
+        } else if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+            return fd;
+        }
+        close(fd);
+        return -1;
+    }
+
+    size_t colon = address.rfind(':');
+    string host = address.substr(4, colon - 4);
+    string port = address.substr(colon + 1);
+    addrinfo hints, *res = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (listen_mode) hints.ai_flags = AI_PASSIVE;
+    const char* node = (host.empty() || host == "*") ? nullptr : host.c_str();
+    if (getaddrinfo(node, port.c_str(), &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (listen_mode) {
+            int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 64) == 0) break;
+        } else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+enum ItemState { ITEM_PENDING, ITEM_LEASED, ITEM_FINISHED };
+
+struct Item {
+    ItemState state = ITEM_PENDING;
+    int attempts = 0;
+    int worker = -1;                            // 持有租约的连接编号
+    chrono::steady_clock::time_point deadline;
+};
+
+struct Worker {
+    int fd;
+    int id;
+    string buffer;
+};
+
+} // namespace
+
+void serve(vector<BatchJob>& jobs, const string& address, double lease, int retries,
+           const vector<string>& forwarded, ostream& log) {
+    signal(SIGPIPE, SIG_IGN);
+    int listen_fd = open_socket(address, true);
+    if (listen_fd < 0) {
+        cerr << "Failed to listen on " << address << ": " << strerror(errno) << endl;
+        exit(1);
+    }
+    log << "Coordinator listening on " << address << ": " << jobs.size() << " particles, lease " << lease
+        << " s, at most " << retries << " retries" << endl;
+    cout << "Coordinator listening on " << address << " (" << jobs.size() << " particles) ..." << endl;
+
+    // jobs 已按估计耗时从大到小排序；重新排队的任务放在队首
+    vector<Item> items(jobs.size());
+    deque<size_t> queue;
+    for (size_t i = 0; i < jobs.size(); ++i) queue.push_back(i);
+    size_t finished = 0;
+    int redispatched = 0, next_worker = 0;
+    vector<Worker> workers;
+    auto batch_start = chrono::steady_clock::now();
+
+    auto requeue = [&](size_t i, const string& reason) {
+        Item& item = items[i];
+        item.worker = -1;
+        if (item.attempts > retries) {
+            item.state = ITEM_FINISHED;
+            ++finished;
+            if (jobs[i].status == 0) jobs[i].status = -1;
+            log << "Giving up " << jobs[i].name << " after " << item.attempts << " attempts (" << reason << ")" << endl;
+            cerr << "Giving up " << jobs[i].name << " (" << reason << ")" << endl;
+        } else {
+            item.state = ITEM_PENDING;
+            queue.push_front(i);
+            ++redispatched;
+            log << "Re-queueing " << jobs[i].name << " (" << reason << ")" << endl;
+        }
+    };
+
+    auto handle = [&](Worker& w, const string& line) {
+        vector<string> f = split_fields(line);
+        auto now = chrono::steady_clock::now();
+        size_t i = (f.size() > 1) ? static_cast<size_t>(atol(f[1].c_str())) : jobs.size();
+        if (f[0] == "GET") {
+            if (!queue.empty()) {
+                i = queue.front();
+                queue.pop_front();
+                Item& item = items[i];
+                item.state = ITEM_LEASED;
+                item.worker = w.id;
+                item.deadline = now + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(lease));
+                ++item.attempts;
+                string msg = "JOB\t" + to_string(i) + "\t" + to_string(lease) + "\t" + relative_particle(jobs[i].para_file);
+                for (const auto& opt : forwarded) msg += "\t" + opt;
+                string params = particle_params_argument(jobs[i].para_file);
+                if (!params.empty()) msg += "\t" + params;
+                send_line(w.fd, msg);
+                log << "Dispatching " << jobs[i].name << " to worker " << w.id << " (attempt " << item.attempts
+                    << ", estimated " << jobs[i].cost << " s)" << endl;
+            } else {
+                send_line(w.fd, finished < jobs.size() ? "WAIT\t1" : "DONE");
+            }
+        } else if (f[0] == "RENEW" && i < jobs.size()) {
+            Item& item = items[i];
+            if (item.state == ITEM_LEASED && item.worker == w.id) {
+                item.deadline = now + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(lease));
+                send_line(w.fd, "OK");
+            } else {
+                send_line(w.fd, "CANCEL");
+            }
+        } else if (f[0] == "RESULT" && i < jobs.size() && f.size() >= 4) {
+            Item& item = items[i];
+            int status = atoi(f[2].c_str());
+            double seconds = atof(f[3].c_str());
+            if (item.state != ITEM_FINISHED && status == 0) {
+                // 包括租约已被收回、但原工作进程最终完成的情况
+                if (item.state == ITEM_PENDING) queue.erase(find(queue.begin(), queue.end(), i));
+                item.state = ITEM_FINISHED;
+                item.worker = -1;
+                ++finished;
+                jobs[i].status = 0;
+                jobs[i].elapsed = seconds;
+                log << "Process " << finished << " of " << jobs.size() << " completed: " << jobs[i].name
+                    << " (worker " << w.id << ", " << seconds << " s, estimated " << jobs[i].cost << " s)." << endl;
+            } else if (item.state == ITEM_LEASED && item.worker == w.id) {
+                jobs[i].status = status;
+                jobs[i].elapsed = seconds;
+                requeue(i, "worker " + to_string(w.id) + " reported status " + f[2]);
+            }
+            send_line(w.fd, "OK");
+        } else {
+            log << "Unknown request from worker " << w.id << ": " << line << endl;
+        }
+    };
+
+    char chunk[4096];
+    while (finished < jobs.size()) {
+        vector<pollfd> fds;
+        fds.push_back({listen_fd, POLLIN, 0});
+        for (const auto& w : workers) fds.push_back({w.fd, POLLIN, 0});
+        poll(fds.data(), fds.size(), 200);
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd >= 0) {
+                workers.push_back({fd, next_worker++, ""});
+                log << "Worker " << workers.back().id << " connected" << endl;
+            }
+        }
+        for (size_t k = 1; k < fds.size(); ++k) {
+            if (!(fds[k].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            Worker& w = workers[k - 1];
+            ssize_t n = ::read(w.fd, chunk, sizeof(chunk));
+            if (n > 0) {
+                w.buffer.append(chunk, n);
+                size_t eol;
+                while ((eol = w.buffer.find('\n')) != string::npos) {
+                    string line = w.buffer.substr(0, eol);
+                    w.buffer.erase(0, eol + 1);
+                    if (!line.empty()) handle(w, line);
+                }
+            } else if (n == 0 || errno != EINTR) {
+                // 工作进程退出：它持有的任务立即重新排队，不等租约到期
+                log << "Worker " << w.id << " disconnected" << endl;
+                for (size_t i = 0; i < items.size(); ++i) {
+                    if (items[i].state == ITEM_LEASED && items[i].worker == w.id) requeue(i, "worker " + to_string(w.id) + " disconnected");
+                }
+                close(w.fd);
+                w.fd = -1;
+            }
+        }
+        workers.erase(remove_if(workers.begin(), workers.end(), [](const Worker& w) { return w.fd < 0; }), workers.end());
+
+        auto now = chrono::steady_clock::now();
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (items[i].state == ITEM_LEASED && now > items[i].deadline) {
+                requeue(i, "lease of worker " + to_string(items[i].worker) + " expired");
+            }
+        }
+    }
+
+    // 关闭连接，工作进程读到 EOF 即退出
+    for (const auto& w : workers) close(w.fd);
+    close(listen_fd);
+    if (address.rfind("unix:", 0) == 0) unlink(address.substr(5).c_str());
+
+    double wall = seconds_since(batch_start), total = 0.0;
+    int failed = 0;
+    for (const auto& job : jobs) {
+        total += job.elapsed;
+        if (job.status != 0) ++failed;
+    }
+    log << "Coordinator finished: wall " << wall << " s, sum of particle times " << total << " s, "
+        << next_worker << " workers, " << redispatched << " re-dispatched, " << failed << " failed" << endl;
+}
+
+namespace {
+
+// 一个请求循环：取任务、运行子进程并续租、报告结果
+int work_loop(const string& address, const string& exe, const string& workDir) {
+    int fd = -1;
+    // 协调进程可能稍后才启动
+    for (int attempt = 0; attempt < 300 && fd < 0; ++attempt) {
+        fd = open_socket(address, false);
+        if (fd < 0) this_thread::sleep_for(chrono::milliseconds(100));
+    }
+    if (fd < 0) {
+        cerr << "Worker " << getpid() << ": failed to connect to " << address << endl;
+        return 0;
+    }
+
+    string buffer, line;
+    int done = 0;
+    while (send_line(fd, "GET") && read_line(fd, buffer, line)) {
+        vector<string> f = split_fields(line);
+        if (f[0] == "DONE") break;
+        if (f[0] == "WAIT") {
+            this_thread::sleep_for(chrono::duration<double>(f.size() > 1 ? atof(f[1].c_str()) : 1.0));
+            continue;
+        }
+        if (f[0] != "JOB" || f.size() < 4) {
+            cerr << "Worker " << getpid() << ": unexpected reply: " << line << endl;
+            break;
+        }
+        string id = f[1];
+        double lease = atof(f[2].c_str());
+        string para_file = PathUtils::joinPath(workDir, f[3]);
+        vector<string> args = {exe, para_file};
+        args.insert(args.end(), f.begin() + 4, f.end());
+
+        auto start = chrono::steady_clock::now();
+        pid_t pid = fork();
+        if (pid == 0) {
+#ifdef __linux__
+            // 工作进程被杀时粒子进程随之结束，不与重新分派的副本同时写输出
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+            vector<char*> child_argv;
+            for (auto& a : args) child_argv.push_back(const_cast<char*>(a.c_str()));
+            child_argv.push_back(nullptr);
+            execvp(exe.c_str(), child_argv.data());
+            _exit(127);   // exec 失败：不运行父进程的 atexit 和缓冲区刷新
+        }
+        int status = (pid < 0) ? -1 : 0;
+        bool cancelled = false, lost = false;
+        auto last_renew = start;
+        while (pid > 0) {
+            if (waitpid(pid, &status, WNOHANG) == pid) break;
+            this_thread::sleep_for(chrono::milliseconds(10));
+            if (seconds_since(last_renew) < lease / 3.0) continue;
+            last_renew = chrono::steady_clock::now();
+            if (!send_line(fd, "RENEW\t" + id) || !read_line(fd, buffer, line)) lost = true;
+            else if (line == "CANCEL") cancelled = true;
+            if (lost || cancelled) {
+                kill(pid, SIGTERM);
+                waitpid(pid, &status, 0);
+                break;
+            }
+        }
+        if (lost) break;
+        if (cancelled) {
+            cout << "Worker " << getpid() << ": " << f[3] << " was re-dispatched, cancelled" << endl;
+            continue;
+        }
+        double seconds = seconds_since(start);
+        cout << "Worker " << getpid() << ": " << f[3] << " finished (status " << status << ", " << seconds << " s)" << endl;
+        ostringstream result;
+        result << "RESULT\t" << id << "\t" << status << "\t" << seconds;
+        if (!send_line(fd, result.str()) || !read_line(fd, buffer, line)) break;
+        if (status == 0) ++done;
+    }
+    close(fd);
+    return done;
+}
+
+} // namespace
+
+int work(const string& address, const string& exe, const string& workDir, int slots, const vector<int>& slot_cpus) {
+    signal(SIGPIPE, SIG_IGN);
+    vector<pid_t> loops;
+    for (int s = 1; s < slots; ++s) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            if (static_cast<int>(slot_cpus.size()) > s) affinity::pin_current_process({slot_cpus[s]});
+            exit(min(work_loop(address, exe, workDir), 255));
+        }
+        if (pid > 0) loops.push_back(pid);
+    }
+    if (!slot_cpus.empty()) affinity::pin_current_process({slot_cpus[0]});
+    int done = work_loop(address, exe, workDir);
+    for (pid_t pid : loops) {
+        int status;
+        if (waitpid(pid, &status, 0) == pid && WIFEXITED(status)) done += WEXITSTATUS(status);
+    }
+    return done;
+}
+
+#endif
+
+} // namespace job_queue
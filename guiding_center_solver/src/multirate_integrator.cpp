@@ -0,0 +1,200 @@
+#include <cmath>
+#include <algorithm>
+#include <Eigen/Dense>
+
+#include "multirate_integrator.h"
+#include "field_calculator.h"
+#include "singular_particle.h"
+#include "trajectory_io.h"
+
+using namespace std;
+using namespace Eigen;
+using traj_io::put_value;
+using traj_io::get_value;
+
+extern double E0, mu, q;
+extern double dt;
+extern double r_step;
+
+namespace multirate {
+
+namespace {
+
+typedef Matrix<double, 12, 1> Vector12d;
+
+} // namespace
+
+Integrator::Integrator(double tol) : tol_(tol) {}
+
+// 完整计算慢变量（与 dydt 相同的场和导数）
+Node Integrator::evaluate(const VectorXd& Y)
+{
+    ++full_evaluations_;
+    double t = Y[0], x = Y[1], y = Y[2], z = Y[3], p_para = Y[4];
+
+    Vector3d B = Bvec(t, x, y, z);
+    Vector3d E = Evec(t, x, y, z);
+    VectorXd dB = B_grad_curv(t, x, y, z, r_step);
+    Vector3d grad_B(dB[0], dB[1], dB[2]);
+    Vector3d curv_B(dB[3], dB[4], dB[5]);
+    DriftTerms d = drift_terms(E0, mu, q, p_para, B, E, grad_B, curv_B);
+
+    Node s;
+    s.t = t;
+    s.p = E0 / c * sqrt(d.gamm * d.gamm - 1.0);
+    s.S << E, grad_B, curv_B, deb_dt(t, x, y, z, d.v_total, r_step);
+    s.B = B;
+    s.dB_ds = grad_B.dot(d.unit_B);
+    return s;
+}
+
+// 由最近的宏步端点外推慢变量（Lagrange 插值多项式）
+Vector12d Integrator::extrapolate(double t) const
+{
+    Vector12d S = Vector12d::Zero();
+    for (size_t i = 0; i < history_.size(); ++i) {
+        double w = 1.0;
+        for (size_t j = 0; j < history_.size(); ++j) {
+            if (j != i) w *= (t - history_[j].t) / (history_[i].t - history_[j].t);
+        }
+        S += w * history_[i].S;
+    }
+    return S;
+}
+
+// 给定慢变量的导数：计算该点的 B 和沿磁力线的 b·grad B（镜面力，平行运动的快变部分）
+VectorXd Integrator::rhs(const VectorXd& Y, const Vector12d& S)
+{
+    ++field_evaluations_;
+    double t = Y[0], x = Y[1], y = Y[2], z = Y[3];
+
+    Vector3d B = Bvec(t, x, y, z);
+    Vector3d unit_B = B / B.norm();
+    double B_plus = Bvec(t, x + r_step * unit_B[0], y + r_step * unit_B[1], z + r_step * unit_B[2]).norm();
+    double B_minus = Bvec(t, x - r_step * unit_B[0], y - r_step * unit_B[1], z - r_step * unit_B[2]).norm();
+    return rhs(Y, B, (B_plus - B_minus) / (2 * r_step), S, true);
+}
+
+// 其余各项与 dydt 相同（drift_terms），镜面力用 dB_ds
+VectorXd Integrator::rhs(const VectorXd& Y, const Vector3d& B, double dB_ds, const Vector12d& S, bool extrapolated) const
+{
+    DriftTerms d = drift_terms(E0, mu, q, Y[4], B, S.segment<3>(0), S.segment<3>(3), S.segment<3>(6));
+    Vector3d deb = S.segment<3>(9);
+    // deb_dt 与 b 垂直，外推误差的平行分量乘 v_para 会进入 dp_para/dt，去掉（端点的完整计算值原样使用）
+    if (extrapolated) deb -= deb.dot(d.unit_B) * d.unit_B;
+
+    double dp_dt_1 = -mu / d.gamm * dB_ds;
+    double dp_dt_3 = d.dp_coef * d.v_total.dot(deb);
+
+    VectorXd arr_out(5);
+    arr_out << 1.0, d.v_total[0], d.v_total[1], d.v_total[2], dp_dt_1 + d.dp_dt_2 + dp_dt_3;
+    return arr_out;
+}
+
+VectorXd Integrator::exact_rhs(const VectorXd& Y)
+{
+    ++full_evaluations_;
+    return dydt(Y);
+}
+
+// 从宏步起点 Y（history_ 的最后一个端点）算一个宏步，结果放入 queue_
+void Integrator::advance(const VectorXd& Y, int max_steps)
+{
+    const Node start = history_.back();
+    for (;;) {
+        int M = min(ratio_, max(max_steps, 1));
+        bool exact = (M == 1);
+        deque<SubStep> block;
+        VectorXd y = Y;
+        for (int j = 0; j < M; ++j) {
+            double t = y[0];
+            VectorXd k1 = (j == 0) ? rhs(y, start.B, start.dB_ds, start.S, false) : rhs(y, extrapolate(t));
+            VectorXd k2 = exact ? exact_rhs(y + 0.5 * dt * k1) : rhs(y + 0.5 * dt * k1, extrapolate(t + 0.5 * dt));
+            VectorXd k3 = exact ? exact_rhs(y + 0.5 * dt * k2) : rhs(y + 0.5 * dt * k2, extrapolate(t + 0.5 * dt));
+            VectorXd k4 = exact ? exact_rhs(y + dt * k3) : rhs(y + dt * k3, extrapolate(t + dt));
+            y += (dt / 6.0) * (k1 + 2 * k2 + 2 * k3 + k4);
+            block.push_back(SubStep{y, k1});
+        }
+        Node end = evaluate(y);
+
+        // 外推误差在本宏步内造成的偏差（M = 1 时为假如外推的偏差，只用于决定是否加大 M）
+        VectorXd d = rhs(y, end.B, end.dB_ds, extrapolate(end.t), true) - rhs(y, end.B, end.dB_ds, end.S, true);
+        double r = sqrt(y[1] * y[1] + y[2] * y[2] + y[3] * y[3]);
+        double err = M * fabs(dt) * max(d.segment<3>(1).norm() / r, fabs(d[4]) / end.p);
+        if (!exact && err > tol_) {
+            ratio_ = max(1, M / 2);
+            ++rejected_;
+            continue;
+        }
+
+        ++macro_steps_;
+        history_.push_back(end);
+        if (history_.size() > 3) history_.pop_front();
+        if (history_.size() == 3 && err < tol_ / 16.0 && M == ratio_) ratio_ = min(2 * ratio_, MAX_RATIO);
+        queue_ = block;
+        return;
+    }
+}
+
+void Integrator::step(VectorXd& Y, VectorXd& k1, int max_steps)
+{
+    if (queue_.empty()) {
+        if (history_.empty()) history_.push_back(evaluate(Y));
+        advance(Y, max_steps);
+    }
+    Y = queue_.front().Y;
+    k1 = queue_.front().k1;
+    queue_.pop_front();
+    ++steps_;
+}
+
+string Integrator::checkpoint() const
+{
+    string state;
+    put_value(state, static_cast<int32_t>(ratio_));
+    put_value(state, static_cast<int32_t>(history_.size()));
+    for (const Node& s : history_) {
+        put_value(state, s.t);
+        put_value(state, s.p);
+        for (int i = 0; i < s.S.size(); ++i) put_value(state, s.S[i]);
+        for (int i = 0; i < s.B.size(); ++i) put_value(state, s.B[i]);
+        put_value(state, s.dB_ds);
+    }
+    const long long counters[5] = {steps_, macro_steps_, rejected_, full_evaluations_, field_evaluations_};
+    put_value(state, counters);
+    return state;
+}
+
+bool Integrator::restore(const string& state)
+{
+    const char* p = state.data();
+    const char* end = p + state.size();
+    int32_t ratio, n;
+    if (!get_value(p, end, ratio) || !get_value(p, end, n) || ratio < 1 || ratio > MAX_RATIO || n < 0 || n > 3) {
+        return false;
+    }
+    deque<Node> history(n);
+    for (Node& s : history) {
+        if (!get_value(p, end, s.t) || !get_value(p, end, s.p)) return false;
+        for (int i = 0; i < s.S.size(); ++i) {
+            if (!get_value(p, end, s.S[i])) return false;
+        }
+        for (int i = 0; i < s.B.size(); ++i) {
+            if (!get_value(p, end, s.B[i])) return false;
+        }
+        if (!get_value(p, end, s.dB_ds)) return false;
+    }
+    long long counters[5];
+    if (!get_value(p, end, counters) || p != end) return false;
+    ratio_ = ratio;
+    history_ = history;
+    queue_.clear();
+    steps_ = counters[0];
+    macro_steps_ = counters[1];
+    rejected_ = counters[2];
+    full_evaluations_ = counters[3];
+    field_evaluations_ = counters[4];
+    return true;
+}
+
+} // namespace multirate
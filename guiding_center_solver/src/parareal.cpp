@@ -0,0 +1,294 @@
+#include <cmath>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <Eigen/Dense>
+#ifndef _WIN32
+    #include <sys/types.h>
+    #include <sys/wait.h>
+    #include <poll.h>
+    #include <unistd.h>
+#endif
+
+#include "parareal.h"
+#include "singular_particle.h"
+#include "progress_board.h"
+
+using namespace std;
+using namespace Eigen;
+
+extern double dt;
+
+namespace parareal {
+
+namespace {
+
+typedef Matrix<double, 5, 1> State;
+
+// 一段细积分的结果
+struct Fine {
+    State start, end;
+    int32_t terminated = 0;         // 进入大气层的步数，0 为积分到段末
+    vector<double> records;         // 段内的输出记录，每个 5 个 double
+    bool valid = false;
+};
+
+VectorXd rk4(const VectorXd& Y, double h)
+{
+    VectorXd k1 = dydt(Y);
+    VectorXd k2 = dydt(Y + 0.5 * h * k1);
+    VectorXd k3 = dydt(Y + 0.5 * h * k2);
+    VectorXd k4 = dydt(Y + h * k3);
+    return Y + (h / 6.0) * (k1 + 2 * k2 + 2 * k3 + k4);
+}
+
+// 第 begin+1 .. end 步，与 singular_particle 的主循环相同
+Fine fine(const State& start, int32_t begin, int32_t end, int write_step, double r_min)
+{
+    Fine f;
+    f.start = start;
+    VectorXd Y = start;
+    for (int32_t i = begin + 1; i <= end; ++i) {
+        Y = rk4(Y, dt);
+        if (i % write_step == 0) f.records.insert(f.records.end(), Y.data(), Y.data() + 5);
+        if (sqrt(Y[1] * Y[1] + Y[2] * Y[2] + Y[3] * Y[3]) < r_min) {
+            f.terminated = i;
+            break;
+        }
+    }
+    f.end = Y;
+    f.valid = true;
+    return f;
+}
+
+// n 步 dt 的区间用步长约 R dt 的 RK4
+State coarse(const State& start, int32_t n, int ratio, long long& steps)
+{
+    int32_t m = (n + ratio - 1) / ratio;
+    double h = n * dt / m;
+    VectorXd Y = start;
+    for (int32_t i = 0; i < m; ++i) Y = rk4(Y, h);
+    steps += m;
+    return Y;
+}
+
+double change(const State& a, const State& b, double p)
+{
+    double r = sqrt(b[1] * b[1] + b[2] * b[2] + b[3] * b[3]);
+    return max((a.segment<3>(1) - b.segment<3>(1)).norm() / r, fabs(a[4] - b[4]) / p);
+}
+
+bool same(const State& a, const State& b)
+{
+    return memcmp(a.data(), b.data(), sizeof(double) * 5) == 0;
+}
+
+#ifndef _WIN32
+bool write_all(int fd, const void* data, size_t len)
+{
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// 子进程的结果：int32 terminated, int64 记录数, double end[5], double 记录
+bool decode(const string& data, Fine& f)
+{
+    int32_t terminated;
+    int64_t n;
+    size_t head = sizeof(terminated) + sizeof(n) + 5 * sizeof(double);
+    if (data.size() < head) return false;
+    memcpy(&terminated, data.data(), sizeof(terminated));
+    memcpy(&n, data.data() + sizeof(terminated), sizeof(n));
+    if (n < 0 || data.size() != head + n * 5 * sizeof(double)) return false;
+    memcpy(f.end.data(), data.data() + sizeof(terminated) + sizeof(n), 5 * sizeof(double));
+    f.records.resize(n * 5);
+    if (n > 0) memcpy(f.records.data(), data.data() + head, n * 5 * sizeof(double));
+    f.terminated = terminated;
+    f.valid = true;
+    return true;
+}
+#endif
+
+// 各段的细积分，每段一个子进程（Windows 上在本进程中逐段计算）
+bool run_fine(const vector<int>& todo, const vector<State>& U, const vector<int32_t>& bounds, int write_step,
+              double r_min, vector<Fine>& F, string& error)
+{
+#ifdef _WIN32
+    for (int j : todo) F[j] = fine(U[j], bounds[j], bounds[j + 1], write_step, r_min);
+    return true;
+#else
+    struct Child {
+        int j;
+        pid_t pid;
+        int fd;
+        string data;
+    };
+    vector<Child> children;
+    for (int j : todo) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            error = string("pipe failed: ") + strerror(errno);
+            break;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            for (const Child& c : children) close(c.fd);
+            Fine f = fine(U[j], bounds[j], bounds[j + 1], write_step, r_min);
+            int64_t n = static_cast<int64_t>(f.records.size() / 5);
+            bool ok = write_all(fds[1], &f.terminated, sizeof(f.terminated)) && write_all(fds[1], &n, sizeof(n)) &&
+                      write_all(fds[1], f.end.data(), 5 * sizeof(double)) &&
+                      write_all(fds[1], f.records.data(), f.records.size() * sizeof(double));
+            _exit(ok ? 0 : 1);
+        }
+        close(fds[1]);
+        if (pid < 0) {
+            close(fds[0]);
+            error = string("fork failed: ") + strerror(errno);
+            break;
+        }
+        children.push_back(Child{j, pid, fds[0], ""});
+    }
+
+    // 同时读各管道，子进程不会因管道写满而阻塞
+    size_t open = children.size();
+    char buffer[65536];
+    while (open > 0) {
+        vector<pollfd> fds;
+        for (const Child& c : children) fds.push_back({c.fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (size_t k = 0; k < children.size(); ++k) {
+            if (children[k].fd < 0 || !(fds[k].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            ssize_t n = read(children[k].fd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) continue;
+            if (n > 0) {
+                children[k].data.append(buffer, n);
+            } else {
+                close(children[k].fd);
+                children[k].fd = -1;
+                --open;
+            }
+        }
+    }
+
+    bool ok = error.empty();
+    for (Child& c : children) {
+        if (c.fd >= 0) close(c.fd);
+        int status = 0;
+        waitpid(c.pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !decode(c.data, F[c.j])) {
+            if (ok) error = "fine integration of slice " + to_string(c.j) + " failed";
+            ok = false;
+            continue;
+        }
+        F[c.j].start = U[c.j];
+    }
+    return ok;
+#endif
+}
+
+} // namespace
+
+int32_t integrate(VectorXd& Y, int32_t num_steps, int write_step, double p, double r_min, int slices,
+                  int coarse_ratio, const function<void(const double*)>& write, ostream& log, Stats& stats,
+                  string& error)
+{
+    // 段的边界：输出记录处，最后一段到 num_steps
+    int32_t intervals = num_steps / write_step;
+    int S = max(1, min(slices, static_cast<int>(intervals)));
+    vector<int32_t> bounds(S + 1);
+    for (int j = 0; j < S; ++j) bounds[j] = static_cast<int32_t>(static_cast<int64_t>(intervals) * j / S) * write_step;
+    bounds[S] = num_steps;
+    stats.slices = S;
+
+    log << "Parareal (--parareal=" << slices << ":" << coarse_ratio << "): " << S << " slices of about "
+        << bounds[1] << " steps, coarse step " << coarse_ratio << " dt" << endl;
+
+    // 第 0 次迭代：只有粗积分
+    auto clock = [] { return chrono::steady_clock::now(); };
+    auto t0 = clock();
+    vector<State> U(S + 1), G(S);
+    U[0] = Y;
+    for (int j = 0; j < S; ++j) {
+        G[j] = coarse(U[j], bounds[j + 1] - bounds[j], coarse_ratio, stats.coarse_steps);
+        U[j + 1] = G[j];
+    }
+    stats.coarse_seconds += chrono::duration<double>(clock() - t0).count();
+
+    vector<Fine> F(S);
+    int last = S;   // 需要的段数（起点已精确的进入大气层的段之后的不再需要）
+    for (int k = 1; k <= S; ++k) {
+        // 起点变了的段重算细积分
+        vector<int> todo;
+        for (int j = 0; j < last; ++j) {
+            if (!F[j].valid || !same(F[j].start, U[j])) todo.push_back(j);
+        }
+        auto t1 = clock();
+        if (!run_fine(todo, U, bounds, write_step, r_min, F, error)) return -1;
+        stats.fine_seconds += chrono::duration<double>(clock() - t1).count();
+        stats.fine_slices += todo.size();
+        stats.iterations = k;
+
+        // 串行修正；起点与细积分相同的段直接取细积分的结果
+        auto t2 = clock();
+        double max_change = 0.0;
+        int exact = 0;
+        bool prefix = true;
+        for (int j = 0; j < last; ++j) {
+            // 只有起点已精确（之前各段都已收敛）时才在进入大气层的段截断；
+            // 否则之后的修正可能让粒子离开大气层，后面的段仍要迭代
+            if (F[j].terminated && prefix && same(F[j].start, U[j])) {
+                last = j + 1;
+                break;
+            }
+            State next;
+            if (same(F[j].start, U[j])) {
+                next = F[j].end;
+                if (prefix) ++exact;
+            } else {
+                prefix = false;
+                State g = coarse(U[j], bounds[j + 1] - bounds[j], coarse_ratio, stats.coarse_steps);
+                next = g + F[j].end - G[j];
+                G[j] = g;
+            }
+            max_change = max(max_change, change(next, U[j + 1], p));
+            U[j + 1] = next;
+        }
+        if (prefix) exact = last;
+        stats.coarse_seconds += chrono::duration<double>(clock() - t2).count();
+        stats.change = max_change;
+        progress_board::update(bounds[min(exact, last)], U[min(exact, last)][0]);
+
+        log << "  Iteration " << k << ": " << todo.size() << " fine slices in parallel, max change " << max_change
+            << ", " << exact << " of " << last << " slices exact" << endl;
+        if (exact == last || max_change < TOL) break;
+    }
+
+    // 按 TOL 收敛而非精确时，在第一个进入大气层的段截断
+    for (int j = 0; j < last; ++j) {
+        if (F[j].terminated) {
+            last = j + 1;
+            break;
+        }
+    }
+
+    // 各段最后一次细积分的记录
+    for (int j = 0; j < last; ++j) {
+        for (size_t r = 0; r < F[j].records.size(); r += 5) write(&F[j].records[r]);
+    }
+    Y = F[last - 1].end;
+    return F[last - 1].terminated;
+}
+
+} // namespace parareal
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <unordered_map>
+
+#include "particle_params.h"
+#include "ensemble_generator.h"
+#include "path_utils.h"
+
+using namespace std;
+
+namespace {
+
+const int NUM_PARAMS = NUM_PARTICLE_PARAMS;
+
+// .para 中的顺序
+const char* const PARAM_NAMES[NUM_PARAMS] = {
+    "dt", "E0", "q", "t_ini", "t_interval", "write_interval", "xgsm", "ygsm", "zgsm",
+    "Ek", "pa", "atmosphere_altitude", "t_step", "r_step", "magnetic_field_model", "wave_field_model"
+};
+
+// 清单和生成器中的粒子，虚拟路径 -> 参数
+unordered_map<string, ParticleParams> registered_params;
+
+} // namespace
+
+void set_particle_param(ParticleParams& params, int idx, double val)
+{
+    switch (idx) {
+        case 0: params.dt = val; break;
+        case 1: params.E0 = val; break;
+        case 2: params.q = val; break;
+        case 3: params.t_ini = val; break;
+        case 4: params.t_interval = val; break;
+        case 5: params.write_interval = val; break;
+        case 6: params.xgsm = val; break;
+        case 7: params.ygsm = val; break;
+        case 8: params.zgsm = val; break;
+        case 9: params.Ek = val; break;
+        case 10: params.pa = val; break;
+        case 11: params.atmosphere_altitude = val; break;
+        case 12: params.t_step = val; break;
+        case 13: params.r_step = val; break;
+        case 14: params.magnetic_field_model = static_cast<int>(val); break;
+        case 15: params.wave_field_model = static_cast<int>(val); break;
+        default: break;
+    }
+}
+
+double get_particle_param(const ParticleParams& params, int idx)
+{
+    if (idx == 14) return static_cast<double>(params.magnetic_field_model);
+    if (idx == 15) return static_cast<double>(params.wave_field_model);
+    double values[NUM_PARTICLE_DOUBLES];
+    particle_param_doubles(params, values);
+    return values[idx];
+}
+
+void particle_param_doubles(const ParticleParams& params, double (&values)[NUM_PARTICLE_DOUBLES])
+{
+    const double v[NUM_PARTICLE_DOUBLES] = {
+        params.dt, params.E0, params.q, params.t_ini, params.t_interval, params.write_interval,
+        params.xgsm, params.ygsm, params.zgsm, params.Ek, params.pa, params.atmosphere_altitude,
+        params.t_step, params.r_step
+    };
+    copy(begin(v), end(v), values);
+}
+
+int particle_param_index(const string& name)
+{
+    for (int i = 0; i < NUM_PARAMS; ++i) {
+        if (name == PARAM_NAMES[i]) return i;
+    }
+    return -1;
+}
+
+const char* particle_param_name(int idx)
+{
+    return (idx >= 0 && idx < NUM_PARAMS) ? PARAM_NAMES[idx] : "";
+}
+
+namespace {
+
+string trim(const string& s)
+{
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == string::npos) return "";
+    return s.substr(b, s.find_last_not_of(" \t\r") - b + 1);
+}
+
+// 整个字符串是一个数值
+bool parse_number(const string& s, double& val)
+{
+    if (s.empty()) return false;
+    char* end = nullptr;
+    val = strtod(s.c_str(), &end);
+    return *end == '\0';
+}
+
+void split_commas(const string& line, vector<string>& fields)
+{
+    fields.clear();
+    size_t start = 0;
+    while (true) {
+        size_t comma = line.find(',', start);
+        fields.push_back(trim(line.substr(start, comma == string::npos ? string::npos : comma - start)));
+        if (comma == string::npos) break;
+        start = comma + 1;
+    }
+}
+
+/**
+ * @brief 逐行读取清单，每个粒子调用一次 row(name, params)，row 返回 false 时提前结束
+ * @return 文件无法打开或格式错误时返回 false（错误信息输出到 cerr）
+ */
+bool scan_manifest(const string& manifest_file, const function<bool(const string&, const ParticleParams&)>& row)
+{
+    ifstream in(manifest_file);
+    if (!in) {
+        cerr << "Failed to open particle manifest: " << manifest_file << endl;
+        return false;
+    }
+    string prefix = PathUtils::getBasename(PathUtils::getFilename(manifest_file));
+
+    ParticleParams defaults;
+    defaults.num_values = NUM_PARAMS;
+    bool has_default[NUM_PARAMS] = {false};
+    vector<int> columns;        // 参数序号，-1 为 name
+    bool in_rows = false;
+    int64_t row_index = 0;
+    vector<string> fields;
+    string line;
+    for (int64_t lineno = 1; getline(in, line); ++lineno) {
+        auto fail = [&](const string& msg) {
+            cerr << manifest_file << ":" << lineno << ": " << msg << endl;
+            return false;
+        };
+        line = trim(line.substr(0, line.find_first_of(";#")));
+        if (line.empty()) continue;
+
+        if (!in_rows) {
+            size_t eq = line.find('=');
+            if (eq == string::npos) return fail("expected \"key = value\" or \"columns = ...\" before the particle rows");
+            string key = trim(line.substr(0, eq));
+            string value = trim(line.substr(eq + 1));
+            if (key != "columns") {
+                int idx = particle_param_index(key);
+                double val;
+                if (idx < 0) return fail("unknown parameter " + key);
+                if (!parse_number(value, val)) return fail("invalid value for " + key + ": " + value);
+                set_particle_param(defaults, idx, val);
+                has_default[idx] = true;
+                continue;
+            }
+            split_commas(value, fields);
+            bool seen[NUM_PARAMS + 1] = {false};
+            for (const auto& name : fields) {
+                int idx = (name == "name") ? -1 : particle_param_index(name);
+                if (idx < 0 && name != "name") return fail("unknown column " + name);
+                if (seen[idx + 1]) return fail("duplicate column " + name);
+                seen[idx + 1] = true;
+                columns.push_back(idx);
+            }
+            for (int i = 0; i < NUM_PARAMS; ++i) {
+                if (!seen[i + 1] && !has_default[i]) return fail(string("parameter ") + PARAM_NAMES[i] + " is neither set nor a column");
+            }
+            in_rows = true;
+            continue;
+        }
+
+        split_commas(line, fields);
+        if (fields.size() != columns.size()) {
+            return fail("expected " + to_string(columns.size()) + " values, found " + to_string(fields.size()));
+        }
+        ParticleParams params = defaults;
+        string name = prefix + "_" + to_string(row_index);
+        for (size_t k = 0; k < columns.size(); ++k) {
+            double val;
+            if (columns[k] < 0) {
+                name = fields[k];
+                if (name.empty() || name.find_first_of("/\\") != string::npos) return fail("invalid particle name " + name);
+            } else if (!parse_number(fields[k], val)) {
+                return fail(string("invalid value for ") + PARAM_NAMES[columns[k]] + ": " + fields[k]);
+            } else {
+                set_particle_param(params, columns[k], val);
+            }
+        }
+        ++row_index;
+        if (!row(name, params)) return true;
+    }
+    if (!in_rows) {
+        cerr << manifest_file << ": no \"columns = ...\" line" << endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool read_particle_params(const string& para_file, ParticleParams& params)
+{
+    auto found = registered_params.find(para_file);
+    if (found != registered_params.end()) {
+        params = found->second;
+        return true;
+    }
+
+    ifstream para_in(para_file);
+    if (!para_in) {
+        // <清单>/<name>.para 又没有登记：在清单中查找（逐行，较慢），或重新生成
+        string source = PathUtils::getParentDirectory(para_file);
+        string name = PathUtils::getBasename(PathUtils::getFilename(para_file));
+        bool hit = false;
+        if (PathUtils::getFileExtension(source) == ".pman") {
+            scan_manifest(source, [&](const string& row_name, const ParticleParams& row_params) {
+                if (row_name != name) return true;
+                params = row_params;
+                hit = true;
+                return false;
+            });
+        } else if (PathUtils::getFileExtension(source) == ".gen") {
+            ensemble::generate(source, [&](const ensemble::Member& m) {
+                if (!hit && m.name == name) {
+                    params = m.params;
+                    hit = true;
+                }
+            });
+        }
+        return hit;
+    }
+
+    string line;
+    int idx = 0;
+    while (getline(para_in, line)) {
+        if (line.empty()) continue;
+
+        size_t pos = line.find(';');
+        string value_str = (pos != string::npos) ? line.substr(0, pos) : line;
+        istringstream iss(value_str);
+        double val;
+        if (!(iss >> val)) continue;
+        set_particle_param(params, idx, val);
+        ++idx;
+    }
+    params.num_values = idx;
+    return true;
+}
+
+bool read_manifest(const string& manifest_file, vector<string>& particles)
+{
+    bool duplicate = false;
+    string prefix = PathUtils::ensureTrailingSeparator(manifest_file);    // 即 joinPath(manifest_file, name + ".para")
+    bool ok = scan_manifest(manifest_file, [&](const string& name, const ParticleParams& params) {
+        string particle = prefix + name + ".para";
+        if (!registered_params.emplace(particle, params).second) {
+            cerr << manifest_file << ": duplicate particle name " << name << endl;
+            duplicate = true;
+            return false;
+        }
+        particles.push_back(particle);
+        return true;
+    });
+    return ok && !duplicate;
+}
+
+bool read_generator(const string& gen_file, vector<string>& particles)
+{
+    string prefix = PathUtils::ensureTrailingSeparator(gen_file);
+    return ensemble::generate(gen_file, [&](const ensemble::Member& m) {
+        string particle = prefix + m.name + ".para";
+        registered_params[particle] = m.params;
+        particles.push_back(particle);
+    });
+}
+
+bool is_particle_source(const string& path)
+{
+    string ext = PathUtils::getFileExtension(path);
+    return ext == ".pman" || ext == ".gen";
+}
+
+bool find_particles(const string& inputDir, vector<string>& particles)
+{
+    particles = PathUtils::findFilesWithExtension(inputDir, ".para", true);
+    for (const auto& manifest_file : PathUtils::findFilesWithExtension(inputDir, ".pman", true)) {
+        if (!read_manifest(manifest_file, particles)) return false;
+    }
+    for (const auto& gen_file : PathUtils::findFilesWithExtension(inputDir, ".gen", true)) {
+        if (!read_generator(gen_file, particles)) return false;
+    }
+    return true;
+}
+
+void register_particle_params(const string& particle, const ParticleParams& params)
+{
+    registered_params[particle] = params;
+}
+
+string particle_params_argument(const string& particle)
+{
+    auto found = registered_params.find(particle);
+    if (found == registered_params.end()) return "";
+
+    string arg = "--params=";
+    char buf[32];
+    for (int i = 0; i < NUM_PARAMS; ++i) {
+        snprintf(buf, sizeof(buf), i ? ",%.17g" : "%.17g", get_particle_param(found->second, i));
+        arg += buf;
+    }
+    return arg;
+}
+
+bool decode_particle_params(const string& text, ParticleParams& params)
+{
+    vector<string> fields;
+    split_commas(text, fields);
+    if (fields.size() != NUM_PARAMS) return false;
+    for (int i = 0; i < NUM_PARAMS; ++i) {
+        double val;
+        if (!parse_number(fields[i], val)) return false;
+        set_particle_param(params, i, val);
+    }
+    params.num_values = NUM_PARAMS;
+    return true;
+}
+
+int64_t integration_steps(const ParticleParams& params)
+{
+    if (params.dt == 0.0) return 0;
+    return static_cast<int64_t>(params.t_interval / fabs(params.dt));
+}
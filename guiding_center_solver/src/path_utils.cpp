@@ -12,6 +12,10 @@ char PathUtils::getPathSeparator() {
 }
 
 std::string PathUtils::getExecutableDirectory() {
+    return getParentDirectory(getExecutablePath());
+}
+
+std::string PathUtils::getExecutablePath() {
     char buffer[MAX_PATH_LENGTH];
     
 #ifdef _WIN32
@@ -29,7 +33,7 @@ std::string PathUtils::getExecutableDirectory() {
     std::string path(buffer);
 #endif
     
-    return getParentDirectory(path);
+    return path;
 }
 
 std::string PathUtils::joinPath(const std::vector<std::string>& components) {
@@ -155,6 +155,15 @@ const WaveConfig& get_config() {
     return config;
 }
 
+void load_config() {
+    get_config();
+}
+
+double shortest_period() {
+    const WaveConfig& config = get_config();
+    return config.valid ? 2 * M_PI / config.omega : HUGE_VAL;
+}
+
 double E_phi_amp(const double& t, const double& L, const double& mu, const double& phi) {
     const auto& config = get_config();
     if (!config.valid) return 0.0;
@@ -0,0 +1,338 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <signal.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "progress_board.h"
+#include "run_options.h"
+
+using namespace std;
+
+namespace progress_board {
+
+namespace {
+
+const char MAGIC[8] = {'G', 'C', 'B', 'O', 'A', 'R', 'D', '1'};
+
+struct Header {
+    char magic[8];
+    uint32_t count;
+    uint32_t slot_size;
+    double created;                         // 墙钟时间 [s since epoch]
+    int32_t pid;                            // 主进程
+    char reserved[36];
+};
+
+struct Slot {
+    atomic<int32_t> state;
+    atomic<int32_t> pid;
+    atomic<int64_t> steps_done;
+    atomic<int64_t> steps_total;
+    atomic<int64_t> first_step;             // 本次开始时已完成的步数（从检查点继续时不为 0）
+    atomic<double> t_start;                 // 粒子的初始时间 t_ini
+    atomic<double> t_sim;
+    atomic<double> start_wall;
+    atomic<double> end_wall;             // 结束时的墙钟时间
+    char name[64];
+};
+
+static_assert(sizeof(Header) == 64, "progress board header layout");
+static_assert(sizeof(Slot) == 128, "progress board slot layout");
+static_assert(atomic<int64_t>::is_always_lock_free && atomic<double>::is_always_lock_free,
+              "progress board needs lock-free atomics to share them between processes");
+
+// 主进程创建的进度表（预 fork 的子进程继承），粒子 -> 槽位
+void* board = nullptr;
+size_t board_size = 0;
+string board_path;
+unordered_map<string, uint32_t> slot_of;
+
+// 本进程正在更新的槽位
+Slot* current = nullptr;
+
+double wall_now()
+{
+    return chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+Slot* slots(void* base)
+{
+    return reinterpret_cast<Slot*>(static_cast<char*>(base) + sizeof(Header));
+}
+
+#ifndef _WIN32
+// 映射已有的进度表，检查文件头
+void* map_board(const string& path, bool writable, size_t& size)
+{
+    int fd = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    void* base = nullptr;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+        size = static_cast<size_t>(st.st_size);
+        base = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) base = nullptr;
+    }
+    close(fd);
+    if (!base) return nullptr;
+    const Header* h = static_cast<const Header*>(base);
+    if (memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->slot_size != sizeof(Slot) ||
+        size < sizeof(Header) + static_cast<size_t>(h->count) * sizeof(Slot)) {
+        munmap(base, size);
+        return nullptr;
+    }
+    return base;
+}
+#endif
+
+string format_duration(double seconds)
+{
+    if (!(seconds >= 0.0) || seconds > 1e9) return "-";
+    int64_t s = static_cast<int64_t>(seconds + 0.5);
+    ostringstream out;
+    if (s >= 3600) out << s / 3600 << "h" << setw(2) << setfill('0') << (s / 60) % 60 << "m";
+    else if (s >= 60) out << s / 60 << "m" << setw(2) << setfill('0') << s % 60 << "s";
+    else out << s << "s";
+    return out.str();
+}
+
+} // namespace
+
+#ifdef _WIN32
+
+bool create(const string&, const vector<BatchJob>&) { return false; }
+string child_argument(const string&) { return ""; }
+void begin(const string&, int64_t, int64_t, double, double) {}
+void update(int64_t, double) {}
+void update_total(int64_t) {}
+void finish(bool) {}
+void settle(const vector<BatchJob>&) {}
+
+bool show(const string& path, bool, ostream& out)
+{
+    out << "The progress board (" << path << ") is only supported on POSIX systems" << endl;
+    return false;
+}
+
+#else
+
+bool create(const string& path, const vector<BatchJob>& jobs)
+{
+    size_t size = sizeof(Header) + jobs.size() * sizeof(Slot);
+    string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    void* base = nullptr;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) base = nullptr;
+    }
+    close(fd);
+    if (!base) {
+        remove(tmp.c_str());
+        return false;
+    }
+
+    // 新文件全为 0，即所有槽位为 STATE_QUEUED
+    Header* h = static_cast<Header*>(base);
+    memcpy(h->magic, MAGIC, sizeof(MAGIC));
+    h->count = static_cast<uint32_t>(jobs.size());
+    h->slot_size = sizeof(Slot);
+    h->created = wall_now();
+    h->pid = static_cast<int32_t>(getpid());
+    slot_of.clear();
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        Slot& s = slots(base)[i];
+        s.steps_total.store(jobs[i].steps, memory_order_relaxed);
+        strncpy(s.name, jobs[i].name.c_str(), sizeof(s.name) - 1);
+        slot_of[jobs[i].para_file] = static_cast<uint32_t>(i);
+    }
+    // 写完再换名，--status 不会看到写了一半的进度表
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        munmap(base, size);
+        remove(tmp.c_str());
+        return false;
+    }
+    if (board) munmap(board, board_size);
+    board = base;
+    board_size = size;
+    board_path = path;
+    return true;
+}
+
+string child_argument(const string& para_file)
+{
+    auto it = slot_of.find(para_file);
+    if (!board || it == slot_of.end()) return "";
+    return "--board=" + to_string(it->second) + ":" + board_path;
+}
+
+void begin(const string& para_file, int64_t steps_total, int64_t steps_done, double t_start, double t_sim)
+{
+    current = nullptr;
+    uint32_t index = 0;
+    if (!run_options.board.empty()) {
+        // exec 的子进程：--board=<槽位>:<路径>
+        size_t colon = run_options.board.find(':');
+        index = static_cast<uint32_t>(atol(run_options.board.substr(0, colon).c_str()));
+        size_t size = 0;
+        void* base = map_board(run_options.board.substr(colon + 1), true, size);
+        if (!base) return;
+        if (index >= static_cast<const Header*>(base)->count) {
+            munmap(base, size);
+            return;
+        }
+        board = base;
+        board_size = size;
+    } else {
+        // 预 fork 的子进程：继承的映射
+        auto it = slot_of.find(para_file);
+        if (!board || it == slot_of.end()) return;
+        index = it->second;
+    }
+
+    Slot* s = &slots(board)[index];
+    double now = wall_now();
+    s->pid.store(static_cast<int32_t>(getpid()), memory_order_relaxed);
+    s->steps_total.store(steps_total, memory_order_relaxed);
+    s->first_step.store(steps_done, memory_order_relaxed);
+    s->steps_done.store(steps_done, memory_order_relaxed);
+    s->t_start.store(t_start, memory_order_relaxed);
+    s->t_sim.store(t_sim, memory_order_relaxed);
+    s->start_wall.store(now, memory_order_relaxed);
+    s->end_wall.store(now, memory_order_relaxed);
+    s->state.store(STATE_RUNNING, memory_order_relaxed);
+    current = s;
+}
+
+void update(int64_t step, double t_sim)
+{
+    if (!current) return;
+    current->steps_done.store(step, memory_order_relaxed);
+    current->t_sim.store(t_sim, memory_order_relaxed);
+}
+
+void update_total(int64_t steps_total)
+{
+    if (!current) return;
+    current->steps_total.store(steps_total, memory_order_relaxed);
+}
+
+void finish(bool ok)
+{
+    if (!current) return;
+    current->end_wall.store(wall_now(), memory_order_relaxed);
+    current->state.store(ok ? STATE_DONE : STATE_FAILED, memory_order_relaxed);
+    current = nullptr;
+}
+
+void settle(const vector<BatchJob>& jobs)
+{
+    if (!board) return;
+    for (const auto& job : jobs) {
+        auto it = slot_of.find(job.para_file);
+        if (it == slot_of.end()) continue;
+        Slot& s = slots(board)[it->second];
+        int32_t state = s.state.load(memory_order_relaxed);
+        if (job.status == 0 && state == STATE_DONE) continue;
+        if (state == STATE_RUNNING) s.end_wall.store(wall_now(), memory_order_relaxed);
+        s.state.store(job.status == 0 ? STATE_DONE : STATE_FAILED, memory_order_relaxed);
+    }
+    msync(board, board_size, MS_ASYNC);
+}
+
+bool show(const string& path, bool all, ostream& out)
+{
+    size_t size = 0;
+    void* base = map_board(path, false, size);
+    if (!base) {
+        out << "No progress board at " << path << " (is a Solver batch running in this workspace?)" << endl;
+        return false;
+    }
+    const Header* h = static_cast<const Header*>(base);
+    Slot* s = slots(base);
+    double now = wall_now();
+
+    // 运行中但进程已不存在：记为丢失（被杀或崩溃）
+    auto alive = [](int32_t pid) { return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM); };
+
+    int64_t counts[5] = {0, 0, 0, 0, 0};   // queued, running, done, failed, lost
+    int64_t steps_done = 0, steps_total = 0;
+    double rate = 0.0;                      // 运行中粒子的步数/秒之和
+    ostringstream rows;
+    rows << left << setw(24) << "particle" << right << setw(10) << "state" << setw(14) << "steps" << setw(8) << "%"
+         << setw(12) << "t - t_ini" << setw(12) << "steps/s" << setw(10) << "elapsed" << setw(10) << "ETA" << "\n";
+    for (uint32_t i = 0; i < h->count; ++i) {
+        int32_t state = s[i].state.load(memory_order_relaxed);
+        int64_t done = s[i].steps_done.load(memory_order_relaxed);
+        int64_t total = s[i].steps_total.load(memory_order_relaxed);
+        int64_t first = s[i].first_step.load(memory_order_relaxed);
+        double start = s[i].start_wall.load(memory_order_relaxed);
+        double end = (state == STATE_RUNNING) ? now : s[i].end_wall.load(memory_order_relaxed);
+        bool lost = (state == STATE_RUNNING && !alive(s[i].pid.load(memory_order_relaxed)));
+
+        // 已完成的粒子（含提前进入大气层）算作全部步数
+        steps_total += total;
+        steps_done += (state == STATE_DONE) ? total : min(done, total);
+        double particle_rate = (end > start && start > 0.0) ? (done - first) / (end - start) : 0.0;
+        if (state == STATE_RUNNING && !lost) rate += particle_rate;
+
+        const char* label = "queued";
+        if (lost) {
+            label = "lost";
+            ++counts[4];
+        } else {
+            ++counts[state >= 0 && state < 4 ? state : 0];
+            if (state == STATE_RUNNING) label = "running";
+            if (state == STATE_DONE) label = "done";
+            if (state == STATE_FAILED) label = "failed";
+        }
+        if (!all && (state != STATE_RUNNING || lost)) continue;
+
+        double percent = total > 0 ? 100.0 * min(done, total) / total : 0.0;
+        double eta = (state == STATE_RUNNING && particle_rate > 0.0) ? (total - done) / particle_rate : -1.0;
+        rows << left << setw(24) << string(s[i].name, strnlen(s[i].name, sizeof(s[i].name))) << right
+             << setw(10) << label << setw(14) << done << setw(8) << fixed << setprecision(1) << percent
+             << setw(12) << setprecision(3) << s[i].t_sim.load(memory_order_relaxed) - s[i].t_start.load(memory_order_relaxed)
+             << setw(12) << setprecision(0) << particle_rate << defaultfloat
+             << setw(10) << format_duration(start > 0.0 ? end - start : -1.0)
+             << setw(10) << format_duration(eta) << "\n";
+    }
+
+    double elapsed = now - h->created;
+    int64_t remaining = steps_total - steps_done;
+    out << "Progress board: " << path << " (main process " << h->pid << ", started " << format_duration(elapsed) << " ago)" << endl;
+    out << "Particles: " << h->count << " total, " << counts[STATE_RUNNING] << " running, " << counts[STATE_QUEUED]
+        << " queued, " << counts[STATE_DONE] << " done, " << counts[STATE_FAILED] << " failed";
+    if (counts[4] > 0) out << ", " << counts[4] << " lost";
+    out << endl;
+    out << "Steps: " << steps_done << " of " << steps_total;
+    if (steps_total > 0) out << " (" << fixed << setprecision(1) << 100.0 * steps_done / steps_total << "%)" << defaultfloat;
+    out << endl;
+    out << "Throughput: " << fixed << setprecision(0) << rate << " steps/s now, "
+        << (elapsed > 0.0 ? steps_done / elapsed : 0.0) << " steps/s average" << defaultfloat << endl;
+    if (counts[STATE_RUNNING] > 0 || counts[STATE_QUEUED] > 0) {
+        out << "ETA: " << format_duration(rate > 0.0 ? remaining / rate : -1.0) << endl;
+    }
+    if (all || counts[STATE_RUNNING] > 0) out << "\n" << rows.str();
+    munmap(base, size);
+    return true;
+}
+
+#endif
+
+} // namespace progress_board
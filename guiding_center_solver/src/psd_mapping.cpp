@@ -0,0 +1,240 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <algorithm>
+#include <Eigen/Dense>
+
+#include "psd_mapping.h"
+#include "field_calculator.h"
+#include "singular_particle.h"
+#include "path_utils.h"
+
+using namespace std;
+using namespace Eigen;
+
+extern double E0, mu;
+
+namespace psd_map {
+
+namespace {
+
+const char* const COLUMNS = "boundary\tt\tx\ty\tz\tp_para\tEk\tpa\tL\tMLT\tpa_eq";
+
+string trim(const string& s)
+{
+    size_t b = s.find_first_not_of(" \t\r\n");
+    if (b == string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r\n");
+    return s.substr(b, e - b + 1);
+}
+
+// 一行：boundary, t, x, y, z, p_para, Ek, pa, L, MLT, pa_eq
+void write_row(ostream& out, const string& boundary, const VectorXd& Y)
+{
+    double p_perp2 = 2.0 * E0 * Bvec(Y[0], Y[1], Y[2], Y[3]).norm() * mu / (c * c);
+    double p = sqrt(Y[4] * Y[4] + p_perp2);
+    double Ek = sqrt(p * p * c * c + E0 * E0) - E0;
+    double pa = acos(max(-1.0, min(1.0, Y[4] / p))) * 180.0 / M_PI;
+
+    Vector3d sm = to_sm(Y);
+    double r2 = sm.squaredNorm();
+    double cos2 = (sm[0] * sm[0] + sm[1] * sm[1]) / r2;
+    double L = sqrt(r2) / cos2;
+    double MLT = fmod(12.0 + atan2(sm[1], sm[0]) * 12.0 / M_PI + 24.0, 24.0);
+    // 偶极场中 B_eq / B = cos^6 λ / sqrt(1 + 3 sin^2 λ)
+    double sin2 = p_perp2 / (p * p);
+    double sin2_eq = min(1.0, sin2 * pow(cos2, 3) / sqrt(1.0 + 3.0 * (1.0 - cos2)));
+    double pa_eq = asin(sqrt(sin2_eq)) * 180.0 / M_PI;
+
+    out << boundary << '\t' << Y[0] << '\t' << Y[1] << '\t' << Y[2] << '\t' << Y[3] << '\t' << Y[4] << '\t' << Ek
+        << '\t' << pa << '\t' << L << '\t' << MLT << '\t' << pa_eq << '\n';
+}
+
+struct Row {
+    string boundary;
+    double t = 0.0, x = 0.0, y = 0.0, z = 0.0, p_para = 0.0, Ek = 0.0, pa = 0.0, L = 0.0, MLT = 0.0, pa_eq = 0.0;
+};
+
+bool read_row(istream& in, Row& r)
+{
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream iss(line);
+        return static_cast<bool>(iss >> r.boundary >> r.t >> r.x >> r.y >> r.z >> r.p_para >> r.Ek >> r.pa >> r.L >> r.MLT >> r.pa_eq);
+    }
+    return false;
+}
+
+} // namespace
+
+bool load_model(const string& path, Model& model, string& error)
+{
+    model = Model();
+    ifstream in(path);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    string line;
+    for (int lineno = 1; getline(in, line); ++lineno) {
+        auto fail = [&](const string& msg) {
+            error = path + ":" + to_string(lineno) + ": " + msg;
+            return false;
+        };
+        line = trim(line.substr(0, line.find_first_of(";#")));
+        if (line.empty()) continue;
+        size_t eq = line.find('=');
+        if (eq == string::npos) return fail("expected \"key = value\"");
+        string key = trim(line.substr(0, eq));
+        string value = trim(line.substr(eq + 1));
+
+        if (key == "time" && value == "model") {
+            model.time_model = true;
+            continue;
+        }
+        char* end = nullptr;
+        double x = strtod(value.c_str(), &end);
+        if (value.empty() || *end != '\0' || !std::isfinite(x)) return fail("invalid value for " + key + ": " + value);
+
+        if (key == "L_max" || key == "magnetopause") {
+            if (x < 0.0) return fail(key + " must not be negative");
+            (key == "L_max" ? model.L_max : model.magnetopause) = x;
+        } else if (key == "f0") {
+            model.f0 = x;
+        } else if (key == "Ek0" || key == "L0") {
+            if (!(x > 0.0)) return fail(key + " must be positive");
+            (key == "Ek0" ? model.Ek0 : model.L0) = x;
+        } else if (key == "gamma") {
+            model.gamma = x;
+        } else if (key == "n") {
+            model.n = x;
+        } else if (key == "lambda") {
+            model.lambda = x;
+        } else if (key == "time") {
+            model.time_model = false;
+            model.f_time = x;
+        } else if (key == "atmosphere") {
+            model.f_atmosphere = x;
+        } else {
+            return fail("unknown key " + key +
+                        " (expected L_max, magnetopause, f0, Ek0, gamma, n, L0, lambda, time or atmosphere)");
+        }
+    }
+    return true;
+}
+
+vector<events::Event> boundary_events(const Model& model)
+{
+    vector<events::Event> list;
+    if (model.L_max > 0.0) {
+        events::Event e;
+        e.type = events::LMAX;
+        e.value = model.L_max;
+        e.stop = true;
+        list.push_back(e);
+    }
+    if (model.magnetopause > 0.0) {
+        events::Event e;
+        e.type = events::MAGNETOPAUSE;
+        e.value = model.magnetopause;
+        e.stop = true;
+        list.push_back(e);
+    }
+    return list;
+}
+
+string outside(const Model& model, const VectorXd& Y)
+{
+    double r = Y.segment<3>(1).norm();
+    if (model.L_max > 0.0) {
+        Vector3d sm = to_sm(Y);
+        if (r * r * r / (sm[0] * sm[0] + sm[1] * sm[1]) > model.L_max) return "lmax";
+    }
+    if (model.magnetopause > 0.0 && r > events::magnetopause_distance(model.magnetopause, Y[1] / r)) return "magnetopause";
+    return "";
+}
+
+string boundary_key(const Model& model)
+{
+    ostringstream key;
+    key << setprecision(17) << "psd_map L_max=" << model.L_max << " magnetopause=" << model.magnetopause;
+    return key.str();
+}
+
+double source(const Model& model, double L, double Ek, double pa_eq)
+{
+    double s = sin(pa_eq * M_PI / 180.0);
+    return model.f0 * pow(Ek / model.Ek0, -model.gamma) * pow(s, model.n) * pow(L / model.L0, model.lambda);
+}
+
+string endpoint_path(const string& outFileBase)
+{
+    return outFileBase + ".endpoint";
+}
+
+bool write_endpoint(const string& path, const VectorXd& observation, const string& boundary, const VectorXd& end)
+{
+    ofstream out(path, ios::out | ios::trunc);
+    if (!out) return false;
+    out << setprecision(17) << "# " << COLUMNS << '\n';
+    write_row(out, "observation", observation);
+    write_row(out, boundary, end);
+    return static_cast<bool>(out);
+}
+
+bool write_map(const string& path, const vector<string>& para_files, const Model& model, ostream& log)
+{
+    ofstream out(path, ios::out | ios::trunc);
+    if (!out) return false;
+    out << "# name\tt\tx\ty\tz\tEk\tpa\tL\tMLT\tpa_eq\tboundary\tt_b\tL_b\tMLT_b\tEk_b\tpa_eq_b\tf\n";
+    out << setprecision(17);
+
+    string outputDir = PathUtils::joinPath(exeDir, "output");
+    const double nan = numeric_limits<double>::quiet_NaN();
+    map<string, size_t> counts;
+    for (const auto& file : para_files) {
+        string name = PathUtils::getBasename(PathUtils::getFilename(file));
+        ifstream in(endpoint_path(PathUtils::joinPath(outputDir, name)));
+        Row obs, end;
+        if (!in || !read_row(in, obs) || !read_row(in, end) || obs.boundary != "observation") {
+            obs = Row();
+            end = Row();
+            end.boundary = "missing";
+            end.t = end.L = end.MLT = end.Ek = end.pa_eq = nan;
+        }
+
+        double f = nan;
+        if (end.boundary == "time") {
+            f = model.time_model ? source(model, end.L, end.Ek, end.pa_eq) : model.f_time;
+        } else if (end.boundary == "lmax" || end.boundary == "magnetopause") {
+            f = source(model, end.L, end.Ek, end.pa_eq);
+        } else if (end.boundary == "atmosphere") {
+            f = model.f_atmosphere;
+        }
+        ++counts[end.boundary];
+
+        out << name << '\t';
+        if (end.boundary == "missing") {
+            out << "nan\tnan\tnan\tnan\tnan\tnan\tnan\tnan\tnan\t";
+        } else {
+            out << obs.t << '\t' << obs.x << '\t' << obs.y << '\t' << obs.z << '\t' << obs.Ek << '\t' << obs.pa << '\t'
+                << obs.L << '\t' << obs.MLT << '\t' << obs.pa_eq << '\t';
+        }
+        out << end.boundary << '\t' << end.t << '\t' << end.L << '\t' << end.MLT << '\t' << end.Ek << '\t' << end.pa_eq
+            << '\t' << f << '\n';
+    }
+
+    log << "PSD map: " << para_files.size() << " observation points ->";
+    for (const auto& kv : counts) log << " " << kv.first << " " << kv.second;
+    log << endl;
+    return static_cast<bool>(out);
+}
+
+} // namespace psd_map
@@ -0,0 +1,149 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <filesystem>
+
+#include "result_cache.h"
+#include "particle_params.h"
+#include "path_utils.h"
+
+using namespace std;
+
+extern string exeDir;
+
+namespace result_cache {
+
+namespace {
+
+const uint64_t FNV_PRIME = 1099511628211ULL;
+const int32_t KEY_VERSION = 1;
+
+string to_hex(uint64_t h)
+{
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+    return buf;
+}
+
+} // namespace
+
+uint64_t hash_bytes(const void* data, size_t len, uint64_t h)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+bool hash_file(const string& path, uint64_t& h)
+{
+    ifstream in(path, ios::binary);
+    if (!in) return false;
+    // 可执行文件有几 MB，按 8 字节一组累加，比逐字节快得多
+    char buf[1 << 16];
+    while (in) {
+        in.read(buf, sizeof(buf));
+        size_t n = static_cast<size_t>(in.gcount());
+        size_t words = n / sizeof(uint64_t);
+        for (size_t i = 0; i < words; ++i) {
+            uint64_t w;
+            memcpy(&w, buf + i * sizeof(uint64_t), sizeof(w));
+            h ^= w;
+            h *= FNV_PRIME;
+        }
+        h = hash_bytes(buf + words * sizeof(uint64_t), n - words * sizeof(uint64_t), h);
+    }
+    return true;
+}
+
+uint64_t binary_hash()
+{
+    static uint64_t h = 0;
+    static bool done = false;
+    if (!done) {
+        h = FNV_OFFSET;
+        try {
+            hash_file(PathUtils::getExecutablePath(), h);
+        } catch (const std::exception&) {
+            // 取不到可执行文件时键里只是少了版本这一项
+        }
+        done = true;
+    }
+    return h;
+}
+
+string wave_config_file(int wave_field_model)
+{
+    const char* ext = nullptr;
+    switch (wave_field_model) {
+        case 1: ext = ".pol"; break;
+        case 2: ext = ".tor"; break;
+        case 3: ext = ".wpol"; break;
+        case 4: ext = ".wtor"; break;
+        default: return "";
+    }
+    return PathUtils::findFirstFileWithExtension(PathUtils::joinPath(exeDir, "input"), ext);
+}
+
+string particle_key(const string& para_file, const string& extra)
+{
+    ParticleParams params;
+    if (!read_particle_params(para_file, params)) return "";
+
+    // 按数值而不是文本计算，修改注释不会使结果失效
+    double values[NUM_PARTICLE_DOUBLES];
+    particle_param_doubles(params, values);
+    const int32_t ints[3] = {KEY_VERSION, params.magnetic_field_model, params.wave_field_model};
+    uint64_t h = hash_bytes(ints, sizeof(ints));
+    h = hash_bytes(values, sizeof(values), h);
+
+    string wave_file = wave_config_file(params.wave_field_model);
+    if (!wave_file.empty()) hash_file(wave_file, h);
+
+    uint64_t binary = binary_hash();
+    h = hash_bytes(&binary, sizeof(binary), h);
+    h = hash_bytes(extra.data(), extra.size(), h);
+    return to_hex(h);
+}
+
+string stamp_key(const string& output_file)
+{
+    ifstream in(stamp_path(output_file));
+    string key;
+    unsigned long long size = 0;
+    if (!in || !(in >> key >> size)) return "";
+
+    error_code ec;
+    uintmax_t actual = filesystem::file_size(output_file, ec);
+    if (ec || actual != size) return "";
+    return key;
+}
+
+bool up_to_date(const string& output_file, const string& key)
+{
+    return !key.empty() && stamp_key(output_file) == key;
+}
+
+bool write_stamp(const string& output_file, const string& key)
+{
+    error_code ec;
+    uintmax_t size = filesystem::file_size(output_file, ec);
+    if (ec || key.empty()) return false;
+
+    // 先写临时文件再改名，戳记要么完整要么不存在
+    string path = stamp_path(output_file);
+    string tmp = path + ".tmp";
+    {
+        ofstream out(tmp, ios::out | ios::trunc);
+        out << key << ' ' << static_cast<unsigned long long>(size) << '\n';
+        out.flush();
+        if (!out) return false;
+    }
+    filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+} // namespace result_cache
@@ -0,0 +1,321 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+
+#include "run_options.h"
+#include "trajectory_io.h"
+#include "trajectory_stream.h"
+#include "job_coordinator.h"
+#include "particle_params.h"
+#include "ensemble_integrator.h"
+#include "bounce_average.h"
+#include "event_detector.h"
+#include "multirate_integrator.h"
+#include "auto_steps.h"
+#include "parareal.h"
+#include "variational.h"
+#include "importance_splitting.h"
+#include "psd_mapping.h"
+#include "path_utils.h"
+
+using namespace std;
+
+RunOptions run_options;
+
+vector<string> parse_run_options(int argc, char* argv[])
+{
+    vector<string> positional;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            positional.push_back(arg);
+            continue;
+        }
+
+        size_t eq = arg.find('=');
+        string key = arg.substr(2, eq == string::npos ? string::npos : eq - 2);
+        string value = (eq == string::npos) ? "" : arg.substr(eq + 1);
+
+        if (key == "columns") {
+            run_options.diag_columns = value;
+        } else if (key == "encoding") {
+            run_options.encoding = traj_io::parse_encoding(value);
+            if (run_options.encoding < 0) {
+                cerr << "Unknown encoding: " << value << " (expected raw or compressed)" << endl;
+                exit(1);
+            }
+        } else if (key == "profile") {
+            run_options.profile = traj_io::parse_profile(value);
+            if (run_options.profile < 0) {
+                cerr << "Unknown profile: " << value << " (expected full, compact, envelope or events)" << endl;
+                exit(1);
+            }
+        } else if (key == "window") {
+            run_options.envelope_window = atoi(value.c_str());
+            if (run_options.envelope_window < 1) {
+                cerr << "Invalid envelope window: " << value << endl;
+                exit(1);
+            }
+        } else if (key == "jobs") {
+            run_options.jobs = atoi(value.c_str());
+            if (run_options.jobs < 1) {
+                cerr << "Invalid number of jobs: " << value << endl;
+                exit(1);
+            }
+        } else if (key == "stream") {
+            if (!traj_stream::valid_target(value)) {
+                cerr << "Invalid stream target: " << value << " (expected fifo:PATH or unix:PATH)" << endl;
+                exit(1);
+            }
+            run_options.stream = value;
+        } else if (key == "shard") {
+            char extra;
+            if (sscanf(value.c_str(), "%d/%d%c", &run_options.shard_index, &run_options.shard_count, &extra) != 2 ||
+                run_options.shard_count < 1 || run_options.shard_index < 0 ||
+                run_options.shard_index >= run_options.shard_count) {
+                cerr << "Invalid shard: " << value << " (expected k/N with 0 <= k < N)" << endl;
+                exit(1);
+            }
+        } else if (key == "prefork") {
+            run_options.prefork = true;
+        } else if (key == "pin") {
+            run_options.pin = true;
+        } else if (key == "ensemble") {
+            run_options.ensemble = value.empty() ? lockstep::DEFAULT_SIZE : atoi(value.c_str());
+            if (run_options.ensemble < 1 || run_options.ensemble > lockstep::MAX_SIZE) {
+                cerr << "Invalid ensemble size: " << value << " (expected 1.." << lockstep::MAX_SIZE << ")" << endl;
+                exit(1);
+            }
+        } else if (key == "symmetry") {
+            run_options.symmetry = value.empty() ? HUGE_VAL : atof(value.c_str());
+            if (!(run_options.symmetry > 0.0)) {
+                cerr << "Invalid symmetry tolerance: " << value << " (expected a positive number of RE)" << endl;
+                exit(1);
+            }
+        } else if (key == "bounce-average") {
+            run_options.bounce_average = value.empty() ? bounce_avg::DEFAULT_RATIO : atof(value.c_str());
+            if (!(run_options.bounce_average > 0.0)) {
+                cerr << "Invalid adiabaticity ratio: " << value << " (expected a positive number)" << endl;
+                exit(1);
+            }
+        } else if (key == "auto-steps") {
+            run_options.auto_steps = value.empty() ? auto_steps::DEFAULT_STEPS_PER_PERIOD : atof(value.c_str());
+            if (!(run_options.auto_steps >= 1.0)) {
+                cerr << "Invalid number of steps per period: " << value << " (expected a number >= 1)" << endl;
+                exit(1);
+            }
+        } else if (key == "parareal") {
+            int slices = max(2, static_cast<int>(thread::hardware_concurrency()));
+            int ratio = parareal::DEFAULT_COARSE_RATIO;
+            char extra;
+            int n = value.empty() ? 0 : sscanf(value.c_str(), "%d:%d%c", &slices, &ratio, &extra);
+            if (n > 2 || (!value.empty() && n < 1) || slices < 2 || slices > parareal::MAX_SLICES || ratio < 1) {
+                cerr << "Invalid parareal slices: " << value << " (expected S[:R] with 2 <= S <= " << parareal::MAX_SLICES
+                     << " and R >= 1)" << endl;
+                exit(1);
+            }
+            run_options.parareal = min(slices, parareal::MAX_SLICES);
+            run_options.parareal_coarse = ratio;
+        } else if (key == "multirate") {
+            run_options.multirate = value.empty() ? multirate::DEFAULT_TOL : atof(value.c_str());
+            if (!(run_options.multirate > 0.0)) {
+                cerr << "Invalid multirate tolerance: " << value << " (expected a positive number)" << endl;
+                exit(1);
+            }
+        } else if (key == "variational") {
+            if (value.empty() || value == "matrix") run_options.variational = variational::MATRIX;
+            else if (value == "ftle") run_options.variational = variational::FTLE;
+            else {
+                cerr << "Invalid variational output: " << value << " (expected matrix or ftle)" << endl;
+                exit(1);
+            }
+        } else if (key == "split") {
+            splitting::Spec spec;
+            string error;
+            if (!splitting::parse_spec(value, spec, error)) {
+                cerr << "Invalid split: " << value << " (" << error << ")" << endl;
+                exit(1);
+            }
+            run_options.split = value;
+        } else if (key == "split-member") {
+            splitting::Member m;
+            if (!splitting::decode_member(value, m)) {
+                cerr << "Invalid split member: " << value << " (expected weight,level,seed,has_wave_seed,wave_seed)" << endl;
+                exit(1);
+            }
+            run_options.split_member = value;
+        } else if (key == "psd-map") {
+            // the particle processes may run elsewhere: pass the model file by absolute path
+            string path = PathUtils::isAbsolutePath(value) ? value : PathUtils::joinPath(PathUtils::getWorkingDirectory(), value);
+            auto model = make_shared<psd_map::Model>();
+            string error;
+            if (value.empty() || !psd_map::load_model(path, *model, error)) {
+                cerr << "Invalid PSD boundary model: " << (value.empty() ? "no file given" : error) << endl;
+                exit(1);
+            }
+            run_options.psd_map = path;
+            run_options.psd_model = model;
+        } else if (key == "events") {
+            vector<events::Event> list;
+            string error;
+            if (!events::parse_events(value, list, error)) {
+                cerr << "Invalid events: " << value << " (" << error << ")" << endl;
+                exit(1);
+            }
+            run_options.events = value;
+        } else if (key == "checkpoint") {
+            run_options.checkpoint = atof(value.c_str());
+            if (!(run_options.checkpoint >= 0.0)) {
+                cerr << "Invalid checkpoint interval: " << value << endl;
+                exit(1);
+            }
+        } else if (key == "resume") {
+            run_options.resume = true;
+        } else if (key == "force") {
+            run_options.force = true;
+        } else if (key == "merge-shards") {
+            run_options.merge_shards = true;
+        } else if (key == "serve" || key == "worker") {
+            if (!job_queue::valid_address(value)) {
+                cerr << "Invalid coordinator address: " << value << " (expected unix:PATH or tcp:HOST:PORT)" << endl;
+                exit(1);
+            }
+            (key == "serve" ? run_options.serve : run_options.worker) = value;
+        } else if (key == "lease") {
+            run_options.lease = atof(value.c_str());
+            if (!(run_options.lease > 0.0)) {
+                cerr << "Invalid lease: " << value << endl;
+                exit(1);
+            }
+        } else if (key == "retries") {
+            run_options.retries = atoi(value.c_str());
+            if (run_options.retries < 0) {
+                cerr << "Invalid number of retries: " << value << endl;
+                exit(1);
+            }
+        } else if (key == "params") {
+            ParticleParams params;
+            if (!decode_particle_params(value, params)) {
+                cerr << "Invalid particle parameters: " << value << " (expected 16 comma-separated values)" << endl;
+                exit(1);
+            }
+            run_options.params = value;
+        } else if (key == "board") {
+            size_t colon = value.find(':');
+            if (colon == 0 || colon == string::npos || colon + 1 == value.size() ||
+                value.find_first_not_of("0123456789") != colon) {
+                cerr << "Invalid progress board: " << value << " (expected SLOT:PATH)" << endl;
+                exit(1);
+            }
+            run_options.board = value;
+        } else if (key == "status") {
+            if (value != "" && value != "all") {
+                cerr << "Invalid status option: " << value << " (expected --status or --status=all)" << endl;
+                exit(1);
+            }
+            run_options.status = value.empty() ? 1 : 2;
+        } else if (key == "t_range") {
+            char extra;
+            if (sscanf(value.c_str(), "%lf,%lf%c", &run_options.t_begin, &run_options.t_end, &extra) != 2) {
+                cerr << "Invalid time range: " << value << " (expected t0,t1)" << endl;
+                exit(1);
+            }
+            run_options.t_range = value;
+        } else {
+            cerr << "Unknown option: " << arg << endl;
+            exit(1);
+        }
+    }
+    if (run_options.profile == traj_io::PROFILE_COMPACT && run_options.encoding == traj_io::ENCODING_COMPRESSED) {
+        cerr << "The compact profile cannot be combined with --encoding=compressed" << endl;
+        exit(1);
+    }
+    if (run_options.profile == traj_io::PROFILE_EVENTS && run_options.events.empty() && run_options.psd_map.empty()) {
+        cerr << "--profile=events requires --events=LIST or --psd-map=FILE" << endl;
+        exit(1);
+    }
+    if (run_options.parareal > 0 && (run_options.bounce_average > 0.0 || run_options.multirate > 0.0 ||
+                                     run_options.auto_steps > 0.0 || !run_options.events.empty())) {
+        cerr << "--parareal cannot be combined with --bounce-average, --multirate, --auto-steps or --events" << endl;
+        exit(1);
+    }
+    if (run_options.variational != variational::NONE &&
+        (run_options.bounce_average > 0.0 || run_options.multirate > 0.0 || run_options.parareal > 0 ||
+         !run_options.stream.empty())) {
+        cerr << "--variational cannot be combined with --bounce-average, --multirate, --parareal or --stream" << endl;
+        exit(1);
+    }
+    if (!run_options.split.empty() &&
+        (run_options.bounce_average > 0.0 || run_options.parareal > 0 || !run_options.stream.empty() ||
+         !run_options.serve.empty() || !run_options.worker.empty())) {
+        cerr << "--split cannot be combined with --bounce-average, --parareal, --stream, --serve or --worker" << endl;
+        exit(1);
+    }
+    if (!run_options.psd_map.empty()) {
+        if (run_options.bounce_average > 0.0 || run_options.parareal > 0 || !run_options.stream.empty() ||
+            !run_options.serve.empty() || !run_options.worker.empty() || !run_options.split.empty()) {
+            cerr << "--psd-map cannot be combined with --bounce-average, --parareal, --stream, --serve, --worker or --split" << endl;
+            exit(1);
+        }
+        if (run_options.profile == traj_io::PROFILE_COMPACT || run_options.profile == traj_io::PROFILE_ENVELOPE) {
+            cerr << "--psd-map writes no trajectories, --profile cannot be compact or envelope" << endl;
+            exit(1);
+        }
+        // only the endpoints are stored
+        run_options.profile = traj_io::PROFILE_EVENTS;
+    }
+    if (!run_options.serve.empty() && !run_options.worker.empty()) {
+        cerr << "--serve and --worker cannot be combined" << endl;
+        exit(1);
+    }
+    if (!run_options.params.empty()) {
+        // 清单中的粒子：参数由主进程给出，不再读清单
+        if (positional.empty()) {
+            cerr << "--params requires a particle" << endl;
+            exit(1);
+        }
+        ParticleParams params;
+        decode_particle_params(run_options.params, params);
+        register_particle_params(positional[0], params);
+    }
+    return positional;
+}
+
+vector<string> forward_run_options()
+{
+    vector<string> args;
+    auto exact = [](double x) {
+        ostringstream out;
+        out << setprecision(17) << x;   // to_string 只有 6 位小数
+        return out.str();
+    };
+    if (!run_options.diag_columns.empty()) args.push_back("--columns=" + run_options.diag_columns);
+    if (run_options.encoding == traj_io::ENCODING_COMPRESSED) args.push_back("--encoding=compressed");
+    if (!run_options.t_range.empty()) args.push_back("--t_range=" + run_options.t_range);
+    if (!run_options.stream.empty()) args.push_back("--stream=" + run_options.stream);
+    if (run_options.checkpoint != RunOptions().checkpoint) args.push_back("--checkpoint=" + exact(run_options.checkpoint));
+    if (run_options.resume) args.push_back("--resume");
+    if (run_options.bounce_average > 0.0) args.push_back("--bounce-average=" + exact(run_options.bounce_average));
+    if (run_options.auto_steps > 0.0) args.push_back("--auto-steps=" + exact(run_options.auto_steps));
+    if (run_options.parareal > 0) {
+        args.push_back("--parareal=" + to_string(run_options.parareal) + ":" + to_string(run_options.parareal_coarse));
+    }
+    if (run_options.multirate > 0.0) args.push_back("--multirate=" + exact(run_options.multirate));
+    if (run_options.variational == variational::MATRIX) args.push_back("--variational=matrix");
+    if (run_options.variational == variational::FTLE) args.push_back("--variational=ftle");
+    if (!run_options.split.empty()) args.push_back("--split=" + run_options.split);
+    if (!run_options.psd_map.empty()) args.push_back("--psd-map=" + run_options.psd_map);
+    if (!run_options.events.empty()) args.push_back("--events=" + run_options.events);
+    if (run_options.profile == traj_io::PROFILE_COMPACT) args.push_back("--profile=compact");
+    if (run_options.profile == traj_io::PROFILE_EVENTS) args.push_back("--profile=events");
+    if (run_options.profile == traj_io::PROFILE_ENVELOPE) {
+        args.push_back("--profile=envelope");
+        args.push_back("--window=" + to_string(run_options.envelope_window));
+    }
+    return args;
+}
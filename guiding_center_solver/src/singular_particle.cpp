@@ -12,6 +12,21 @@
 #include "path_utils.h"
 #include "field_calculator.h"
 #include "particle_calculator.h"
+#include "run_options.h"
+#include "particle_params.h"
+#include "trajectory_io.h"
+#include "trajectory_stream.h"
+#include "checkpoint.h"
+#include "result_cache.h"
+#include "progress_board.h"
+#include "bounce_average.h"
+#include "event_detector.h"
+#include "multirate_integrator.h"
+#include "auto_steps.h"
+#include "parareal.h"
+#include "variational.h"
+#include "importance_splitting.h"
+#include "psd_mapping.h"
 
 
 using namespace std;
@@ -27,17 +42,26 @@ double dt;
 double t_step, r_step;
 int magnetic_field_model, wave_field_model;
 
-const double c = 47.055; // Speed of light in RE/s
+namespace {
 
-VectorXd dydt(const VectorXd& arr_in)
-{
+// 导心方程右端用到的场量：B、E、|B| 的梯度和磁力线曲率（dydt 与其雅可比矩阵共用）
+struct DriftFields {
+    Vector3d B, E, grad_B, curv_B;
+};
 
-    if (arr_in.size() != 5)
-    {
-        cerr << "Input vector must have exactly 5 elements." << endl;
-        return {};
-    }
+DriftFields drift_fields(double t, double x, double y, double z)
+{
+    DriftFields f;
+    f.B = Bvec(t, x, y, z);
+    f.E = Evec(t, x, y, z);
+    VectorXd dB = B_grad_curv(t, x, y, z, r_step);
+    f.grad_B = Vector3d(dB[0], dB[1], dB[2]);
+    f.curv_B = Vector3d(dB[3], dB[4], dB[5]);
+    return f;
+}
 
+VectorXd drift_rate(const VectorXd& arr_in, const DriftFields& fields)
+{
     VectorXd arr_out(5);
 
     double t = arr_in[0];
@@ -45,30 +69,12 @@ VectorXd dydt(const VectorXd& arr_in)
     double y = arr_in[2];
     double z = arr_in[3];
     double p_para = arr_in[4];
-    
-    // Calculate the magnetic field B, electric field E, and their derivatives
-    Vector3d B = Bvec(t, x, y, z);
-    double Bt = sqrt(B[0] * B[0] + B[1] * B[1] + B[2] * B[2]);
-    Vector3d E = Evec(t, x, y, z);
 
-    VectorXd dB = B_grad_curv(t, x, y, z, r_step);
-    Vector3d grad_B(dB[0], dB[1], dB[2]);
-    Vector3d curv_B(dB[3], dB[4], dB[5]);
-    Vector3d unit_B(B[0] / Bt, B[1] / Bt, B[2] / Bt);
-
-    // Calculate the drift velocities
-    double gamm = sqrt(1. + pow(p_para * c, 2) / pow(E0, 2) + 2. * mu * Bt / E0);
-    Vector3d vd_ExB = E.cross(B) / Bt / Bt * 0.15696123;                                                 // ExB drift velocity in RE/s
-    Vector3d vd_grad = mu * B.cross(grad_B) / (gamm * q * pow(Bt, 2)) * 24.6368279;                      // gradient drift velocity in RE/s
-    Vector3d vd_curv = pow(p_para * c, 2) / (gamm * E0 * q * pow(Bt, 2)) * B.cross(curv_B) * 24.6368279; // curvature drift velocity in RE/s
-    Vector3d v_para = p_para * pow(c, 2) / (gamm * E0) * unit_B;                                         // parallel velocity in RE/s
-    Vector3d v_total = vd_ExB + vd_grad + vd_curv + v_para;
-
-    // Calculate the changing rate of parallel momentum
-    double dp_dt_1 = -mu / gamm * grad_B.dot(unit_B);
-    double dp_dt_2 = q * E.dot(unit_B) * 6.371e-3;
-    double dp_dt_3 = gamm * E0 / pow(c, 2) * v_total.dot(deb_dt(t, x, y, z, v_total, r_step));
-    double dp_dt = dp_dt_1 + dp_dt_2 + dp_dt_3;
+    // the drift velocities and the changing rate of parallel momentum
+    DriftTerms d = drift_terms(E0, mu, q, p_para, fields.B, fields.E, fields.grad_B, fields.curv_B);
+    const Vector3d& v_total = d.v_total;
+    double dp_dt_3 = d.dp_coef * v_total.dot(deb_dt(t, x, y, z, v_total, r_step));
+    double dp_dt = d.dp_dt_1 + d.dp_dt_2 + dp_dt_3;
 
     // double pB_pt = pBpt(t, x, y, z, t_step);
 
@@ -81,22 +87,185 @@ VectorXd dydt(const VectorXd& arr_in)
     // debug information
     if (false)
     {
-        cout << "B: " << B.transpose() << endl;
-        cout << "Bt: " << Bt << endl;
-        cout << "E: " << E.transpose() << endl;
+        cout << "B: " << fields.B.transpose() << endl;
+        cout << "Bt: " << fields.B.norm() << endl;
+        cout << "E: " << fields.E.transpose() << endl;
         cout << "\nPosition: [" << arr_in[1] << ", " << arr_in[2] << ", " << arr_in[3] << "]" << endl;
-        cout << "vd_ExB: [" << vd_ExB[0] << ", " << vd_ExB[1] << ", " << vd_ExB[2] << "]" << endl;
-        cout << "vd_grad: [" << vd_grad[0] << ", " << vd_grad[1] << ", " << vd_grad[2] << "]" << endl;
-        cout << "vd_curv: [" << vd_curv[0] << ", " << vd_curv[1] << ", " << vd_curv[2] << "]" << endl;
-        cout << "v_para: [" << v_para[0] << ", " << v_para[1] << ", " << v_para[2] << "]" << endl;
-        cout << "dp1: " << dp_dt_1 * dt << endl;
-        cout << "dp2: " << dp_dt_2 * dt << endl;
+        cout << "vd_ExB: [" << d.vd_ExB[0] << ", " << d.vd_ExB[1] << ", " << d.vd_ExB[2] << "]" << endl;
+        cout << "vd_grad: [" << d.vd_grad[0] << ", " << d.vd_grad[1] << ", " << d.vd_grad[2] << "]" << endl;
+        cout << "vd_curv: [" << d.vd_curv[0] << ", " << d.vd_curv[1] << ", " << d.vd_curv[2] << "]" << endl;
+        cout << "v_para: [" << d.v_para[0] << ", " << d.v_para[1] << ", " << d.v_para[2] << "]" << endl;
+        cout << "dp1: " << d.dp_dt_1 * dt << endl;
+        cout << "dp2: " << d.dp_dt_2 * dt << endl;
         cout << "dp3: " << dp_dt_3 * dt << endl;
         cout << "dp: " << dp_dt * dt << endl;
     }
     return arr_out;
 }
 
+} // namespace
+
+DriftTerms drift_terms(double E0, double mu, double q, double p_para, const Vector3d& B, const Vector3d& E,
+                       const Vector3d& grad_B, const Vector3d& curv_B, double gamm)
+{
+    DriftTerms d;
+    double Bt = sqrt(B[0] * B[0] + B[1] * B[1] + B[2] * B[2]);
+    d.unit_B = Vector3d(B[0] / Bt, B[1] / Bt, B[2] / Bt);
+
+    if (gamm == 0.0) gamm = sqrt(1. + pow(p_para * c, 2) / pow(E0, 2) + 2. * mu * Bt / E0);
+    d.gamm = gamm;
+    d.vd_ExB = E.cross(B) / Bt / Bt * 0.15696123;                                                 // ExB drift velocity in RE/s
+    d.vd_grad = mu * B.cross(grad_B) / (gamm * q * pow(Bt, 2)) * 24.6368279;                      // gradient drift velocity in RE/s
+    d.vd_curv = pow(p_para * c, 2) / (gamm * E0 * q * pow(Bt, 2)) * B.cross(curv_B) * 24.6368279; // curvature drift velocity in RE/s
+    d.v_para = p_para * pow(c, 2) / (gamm * E0) * d.unit_B;                                       // parallel velocity in RE/s
+    d.v_total = d.vd_ExB + d.vd_grad + d.vd_curv + d.v_para;
+
+    d.dp_dt_1 = -mu / gamm * grad_B.dot(d.unit_B);
+    d.dp_dt_2 = q * E.dot(d.unit_B) * 6.371e-3;
+    d.dp_coef = gamm * E0 / pow(c, 2);
+    return d;
+}
+
+VectorXd dydt(const VectorXd& arr_in)
+{
+
+    if (arr_in.size() != 5)
+    {
+        cerr << "Input vector must have exactly 5 elements." << endl;
+        return {};
+    }
+    return drift_rate(arr_in, drift_fields(arr_in[0], arr_in[1], arr_in[2], arr_in[3]));
+}
+
+VectorXd dydt_jacobian(const VectorXd& Y, Matrix<double, 5, 5>& J, bool time_column)
+{
+    FieldJet jet = field_jet(Y[0], Y[1], Y[2], Y[3], r_step);
+    DriftFields fields;
+    fields.B = jet.B;
+    fields.E = jet.E;
+    fields.grad_B = Vector3d(jet.grad_curv[0], jet.grad_curv[1], jet.grad_curv[2]);
+    fields.curv_B = Vector3d(jet.grad_curv[3], jet.grad_curv[4], jet.grad_curv[5]);
+    VectorXd f = drift_rate(Y, fields);
+
+    // x, y, z: the fields at Y ± r_step e_k from their first-order expansion (derivatives of grad |B| and
+    // of the curvature from the second derivatives of B), so only deb_dt is evaluated at the shifted points
+    double Bt = jet.B.norm();
+    Vector3d b = jet.B / Bt;
+    Vector3d g = jet.dB.transpose() * b;             // g_j = ∂_j |B|
+    Matrix3d db = (jet.dB - b * g.transpose()) / Bt; // db(i, j) = ∂_j b_i
+    for (int k = 0; k < 3; ++k)
+    {
+        const Matrix3d& d2 = jet.d2B[k];                               // d2(i, j) = ∂_j ∂_k B_i
+        Vector3d dg = jet.dB.transpose() * db.col(k) + d2.transpose() * b; // ∂_k g
+        Matrix3d ddb = (d2 - db.col(k) * g.transpose() - b * dg.transpose() - db * g[k]) / Bt; // ∂_k db
+        DriftFields fp, fm;
+        fp.B = fields.B + r_step * jet.dB.col(k);
+        fm.B = fields.B - r_step * jet.dB.col(k);
+        fp.E = fields.E + r_step * jet.dE.col(k);
+        fm.E = fields.E - r_step * jet.dE.col(k);
+        fp.grad_B = fields.grad_B + r_step * dg;
+        fm.grad_B = fields.grad_B - r_step * dg;
+        Vector3d dcurv = db * db.col(k) + ddb * b;                     // ∂_k (Σ_j b_j ∂_j b)
+        fp.curv_B = fields.curv_B + r_step * dcurv;
+        fm.curv_B = fields.curv_B - r_step * dcurv;
+        VectorXd Yp = Y, Ym = Y;
+        Yp[k + 1] += r_step;
+        Ym[k + 1] -= r_step;
+        J.col(k + 1) = (drift_rate(Yp, fp) - drift_rate(Ym, fm)) / (2.0 * r_step);
+    }
+
+    // t: central difference of dydt with t_step
+    if (time_column)
+    {
+        VectorXd Yp = Y, Ym = Y;
+        Yp[0] += t_step;
+        Ym[0] -= t_step;
+        J.col(0) = (dydt(Yp) - dydt(Ym)) / (2.0 * t_step);
+    }
+    else
+    {
+        J.col(0).setZero();
+    }
+
+    // p_para: the fields do not depend on it, central difference with the fields at Y
+    double p = sqrt(Y[4] * Y[4] + 2.0 * mu * Bt * E0 / (c * c));
+    double hp = 1e-6 * p;
+    VectorXd Yp = Y, Ym = Y;
+    Yp[4] += hp;
+    Ym[4] -= hp;
+    J.col(4) = (drift_rate(Yp, fields) - drift_rate(Ym, fields)) / (2.0 * hp);
+    return f;
+}
+
+// 紧凑方案本身就是定长记录，不再压缩；events 方案只有事件记录
+int output_encoding()
+{
+    return (run_options.profile == traj_io::PROFILE_COMPACT || run_options.profile == traj_io::PROFILE_EVENTS)
+               ? traj_io::ENCODING_RAW : run_options.encoding;
+}
+
+std::string trajectory_output_path(const std::string& outFileBase)
+{
+    // a mapping run (--psd-map) stores only the endpoint
+    if (!run_options.psd_map.empty()) return psd_map::endpoint_path(outFileBase);
+    return traj_io::encoded_path(outFileBase, traj_io::profile_ext(run_options.profile), output_encoding());
+}
+
+std::string solver_cache_key(const std::string& para_file)
+{
+    ostringstream extra;
+    extra << "solver profile=" << run_options.profile << " encoding=" << output_encoding();
+    if (run_options.profile == traj_io::PROFILE_ENVELOPE) extra << " window=" << run_options.envelope_window;
+    if (run_options.bounce_average > 0.0) extra << " bounce_average=" << run_options.bounce_average;
+    if (!run_options.events.empty()) extra << " events=" << run_options.events;
+    if (run_options.variational != variational::NONE) extra << " variational=" << run_options.variational;
+    if (run_options.multirate > 0.0) extra << " multirate=" << run_options.multirate;
+    if (run_options.auto_steps > 0.0) extra << " auto_steps=" << run_options.auto_steps;
+    if (run_options.parareal > 0) extra << " parareal=" << run_options.parareal << ":" << run_options.parareal_coarse;
+    if (!run_options.split.empty()) extra << " split=" << run_options.split;
+    // the boundaries only: the boundary PSD is sampled by the main process
+    if (run_options.psd_model) extra << " " << psd_map::boundary_key(*run_options.psd_model);
+    return result_cache::particle_key(para_file, extra.str());
+}
+
+// 事件记录 (.gce) 写入器。检查点中的状态前面是 --events 的值和 '\0'，与本次不同时不能继续
+static std::unique_ptr<traj_io::TrajectoryWriter> open_event_writer(const std::string& outFileBase, const std::string* resume_state)
+{
+    string prefix = "GCEV";
+    int32_t count = 0;
+    prefix.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    if (!resume_state) return traj_io::open_writer(outFileBase, ".gce", traj_io::ENCODING_RAW, events::NCOLS, prefix, 4);
+
+    size_t sep = resume_state->find('\0');
+    if (sep == string::npos || resume_state->compare(0, sep, run_options.events) != 0) return nullptr;
+    auto writer = traj_io::open_writer(outFileBase, ".gce", traj_io::ENCODING_RAW, events::NCOLS, prefix, 4, true);
+    const char* p = resume_state->data() + sep + 1;
+    if (!writer->restore(p, resume_state->data() + resume_state->size()) || !writer->good()) return nullptr;
+    return writer;
+}
+
+void log_particle_params(std::ostream& log, const ParticleParams& params, const std::string& outFilePath)
+{
+    log << "Parameters loaded successfully:" << endl;
+    log << "  Particle properties:" << endl;
+    log << "    E0 = " << params.E0 << " MeV (rest energy)" << endl;
+    log << "    q = " << params.q << " e (charge)" << endl;
+    log << "    Ek = " << params.Ek << " MeV (kinetic energy)" << endl;
+    log << "    pa = " << params.pa << " degrees (pitch angle)" << endl;
+    log << "  Time parameters:" << endl;
+    log << "    dt = " << params.dt << " s (time step)" << endl;
+    log << "    t_ini = " << params.t_ini << " s (initial time)" << endl;
+    log << "    t_interval = " << params.t_interval << " s (simulation duration)" << endl;
+    log << "    write_interval = " << params.write_interval << " s (output interval)" << endl;
+    log << "  Spatial parameters:" << endl;
+    log << "    Initial position: [" << params.xgsm << ", " << params.ygsm << ", " << params.zgsm << "] RE" << endl;
+    log << "    atmosphere_altitude = " << params.atmosphere_altitude << " km" << endl;
+    log << "  Numerical parameters:" << endl;
+    log << "    t_step = " << params.t_step << " s (field time step)" << endl;
+    log << "    r_step = " << params.r_step << " RE (field spatial step)" << endl;
+    log << "Output file: " << outFilePath << endl;
+}
+
 int singular_particle(const std::string& para_file)
 {
     // 1. 创建目录结构使用PathUtils
@@ -139,54 +308,46 @@ int singular_particle(const std::string& para_file)
     logFile << "Log file: " << logFilePath << endl;
     
     // Read parameters from para_file
-    double t_ini, t_interval, write_interval;
-    double xgsm, ygsm, zgsm, Ek, pa;
-    double atmosphere_altitude;
-
-    ifstream para_in(para_file);
-    if (!para_in) {
+    ParticleParams params;
+    if (!read_particle_params(para_file, params)) {
         logFile << "ERROR: Failed to open parameter file: " << para_file << endl;
         cerr << "Failed to open parameter file: " << para_file << endl;
         logFile.close();
         exit(1);
     }
-    
     logFile << "Reading parameters from file..." << endl;
-    string line;
-    int idx = 0;
-    while (getline(para_in, line)) {
-        if (line.empty()) continue;
-        
-        size_t pos = line.find(';');
-        string value_str = (pos != string::npos) ? line.substr(0, pos) : line;
-        istringstream iss(value_str);
-        double val;
-        if (!(iss >> val)) continue;
-        switch (idx) {
-            case 0: dt = val; break;
-            case 1: E0 = val; break;
-            case 2: q = val; break;
-            case 3: t_ini = val; break;
-            case 4: t_interval = val; break;
-            case 5: write_interval = val; break;
-            case 6: xgsm = val; break;
-            case 7: ygsm = val; break;
-            case 8: zgsm = val; break;
-            case 9: Ek = val; break;
-            case 10: pa = val; break;
-            case 11: atmosphere_altitude = val; break;
-            case 12: t_step = val; break;
-            case 13: r_step = val; break;
-            case 14: magnetic_field_model = static_cast<int>(val); break;
-            case 15: wave_field_model = static_cast<int>(val); break;
-            default: break;
-        }
-        ++idx;
+
+    dt = params.dt;
+    E0 = params.E0;
+    q = params.q;
+    t_step = params.t_step;
+    r_step = params.r_step;
+    magnetic_field_model = params.magnetic_field_model;
+    wave_field_model = params.wave_field_model;
+    double t_ini = params.t_ini, t_interval = params.t_interval, write_interval = params.write_interval;
+    double xgsm = params.xgsm, ygsm = params.ygsm, zgsm = params.zgsm, Ek = params.Ek, pa = params.pa;
+    double atmosphere_altitude = params.atmosphere_altitude;
+
+    // backward tracing from the observation point to the boundaries (--psd-map)
+    bool mapping = run_options.psd_model != nullptr;
+    if (mapping) dt = -fabs(dt);
+
+    // a split child continues with the random wave phases of its parent (--split)
+    splitting::Member split_member;
+    if (!run_options.split.empty())
+    {
+        split_member = splitting::member(para_file);
+        if (split_member.has_wave_seed) restore_wave_seed(wave_field_model, split_member.wave_seed);
     }
-    para_in.close();
 
     // 4. 输出文件路径使用PathUtils
-    string outFilePath = PathUtils::joinPath(outputDir, base_filename + ".gct");
+    string outFileBase = PathUtils::joinPath(outputDir, base_filename);
+    int encoding = output_encoding();
+    string outFilePath = trajectory_output_path(outFileBase);
+    if (!run_options.stream.empty()) outFilePath = "stream " + run_options.stream;
+    else result_cache::clear_stamp(outFilePath);  // 重写期间输出文件不算最新
+    if (mapping) remove(outFilePath.c_str());  // no stale endpoint if this run fails
+    if (!run_options.split.empty()) remove((outFileBase + ".split").c_str());  // nor stale split records
     // char filename[256];
     // snprintf(filename, sizeof(filename),
     //          "E0_%.2f_q_%.2f_tini_%d_x_%.2f_y_%.2f_z_%.2f_Ek_%.2f_pa_%.2f.gct",
@@ -195,24 +356,7 @@ int singular_particle(const std::string& para_file)
     
     
     // log the detailed parameters
-    logFile << "Parameters loaded successfully:" << endl;
-    logFile << "  Particle properties:" << endl;
-    logFile << "    E0 = " << E0 << " MeV (rest energy)" << endl;
-    logFile << "    q = " << q << " e (charge)" << endl;
-    logFile << "    Ek = " << Ek << " MeV (kinetic energy)" << endl;
-    logFile << "    pa = " << pa << " degrees (pitch angle)" << endl;
-    logFile << "  Time parameters:" << endl;
-    logFile << "    dt = " << dt << " s (time step)" << endl;
-    logFile << "    t_ini = " << t_ini << " s (initial time)" << endl;
-    logFile << "    t_interval = " << t_interval << " s (simulation duration)" << endl;
-    logFile << "    write_interval = " << write_interval << " s (output interval)" << endl;
-    logFile << "  Spatial parameters:" << endl;
-    logFile << "    Initial position: [" << xgsm << ", " << ygsm << ", " << zgsm << "] RE" << endl;
-    logFile << "    atmosphere_altitude = " << atmosphere_altitude << " km" << endl;
-    logFile << "  Numerical parameters:" << endl;
-    logFile << "    t_step = " << t_step << " s (field time step)" << endl;
-    logFile << "    r_step = " << r_step << " RE (field spatial step)" << endl;
-    logFile << "Output file: " << outFilePath << endl;
+    log_particle_params(logFile, params, outFilePath);
 
     // pre-parameter calculations
     double t_end = t_ini + t_interval*abs(dt)/dt;
@@ -224,6 +368,30 @@ int singular_particle(const std::string& para_file)
 
     int write_step = static_cast<int>(write_interval / abs(dt));
     int32_t write_count = num_steps / write_step + 1; // 用int64_t替换long
+
+    // automatic steps (--auto-steps): dt and r_step from the local scales, dt divides write_interval
+    double dt_sign = (dt < 0) ? -1.0 : 1.0;
+    auto log_auto_steps = [&](const auto_steps::Scales& s) {
+        logFile << "dt = " << dt << " s, r_step = " << r_step << " RE (bounce period " << s.tau_b << " s, L = " << s.L
+                << ", lambda = " << s.lambda * 180.0 / M_PI << " deg, B/|grad B| = " << s.grad_length << " RE";
+        if (std::isfinite(s.wave_period)) logFile << ", wave period " << s.wave_period << " s";
+        logFile << ")" << endl;
+    };
+    if (run_options.auto_steps > 0.0)
+    {
+        VectorXd Y_ini(5);
+        Y_ini << t_ini, xgsm, ygsm, zgsm, p_para;
+        auto_steps::Scales s = auto_steps::local_scales(Y_ini);
+        int32_t intervals = static_cast<int32_t>(floor(t_interval / write_interval + 1e-9));
+        write_step = auto_steps::steps_per_write(s, write_interval, run_options.auto_steps);
+        dt = dt_sign * write_interval / write_step;
+        r_step = auto_steps::r_step_for(s);
+        num_steps = intervals * write_step;
+        write_count = intervals + 1;
+        logFile << "Automatic steps (--auto-steps=" << run_options.auto_steps << " steps per period, .para dt and r_step not used):" << endl;
+        logFile << "  ";
+        log_auto_steps(s);
+    }
     
     // log the simulation setup
     logFile << "Simulation setup:" << endl;
@@ -236,77 +404,470 @@ int singular_particle(const std::string& para_file)
     logFile << "  Write every " << write_step << " steps" << endl;
     logFile << "  Expected output records = " << write_count << endl;
     
-    // Write the number of writes to the beginning of the file
-    ofstream outfile(outFilePath, ios::binary | ios::trunc);
-    if (!outfile)
+    // continue from the checkpoint of an interrupted run of the same particle
+    string checkpointPath = outFileBase + ".ckpt";
+    bool use_checkpoint = run_options.checkpoint > 0.0 && run_options.stream.empty() && run_options.parareal == 0 &&
+                          run_options.split.empty();
+    Checkpoint ck;
+    string cache_key = solver_cache_key(para_file);
+    unique_ptr<traj_io::TrajectoryWriter> outfile, eventfile, varfile;
+    unique_ptr<multirate::Integrator> multi;
+    if (run_options.multirate > 0.0) multi.reset(new multirate::Integrator(run_options.multirate));
+    string eventFilePath = outFileBase + ".gce";
+    string varFilePath = outFileBase + ".gcv";
+    variational::Matrix5d Phi;
+    if (run_options.resume && use_checkpoint && load_checkpoint(checkpointPath, ck))
+    {
+        if (!checkpoint_matches(ck, params, run_options.profile, encoding, run_options.envelope_window, cache_key))
+        {
+            logFile << "Checkpoint " << checkpointPath << " belongs to another run (parameters, wave configuration, Solver or options), starting over" << endl;
+        }
+        else
+        {
+            outfile = traj_io::open_trajectory_writer(outFileBase, run_options.profile, encoding, write_count,
+                                                      write_step * dt, run_options.envelope_window, &ck.writer_state);
+            if (!outfile) logFile << "Failed to reopen " << outFilePath << " at the checkpoint, starting over" << endl;
+            else if (!run_options.events.empty() && !(eventfile = open_event_writer(outFileBase, &ck.events_state)))
+            {
+                logFile << "Failed to reopen " << eventFilePath << " at the checkpoint, starting over" << endl;
+                outfile.reset();
+            }
+            else if (run_options.auto_steps == 0.0 && (ck.dt != dt || ck.r_step != r_step))
+            {
+                logFile << "Checkpoint " << checkpointPath << " was written with --auto-steps, starting over" << endl;
+                outfile.reset();
+                eventfile.reset();
+            }
+            else if (multi && !multi->restore(ck.integrator_state))
+            {
+                logFile << "Checkpoint " << checkpointPath << " has no multirate state, starting over" << endl;
+                outfile.reset();
+                eventfile.reset();
+            }
+            else if (run_options.variational != variational::NONE &&
+                     !(varfile = variational::open_writer(outFileBase, run_options.variational, &ck.variational_state, Phi)))
+            {
+                logFile << "Failed to reopen " << varFilePath << " at the checkpoint, starting over" << endl;
+                outfile.reset();
+                eventfile.reset();
+            }
+        }
+    }
+    bool resumed = static_cast<bool>(outfile);
+
+    if (resumed)
+    {
+        // already opened at the checkpoint
+    }
+    else if (!run_options.stream.empty())
+    {
+        // records go to the stream consumer, nothing is written to disk
+        traj_stream::StreamMeta meta;
+        meta.magnetic_field_model = magnetic_field_model;
+        meta.wave_field_model = wave_field_model;
+        meta.expected_count = write_count;
+        meta.E0 = E0; meta.q = q; meta.Ek = Ek; meta.pa = pa;
+        meta.p = p; meta.mu = mu;
+        meta.t_ini = t_ini;
+        meta.write_dt = write_step * dt;
+        meta.name = base_filename;
+        outfile = traj_stream::open_stream_writer(run_options.stream, meta);
+    }
+    else
+    {
+        // The number of writes is stored at the beginning of the file (and corrected on close)
+        outfile = traj_io::open_trajectory_writer(
+            outFileBase, run_options.profile, encoding, write_count, write_step * dt, run_options.envelope_window);
+    }
+    if (!outfile->good())
     {
         logFile << "ERROR: Failed to open output file: " << outFilePath << endl;
         cerr << "Failed to open output file: " + outFilePath << endl;
         logFile.close();
         exit(1);
     }
-    outfile.write(reinterpret_cast<const char *>(&write_count), sizeof(int32_t)); // 明确写入8字节
+    if (!run_options.events.empty() && !resumed)
+    {
+        eventfile = open_event_writer(outFileBase, nullptr);
+        if (!eventfile->good())
+        {
+            logFile << "ERROR: Failed to open event file: " << eventFilePath << endl;
+            cerr << "Failed to open event file: " + eventFilePath << endl;
+            logFile.close();
+            exit(1);
+        }
+    }
+    if (run_options.variational != variational::NONE && !resumed)
+    {
+        varfile = variational::open_writer(outFileBase, run_options.variational, nullptr, Phi);
+        if (!varfile->good())
+        {
+            logFile << "ERROR: Failed to open variational output file: " << varFilePath << endl;
+            cerr << "Failed to open variational output file: " + varFilePath << endl;
+            logFile.close();
+            exit(1);
+        }
+    }
 
     VectorXd Y(5);
-    Y << t_ini, xgsm, ygsm, zgsm, p_para;
-    outfile.write(reinterpret_cast<const char *>(Y.data()), Y.size() * sizeof(double));
-
     int32_t actual_write_count = 1; // 用int32_t替换long
+    int32_t first_step = 1, resume_next_write = 0;
+    unsigned int seed = 0;
+    if (resumed)
+    {
+        for (int j = 0; j < 5; ++j) Y[j] = ck.Y[j];
+        mu = ck.mu;
+        if (ck.has_wave_seed) restore_wave_seed(wave_field_model, ck.wave_seed);
+        actual_write_count = static_cast<int32_t>(ck.write_count);
+        first_step = static_cast<int32_t>(ck.step) + 1;
+        if (run_options.auto_steps > 0.0)
+        {
+            // step size at the checkpoint
+            dt = ck.dt;
+            r_step = ck.r_step;
+            write_step = static_cast<int>(llround(write_interval / fabs(dt)));
+            resume_next_write = static_cast<int32_t>(ck.next_write);
+            num_steps = resume_next_write + write_step * (write_count - actual_write_count - 1);
+        }
+        logFile << "RESUMED from checkpoint " << checkpointPath << " at step " << ck.step << " (t = " << Y[0]
+                << " s, " << ck.write_count << " records written)" << endl;
+    }
+    else
+    {
+        Y << t_ini, xgsm, ygsm, zgsm, p_para;
+    }
+
+    // bounce-averaged drift (--bounce-average) as long as the particle is adiabatic
+    double r_atmosphere = 1.0 + atmosphere_altitude / 6371.0;
+    double wave_period = wave_shortest_period(wave_field_model);
+    bounce_avg::State drift;
+    bool bounce_averaged = false;
+    string reason;
+    auto adiabatic = [&]() {
+        if (wave_period >= run_options.bounce_average * drift.at.tau_b) return true;
+        ostringstream msg;
+        msg << "wave period " << wave_period << " s < " << run_options.bounce_average << " bounce periods ("
+            << drift.at.tau_b << " s)";
+        reason = msg.str();
+        return false;
+    };
+    if (run_options.bounce_average > 0.0)
+    {
+        bounce_averaged = bounce_avg::init(Y, r_atmosphere, drift, reason) && adiabatic();
+        if (bounce_averaged)
+        {
+            Y = bounce_avg::guiding_center(drift);
+            logFile << "Bounce-averaged drift (--bounce-average=" << run_options.bounce_average << "):" << endl;
+            logFile << "  Drift shell L = " << drift.L << ", phi = " << drift.phi << " rad (SM)" << endl;
+            logFile << "  Minimum B = " << drift.at.B_eq << " nT, mirror B = " << drift.at.B_m << " nT" << endl;
+            logFile << "  Bounce period = " << drift.at.tau_b << " s, I = " << drift.at.I << " RE" << endl;
+            logFile << "  Drift period = " << 2.0 * M_PI / fabs(drift.at.dphi_dt) << " s" << endl;
+        }
+        else
+        {
+            logFile << "Bounce averaging not used (" << reason << "), full guiding-centre integration" << endl;
+        }
+    }
+    if (!resumed) outfile->write(Y.data());
+    if (varfile)
+    {
+        if (!resumed) variational::write(*varfile, run_options.variational, Y, Phi, t_ini, p);
+        logFile << "Variational equations (--variational=" << (run_options.variational == variational::MATRIX ? "matrix" : "ftle")
+                << "): sensitivity matrix and FTLE -> " << varFilePath << endl;
+    }
+
+    // checkpoint state that does not change during the integration
+    ck.params = params;
+    ck.profile = run_options.profile;
+    ck.encoding = encoding;
+    ck.window = run_options.envelope_window;
+    ck.key = cache_key;
+    ck.has_wave_seed = wave_seed(wave_field_model, seed) ? 1 : 0;
+    ck.wave_seed = seed;
+
+    // importance splitting and Russian roulette (--split)
+    unique_ptr<splitting::Tracker> tracker;
+    if (!run_options.split.empty())
+    {
+        splitting::Spec spec;
+        string error;
+        splitting::parse_spec(run_options.split, spec, error);
+        tracker.reset(new splitting::Tracker(spec, split_member, para_file, Y, ck.has_wave_seed != 0, seed));
+        logFile << "Importance splitting (--split=" << run_options.split << "): weight " << tracker->weight()
+                << ", split records -> " << outFileBase << ".split" << endl;
+    }
+    auto last_checkpoint = std::chrono::steady_clock::now();
 
     // Record start time
     auto start_time = std::chrono::high_resolution_clock::now();
     logFile << "Starting integration loop..." << endl;
+    progress_board::begin(para_file, num_steps, first_step - 1, t_ini, Y[0]);
+
+    int last_percent = -1;
+    int32_t next_write = (resume_next_write > 0) ? resume_next_write : ((first_step - 1) / write_step + 1) * write_step;
+    auto save_checkpoint_at = [&](int32_t i) {
+        if (use_checkpoint && (!multi || multi->at_node()) && std::chrono::duration<double>(std::chrono::steady_clock::now() - last_checkpoint).count() >= run_options.checkpoint)
+        {
+            ck.step = i;
+            ck.write_count = actual_write_count;
+            for (int j = 0; j < 5; ++j) ck.Y[j] = Y[j];
+            ck.mu = mu;
+            ck.dt = dt;
+            ck.r_step = r_step;
+            ck.next_write = next_write;
+            ck.writer_state = outfile->checkpoint();
+            string events_state = eventfile ? eventfile->checkpoint() : "";
+            ck.events_state = eventfile ? run_options.events + '\0' + events_state : "";
+            ck.integrator_state = multi ? multi->checkpoint() : "";
+            ck.variational_state = varfile ? variational::checkpoint(*varfile, run_options.variational, Phi) : "";
+            if (ck.writer_state.empty() || (eventfile && events_state.empty()) || (varfile && ck.variational_state.empty()) ||
+                !save_checkpoint(checkpointPath, ck))
+            {
+                logFile << "WARNING: Failed to write checkpoint " << checkpointPath << ", checkpoints disabled" << endl;
+                use_checkpoint = false;
+            }
+            last_checkpoint = std::chrono::steady_clock::now();
+        }
+    };
+
+    // bounce-averaged steps: up to the next output record, then full steps from where the averaging ended
+    int32_t bounce_steps = 0, bounce_start = first_step - 1, bounce_end = bounce_start;
+    while (bounce_averaged && bounce_end < num_steps)
+    {
+        double h = bounce_avg::suggested_step(drift, wave_period);
+        int32_t n = static_cast<int32_t>(min(h / abs(dt), static_cast<double>(num_steps)));
+        int32_t i = min(min(bounce_end + max(n, 1), next_write), num_steps);
+        if (!bounce_avg::step(drift, (i - bounce_end) * dt, r_atmosphere, reason) || !adiabatic())
+        {
+            logFile << "BOUNCE AVERAGING ENDED at step " << bounce_end << " (t = " << Y[0] << " s): " << reason << endl;
+            logFile << "  Continuing with full guiding-centre integration from the minimum-B point" << endl;
+            break;
+        }
+        bounce_end = i;
+        ++bounce_steps;
+        Y = bounce_avg::guiding_center(drift);
+        progress_board::update(i, Y[0]);
+
+        if (i == next_write)
+        {
+            outfile->write(Y.data());
+            ++actual_write_count;
+            next_write += write_step;
+        }
+        int percent = static_cast<int>(100.0 * i / num_steps) / 10 * 10;
+        if (percent > last_percent)
+        {
+            logFile << "Progress: " << percent << "% (" << i << " / " << num_steps << " steps)" << '\n';
+            logFile << "  Current time: " << Y[0] << " s" << '\n';
+            last_percent = percent;
+        }
+        save_checkpoint_at(i);
+    }
+    if (bounce_averaged) first_step = bounce_end + 1;
+
+    // new dt and r_step (--auto-steps) at a record, when the local scales have changed enough
+    auto retune = [&](int32_t i) {
+        auto_steps::Scales s = auto_steps::local_scales(Y);
+        int new_write_step = auto_steps::steps_per_write(s, write_interval, run_options.auto_steps);
+        double new_r_step = auto_steps::r_step_for(s);
+        bool new_dt = auto_steps::changed(write_step, new_write_step), new_r = auto_steps::changed(r_step, new_r_step);
+        if (!new_dt && !new_r) return;
+        if (new_dt)
+        {
+            write_step = new_write_step;
+            dt = dt_sign * write_interval / write_step;
+            next_write = i + write_step;
+            num_steps = i + write_step * (write_count - actual_write_count);
+            progress_board::update_total(num_steps);
+        }
+        if (new_r) r_step = new_r_step;
+        logFile << "AUTO STEPS at step " << i << " (t - t_ini = " << Y[0] - t_ini << " s): ";
+        log_auto_steps(s);
+    };
+
+    // event detection (--events) on the full guiding-centre steps
+    unique_ptr<events::Detector> detector;
+    vector<events::Crossing> found;
+    vector<events::Event> event_list;
+    if (eventfile)
+    {
+        string error;
+        events::parse_events(run_options.events, event_list, error);
+        logFile << "Detecting events: " << run_options.events << " -> " << eventFilePath << endl;
+        if (run_options.bounce_average > 0.0) logFile << "  (not during bounce-averaged steps)" << endl;
+    }
+    // the mapping boundaries end the integration (--psd-map), located like the events
+    string boundary = "time";
+    VectorXd Y_boundary;
+    if (mapping)
+    {
+        const psd_map::Model& psd_model = *run_options.psd_model;
+        vector<events::Event> boundaries = psd_map::boundary_events(psd_model);
+        event_list.insert(event_list.end(), boundaries.begin(), boundaries.end());
+        logFile << "Backward PSD mapping (--psd-map=" << run_options.psd_map << "): dt = " << dt << " s, boundaries t = "
+                << t_end << " s, atmosphere";
+        if (psd_model.L_max > 0.0) logFile << ", L_max = " << psd_model.L_max;
+        if (psd_model.magnetopause > 0.0) logFile << ", magnetopause (Dp = " << psd_model.magnetopause << " nPa)";
+        logFile << " -> " << outFilePath << endl;
+        string already = psd_map::outside(psd_model, Y);
+        if (!already.empty() && !resumed)
+        {
+            logFile << "Observation point is outside the " << already << " boundary, not integrated" << endl;
+            boundary = already;
+            Y_boundary = Y;
+            first_step = num_steps + 1;
+        }
+    }
+    if (!event_list.empty())
+    {
+        detector.reset(new events::Detector(event_list, r_atmosphere));
+        detector->start(Y);
+    }
+
+    auto log_atmosphere = [&](int32_t i) {
+        boundary = "atmosphere";
+        double r_current = sqrt(Y[1] * Y[1] + Y[2] * Y[2] + Y[3] * Y[3]);
+        logFile << "EARLY TERMINATION: Particle reached atmosphere at step " << i << endl;
+        logFile << "  Final time: " << Y[0] << " s" << endl;
+        logFile << "  Final position: [" << Y[1] << ", " << Y[2] << ", " << Y[3] << "] RE" << endl;
+        logFile << "  Distance from Earth: " << r_current << " RE" << endl;
+        logFile << "  Atmosphere threshold: " << r_atmosphere << " RE" << endl;
+    };
+
+    // time-parallel integration (--parareal) instead of the step loop below
+    parareal::Stats parareal_stats;
+    if (run_options.parareal > 0)
+    {
+        string error;
+        int32_t terminated = parareal::integrate(
+            Y, num_steps, write_step, p, r_atmosphere, run_options.parareal, run_options.parareal_coarse,
+            [&](const double* record) { outfile->write(record); ++actual_write_count; }, logFile, parareal_stats, error);
+        if (terminated < 0)
+        {
+            logFile << "ERROR: Parareal integration failed: " << error << endl;
+            cerr << "Parareal integration failed: " << error << endl;
+            logFile.close();
+            exit(1);
+        }
+        if (terminated > 0) log_atmosphere(terminated);
+        first_step = num_steps + 1;
+    }
 
-    for (int32_t i = 1; i <= num_steps; ++i) // 用int64_t替换long
+    for (int32_t i = first_step; i <= num_steps; ++i) // 用int64_t替换long
     {
         
         // Runge-Kutta 4th order integration
-        VectorXd k1 = dydt(Y);
-        VectorXd k2 = dydt(Y + 0.5 * dt * k1);
-        VectorXd k3 = dydt(Y + 0.5 * dt * k2);
-        VectorXd k4 = dydt(Y + dt * k3);
-        Y += (dt / 6.0) * (k1 + 2 * k2 + 2 * k3 + k4);
+        VectorXd Y0;
+        if (detector) Y0 = Y;
+        VectorXd k1;
+        if (multi)
+        {
+            // field derivatives only at the macro-step nodes (--multirate)
+            multi->step(Y, k1, run_options.auto_steps > 0.0 ? next_write - i + 1 : multirate::MAX_RATIO);
+        }
+        else if (varfile)
+        {
+            // sensitivity matrix with the same RK4 stages (--variational)
+            variational::step(Y, Phi, dt, k1, run_options.variational);
+        }
+        else
+        {
+            k1 = dydt(Y);
+            VectorXd k2 = dydt(Y + 0.5 * dt * k1);
+            VectorXd k3 = dydt(Y + 0.5 * dt * k2);
+            VectorXd k4 = dydt(Y + dt * k3);
+            Y += (dt / 6.0) * (k1 + 2 * k2 + 2 * k3 + k4);
+        }
+        progress_board::update(i, Y[0]);
         
-        if (i % write_step == 0)
+        if (i == next_write)
         {
-            outfile.write(reinterpret_cast<const char *>(Y.data()), Y.size() * sizeof(double));
+            outfile->write(Y.data());
+            if (varfile) variational::write(*varfile, run_options.variational, Y, Phi, t_ini, p);
             ++actual_write_count;
+            next_write += write_step;
+            if (run_options.auto_steps > 0.0 && i < num_steps) retune(i);
         }
         // Output progress every 10% of the total steps
-        static int last_percent = -1;
         int percent = static_cast<int>(100.0 * i / num_steps);
         if (percent != last_percent && percent % 10 == 0)
         {
-            logFile << "Progress: " << percent << "% (" << i << " / " << num_steps << " steps)" << endl;
-            logFile << "  Current time: " << Y[0] << " s" << endl;
+            // live progress is in the progress board (Solver --status), no need to flush the log
+            logFile << "Progress: " << percent << "% (" << i << " / " << num_steps << " steps)" << '\n';
+            logFile << "  Current time: " << Y[0] << " s" << '\n';
             last_percent = percent;
         }
+
+        // events located within this step (dense output), in time order
+        if (detector)
+        {
+            found.clear();
+            bool stop = detector->check(Y0, k1, Y, dt, found);
+            for (const auto& c : found)
+            {
+                double record[events::NCOLS] = {c.Y[0], c.Y[1], c.Y[2], c.Y[3], c.Y[4],
+                                                static_cast<double>(c.type), static_cast<double>(c.direction)};
+                if (eventfile) eventfile->write(record);
+            }
+            if (stop)
+            {
+                const events::Crossing& c = found.back();
+                boundary = events::event_name(c.type);
+                Y_boundary = c.Y;
+                logFile << "TERMINATED by event " << events::event_name(c.type) << " at step " << i << endl;
+                logFile << "  Event time: " << c.Y[0] << " s (t - t_ini = " << c.Y[0] - t_ini << " s)" << endl;
+                logFile << "  Event position: [" << c.Y[1] << ", " << c.Y[2] << ", " << c.Y[3] << "] RE" << endl;
+                break;
+            }
+        }
         
         // check if the particle has reached the atmosphere
         double r_current = sqrt(Y[1] * Y[1] + Y[2] * Y[2] + Y[3] * Y[3]);
-        if (r_current < (1.0 + atmosphere_altitude / 6371.0))
+        if (r_current < r_atmosphere)
         {
-            logFile << "EARLY TERMINATION: Particle reached atmosphere at step " << i << endl;
-            logFile << "  Final time: " << Y[0] << " s" << endl;
-            logFile << "  Final position: [" << Y[1] << ", " << Y[2] << ", " << Y[3] << "] RE" << endl;
-            logFile << "  Distance from Earth: " << r_current << " RE" << endl;
-            logFile << "  Atmosphere threshold: " << (1.0 + atmosphere_altitude / 6371.0) << " RE" << endl;
+            log_atmosphere(i);
             break;
         }
+
+        // split at a higher importance level, roulette two levels below (--split)
+        if (tracker && !tracker->check(Y, logFile)) break;
+
+        // periodic checkpoint (wall clock)
+        save_checkpoint_at(i);
     }
 
     // Record end time and output elapsed time
     auto end_time = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = end_time - start_time;
 
-    // If the actual number of writes is less than the expected number, go back to the file header to modify the write count
-    if (actual_write_count < write_count)
+    // close() writes the actual number of records into the file header
+    outfile->close();
+    if (eventfile) eventfile->close();
+    if (varfile) varfile->close();
+    if (tracker && !tracker->write(outFileBase + ".split", Y))
     {
-        outfile.seekp(0, ios::beg);
-        outfile.write(reinterpret_cast<const char *>(&actual_write_count), sizeof(int32_t)); 
-        outfile.flush();
+        logFile << "WARNING: Failed to write split records " << outFileBase << ".split" << endl;
+    }
+    if (mapping)
+    {
+        // the located boundary crossing, otherwise the last state
+        if (Y_boundary.size() == 0) Y_boundary = Y;
+        VectorXd Y_observation(5);
+        Y_observation << t_ini, xgsm, ygsm, zgsm, p_para;
+        if (!psd_map::write_endpoint(outFilePath, Y_observation, boundary, Y_boundary))
+        {
+            logFile << "ERROR: Failed to write mapping endpoint: " << outFilePath << endl;
+            cerr << "Failed to write mapping endpoint: " + outFilePath << endl;
+            logFile.close();
+            exit(1);
+        }
+    }
+    progress_board::finish(true);
+    remove(checkpointPath.c_str());
+    if (run_options.stream.empty() && !result_cache::write_stamp(outFilePath, cache_key))
+    {
+        logFile << "WARNING: Failed to write result stamp for " << outFilePath << endl;
     }
-    outfile.close();
 
     // obtain end timestamp
     now = time(nullptr);
@@ -327,6 +888,43 @@ int singular_particle(const std::string& para_file)
     logFile << "Performance statistics:" << endl;
     logFile << "  Total integration time: " << elapsed.count() << " seconds" << endl;
     logFile << "  Average time per step: " << (elapsed.count() / num_steps) << " seconds" << endl;
+    if (run_options.bounce_average > 0.0)
+    {
+        logFile << "  Bounce-averaged drift steps: " << bounce_steps << " (covering " << (bounce_end - bounce_start) << " of "
+                << num_steps << " time steps)" << endl;
+    }
+    if (multi)
+    {
+        logFile << "  Multirate macro steps: " << multi->macro_steps() << " (" << multi->rejected() << " rejected, final ratio "
+                << multi->ratio() << " steps per macro step)" << endl;
+        logFile << "  Field derivative evaluations: " << multi->full_evaluations() << " full, " << multi->field_evaluations()
+                << " B and b.grad B only (plain RK4: " << 4 * multi->steps() << " full)" << endl;
+    }
+    if (run_options.parareal > 0)
+    {
+        logFile << "  Parareal: " << parareal_stats.slices << " slices, " << parareal_stats.iterations << " iterations, "
+                << parareal_stats.fine_slices << " fine slice integrations (serial: " << parareal_stats.slices
+                << "), final change " << parareal_stats.change << endl;
+        logFile << "  Parareal wall time: fine " << parareal_stats.fine_seconds << " s (in parallel), coarse "
+                << parareal_stats.coarse_seconds << " s (" << parareal_stats.coarse_steps << " steps)" << endl;
+    }
+    if (varfile)
+    {
+        logFile << "  Finite-time Lyapunov exponent: " << variational::ftle(Phi, Y[0] - t_ini, p) << " 1/s over "
+                << fabs(Y[0] - t_ini) << " s (" << varfile->count() << " records in " << varFilePath << ")" << endl;
+    }
+    if (eventfile) logFile << "  Events recorded: " << eventfile->count() << " (" << eventFilePath << ")" << endl;
+    if (mapping)
+    {
+        logFile << "  Mapping endpoint: " << boundary << " boundary at t = " << Y_boundary[0] << " s (t - t_ini = "
+                << Y_boundary[0] - t_ini << " s)" << endl;
+    }
+    if (tracker)
+    {
+        logFile << "  Importance splitting: weight " << tracker->initial_weight() << " -> " << tracker->weight() << ", "
+                << tracker->children() << " children, " << tracker->survived() << " roulette survivals"
+                << (tracker->killed() ? ", killed by roulette" : "") << endl;
+    }
     logFile << "  Expected writes: " << write_count << endl;
     logFile << "  Actual writes: " << actual_write_count << endl;
     logFile << "Output file: " << outFilePath << endl;
@@ -0,0 +1,260 @@
+// stream_consumer.cpp
+// 轨迹流的参考消费者：接收 Solver --stream=... 发来的记录，在线累计直方图，不经过磁盘
+//
+// 用法（先启动消费者，再启动 Solver）:
+//   ./StreamConsumer unix:/tmp/gc.sock [--bins=N] [--streams=N] [--idle=S] [--out=FILE]
+//   ./Solver --stream=unix:/tmp/gc.sock
+// fifo:PATH 时由消费者创建命名管道。
+// 消费者在收到 --streams 个粒子的结束帧后退出；未指定时，所有粒子结束且 --idle 秒内没有新数据后退出。
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "trajectory_stream.h"
+
+using namespace std;
+using namespace traj_stream;
+
+struct Histogram {
+    string name;
+    double lo, hi;
+    vector<double> counts;
+    double underflow = 0.0, overflow = 0.0;
+
+    Histogram(const string& name, double lo, double hi, int bins) : name(name), lo(lo), hi(hi), counts(bins, 0.0) {}
+    void add(double v) {
+        if (!(v >= lo)) { underflow += 1.0; return; }
+        int k = static_cast<int>((v - lo) / (hi - lo) * counts.size());
+        if (k >= static_cast<int>(counts.size())) {
+            if (v > hi) { overflow += 1.0; return; }
+            k = static_cast<int>(counts.size()) - 1;
+        }
+        counts[k] += 1.0;
+    }
+};
+
+struct StreamState {
+    StreamMeta meta;
+    int64_t received = 0;
+    bool ended = false;
+    double r_last = 0.0;
+};
+
+struct Connection {
+    int fd;
+    string buffer;
+    int64_t stream;     // unix 连接对应的粒子（-1 尚未知）
+};
+
+static map<uint32_t, StreamState> streams;
+static vector<Histogram> histograms;
+static int64_t total_records = 0;
+static int streams_ended = 0;
+
+static void consume_records(StreamState& st, const double* rec, uint32_t count) {
+    int ncols = st.meta.ncols;
+    for (uint32_t k = 0; k < count; ++k) {
+        const double* Y = rec + k * ncols;
+        double r = sqrt(Y[1] * Y[1] + Y[2] * Y[2] + Y[3] * Y[3]);
+        histograms[0].add(r);
+        histograms[1].add(asin(Y[3] / r) * 180.0 / M_PI);
+        histograms[2].add(st.meta.p > 0.0 ? Y[4] / st.meta.p : 0.0);
+        st.r_last = r;
+    }
+    st.received += count;
+    total_records += count;
+}
+
+// 解析缓冲区中的完整帧，返回 false 表示协议错误
+static bool consume_frames(string& buffer, int64_t& stream) {
+    size_t pos = 0;
+    while (buffer.size() - pos >= static_cast<size_t>(FRAME_HEADER_LEN)) {
+        FrameHeader head;
+        memcpy(&head, buffer.data() + pos, sizeof(head));
+        if (head.magic != FRAME_MAGIC || head.length > static_cast<uint32_t>(MAX_FRAME_LEN)) return false;
+        if (buffer.size() - pos < FRAME_HEADER_LEN + head.length) break;
+        const char* payload = buffer.data() + pos + FRAME_HEADER_LEN;
+
+        StreamState& st = streams[head.stream];
+        stream = head.stream;
+        if (head.type == FRAME_START) {
+            if (!st.meta.from_bytes(payload, head.length)) return false;
+        } else if (head.type == FRAME_RECORDS) {
+            if (head.length != head.count * st.meta.ncols * sizeof(double)) return false;
+            consume_records(st, reinterpret_cast<const double*>(payload), head.count);
+        } else if (head.type == FRAME_END) {
+            if (!st.ended) ++streams_ended;
+            st.ended = true;
+        }
+        pos += FRAME_HEADER_LEN + head.length;
+    }
+    buffer.erase(0, pos);
+    return true;
+}
+
+static void write_report(const string& path) {
+    ofstream out(path);
+    out << "# streams " << streams.size() << ", completed " << streams_ended << ", records " << total_records << "\n";
+    out << "# name\trecords\texpected\tended\tfinal_r[RE]\n";
+    for (const auto& kv : streams) {
+        const StreamState& st = kv.second;
+        out << "# " << st.meta.name << "\t" << st.received << "\t" << st.meta.expected_count << "\t"
+            << (st.ended ? 1 : 0) << "\t" << st.r_last << "\n";
+    }
+    for (const auto& h : histograms) {
+        out << "\n# histogram " << h.name << " [" << h.lo << ", " << h.hi << "], underflow "
+            << h.underflow << ", overflow " << h.overflow << "\n";
+        double width = (h.hi - h.lo) / h.counts.size();
+        for (size_t k = 0; k < h.counts.size(); ++k) {
+            out << setprecision(6) << h.lo + (k + 0.5) * width << "\t" << h.counts[k] << "\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    string target, out_path = "stream_hist.txt";
+    int bins = 50, expected_streams = 0;
+    double idle_seconds = 5.0;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--bins=", 0) == 0) bins = atoi(arg.c_str() + 7);
+        else if (arg.rfind("--streams=", 0) == 0) expected_streams = atoi(arg.c_str() + 10);
+        else if (arg.rfind("--idle=", 0) == 0) idle_seconds = atof(arg.c_str() + 7);
+        else if (arg.rfind("--out=", 0) == 0) out_path = arg.substr(6);
+        else if (target.empty() && valid_target(arg)) target = arg;
+        else {
+            cerr << "Unknown argument: " << arg << endl;
+            return 1;
+        }
+    }
+    if (target.empty() || bins < 1) {
+        cerr << "Usage: StreamConsumer fifo:PATH|unix:PATH [--bins=N] [--streams=N] [--idle=S] [--out=FILE]" << endl;
+        return 1;
+    }
+    histograms.emplace_back("r[RE]", 1.0, 12.0, bins);
+    histograms.emplace_back("lat_gsm[deg]", -90.0, 90.0, bins);
+    histograms.emplace_back("p_para/p0", -1.0, 1.0, bins);
+
+    string path = target.substr(5);
+    bool is_fifo = target.rfind("fifo:", 0) == 0;
+    int listen_fd = -1, keep_fd = -1;
+    vector<Connection> conns;
+    if (is_fifo) {
+        struct stat sb;
+        if (stat(path.c_str(), &sb) != 0 && mkfifo(path.c_str(), 0666) != 0) {
+            cerr << "Failed to create fifo " << path << ": " << strerror(errno) << endl;
+            return 1;
+        }
+        int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+        // 自己保持一个写端，生产者之间的空档不会读到 EOF
+        keep_fd = open(path.c_str(), O_WRONLY);
+        if (fd < 0 || keep_fd < 0) {
+            cerr << "Failed to open fifo " << path << ": " << strerror(errno) << endl;
+            return 1;
+        }
+        conns.push_back({fd, "", -1});
+    } else {
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(path.c_str());
+        if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(listen_fd, 64) != 0) {
+            cerr << "Failed to listen on " << path << ": " << strerror(errno) << endl;
+            return 1;
+        }
+    }
+    cout << "Listening on " << target << " ..." << endl;
+
+    auto start = chrono::steady_clock::now();
+    auto last_data = start;
+    auto last_report = start;
+    vector<char> chunk(1 << 16);
+    while (true) {
+        vector<pollfd> fds;
+        if (listen_fd >= 0) fds.push_back({listen_fd, POLLIN, 0});
+        for (const auto& c : conns) fds.push_back({c.fd, POLLIN, 0});
+        poll(fds.data(), fds.size(), 200);
+
+        size_t base = 0;
+        if (listen_fd >= 0) {
+            base = 1;
+            if (fds[0].revents & POLLIN) {
+                int fd = accept(listen_fd, nullptr, nullptr);
+                if (fd >= 0) conns.push_back({fd, "", -1});
+            }
+        }
+        for (size_t i = 0; i < fds.size() - base; ++i) {
+            if (!(fds[base + i].revents & (POLLIN | POLLHUP))) continue;
+            Connection& c = conns[i];
+            ssize_t n = read(c.fd, chunk.data(), chunk.size());
+            if (n > 0) {
+                c.buffer.append(chunk.data(), n);
+                last_data = chrono::steady_clock::now();
+                if (!consume_frames(c.buffer, c.stream)) {
+                    cerr << "Protocol error, dropping connection" << endl;
+                    n = 0;
+                }
+            }
+            if (n == 0 && !is_fifo) {
+                // 连接断开但没有结束帧：粒子进程异常退出，按未完成计
+                auto it = streams.find(static_cast<uint32_t>(c.stream));
+                if (c.stream >= 0 && it != streams.end() && !it->second.ended) {
+                    cerr << "Stream of " << it->second.meta.name << " closed without end frame" << endl;
+                    it->second.ended = true;
+                    ++streams_ended;
+                }
+                close(c.fd);
+                c.fd = -1;
+            }
+        }
+        for (size_t i = conns.size(); i-- > 0;) {
+            if (conns[i].fd < 0) conns.erase(conns.begin() + i);
+        }
+
+        auto now = chrono::steady_clock::now();
+        if (chrono::duration<double>(now - last_report).count() >= 10.0) {
+            cout << "  streams " << streams.size() << ", completed " << streams_ended
+                 << ", records " << total_records << endl;
+            write_report(out_path);
+            last_report = now;
+        }
+
+        bool all_ended = !streams.empty() && streams_ended == static_cast<int>(streams.size());
+        if (expected_streams > 0 ? streams_ended >= expected_streams
+                                 : (all_ended && chrono::duration<double>(now - last_data).count() >= idle_seconds)) {
+            break;
+        }
+    }
+
+    for (const auto& c : conns) close(c.fd);
+    if (keep_fd >= 0) close(keep_fd);
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(path.c_str());
+    }
+
+    write_report(out_path);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Received " << total_records << " records from " << streams.size() << " particles ("
+         << streams_ended << " completed) in " << elapsed << " s, histograms written to " << out_path << endl;
+    return 0;
+}
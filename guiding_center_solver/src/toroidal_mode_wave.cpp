@@ -32,6 +32,54 @@ std::string original_seed_str; // 保存配置文件中的原始seed字符串
 // 配置读取标志
 static bool config_loaded = false;
 
+// 各频率分量 (2N-1 个)
+static VectorXd omega_seq, E0_seq, phi0_seq;
+
+// 频率、幅值、相位序列只取决于配置，读取配置时计算一次
+static void build_spectrum() {
+    // omega sequence
+    omega_seq = VectorXd::Zero(N * 2 - 1);
+    if (N == 1) {
+        // 只有一个频率分量
+        omega_seq[0] = omega;
+    } else if (N > 1) {
+        double start = omega / omega_width;
+        double end = omega * omega_width;
+        double ratio = pow(end / start, 1.0 / (N * 2 - 2));
+        omega_seq[0] = start;
+        for (int i = 1; i < N * 2 - 1; ++i) {
+            omega_seq[i] = omega_seq[i - 1] * ratio;
+        }
+    }
+    
+    // E0i sequence (Gaussian distribution)
+    E0_seq = VectorXd::Zero(N * 2 - 1);
+    if (N == 1) {
+        E0_seq[0] = E0;
+    } else if (N > 1) {
+        double sum_sq = 0.0;
+        for (int i = 0; i < N * 2 - 1; ++i) {
+            double x = (i - (N - 1)) / sigma;
+            E0_seq[i] = exp(-0.5 * x * x);
+            sum_sq += E0_seq[i] * E0_seq[i];
+        }
+        E0_seq *= E0 / sqrt(sum_sq);
+    }
+    
+    // phi0 sequence
+    phi0_seq = VectorXd::Zero(N * 2 - 1);
+    if (N == 1) {
+        phi0_seq[0] = phi0;
+    } else if (N > 1) {
+        // 多个频率分量，使用随机相位
+        std::mt19937 gen(seed); // 固定种子
+        std::uniform_real_distribution<double> dist(0.0, 2 * M_PI);
+        for (int i = 0; i < N * 2 - 1; ++i) {
+            phi0_seq[i] = dist(gen);
+        }
+    }
+}
+
 // 读取配置文件的函数
 bool loadWaveConfig() {
     if (config_loaded) return true;
@@ -142,6 +190,7 @@ bool loadWaveConfig() {
         std::cout << "  seed (config) = " << original_seed_str << std::endl;
         std::cout << "  seed (actual) = " << seed << std::endl;
         
+        build_spectrum();
         config_loaded = true;
         return true;
         
@@ -151,6 +200,21 @@ bool loadWaveConfig() {
     }
 }
 
+unsigned int current_seed() {
+    return seed;
+}
+
+void restore_seed(unsigned int s) {
+    if (!loadWaveConfig()) return;
+    seed = s;
+    build_spectrum();
+}
+
+double shortest_period() {
+    if (!loadWaveConfig()) return HUGE_VAL;
+    return 2.0 * M_PI / omega_seq.maxCoeff();
+}
+
 double E_L_amp(const double& t, const double& L, const double& mu, const double& phi, const double& E0i) {
     
     double theta = mu2theta(mu, L); // Convert mu to theta using the dipole model
@@ -187,48 +251,6 @@ VectorXd tor_wave(const double& t, const double& xgsm, const double& ygsm, const
         throw std::runtime_error("Wave configuration loading failed");
     }
 
-    // omega sequence
-    VectorXd omega_seq = VectorXd::Zero(N * 2 - 1);
-    if (N == 1) {
-        // 只有一个频率分量
-        omega_seq[0] = omega;
-    } else if (N > 1) {
-        double start = omega / omega_width;
-        double end = omega * omega_width;
-        double ratio = pow(end / start, 1.0 / (N * 2 - 2));
-        omega_seq[0] = start;
-        for (int i = 1; i < N * 2 - 1; ++i) {
-            omega_seq[i] = omega_seq[i - 1] * ratio;
-        }
-    }
-    
-    // E0i sequence (Gaussian distribution)
-    VectorXd E0_seq = VectorXd::Zero(N * 2 - 1);
-    if (N == 1) {
-        E0_seq[0] = E0;
-    } else if (N > 1) {
-        double sum_sq = 0.0;
-        for (int i = 0; i < N * 2 - 1; ++i) {
-            double x = (i - (N - 1)) / sigma;
-            E0_seq[i] = exp(-0.5 * x * x);
-            sum_sq += E0_seq[i] * E0_seq[i];
-        }
-        E0_seq *= E0 / sqrt(sum_sq);
-    }
-    
-    // phi0 sequence
-    VectorXd phi0_seq = VectorXd::Zero(N * 2 - 1);
-    if (N == 1) {
-        phi0_seq[0] = phi0;
-    } else if (N > 1) {
-        // 多个频率分量，使用随机相位
-        std::mt19937 gen(seed); // 固定种子
-        std::uniform_real_distribution<double> dist(0.0, 2 * M_PI);
-        for (int i = 0; i < N * 2 - 1; ++i) {
-            phi0_seq[i] = dist(gen);
-        }
-    }
-    
     time_t epoch_time = static_cast<time_t>(t);
     tm* time_info = gmtime(&epoch_time);
 
@@ -276,4 +298,46 @@ VectorXd tor_wave(const double& t, const double& xgsm, const double& ygsm, const
     return EB_gsm;
 
 }
-} 
\ No newline at end of file
+
+Vector4d temporal_sums(const double& t) {
+    Vector4d sums = Vector4d::Zero();
+    for (int i = 0; i < N * 2 - 1; ++i) {
+        double a = phi0_seq[i] - omega_seq[i] * t;
+        sums[0] += E0_seq[i] * cos(a);
+        sums[1] += E0_seq[i] * sin(a);
+        sums[2] += E0_seq[i] / omega_seq[i] * cos(a);
+        sums[3] += E0_seq[i] / omega_seq[i] * sin(a);
+    }
+    return sums;
+}
+
+// 频率分量之和：Σ E0i cos(m phi + ai) = cos(m phi) C1 - sin(m phi) S1，Σ E0i/ωi sin(m phi + ai) = sin(m phi) C2 + cos(m phi) S2
+Matrix<double, 6, 1> wave_sm(const Vector4d& sums, const double& xsm, const double& ysm, const double& zsm) {
+    
+    Vector3d dip_cor = cartesian_to_dipole(Vector3d(xsm, ysm, zsm));
+    double L = dip_cor[0];
+    double phi = dip_cor[1];
+    double mu = dip_cor[2];
+    Matrix3d dip_bas = dipole_basis(Vector3d(xsm, ysm, zsm));
+    Vector3d e_L = dip_bas.col(0);
+    Vector3d e_phi = dip_bas.col(1);
+    Vector3d e_mu = dip_bas.col(2);
+
+    double cos_m = cos(m * phi), sin_m = sin(m * phi);
+    double cos_sum = cos_m * sums[0] - sin_m * sums[1];     // Σ E0i cos(m phi + ai)
+    double sin_sum_w = sin_m * sums[2] + cos_m * sums[3];   // Σ E0i/ωi sin(m phi + ai)
+    double cos_sum_w = cos_m * sums[2] - sin_m * sums[3];   // Σ E0i/ωi cos(m phi + ai)
+
+    // E_L_amp(..., E0i) = E0i * amp(L, mu)
+    auto amp = [](const double& L, const double& mu) { return E_L_amp(0.0, L, mu, 0.0, 1.0); };
+    double phEpmu = (h_L(L, mu + dmu) * amp(L, mu + dmu) - h_L(L, mu - dmu) * amp(L, mu - dmu)) / (2 * dmu);
+
+    Vector3d E_sm = cos_sum * amp(L, mu) * e_L;
+    Vector3d B_sm = sin_sum_w / h_L(L, mu) / h_mu(L, mu) * phEpmu / 6.371 * e_phi
+                  - m * cos_sum_w / h_phi(L, mu) * amp(L, mu) / 6.371 * e_mu;
+
+    Matrix<double, 6, 1> EB_sm;
+    EB_sm << E_sm, B_sm;
+    return EB_sm;
+}
+}
@@ -0,0 +1,864 @@
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+
+#include "trajectory_io.h"
+#include "result_cache.h"
+
+using namespace std;
+
+namespace traj_io {
+
+static const char GCZ_MAGIC[4] = {'G', 'C', 'Z', '1'};
+static const int GCZ_HEADER_LEN = 32;
+static const int DEFAULT_BLOCK_SIZE = 1024;
+static const char COMPACT_MAGIC[4] = {'G', 'C', 'T', 'C'};
+static const int COMPACT_HEADER_LEN = 4 + 4 + 2 * 8 + 8 * 8;
+static const char ENVELOPE_MAGIC[4] = {'G', 'C', 'T', 'E'};
+static const int ENVELOPE_PREFIX_LEN = 4 + 3 * 4 + 8;
+
+int parse_encoding(const string& name) {
+    if (name == "raw") return ENCODING_RAW;
+    if (name == "compressed") return ENCODING_COMPRESSED;
+    return -1;
+}
+
+string encoded_path(const string& base, const string& ext, int encoding) {
+    return base + ext + (encoding == ENCODING_COMPRESSED ? "z" : "");
+}
+
+int parse_profile(const string& name) {
+    if (name == "full") return PROFILE_FULL;
+    if (name == "compact") return PROFILE_COMPACT;
+    if (name == "envelope") return PROFILE_ENVELOPE;
+    if (name == "events") return PROFILE_EVENTS;
+    return -1;
+}
+
+string profile_ext(int profile) {
+    if (profile == PROFILE_COMPACT) return ".gctc";
+    if (profile == PROFILE_ENVELOPE) return ".gcte";
+    if (profile == PROFILE_EVENTS) return ".gce";
+    return ".gct";
+}
+
+static bool file_exists(const string& path) {
+    ifstream f(path, ios::binary);
+    return f.good();
+}
+
+string find_trajectory(const string& base) {
+    const string candidates[] = {
+        encoded_path(base, ".gct", ENCODING_RAW),
+        encoded_path(base, ".gct", ENCODING_COMPRESSED),
+        base + profile_ext(PROFILE_COMPACT),
+    };
+    for (const auto& path : candidates) {
+        if (file_exists(path)) return path;
+    }
+    return "";
+}
+
+// ---------------------------------------------------------------------------
+// block codec
+
+static inline uint64_t to_bits(double v) {
+    uint64_t u;
+    memcpy(&u, &v, sizeof(u));
+    return u;
+}
+
+static inline double from_bits(uint64_t u) {
+    double v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+// 多项式外推预测（order 1: 前值，2: 线性，3: 二次），只用加减法，
+// 避免编译器把乘加合并为FMA，保证编码端和解码端（包括MATLAB）逐位一致
+static inline double predict(const double* column, int k, int stride, int order) {
+    if (k == 0) return 0.0;
+    double x1 = column[(k - 1) * stride];
+    if (k == 1 || order == 1) return x1;
+    double x2 = column[(k - 2) * stride];
+    if (k == 2 || order == 2) return (x1 + x1) - x2;
+    double x3 = column[(k - 3) * stride];
+    double d = x1 - x2;
+    return ((d + d) + d) + x3;
+}
+
+static inline int significant_bytes(uint64_t r) {
+    int nbytes = 0;
+    while (nbytes < 8 && (r >> (8 * nbytes)) != 0) ++nbytes;
+    return nbytes;
+}
+
+void encode_block(const double* records, int nrec, int ncols, string& out) {
+    vector<uint8_t> ctrl;
+    vector<uint8_t> data;
+    for (int j = 0; j < ncols; ++j) {
+        const double* column = records + j;
+
+        // 每列选择残差最小的预测阶数
+        int order = 1;
+        size_t best = SIZE_MAX;
+        for (int candidate = 1; candidate <= 3; ++candidate) {
+            size_t total = 0;
+            for (int k = 0; k < nrec; ++k) {
+                total += significant_bytes(to_bits(column[k * ncols]) ^ to_bits(predict(column, k, ncols, candidate)));
+            }
+            if (total < best) { best = total; order = candidate; }
+        }
+
+        ctrl.assign((nrec + 1) / 2, 0);
+        data.clear();
+        for (int k = 0; k < nrec; ++k) {
+            uint64_t r = to_bits(column[k * ncols]) ^ to_bits(predict(column, k, ncols, order));
+            int nbytes = significant_bytes(r);
+            ctrl[k / 2] |= static_cast<uint8_t>(nbytes << (4 * (k % 2)));
+            for (int b = 0; b < nbytes; ++b) data.push_back(static_cast<uint8_t>(r >> (8 * b)));
+        }
+        out.push_back(static_cast<char>(order));
+        out.append(reinterpret_cast<const char*>(ctrl.data()), ctrl.size());
+        out.append(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+}
+
+bool decode_block(const char* payload, size_t len, int nrec, int ncols, double* records) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(payload);
+    const uint8_t* end = p + len;
+    for (int j = 0; j < ncols; ++j) {
+        double* column = records + j;
+        if (p + 1 + (nrec + 1) / 2 > end) return false;
+        int order = *p++;
+        if (order < 1 || order > 3) return false;
+        const uint8_t* ctrl = p;
+        const uint8_t* data = p + (nrec + 1) / 2;
+        for (int k = 0; k < nrec; ++k) {
+            int nbytes = (ctrl[k / 2] >> (4 * (k % 2))) & 0x0F;
+            if (nbytes > 8 || data + nbytes > end) return false;
+            uint64_t r = 0;
+            for (int b = 0; b < nbytes; ++b) r |= static_cast<uint64_t>(data[b]) << (8 * b);
+            data += nbytes;
+            column[k * ncols] = from_bits(r ^ to_bits(predict(column, k, ncols, order)));
+        }
+        p = data;
+    }
+    return p == end;
+}
+
+// ---------------------------------------------------------------------------
+// writers
+
+// 检查点状态的类型标记
+enum WriterKind : int32_t { WRITER_RAW = 1, WRITER_COMPRESSED = 2, WRITER_COMPACT = 3, WRITER_ENVELOPE = 4, WRITER_NONE = 5 };
+
+static bool get_kind(const char*& p, const char* end, int32_t expected) {
+    int32_t kind;
+    return get_value(p, end, kind) && kind == expected;
+}
+
+// 把文件截断到检查点时的长度，并打开到末尾继续写入
+static bool reopen_at(ofstream& out, const string& path, int64_t length) {
+    error_code ec;
+    uintmax_t size = filesystem::file_size(path, ec);
+    if (ec || size < static_cast<uintmax_t>(length)) return false;
+    filesystem::resize_file(path, static_cast<uintmax_t>(length), ec);
+    if (ec) return false;
+    out.open(path, ios::binary | ios::in | ios::out);
+    out.seekp(0, ios::end);
+    return static_cast<bool>(out);
+}
+
+class RawWriter : public TrajectoryWriter {
+public:
+    RawWriter(const string& path, int ncols, const string& prefix, int count_offset, bool resume = false)
+        : TrajectoryWriter(path, ncols, prefix, count_offset) {
+        if (resume) return;
+        out_.open(path, ios::binary | ios::trunc);
+        out_.write(prefix_.data(), prefix_.size());
+    }
+    bool good() const override { return static_cast<bool>(out_); }
+    void write(const double* record) override {
+        out_.write(reinterpret_cast<const char*>(record), ncols_ * sizeof(double));
+        ++count_;
+    }
+    void close() override {
+        if (!out_.is_open()) return;
+        if (count_offset_ >= 0) {
+            int32_t n = static_cast<int32_t>(count_);
+            out_.seekp(count_offset_, ios::beg);
+            out_.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        }
+        out_.close();
+    }
+    string checkpoint() override {
+        int64_t length = static_cast<int64_t>(out_.tellp());
+        if (count_offset_ >= 0) {
+            int32_t n = static_cast<int32_t>(count_);
+            out_.seekp(count_offset_, ios::beg);
+            out_.write(reinterpret_cast<const char*>(&n), sizeof(n));
+            out_.seekp(length, ios::beg);
+        }
+        out_.flush();
+        string state;
+        put_value(state, static_cast<int32_t>(WRITER_RAW));
+        put_value(state, length);
+        put_value(state, count_);
+        return state;
+    }
+    bool restore(const char*& p, const char* end) override {
+        int64_t length;
+        return get_kind(p, end, WRITER_RAW) && get_value(p, end, length) && get_value(p, end, count_) &&
+               reopen_at(out_, path_, length);
+    }
+private:
+    ofstream out_;
+};
+
+class CompressedWriter : public TrajectoryWriter {
+public:
+    CompressedWriter(const string& path, int ncols, const string& prefix, int count_offset, bool resume = false)
+        : TrajectoryWriter(path, ncols, prefix, count_offset) {
+        buffer_.reserve(static_cast<size_t>(DEFAULT_BLOCK_SIZE) * ncols_);
+        if (resume) return;
+        out_.open(path, ios::binary | ios::trunc);
+        write_header(0, 0);
+        out_.write(prefix_.data(), prefix_.size());
+    }
+    bool good() const override { return static_cast<bool>(out_); }
+    void write(const double* record) override {
+        buffer_.insert(buffer_.end(), record, record + ncols_);
+        ++count_;
+        if (static_cast<int>(buffer_.size() / ncols_) == DEFAULT_BLOCK_SIZE) flush_block();
+    }
+    void close() override {
+        if (!out_.is_open()) return;
+        flush_block();
+
+        // block index
+        int64_t index_offset = static_cast<int64_t>(out_.tellp());
+        int64_t nblocks = static_cast<int64_t>(index_.size());
+        out_.write(reinterpret_cast<const char*>(&nblocks), sizeof(nblocks));
+        for (const auto& entry : index_) {
+            out_.write(reinterpret_cast<const char*>(&entry.offset), sizeof(entry.offset));
+            out_.write(reinterpret_cast<const char*>(&entry.first_record), sizeof(entry.first_record));
+            out_.write(reinterpret_cast<const char*>(&entry.first_value), sizeof(entry.first_value));
+        }
+
+        out_.seekp(0, ios::beg);
+        write_header(count_, index_offset);
+        if (count_offset_ >= 0) {
+            int32_t n = static_cast<int32_t>(count_);
+            out_.seekp(GCZ_HEADER_LEN + count_offset_, ios::beg);
+            out_.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        }
+        out_.close();
+    }
+    // 已写出的块在文件中，索引和未满一块的记录存入状态
+    string checkpoint() override {
+        int64_t length = static_cast<int64_t>(out_.tellp());
+        out_.flush();
+        string state;
+        put_value(state, static_cast<int32_t>(WRITER_COMPRESSED));
+        put_value(state, length);
+        put_value(state, count_);
+        put_value(state, static_cast<int64_t>(index_.size()));
+        for (const auto& entry : index_) put_value(state, entry);
+        put_value(state, static_cast<int64_t>(buffer_.size()));
+        state.append(reinterpret_cast<const char*>(buffer_.data()), buffer_.size() * sizeof(double));
+        return state;
+    }
+    bool restore(const char*& p, const char* end) override {
+        int64_t length, nindex, nbuffer;
+        if (!get_kind(p, end, WRITER_COMPRESSED) || !get_value(p, end, length) || !get_value(p, end, count_) ||
+            !get_value(p, end, nindex) || nindex < 0) {
+            return false;
+        }
+        index_.resize(nindex);
+        for (auto& entry : index_) {
+            if (!get_value(p, end, entry)) return false;
+        }
+        if (!get_value(p, end, nbuffer) || nbuffer < 0 || nbuffer % ncols_ != 0 ||
+            end - p < static_cast<ptrdiff_t>(nbuffer * sizeof(double))) {
+            return false;
+        }
+        buffer_.assign(reinterpret_cast<const double*>(p), reinterpret_cast<const double*>(p) + nbuffer);
+        p += nbuffer * sizeof(double);
+        return reopen_at(out_, path_, length);
+    }
+private:
+    struct IndexEntry { int64_t offset; int64_t first_record; double first_value; };
+
+    void write_header(int64_t record_count, int64_t index_offset) {
+        int32_t fields[3] = {ncols_, DEFAULT_BLOCK_SIZE, static_cast<int32_t>(prefix_.size())};
+        out_.write(GCZ_MAGIC, sizeof(GCZ_MAGIC));
+        out_.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+        out_.write(reinterpret_cast<const char*>(&record_count), sizeof(record_count));
+        out_.write(reinterpret_cast<const char*>(&index_offset), sizeof(index_offset));
+    }
+
+    void flush_block() {
+        int32_t nrec = static_cast<int32_t>(buffer_.size() / ncols_);
+        if (nrec == 0) return;
+        payload_.clear();
+        encode_block(buffer_.data(), nrec, ncols_, payload_);
+        int32_t len = static_cast<int32_t>(payload_.size());
+
+        index_.push_back({static_cast<int64_t>(out_.tellp()), count_ - nrec, buffer_[0]});
+        out_.write(reinterpret_cast<const char*>(&nrec), sizeof(nrec));
+        out_.write(reinterpret_cast<const char*>(&len), sizeof(len));
+        out_.write(payload_.data(), payload_.size());
+        buffer_.clear();
+    }
+
+    ofstream out_;
+    vector<double> buffer_;
+    string payload_;
+    vector<IndexEntry> index_;
+};
+
+// compact: 隐式时间，x, y, z, p_para 存为相对首条记录的 float32
+class CompactWriter : public TrajectoryWriter {
+public:
+    CompactWriter(const string& path, int32_t write_count, double write_dt, bool resume = false)
+        : TrajectoryWriter(path, 5, "", -1), write_count_(write_count), write_dt_(write_dt) {
+        if (resume) return;
+        out_.open(path, ios::binary | ios::trunc);
+        write_header(write_count);
+    }
+    bool good() const override { return static_cast<bool>(out_); }
+    void write(const double* record) override {
+        if (count_ == 0) {
+            // 首条记录决定偏移和缩放：位置按初始地心距离，动量按初始平行动量
+            t_ini_ = record[0];
+            double r0 = sqrt(record[1] * record[1] + record[2] * record[2] + record[3] * record[3]);
+            for (int j = 0; j < 4; ++j) offset_[j] = record[j + 1];
+            for (int j = 0; j < 3; ++j) scale_[j] = (r0 > 0.0) ? r0 : 1.0;
+            scale_[3] = (record[4] != 0.0) ? fabs(record[4]) : 1.0;
+            // 文件头随即写完整（与 raw 的前缀一样，运行中的文件也能读取）
+            streampos pos = out_.tellp();
+            out_.seekp(0, ios::beg);
+            write_header(write_count_);
+            out_.seekp(pos);
+        }
+        float packed[4];
+        for (int j = 0; j < 4; ++j) packed[j] = static_cast<float>((record[j + 1] - offset_[j]) / scale_[j]);
+        out_.write(reinterpret_cast<const char*>(packed), sizeof(packed));
+        ++count_;
+    }
+    void close() override {
+        if (!out_.is_open()) return;
+        out_.seekp(0, ios::beg);
+        write_header(static_cast<int32_t>(count_));
+        out_.close();
+    }
+    string checkpoint() override {
+        int64_t length = static_cast<int64_t>(out_.tellp());
+        out_.seekp(0, ios::beg);
+        write_header(static_cast<int32_t>(count_));
+        out_.seekp(length, ios::beg);
+        out_.flush();
+        string state;
+        put_value(state, static_cast<int32_t>(WRITER_COMPACT));
+        put_value(state, length);
+        put_value(state, count_);
+        put_value(state, t_ini_);
+        put_value(state, offset_);
+        put_value(state, scale_);
+        return state;
+    }
+    bool restore(const char*& p, const char* end) override {
+        int64_t length;
+        return get_kind(p, end, WRITER_COMPACT) && get_value(p, end, length) && get_value(p, end, count_) &&
+               get_value(p, end, t_ini_) && get_value(p, end, offset_) && get_value(p, end, scale_) &&
+               reopen_at(out_, path_, length);
+    }
+private:
+    void write_header(int32_t count) {
+        out_.write(COMPACT_MAGIC, sizeof(COMPACT_MAGIC));
+        out_.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out_.write(reinterpret_cast<const char*>(&t_ini_), sizeof(t_ini_));
+        out_.write(reinterpret_cast<const char*>(&write_dt_), sizeof(write_dt_));
+        out_.write(reinterpret_cast<const char*>(offset_), sizeof(offset_));
+        out_.write(reinterpret_cast<const char*>(scale_), sizeof(scale_));
+    }
+
+    ofstream out_;
+    int32_t write_count_;
+    double t_ini_ = 0.0;
+    double write_dt_;
+    double offset_[4] = {0, 0, 0, 0};
+    double scale_[4] = {1, 1, 1, 1};
+};
+
+// envelope: 每 window 条记录合并为一条 min/max/mean 记录，交给下层（raw/compressed）写入器
+class EnvelopeWriter : public TrajectoryWriter {
+public:
+    EnvelopeWriter(unique_ptr<TrajectoryWriter> inner, int window)
+        : TrajectoryWriter(inner->path(), 5, "", -1), inner_(std::move(inner)), window_(window) {}
+    bool good() const override { return inner_->good(); }
+    void write(const double* record) override {
+        if (n_ == 0) {
+            env_[0] = record[0];
+            for (int j = 0; j < 4; ++j) {
+                env_[2 + 3 * j] = record[j + 1];
+                env_[3 + 3 * j] = record[j + 1];
+                sum_[j] = 0.0;
+            }
+        }
+        env_[1] = record[0];
+        for (int j = 0; j < 4; ++j) {
+            double v = record[j + 1];
+            if (v < env_[2 + 3 * j]) env_[2 + 3 * j] = v;
+            if (v > env_[3 + 3 * j]) env_[3 + 3 * j] = v;
+            sum_[j] += v;
+        }
+        ++count_;
+        if (++n_ == window_) flush_window();
+    }
+    void close() override {
+        flush_window();
+        inner_->close();
+    }
+    string checkpoint() override {
+        string state;
+        put_value(state, static_cast<int32_t>(WRITER_ENVELOPE));
+        put_value(state, count_);
+        put_value(state, static_cast<int32_t>(n_));
+        put_value(state, env_);
+        put_value(state, sum_);
+        return state + inner_->checkpoint();
+    }
+    bool restore(const char*& p, const char* end) override {
+        int32_t n;
+        if (!get_kind(p, end, WRITER_ENVELOPE) || !get_value(p, end, count_) || !get_value(p, end, n) ||
+            !get_value(p, end, env_) || !get_value(p, end, sum_)) {
+            return false;
+        }
+        n_ = n;
+        return inner_->restore(p, end);
+    }
+private:
+    void flush_window() {
+        if (n_ == 0) return;
+        for (int j = 0; j < 4; ++j) env_[4 + 3 * j] = sum_[j] / n_;
+        inner_->write(env_);
+        n_ = 0;
+    }
+
+    unique_ptr<TrajectoryWriter> inner_;
+    int window_;
+    int n_ = 0;
+    double env_[ENVELOPE_NCOLS];
+    double sum_[4];
+};
+
+// events: 不写轨迹，只计数（事件记录由 Solver 另外写入）
+class NullWriter : public TrajectoryWriter {
+public:
+    explicit NullWriter(const string& path) : TrajectoryWriter(path, 5, "", -1) {}
+    bool good() const override { return true; }
+    void write(const double*) override { ++count_; }
+    void close() override {}
+    string checkpoint() override {
+        string state;
+        put_value(state, static_cast<int32_t>(WRITER_NONE));
+        put_value(state, count_);
+        return state;
+    }
+    bool restore(const char*& p, const char* end) override {
+        return get_kind(p, end, WRITER_NONE) && get_value(p, end, count_);
+    }
+};
+
+// 删除过时的输出文件及其结果戳记
+static void remove_output(const string& path) {
+    remove(path.c_str());
+    result_cache::clear_stamp(path);
+}
+
+unique_ptr<TrajectoryWriter> open_writer(const string& base, const string& ext, int encoding,
+                                         int ncols, const string& prefix, int count_offset, bool resume) {
+    // remove stale files written with another encoding
+    for (int other : {ENCODING_RAW, ENCODING_COMPRESSED}) {
+        if (other != encoding && !resume) remove_output(encoded_path(base, ext, other));
+    }
+
+    string path = encoded_path(base, ext, encoding);
+    if (encoding == ENCODING_COMPRESSED) {
+        return unique_ptr<TrajectoryWriter>(new CompressedWriter(path, ncols, prefix, count_offset, resume));
+    }
+    return unique_ptr<TrajectoryWriter>(new RawWriter(path, ncols, prefix, count_offset, resume));
+}
+
+unique_ptr<TrajectoryWriter> open_trajectory_writer(const string& base, int profile, int encoding,
+                                                    int32_t write_count, double write_dt, int window,
+                                                    const string* resume_state) {
+    bool resume = (resume_state != nullptr);
+    // remove stale trajectories written with another profile
+    for (int other : {PROFILE_FULL, PROFILE_COMPACT, PROFILE_ENVELOPE}) {
+        if (other == profile || resume) continue;
+        remove_output(encoded_path(base, profile_ext(other), ENCODING_RAW));
+        remove_output(encoded_path(base, profile_ext(other), ENCODING_COMPRESSED));
+    }
+
+    unique_ptr<TrajectoryWriter> writer;
+    if (profile == PROFILE_EVENTS) {
+        writer.reset(new NullWriter(base + profile_ext(profile)));
+    } else if (profile == PROFILE_COMPACT) {
+        if (!resume) remove_output(encoded_path(base, profile_ext(profile), ENCODING_COMPRESSED));
+        writer.reset(new CompactWriter(base + profile_ext(profile), write_count, write_dt, resume));
+    } else if (profile == PROFILE_ENVELOPE) {
+        int32_t fields[3] = {(write_count + window - 1) / window, window, 0};
+        string prefix(ENVELOPE_MAGIC, sizeof(ENVELOPE_MAGIC));
+        prefix.append(reinterpret_cast<const char*>(fields), sizeof(fields));
+        prefix.append(reinterpret_cast<const char*>(&write_dt), sizeof(write_dt));
+        writer.reset(new EnvelopeWriter(
+            open_writer(base, profile_ext(profile), encoding, ENVELOPE_NCOLS, prefix, 4, resume), window));
+    } else {
+        string header(reinterpret_cast<const char*>(&write_count), sizeof(int32_t));
+        writer = open_writer(base, profile_ext(profile), encoding, 5, header, 0, resume);
+    }
+
+    if (resume) {
+        const char* p = resume_state->data();
+        if (!writer->restore(p, p + resume_state->size()) || !writer->good()) return nullptr;
+    }
+    return writer;
+}
+
+// ---------------------------------------------------------------------------
+// reader
+
+bool TrajectoryReader::open(const string& path, int ncols, int prefix_len, int count_offset) {
+    in_.open(path, ios::binary);
+    if (!in_) return false;
+
+    in_.seekg(0, ios::end);
+    int64_t file_size = static_cast<int64_t>(in_.tellg());
+    in_.seekg(0, ios::beg);
+
+    char magic[4] = {0, 0, 0, 0};
+    in_.read(magic, sizeof(magic));
+    if (in_.gcount() == sizeof(magic) && memcmp(magic, GCZ_MAGIC, sizeof(magic)) == 0) {
+        encoding_ = ENCODING_COMPRESSED;
+        int32_t fields[3];
+        in_.read(reinterpret_cast<char*>(fields), sizeof(fields));
+        in_.read(reinterpret_cast<char*>(&count_), sizeof(count_));
+        in_.read(reinterpret_cast<char*>(&index_offset_), sizeof(index_offset_));
+        if (!in_) return false;
+        ncols_ = fields[0];
+        block_size_ = fields[1];
+        prefix_.resize(fields[2]);
+        in_.read(&prefix_[0], prefix_.size());
+        data_offset_ = GCZ_HEADER_LEN + fields[2];
+        if (prefix_.compare(0, sizeof(ENVELOPE_MAGIC), ENVELOPE_MAGIC, sizeof(ENVELOPE_MAGIC)) == 0) {
+            profile_ = PROFILE_ENVELOPE;
+        }
+
+        if (index_offset_ > 0) {
+            int64_t nblocks = 0;
+            in_.seekg(index_offset_, ios::beg);
+            in_.read(reinterpret_cast<char*>(&nblocks), sizeof(nblocks));
+            for (int64_t k = 0; k < nblocks && in_; ++k) {
+                int64_t entry[2];
+                double first_value;
+                in_.read(reinterpret_cast<char*>(entry), sizeof(entry));
+                in_.read(reinterpret_cast<char*>(&first_value), sizeof(first_value));
+                block_offsets_.push_back(entry[0]);
+                block_first_record_.push_back(entry[1]);
+                block_first_time_.push_back(first_value);
+            }
+        } else {
+            // 文件未正常关闭（没有索引）：扫描块头重建
+            count_ = 0;
+            int64_t offset = data_offset_;
+            while (offset + 8 <= file_size) {
+                int32_t head[2];
+                in_.seekg(offset, ios::beg);
+                in_.read(reinterpret_cast<char*>(head), sizeof(head));
+                if (!in_ || offset + 8 + head[1] > file_size) break;
+
+                // 首条记录没有预测值，第一列的残差就是它的时间
+                string lead(1 + (head[0] + 1) / 2 + 8, '\0');
+                in_.read(&lead[0], lead.size());
+                in_.clear();
+                uint64_t r = 0;
+                int nbytes = static_cast<uint8_t>(lead[1]) & 0x0F;
+                for (int b = 0; b < nbytes && b < 8; ++b) {
+                    r |= static_cast<uint64_t>(static_cast<uint8_t>(lead[1 + (head[0] + 1) / 2 + b])) << (8 * b);
+                }
+
+                block_offsets_.push_back(offset);
+                block_first_record_.push_back(count_);
+                block_first_time_.push_back(from_bits(r));
+                count_ += head[0];
+                offset += 8 + head[1];
+            }
+            index_offset_ = offset;
+        }
+        in_.clear();
+        next_block_offset_ = data_offset_;
+        return static_cast<bool>(in_);
+    }
+
+    encoding_ = ENCODING_RAW;
+    block_size_ = DEFAULT_BLOCK_SIZE;
+    if (in_.gcount() == sizeof(magic) && memcmp(magic, COMPACT_MAGIC, sizeof(magic)) == 0) {
+        return open_compact(file_size);
+    }
+    if (in_.gcount() == sizeof(magic) && memcmp(magic, ENVELOPE_MAGIC, sizeof(magic)) == 0) {
+        profile_ = PROFILE_ENVELOPE;
+        ncols = ENVELOPE_NCOLS;
+        prefix_len = ENVELOPE_PREFIX_LEN;
+        count_offset = 4;
+    }
+    ncols_ = ncols;
+    in_.clear();
+    in_.seekg(0, ios::beg);
+    prefix_.resize(prefix_len);
+    in_.read(&prefix_[0], prefix_len);
+    if (in_.gcount() != prefix_len) return false;
+    data_offset_ = prefix_len;
+
+    int64_t available = (file_size - prefix_len) / (ncols_ * static_cast<int64_t>(sizeof(double)));
+    if (count_offset >= 0) {
+        int32_t n;
+        memcpy(&n, prefix_.data() + count_offset, sizeof(n));
+        count_ = (n < available) ? n : available;
+    } else {
+        count_ = available;
+    }
+    return true;
+}
+
+bool TrajectoryReader::open_compact(int64_t file_size) {
+    profile_ = PROFILE_COMPACT;
+    ncols_ = 5;
+    in_.clear();
+    in_.seekg(0, ios::beg);
+    prefix_.resize(COMPACT_HEADER_LEN);
+    in_.read(&prefix_[0], COMPACT_HEADER_LEN);
+    if (in_.gcount() != COMPACT_HEADER_LEN) return false;
+    data_offset_ = COMPACT_HEADER_LEN;
+
+    int32_t n;
+    const char* p = prefix_.data() + 4;
+    memcpy(&n, p, sizeof(n));              p += sizeof(n);
+    memcpy(&t_ini_, p, sizeof(t_ini_));    p += sizeof(t_ini_);
+    memcpy(&write_dt_, p, sizeof(write_dt_)); p += sizeof(write_dt_);
+    memcpy(offset_, p, sizeof(offset_));   p += sizeof(offset_);
+    memcpy(scale_, p, sizeof(scale_));
+
+    int64_t available = (file_size - COMPACT_HEADER_LEN) / static_cast<int64_t>(4 * sizeof(float));
+    count_ = (n < available) ? n : available;
+    return true;
+}
+
+void TrajectoryReader::expand_compact(const float* packed, int64_t first, int64_t nrec, double* records) const {
+    for (int64_t k = 0; k < nrec; ++k) {
+        double* record = records + k * 5;
+        record[0] = t_ini_ + static_cast<double>(first + k) * write_dt_;
+        for (int j = 0; j < 4; ++j) record[j + 1] = offset_[j] + scale_[j] * static_cast<double>(packed[4 * k + j]);
+    }
+}
+
+bool TrajectoryReader::load_block_at(int64_t offset) {
+    int32_t head[2];
+    in_.seekg(offset, ios::beg);
+    in_.read(reinterpret_cast<char*>(head), sizeof(head));
+    if (!in_) return false;
+    string payload(head[1], '\0');
+    in_.read(&payload[0], payload.size());
+    if (!in_) return false;
+    block_.resize(static_cast<size_t>(head[0]) * ncols_);
+    next_block_offset_ = offset + 8 + head[1];
+    return decode_block(payload.data(), payload.size(), head[0], ncols_, block_.data());
+}
+
+bool TrajectoryReader::next(double* record) {
+    if (records_read_ >= count_) return false;
+
+    if (profile_ == PROFILE_COMPACT) {
+        float packed[4];
+        in_.read(reinterpret_cast<char*>(packed), sizeof(packed));
+        if (!in_) return false;
+        expand_compact(packed, records_read_, 1, record);
+        ++records_read_;
+        return true;
+    }
+
+    if (encoding_ == ENCODING_RAW) {
+        in_.read(reinterpret_cast<char*>(record), ncols_ * sizeof(double));
+        if (!in_) return false;
+        ++records_read_;
+        return true;
+    }
+
+    if (block_pos_ >= static_cast<int64_t>(block_.size() / ncols_)) {
+        if (next_block_offset_ >= index_offset_ || !load_block_at(next_block_offset_)) return false;
+        block_pos_ = 0;
+    }
+    memcpy(record, &block_[block_pos_ * ncols_], ncols_ * sizeof(double));
+    ++block_pos_;
+    ++records_read_;
+    return true;
+}
+
+int64_t TrajectoryReader::num_blocks() const {
+    if (encoding_ == ENCODING_COMPRESSED) return static_cast<int64_t>(block_offsets_.size());
+    return (count_ + block_size_ - 1) / block_size_;
+}
+
+bool TrajectoryReader::read_block(int64_t k, vector<double>& records) {
+    if (k < 0 || k >= num_blocks()) return false;
+
+    // 随机访问不影响顺序读取的位置
+    streampos saved = in_.tellg();
+    bool ok;
+    if (encoding_ == ENCODING_COMPRESSED) {
+        vector<double> streaming_block;
+        streaming_block.swap(block_);
+        int64_t saved_next = next_block_offset_;
+        ok = load_block_at(block_offsets_[k]);
+        records.swap(block_);
+        block_.swap(streaming_block);
+        next_block_offset_ = saved_next;
+    } else if (profile_ == PROFILE_COMPACT) {
+        int64_t first = k * block_size_;
+        int64_t nrec = (count_ - first < block_size_) ? count_ - first : block_size_;
+        vector<float> packed(static_cast<size_t>(nrec) * 4);
+        in_.seekg(data_offset_ + first * static_cast<int64_t>(4 * sizeof(float)), ios::beg);
+        in_.read(reinterpret_cast<char*>(packed.data()), packed.size() * sizeof(float));
+        ok = static_cast<bool>(in_);
+        records.resize(static_cast<size_t>(nrec) * ncols_);
+        expand_compact(packed.data(), first, nrec, records.data());
+    } else {
+        int64_t first = k * block_size_;
+        int64_t nrec = (count_ - first < block_size_) ? count_ - first : block_size_;
+        records.resize(static_cast<size_t>(nrec) * ncols_);
+        in_.seekg(data_offset_ + first * ncols_ * static_cast<int64_t>(sizeof(double)), ios::beg);
+        in_.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(double));
+        ok = static_cast<bool>(in_);
+    }
+    in_.clear();
+    in_.seekg(saved);
+    return ok;
+}
+
+int TrajectoryReader::direction() {
+    if (direction_ == 0) {
+        direction_ = 1;
+        if (count_ > 1 && time_at(count_ - 1) < time_at(0)) direction_ = -1;
+    }
+    return direction_;
+}
+
+int64_t TrajectoryReader::block_of(int64_t k) const {
+    auto it = upper_bound(block_first_record_.begin(), block_first_record_.end(), k);
+    return static_cast<int64_t>(it - block_first_record_.begin()) - 1;
+}
+
+bool TrajectoryReader::cached_block(int64_t b) {
+    if (cache_id_ == b) return true;
+    cache_id_ = -1;
+    if (!read_block(b, cache_)) return false;
+    cache_id_ = b;
+    return true;
+}
+
+double TrajectoryReader::time_at(int64_t k) {
+    if (profile_ == PROFILE_COMPACT) return t_ini_ + static_cast<double>(k) * write_dt_;
+    if (encoding_ == ENCODING_COMPRESSED) {
+        int64_t b = block_of(k);
+        if (b < 0 || !cached_block(b)) return NAN;
+        return cache_[(k - block_first_record_[b]) * ncols_];
+    }
+    double t = NAN;
+    in_.clear();
+    in_.seekg(data_offset_ + k * ncols_ * static_cast<int64_t>(sizeof(double)), ios::beg);
+    in_.read(reinterpret_cast<char*>(&t), sizeof(t));
+    return t;
+}
+
+// 第一条满足 u_k >= u（upper 时 u_k > u）的记录，u = direction * t
+int64_t TrajectoryReader::bound_time(double t, bool upper) {
+    if (count_ == 0) return 0;
+    in_.clear();
+    streampos saved = in_.tellg();
+
+    int dir = direction();
+    double u = dir * t;
+    auto before = [&](double tk) { return upper ? (dir * tk <= u) : (dir * tk < u); };
+
+    int64_t lo = 0, hi = count_;
+    if (encoding_ == ENCODING_COMPRESSED && !block_first_time_.empty()) {
+        // 先用块索引缩小到一个块
+        int64_t nb = static_cast<int64_t>(block_first_time_.size());
+        int64_t b = partition_point(block_first_time_.begin(), block_first_time_.end(), before) - block_first_time_.begin();
+        if (b < nb) hi = block_first_record_[b];
+        lo = (b > 0) ? block_first_record_[b - 1] : 0;
+    }
+    while (lo < hi) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (before(time_at(mid))) lo = mid + 1;
+        else hi = mid;
+    }
+
+    in_.clear();
+    in_.seekg(saved);
+    return lo;
+}
+
+int64_t TrajectoryReader::lower_bound_time(double t) {
+    return bound_time(t, false);
+}
+
+bool TrajectoryReader::seek(int64_t k) {
+    if (k < 0 || k > count_) return false;
+    records_read_ = k;
+    in_.clear();
+    if (encoding_ == ENCODING_COMPRESSED) {
+        if (k == count_) return true;
+        int64_t b = block_of(k);
+        if (b < 0 || !load_block_at(block_offsets_[b])) return false;
+        block_pos_ = k - block_first_record_[b];
+        return true;
+    }
+    int64_t record_bytes = (profile_ == PROFILE_COMPACT) ? static_cast<int64_t>(4 * sizeof(float))
+                                                         : ncols_ * static_cast<int64_t>(sizeof(double));
+    in_.seekg(data_offset_ + k * record_bytes, ios::beg);
+    return static_cast<bool>(in_);
+}
+
+int64_t TrajectoryReader::seek_range(double t0, double t1) {
+    if (t0 > t1) swap(t0, t1);
+    bool forward = direction() > 0;
+    int64_t first = bound_time(forward ? t0 : t1, false);
+    int64_t last = bound_time(forward ? t1 : t0, true);
+    if (last < first || !seek(first)) return 0;
+    return last - first;
+}
+
+bool TrajectoryReader::read_range(double t0, double t1, vector<double>& records) {
+    int64_t n = seek_range(t0, t1);
+    records.resize(static_cast<size_t>(n) * ncols_);
+    for (int64_t k = 0; k < n; ++k) {
+        if (!next(&records[k * ncols_])) return false;
+    }
+    return true;
+}
+
+bool read_range(const string& path, double t0, double t1, vector<double>& records, int* ncols) {
+    TrajectoryReader reader;
+    if (!reader.open(path, 5, sizeof(int32_t), 0)) return false;
+    if (ncols) *ncols = reader.ncols();
+    return reader.read_range(t0, t1, records);
+}
+
+} // namespace traj_io
@@ -0,0 +1,165 @@
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "trajectory_stream.h"
+
+using namespace std;
+
+namespace traj_stream {
+
+string StreamMeta::to_bytes() const {
+    int32_t ints[4] = {ncols, magnetic_field_model, wave_field_model, expected_count};
+    double doubles[8] = {E0, q, Ek, pa, p, mu, t_ini, write_dt};
+    string out(reinterpret_cast<const char*>(ints), sizeof(ints));
+    out.append(reinterpret_cast<const char*>(doubles), sizeof(doubles));
+    out.append(name);
+    return out;
+}
+
+bool StreamMeta::from_bytes(const char* data, size_t len) {
+    int32_t ints[4];
+    double doubles[8];
+    if (len < sizeof(ints) + sizeof(doubles)) return false;
+    memcpy(ints, data, sizeof(ints));
+    memcpy(doubles, data + sizeof(ints), sizeof(doubles));
+    ncols = ints[0];
+    magnetic_field_model = ints[1];
+    wave_field_model = ints[2];
+    expected_count = ints[3];
+    E0 = doubles[0]; q = doubles[1]; Ek = doubles[2]; pa = doubles[3];
+    p = doubles[4]; mu = doubles[5]; t_ini = doubles[6]; write_dt = doubles[7];
+    name.assign(data + sizeof(ints) + sizeof(doubles), len - sizeof(ints) - sizeof(doubles));
+    return ncols > 0;
+}
+
+bool valid_target(const string& target) {
+    return (target.rfind("fifo:", 0) == 0 || target.rfind("unix:", 0) == 0) && target.size() > 5;
+}
+
+int records_per_frame(int ncols) {
+    return (MAX_FRAME_LEN - FRAME_HEADER_LEN) / (ncols * static_cast<int>(sizeof(double)));
+}
+
+#ifdef _WIN32
+
+unique_ptr<traj_io::TrajectoryWriter> open_stream_writer(const string& target, const StreamMeta&) {
+    cerr << "Streaming output (" << target << ") is only supported on POSIX systems" << endl;
+    exit(1);
+}
+
+#else
+
+class StreamWriter : public traj_io::TrajectoryWriter {
+public:
+    StreamWriter(const string& target, int fd, const StreamMeta& meta)
+        : TrajectoryWriter(target, meta.ncols, "", -1), fd_(fd),
+          stream_(static_cast<uint32_t>(getpid())), per_frame_(records_per_frame(meta.ncols)) {
+        buffer_.reserve(static_cast<size_t>(per_frame_) * ncols_);
+        string payload = meta.to_bytes();
+        send_frame(FRAME_START, 0, payload.data(), payload.size());
+    }
+    ~StreamWriter() override { close(); }
+
+    bool good() const override { return fd_ >= 0 && !failed_; }
+    void write(const double* record) override {
+        buffer_.insert(buffer_.end(), record, record + ncols_);
+        ++count_;
+        if (static_cast<int>(buffer_.size() / ncols_) == per_frame_) flush();
+    }
+    void close() override {
+        if (fd_ < 0) return;
+        flush();
+        int64_t n = count_;
+        send_frame(FRAME_END, 0, &n, sizeof(n));
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+private:
+    void flush() {
+        if (buffer_.empty()) return;
+        send_frame(FRAME_RECORDS, static_cast<uint32_t>(buffer_.size() / ncols_),
+                   buffer_.data(), buffer_.size() * sizeof(double));
+        buffer_.clear();
+    }
+
+    // 帧头和负载拼成一块，用一次 write 写出（fifo 中保证原子性）
+    void send_frame(uint16_t type, uint32_t count, const void* payload, size_t len) {
+        if (failed_) return;
+        FrameHeader head = {FRAME_MAGIC, type, stream_, count, static_cast<uint32_t>(len)};
+        frame_.assign(reinterpret_cast<const char*>(&head), sizeof(head));
+        frame_.append(static_cast<const char*>(payload), len);
+
+        size_t done = 0;
+        while (done < frame_.size()) {
+            ssize_t n = ::write(fd_, frame_.data() + done, frame_.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                cerr << "Stream " << path_ << " closed by the consumer: " << strerror(errno) << endl;
+                failed_ = true;
+                return;
+            }
+            done += static_cast<size_t>(n);
+        }
+    }
+
+    int fd_;
+    uint32_t stream_;
+    int per_frame_;
+    bool failed_ = false;
+    vector<double> buffer_;
+    string frame_;
+};
+
+unique_ptr<traj_io::TrajectoryWriter> open_stream_writer(const string& target, const StreamMeta& meta) {
+    if (!valid_target(target)) {
+        cerr << "Invalid stream target: " << target << " (expected fifo:PATH or unix:PATH)" << endl;
+        exit(1);
+    }
+    if (FRAME_HEADER_LEN + meta.to_bytes().size() > static_cast<size_t>(MAX_FRAME_LEN)) {
+        cerr << "Stream metadata too long for " << meta.name << endl;
+        exit(1);
+    }
+    // a vanished consumer must not kill the particle process
+    signal(SIGPIPE, SIG_IGN);
+
+    string path = target.substr(5);
+    int fd = -1;
+    if (target.rfind("fifo:", 0) == 0) {
+        // blocks until the consumer has opened the read end
+        fd = open(path.c_str(), O_WRONLY);
+    } else {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            cerr << "UNIX socket path too long: " << path << endl;
+            exit(1);
+        }
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        cerr << "Failed to open stream " << target << ": " << strerror(errno) << endl;
+        exit(1);
+    }
+    return unique_ptr<traj_io::TrajectoryWriter>(new StreamWriter(target, fd, meta));
+}
+
+#endif
+
+} // namespace traj_stream
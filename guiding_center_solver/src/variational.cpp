@@ -0,0 +1,92 @@
+#include <cmath>
+#include <Eigen/Dense>
+
+#include "variational.h"
+#include "singular_particle.h"
+
+using namespace std;
+using namespace Eigen;
+using traj_io::put_value;
+using traj_io::get_value;
+
+namespace variational {
+
+int ncols(int output)
+{
+    return output == MATRIX ? 27 : 2;
+}
+
+void step(VectorXd& Y, Matrix5d& Phi, double h, VectorXd& k1, int output)
+{
+    // Φ 的第 0 行恒为 e_0，J 的第 0 列只影响 Φ 的第 0 列，ftle 方案不需要
+    bool time_column = output == MATRIX;
+    Matrix5d J;
+    k1 = dydt_jacobian(Y, J, time_column);
+    Matrix5d K1 = J * Phi;
+    VectorXd k2 = dydt_jacobian(Y + 0.5 * h * k1, J, time_column);
+    Matrix5d K2 = J * (Phi + 0.5 * h * K1);
+    VectorXd k3 = dydt_jacobian(Y + 0.5 * h * k2, J, time_column);
+    Matrix5d K3 = J * (Phi + 0.5 * h * K2);
+    VectorXd k4 = dydt_jacobian(Y + h * k3, J, time_column);
+    Matrix5d K4 = J * (Phi + h * K3);
+    Y += (h / 6.0) * (k1 + 2 * k2 + 2 * k3 + k4);
+    Phi += (h / 6.0) * (K1 + 2 * K2 + 2 * K3 + K4);
+}
+
+double ftle(const Matrix5d& Phi, double elapsed, double p)
+{
+    if (elapsed == 0.0) return 0.0;
+    // x, y, z, p_para / p
+    Matrix4d S = Phi.block<4, 4>(1, 1);
+    S.row(3) /= p;
+    S.col(3) *= p;
+    double sigma = JacobiSVD<Matrix4d>(S).singularValues()[0];
+    return log(sigma) / fabs(elapsed);
+}
+
+unique_ptr<traj_io::TrajectoryWriter> open_writer(const string& outFileBase, int output, const string* resume_state,
+                                                  Matrix5d& Phi)
+{
+    string prefix = "GCVR";
+    put_value(prefix, static_cast<int32_t>(0));
+    put_value(prefix, static_cast<int32_t>(ncols(output)));
+    if (!resume_state) {
+        Phi.setIdentity();
+        return traj_io::open_writer(outFileBase, ".gcv", traj_io::ENCODING_RAW, ncols(output), prefix, 4);
+    }
+
+    const char* p = resume_state->data();
+    const char* end = p + resume_state->size();
+    int32_t saved;
+    double values[25];
+    if (!get_value(p, end, saved) || saved != output || !get_value(p, end, values)) return nullptr;
+    Phi = Map<const Matrix<double, 5, 5, RowMajor>>(values);
+    auto writer = traj_io::open_writer(outFileBase, ".gcv", traj_io::ENCODING_RAW, ncols(output), prefix, 4, true);
+    if (!writer->restore(p, end) || !writer->good()) return nullptr;
+    return writer;
+}
+
+void write(traj_io::TrajectoryWriter& writer, int output, const VectorXd& Y, const Matrix5d& Phi, double t_ini,
+           double p)
+{
+    double record[27];
+    record[0] = Y[0];
+    record[1] = ftle(Phi, Y[0] - t_ini, p);
+    if (output == MATRIX) Map<Matrix<double, 5, 5, RowMajor>>(record + 2) = Phi;
+    writer.write(record);
+}
+
+string checkpoint(traj_io::TrajectoryWriter& writer, int output, const Matrix5d& Phi)
+{
+    string writer_state = writer.checkpoint();
+    if (writer_state.empty()) return "";
+    string state;
+    put_value(state, static_cast<int32_t>(output));
+    double values[25];
+    Map<Matrix<double, 5, 5, RowMajor>> out(values);
+    out = Phi;
+    put_value(state, values);
+    return state + writer_state;
+}
+
+} // namespace variational
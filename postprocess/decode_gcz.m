@@ -0,0 +1,137 @@
+function [prefix, data] = decode_gcz(filename, t_range)
+    % Decodes a compressed trajectory/diagnostic file (.gctz, .gcdz, .gctez).
+    %
+    % The compressed file stores the same header (prefix) and records as the
+    % raw .gct/.gcd file, encoded in blocks (see trajectory_io.h):
+    %   header : 'GCZ1', int32 ncols, int32 block_size, int32 prefix_len,
+    %            int64 record_count, int64 index_offset
+    %   prefix : prefix_len bytes, identical to the header of the raw file
+    %   blocks : int32 nrec, int32 payload_len, payload
+    %   index  : int64 nblocks, per block int64 offset, int64 first_record, double first_value
+    % Each column of a block is stored as: uint8 predictor order, the packed
+    % 4-bit byte counts of the residuals, and the residual bytes. A residual is
+    % the XOR of the value bits and the bits of the polynomial prediction.
+    %
+    % Optional:
+    %   t_range : [t0 t1], only records whose first column (time) lies in the
+    %             range are returned; only the blocks covering it are decoded
+    %
+    % Returns:
+    %   prefix : uint8 column vector, the header of the raw file
+    %   data   : record matrix (N x ncols), identical to the raw file contents
+
+    fid = fopen(filename, 'rb');
+    if fid < 0
+        error('Failed to open file %s', filename);
+    end
+
+    header = fread(fid, 32, '*uint8');
+    if numel(header) < 32 || ~isequal(char(header(1:4))', 'GCZ1')
+        fclose(fid);
+        error('%s is not a compressed trajectory file', filename);
+    end
+    ncols        = double(typecast(header(5:8), 'int32'));
+    prefix_len   = double(typecast(header(13:16), 'int32'));
+    record_count = double(typecast(header(17:24), 'int64'));
+    index_offset = double(typecast(header(25:32), 'int64'));
+    prefix = fread(fid, prefix_len, '*uint8');
+
+    if index_offset > 0
+        fseek(fid, index_offset, 'bof');
+        nblocks = fread(fid, 1, 'int64');
+        raw_index = reshape(fread(fid, 24 * nblocks, '*uint8'), 24, nblocks);
+        offsets = double(typecast(reshape(raw_index(1:8, :), [], 1), 'int64'));
+        first_t = typecast(reshape(raw_index(17:24, :), [], 1), 'double');
+    else
+        % a file without index (interrupted run) is decoded up to its last complete block
+        fseek(fid, 0, 'eof');
+        file_size = ftell(fid);
+        offsets = [];
+        offset = 32 + prefix_len;
+        while offset + 8 <= file_size
+            fseek(fid, offset, 'bof');
+            head = fread(fid, 2, 'int32');
+            if offset + 8 + head(2) > file_size
+                break;
+            end
+            offsets(end+1, 1) = offset; %#ok<AGROW>
+            offset = offset + 8 + head(2);
+        end
+        first_t = [];
+    end
+
+    % blocks that may contain records in t_range: block b spans [first_t(b), first_t(b+1)]
+    selected = true(numel(offsets), 1);
+    if nargin > 1 && numel(first_t) > 1
+        t_lo = min(t_range);
+        t_hi = max(t_range);
+        direction = 1;
+        if first_t(end) < first_t(1)
+            direction = -1;                     % backward integration
+        end
+        span_end = [first_t(2:end); direction * Inf];
+        selected = max(first_t, span_end) >= t_lo & min(first_t, span_end) <= t_hi;
+    end
+
+    data = zeros(max(record_count, 0), ncols);
+    row = 0;
+    for b = find(selected)'
+        fseek(fid, offsets(b), 'bof');
+        head = fread(fid, 2, 'int32');
+        nrec = head(1);
+        payload = fread(fid, head(2), '*uint8');
+        if numel(payload) < head(2)
+            break;
+        end
+        data(row+1:row+nrec, :) = decode_block(payload, nrec, ncols);
+        row = row + nrec;
+    end
+    data = data(1:row, :);
+    fclose(fid);
+
+    if nargin > 1
+        t = data(:, 1);
+        data = data(t >= min(t_range) & t <= max(t_range), :);
+    end
+end
+
+function block = decode_block(bytes, nrec, ncols)
+    block = zeros(nrec, ncols);
+    p = 0;                                      % zero-based byte offset
+    for j = 1:ncols
+        order = double(bytes(p+1));
+        p = p + 1;
+        nctrl = ceil(nrec / 2);
+        ctrl = bytes(p+1:p+nctrl);
+        p = p + nctrl;
+        nib = [bitand(ctrl, uint8(15))'; bitshift(ctrl, -4)'];
+        nib = double(nib(1:nrec))';
+        start = p + cumsum([0; nib(1:end-1)]);
+        residual = zeros(nrec, 1, 'uint64');
+        for b = 0:7
+            sel = nib > b;
+            residual(sel) = residual(sel) + bitshift(uint64(bytes(start(sel) + b + 1)), 8*b);
+        end
+        p = p + sum(nib);
+
+        col = zeros(nrec, 1);
+        for k = 1:nrec
+            col(k) = typecast(bitxor(residual(k), typecast(predict(col, k, order), 'uint64')), 'double');
+        end
+        block(:, j) = col;
+    end
+end
+
+function p = predict(col, k, order)
+    % Same additions/subtractions as the C++ encoder, so that the result is bit-exact
+    if k == 1
+        p = 0;
+    elseif k == 2 || order == 1
+        p = col(k-1);
+    elseif k == 3 || order == 2
+        p = (col(k-1) + col(k-1)) - col(k-2);
+    else
+        d = col(k-1) - col(k-2);
+        p = ((d + d) + d) + col(k-3);
+    end
+end
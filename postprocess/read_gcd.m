@@ -23,6 +23,7 @@ function data = read_gcd(filename)
     %     - t_step: Time step for the simulation [s]
     %     - r_step: Radial step for the simulation [RE]
     %     - write_count: Number of records written in the file
+    %     - columns: Names of the diagnostic quantities stored in the file
     %     - t: Time vector (N-element vector) [s]
     %     - gsm_pos: Position in GSM coordinates (Nx3 matrix) [RE]
     %     - p_para: Parallel momentum (N-element vector) [s*MeV/RE]
@@ -47,18 +48,39 @@ function data = read_gcd(filename)
     % Example usage:
     %   data = read_gcd('simulation_output.gcd');
     %
+    % Compressed files (.gcdz) are decoded transparently.
+    %
     % Notes:
     %   - The specific fields and their formats depend on the version of the .gcd file !
+    %   - Diagnosor may be asked to write only some of the quantities (--columns
+    %     or a .dcol file). Quantities that are not in the file are not set.
 
     disp(['Reading GCD file: ', fullfile(pwd, filename),' ...']);
 
-    fid = fopen(filename, 'rb');
-    if fid < 0
-        error('Failed to open file %s', filename);
+    % the header: 14 doubles and 5 int32 (models, record count, record length, column mask)
+    header_len = 14*8 + 5*4;
+    [~, ~, ext] = fileparts(filename);
+    if strcmpi(ext, '.gcdz')
+        % compressed diagnostics (Diagnosor --encoding=compressed)
+        [header, raw] = decode_gcz(filename);
+    else
+        fid = fopen(filename, 'rb');
+        if fid < 0
+            error('Failed to open file %s', filename);
+        end
+        header = fread(fid, header_len, '*uint8');
+        if numel(header) < header_len
+            fclose(fid);
+            error('File is empty or has an incorrect format');
+        end
+        record_len = double(typecast(header(header_len-7:header_len-4), 'int32'));
+        write_count = double(typecast(header(header_len-11:header_len-8), 'int32'));
+        raw = fread(fid, [record_len, write_count], 'double')';
+        fclose(fid);
     end
 
     % read the simulation parameters
-    para = fread(fid, 14, 'double')';
+    para = typecast(header(1:14*8), 'double')';
     data.dt                 = para(1);
     data.E0                 = para(2);
     data.q                  = para(3);
@@ -74,44 +96,31 @@ function data = read_gcd(filename)
     data.t_step             = para(13);
     data.r_step             = para(14);
 
-    % read magnetic field and wave field model numbers
-    data.magnetic_field_model = fread(fid, 1, 'int32');
-    data.wave_field_model     = fread(fid, 1, 'int32');
-
-    % read the number of records
-    write_count = fread(fid, 1, 'int32');
-    if isempty(write_count)
-        fclose(fid);
-        error('File is empty or has an incorrect format');
-    end
-    data.write_count = write_count;
+    % magnetic field and wave field model numbers, number of records,
+    % and the column schema (record length and bit mask of the stored quantities)
+    ints = double(typecast(header(14*8+1:header_len), 'int32'));
+    data.magnetic_field_model = ints(1);
+    data.wave_field_model     = ints(2);
+    data.write_count          = ints(3);
+    column_mask = double(typecast(header(header_len-3:header_len), 'uint32'));
 
-    % read all the diagnostic data
-    record_len = 40;
-    raw = fread(fid, [record_len, write_count], 'double')';
-    fclose(fid);
+    % all quantities in the order Diagnosor writes them: name and width
+    schema = { ...
+        't', 1; 'gsm_pos', 3; 'p_para', 1; 'sm_pos', 3; 'MLAT', 1; 'MLT', 1; 'L', 1; ...
+        'B', 3; 'E', 3; 'grad_B', 3; 'curv_B', 3; ...
+        'vd_ExB', 3; 'vd_grad', 3; 'vd_curv', 3; 'v_para', 3; 'gamm', 1; ...
+        'dp_dt_1', 1; 'dp_dt_2', 1; 'dp_dt_3', 1; 'pB_pt', 1};
 
+    data.columns = {};
     idx = 1;
-    data.t         = raw(:, idx); idx = idx+1;                % 1
-    data.gsm_pos   = raw(:, idx:idx+2); idx = idx+3;          % 2-4
-    data.p_para    = raw(:, idx); idx = idx+1;                % 5
-    data.sm_pos    = raw(:, idx:idx+2); idx = idx+3;          % 6-8
-    data.MLAT      = raw(:, idx); idx = idx+1;                % 9
-    data.MLT       = raw(:, idx); idx = idx+1;                % 10
-    data.L         = raw(:, idx); idx = idx+1;                % 11
-    data.B         = raw(:, idx:idx+2); idx = idx+3;          % 12-14
-    data.E         = raw(:, idx:idx+2); idx = idx+3;          % 15-17
-    data.grad_B    = raw(:, idx:idx+2); idx = idx+3;          % 18-20
-    data.curv_B    = raw(:, idx:idx+2); idx = idx+3;          % 21-23
-    data.vd_ExB    = raw(:, idx:idx+2); idx = idx+3;          % 24-26
-    data.vd_grad   = raw(:, idx:idx+2); idx = idx+3;          % 27-29
-    data.vd_curv   = raw(:, idx:idx+2); idx = idx+3;          % 30-32
-    data.v_para    = raw(:, idx:idx+2); idx = idx+3;          % 33-35
-    data.gamm      = raw(:, idx); idx = idx+1;                % 36
-    data.dp_dt_1   = raw(:, idx); idx = idx+1;                % 37
-    data.dp_dt_2   = raw(:, idx); idx = idx+1;                % 38
-    data.dp_dt_3   = raw(:, idx); idx = idx+1;                % 39
-    data.pB_pt     = raw(:, idx);                             % 40
+    for k = 1:size(schema, 1)
+        if bitand(column_mask, bitshift(1, k-1))
+            width = schema{k, 2};
+            data.(schema{k, 1}) = raw(:, idx:idx+width-1);
+            data.columns{end+1} = schema{k, 1};
+            idx = idx + width;
+        end
+    end
 
     disp('Finished reading GCD file.');
 
@@ -0,0 +1,47 @@
+function ev = read_gce(filename)
+    % Reads an event file (.gce) written by Solver --events=LIST.
+    % Events are in time order; the state is interpolated within the step.
+    %
+    % Returns:
+    %   ev (struct):
+    %     - count     : number of events
+    %     - t         : event time, Epoch time [s]
+    %     - x, y, z   : GSM position [RE]
+    %     - p_para    : parallel momentum [MeV*s/RE]
+    %     - type      : 0 mirror, 1 equator, 2 atmosphere, 3 lmax, 4 magnetopause
+    %     - direction : +1 if the event function increases, -1 if it decreases
+    %     - names     : event names, cell array
+
+    disp(['Reading GCE file: ', fullfile(pwd, filename),' ...']);
+
+    fid = fopen(filename, 'rb');
+    if fid < 0
+        error('Failed to open file %s', filename);
+    end
+    % prefix: "GCEV", int32 count
+    magic = fread(fid, 4, '*char')';
+    if ~isequal(magic, 'GCEV')
+        fclose(fid);
+        error('%s is not an event file', filename);
+    end
+    ev.count = fread(fid, 1, 'int32');
+    data = fread(fid, [7, ev.count], 'double')';
+    fclose(fid);
+
+    if size(data, 1) ~= ev.count
+        warning('The actual number of events (%d) does not match the expected count (%d).', size(data, 1), ev.count);
+    end
+
+    ev.t         = data(:, 1);
+    ev.x         = data(:, 2);
+    ev.y         = data(:, 3);
+    ev.z         = data(:, 4);
+    ev.p_para    = data(:, 5);
+    ev.type      = data(:, 6);
+    ev.direction = data(:, 7);
+
+    event_names = {'mirror', 'equator', 'atmosphere', 'lmax', 'magnetopause'};
+    ev.names = event_names(ev.type + 1)';
+
+    disp('Finished reading GCE file.');
+end
@@ -1,5 +1,12 @@
-function [count, t_val, x_val, y_val, z_val, p_para_val] = read_gct(filename)
+function [count, t_val, x_val, y_val, z_val, p_para_val] = read_gct(filename, t_range)
     % This function reads a binary file(.gct) containing guiding center trajectory data.
+    % Compressed files (.gctz) and compact files (.gctc, Solver --profile=compact)
+    % are decoded transparently; for .gctc t is reconstructed as t_ini + k*write_dt
+    % and positions/momentum have float32 precision.
+    % With the optional t_range = [t0 t1] only the records with t0 <= t <= t1 are
+    % read: the raw file is bisected on its fixed-size records, the compact time
+    % is computed, and for compressed files only the blocks covering the range
+    % are decoded (block time index). count is then the number of records read.
     % The function returns:
     %   count      : number of records
     %   t_val      : array of time values, Epoch time [s]
@@ -10,22 +17,91 @@ function [count, t_val, x_val, y_val, z_val, p_para_val] = read_gct(filename)
     
     disp(['Reading GCT file: ', fullfile(pwd, filename),' ...']);
 
-    fid = fopen(filename, 'rb');
-    if fid < 0
-        error('Failed to open file %s', filename);
+    ranged = nargin > 1;
+    if ranged
+        t_lo = min(t_range);
+        t_hi = max(t_range);
     end
-    
-    % Read the number of records
-    count = fread(fid, 1, 'int32'); % 'long' is 8 bytes on some platforms, use 'int32' if 4 bytes
-    if isempty(count)
-        error('File is empty or has an incorrect format');
+
+    [~, ~, ext] = fileparts(filename);
+    if strcmpi(ext, '.gctz')
+        % compressed trajectory (Solver --encoding=compressed)
+        if ranged
+            [prefix, data] = decode_gcz(filename, t_range);
+        else
+            [prefix, data] = decode_gcz(filename);
+        end
+        count = double(typecast(prefix(1:4), 'int32'));
+    elseif strcmpi(ext, '.gctc')
+        % compact trajectory: "GCTC", int32 count, double t_ini, double write_dt,
+        % double offset(4), double scale(4), then 4 float32 per record
+        fid = fopen(filename, 'rb');
+        if fid < 0
+            error('Failed to open file %s', filename);
+        end
+        magic = fread(fid, 4, '*char')';
+        if ~strcmp(magic, 'GCTC')
+            fclose(fid);
+            error('%s is not a compact trajectory file', filename);
+        end
+        count    = fread(fid, 1, 'int32');
+        t_ini    = fread(fid, 1, 'double');
+        write_dt = fread(fid, 1, 'double');
+        offset   = fread(fid, 4, 'double')';
+        scale    = fread(fid, 4, 'double')';
+        first = 0;
+        n = count;
+        if ranged
+            % t_k = t_ini + k*write_dt, one record of margin against rounding
+            k = sort(([t_lo t_hi] - t_ini) / write_dt);
+            first = max(0, ceil(k(1)) - 1);
+            n = max(0, min(count - 1, floor(k(2)) + 1) - first + 1);
+            fseek(fid, first * 16, 'cof');
+        end
+        packed   = fread(fid, [4, n], 'single=>double')';
+        fclose(fid);
+        n = size(packed, 1);
+        data = [t_ini + (first:first+n-1)' * write_dt, offset + packed .* scale];
+    else
+        fid = fopen(filename, 'rb');
+        if fid < 0
+            error('Failed to open file %s', filename);
+        end
+
+        % Read the number of records
+        count = fread(fid, 1, 'int32'); % 'long' is 8 bytes on some platforms, use 'int32' if 4 bytes
+        if isempty(count)
+            error('File is empty or has an incorrect format');
+        end
+
+        if ranged
+            % fixed-size records with monotonic t: bisect the file
+            fseek(fid, 0, 'eof');
+            n = min(count, floor((ftell(fid) - 4) / 40));
+            direction = 1;
+            if n > 1 && record_time(fid, n - 1) < record_time(fid, 0)
+                direction = -1;                  % backward integration
+            end
+            if direction > 0
+                first = time_bound(fid, n, t_lo, false, direction);
+                last  = time_bound(fid, n, t_hi, true, direction);
+            else
+                first = time_bound(fid, n, t_hi, false, direction);
+                last  = time_bound(fid, n, t_lo, true, direction);
+            end
+            fseek(fid, 4 + first * 40, 'bof');
+            data = fread(fid, [5, max(0, last - first)], 'double')';
+        else
+            % Read all data
+            data = fread(fid, [5, count], 'double')';
+        end
+        fclose(fid);
     end
-    
-    % Read all data
-    data = fread(fid, [5, count], 'double')';
-    fclose(fid);
 
-    if size(data,1) ~= count
+    if ranged
+        data = data(data(:,1) >= t_lo & data(:,1) <= t_hi, :);
+        count = size(data, 1);
+    elseif size(data,1) ~= count
         warning('The actual number of data rows (%d) does not match the expected count (%d). The file may not have been completely written.', size(data,1), count);
         % Pad the data to the expected length to avoid indexing errors
         data(count,5) = 0;
@@ -40,4 +116,25 @@ function [count, t_val, x_val, y_val, z_val, p_para_val] = read_gct(filename)
     
     disp('Finished reading GCT file.');
     
-end
\ No newline at end of file
+end
+
+function t = record_time(fid, k)
+    fseek(fid, 4 + k * 40, 'bof');
+    t = fread(fid, 1, 'double');
+end
+
+function k = time_bound(fid, n, t, upper, direction)
+    % Number of leading records with direction*t_k < direction*t (<= when upper)
+    lo = 0;
+    hi = n;
+    while lo < hi
+        mid = floor((lo + hi) / 2);
+        tk = record_time(fid, mid);
+        if direction * tk < direction * t || (upper && tk == t)
+            lo = mid + 1;
+        else
+            hi = mid;
+        end
+    end
+    k = lo;
+end
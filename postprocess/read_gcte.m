@@ -0,0 +1,58 @@
+function env = read_gcte(filename)
+    % Reads an envelope trajectory file (.gcte or compressed .gctez) written by
+    % Solver --profile=envelope. Every record summarizes a window of consecutive
+    % trajectory points.
+    %
+    % Returns:
+    %   env (struct):
+    %     - count    : number of windows
+    %     - window   : trajectory records per window (the last one may be shorter)
+    %     - write_dt : time between trajectory records [s]
+    %     - t_first, t_last : time of the first/last point of each window, Epoch time [s]
+    %     - x, y, z, p_para : N x 3 matrices, columns are [min, max, mean] over the window
+    %                         (GSM position [RE], parallel momentum [MeV*s/RE])
+
+    disp(['Reading GCTE file: ', fullfile(pwd, filename),' ...']);
+
+    % prefix: "GCTE", int32 count, int32 window, int32 0, double write_dt
+    prefix_len = 4 + 3*4 + 8;
+    ncols = 14;
+    [~, ~, ext] = fileparts(filename);
+    if strcmpi(ext, '.gctez')
+        [prefix, data] = decode_gcz(filename);
+    else
+        fid = fopen(filename, 'rb');
+        if fid < 0
+            error('Failed to open file %s', filename);
+        end
+        prefix = fread(fid, prefix_len, '*uint8');
+        if numel(prefix) < prefix_len
+            fclose(fid);
+            error('File is empty or has an incorrect format');
+        end
+        count = double(typecast(prefix(5:8), 'int32'));
+        data = fread(fid, [ncols, count], 'double')';
+        fclose(fid);
+    end
+
+    if ~isequal(char(prefix(1:4))', 'GCTE')
+        error('%s is not an envelope trajectory file', filename);
+    end
+    ints = double(typecast(prefix(5:16), 'int32'));
+    env.count    = ints(1);
+    env.window   = ints(2);
+    env.write_dt = typecast(prefix(17:24), 'double');
+
+    if size(data, 1) ~= env.count
+        warning('The actual number of windows (%d) does not match the expected count (%d).', size(data, 1), env.count);
+    end
+
+    env.t_first = data(:, 1);
+    env.t_last  = data(:, 2);
+    env.x       = data(:, 3:5);
+    env.y       = data(:, 6:8);
+    env.z       = data(:, 9:11);
+    env.p_para  = data(:, 12:14);
+
+    disp('Finished reading GCTE file.');
+end
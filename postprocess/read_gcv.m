@@ -0,0 +1,44 @@
+function sv = read_gcv(filename)
+    % Reads a sensitivity file (.gcv) written by Solver --variational[=matrix|ftle].
+    % One record per trajectory record.
+    %
+    % Returns:
+    %   sv (struct):
+    %     - count : number of records
+    %     - t     : Epoch time [s]
+    %     - ftle  : finite-time Lyapunov exponent [1/s] (0 at t_ini)
+    %     - Phi   : 5 x 5 x count sensitivity matrices dY(t)/dY(t_ini), Y = (t, x, y, z, p_para);
+    %               empty for --variational=ftle
+
+    disp(['Reading GCV file: ', fullfile(pwd, filename),' ...']);
+
+    fid = fopen(filename, 'rb');
+    if fid < 0
+        error('Failed to open file %s', filename);
+    end
+    % prefix: "GCVR", int32 count, int32 ncols
+    magic = fread(fid, 4, '*char')';
+    if ~isequal(magic, 'GCVR')
+        fclose(fid);
+        error('%s is not a sensitivity file', filename);
+    end
+    sv.count = fread(fid, 1, 'int32');
+    ncols = fread(fid, 1, 'int32');
+    data = fread(fid, [ncols, sv.count], 'double');
+    fclose(fid);
+
+    if size(data, 2) ~= sv.count
+        warning('The actual number of records (%d) does not match the expected count (%d).', size(data, 2), sv.count);
+    end
+
+    sv.t    = data(1, :)';
+    sv.ftle = data(2, :)';
+    if ncols == 27
+        % stored row by row
+        sv.Phi = permute(reshape(data(3:27, :), 5, 5, []), [2 1 3]);
+    else
+        sv.Phi = [];
+    end
+
+    disp('Finished reading GCV file.');
+end